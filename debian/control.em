@@ -3,7 +3,7 @@ Section: misc
 Priority: optional
 Maintainer: @(Maintainer)
 Build-Depends: debhelper (>= @(debhelper_version).0.0), @(', '.join(BuildDepends)),
- libgstreamer1.0-dev
+ libgstreamer1.0-dev, libgstrtspserver-1.0-dev
 Homepage: @(Homepage)
 Standards-Version: 3.9.2
 
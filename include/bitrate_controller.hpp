@@ -0,0 +1,197 @@
+#ifndef FOG_SW_DEPTHAI_BITRATE_CONTROLLER_H
+#define FOG_SW_DEPTHAI_BITRATE_CONTROLLER_H
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace depthai_ctrl
+{
+
+//! @brief Limits and reaction speed of the adaptive bitrate
+struct BitrateControllerConfig
+{
+  //! @brief Target range in bits per second
+  int minBitrate = 500000;
+  int maxBitrate = 3000000;
+  //! @brief Receiver report loss fraction which counts as congestion, 0.0 - 1.0
+  double lossThreshold = 0.02;
+  //! @brief Round trip time above the lowest one seen which counts as congestion
+  double roundTripRiseMs = 200.0;
+  //! @brief Queue fill which counts as congestion, 0.0 - 1.0. Half of it blocks increases.
+  double queueThreshold = 0.5;
+  //! @brief Multiplier of the target on congestion
+  double decreaseFactor = 0.7;
+  //! @brief Additive increase per step, as a fraction of maxBitrate
+  double increaseStep = 0.05;
+  //! @brief Minimum time between two decreases, so the encoder can react to the first one
+  int64_t decreaseIntervalMs = 2000;
+  //! @brief Time without congestion before the target rises, and between two increases
+  int64_t increaseHoldMs = 5000;
+};
+
+//! @brief Link state sampled from the streaming pipeline
+struct CongestionSample
+{
+  //! @brief Worst fraction lost of the RTCP receiver reports, 0.0 - 1.0
+  double fractionLost = 0.0;
+  //! @brief Worst round trip time of the receiver reports, 0 if unknown
+  double roundTripMs = 0.0;
+  //! @brief Fullest destination queue in front of the network sinks, 0.0 - 1.0
+  double sinkQueueFill = 0.0;
+  //! @brief Fill of the incoming chunk queue, 0.0 - 1.0
+  double queueFill = 0.0;
+  //! @brief Cumulative number of chunks and buffers dropped on the way to the sinks
+  uint64_t droppedFrames = 0;
+};
+
+//! @brief Target encoder bitrate from the congestion of the stream, additive increase and
+//! multiplicative decrease. Loss, a rising round trip time, filling queues and drops all
+//! cut the target at once, it only rises again after a quiet hold time. Not thread-safe.
+class BitrateController
+{
+public:
+  explicit BitrateController(const BitrateControllerConfig & config = BitrateControllerConfig())
+  : _config(config),
+    _target(config.maxBitrate)
+  {
+  }
+
+  //! @brief Change the target range, e.g. when the camera was started with another bitrate.
+  //! The target starts over from the maximum.
+  //! @param[in] minBitrate - lowest target
+  //! @param[in] maxBitrate - highest target
+  //! @return void
+  //!
+  void SetRange(int minBitrate, int maxBitrate)
+  {
+    _config.minBitrate = std::min(minBitrate, maxBitrate);
+    _config.maxBitrate = maxBitrate;
+    _target = maxBitrate;
+    _haveSample = false;
+  }
+
+  const BitrateControllerConfig & GetConfig() const {return _config;}
+
+  //! @brief Feed a new sample of the link state
+  //! @param[in] sample - congestion signals of the pipeline
+  //! @param[in] nowMs - monotonic time of the sample
+  //! @return the new target bitrate
+  //!
+  int Update(const CongestionSample & sample, int64_t nowMs)
+  {
+    if (!_haveSample) {
+      _haveSample = true;
+      _lastDroppedFrames = sample.droppedFrames;
+      _lastCongestionMs = nowMs;
+      _lastDecreaseMs = nowMs - _config.decreaseIntervalMs;
+      _lastIncreaseMs = nowMs;
+      _minRoundTripMs = 0.0;
+    }
+    if (sample.roundTripMs > 0.0 &&
+      (_minRoundTripMs <= 0.0 || sample.roundTripMs < _minRoundTripMs))
+    {
+      _minRoundTripMs = sample.roundTripMs;
+    }
+    const bool dropped = sample.droppedFrames > _lastDroppedFrames;
+    _lastDroppedFrames = sample.droppedFrames;
+    const bool delayed = sample.roundTripMs > 0.0 &&
+      sample.roundTripMs > _minRoundTripMs + _config.roundTripRiseMs;
+    const double queueFill = std::max(sample.sinkQueueFill, sample.queueFill);
+
+    if (dropped || delayed || sample.fractionLost > _config.lossThreshold ||
+      queueFill > _config.queueThreshold)
+    {
+      _lastCongestionMs = nowMs;
+      if (nowMs - _lastDecreaseMs >= _config.decreaseIntervalMs) {
+        _lastDecreaseMs = nowMs;
+        _target = std::max(
+          _config.minBitrate, (int)std::lround(_target * _config.decreaseFactor));
+        _decreases++;
+      }
+    } else if (queueFill > _config.queueThreshold * 0.5 ||
+      sample.fractionLost > _config.lossThreshold * 0.5)
+    {
+      // Close to the limit, stay here.
+      _lastIncreaseMs = nowMs;
+    } else if (nowMs - _lastCongestionMs >= _config.increaseHoldMs &&
+      nowMs - _lastIncreaseMs >= _config.increaseHoldMs && _target < _config.maxBitrate)
+    {
+      _lastIncreaseMs = nowMs;
+      _target = std::min(
+        _config.maxBitrate,
+        _target + (int)std::lround(_config.maxBitrate * _config.increaseStep));
+      _increases++;
+    }
+    return _target;
+  }
+
+  //! @brief Return the current target bitrate
+  int GetTarget() const {return _target;}
+
+  //! @brief Return number of decreases and increases of the target
+  uint64_t GetDecreases() const {return _decreases;}
+  uint64_t GetIncreases() const {return _increases;}
+
+private:
+  BitrateControllerConfig _config;
+  int _target;
+  bool _haveSample = false;
+  uint64_t _lastDroppedFrames = 0;
+  double _minRoundTripMs = 0.0;
+  int64_t _lastCongestionMs = 0;
+  int64_t _lastDecreaseMs = 0;
+  int64_t _lastIncreaseMs = 0;
+  uint64_t _decreases = 0;
+  uint64_t _increases = 0;
+};
+
+//! @brief Decides when a new target bitrate is worth a change of the encoder.
+//! Small changes are ignored, and changes are spaced out, since every change of the device
+//! encoder interrupts the stream. Decreases wait for interval, increases for twice that.
+class BitrateHysteresis
+{
+public:
+  //! @brief Constructor
+  //! @param[in] threshold - relative change below which a target is ignored, e.g. 0.15
+  //! @param[in] intervalMs - minimum time between two changes
+  //!
+  BitrateHysteresis(double threshold = 0.15, int64_t intervalMs = 10000)
+  : _threshold(threshold),
+    _intervalMs(intervalMs)
+  {
+  }
+
+  //! @brief Return true if the encoder should change from the current bitrate to the target
+  //! @param[in] current - bitrate of the encoder
+  //! @param[in] target - requested bitrate
+  //! @param[in] nowMs - monotonic time
+  //! @return true to apply the target, the change is then recorded at nowMs
+  //!
+  bool Apply(int current, int target, int64_t nowMs)
+  {
+    if (current <= 0 || target <= 0) {
+      return false;
+    }
+    const double change = (double)(target - current) / current;
+    if (std::abs(change) < _threshold) {
+      return false;
+    }
+    const int64_t wait = change > 0.0 ? 2 * _intervalMs : _intervalMs;
+    if (_changed && nowMs - _lastChangeMs < wait) {
+      return false;
+    }
+    _changed = true;
+    _lastChangeMs = nowMs;
+    return true;
+  }
+
+private:
+  double _threshold;
+  int64_t _intervalMs;
+  bool _changed = false;
+  int64_t _lastChangeMs = 0;
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_BITRATE_CONTROLLER_H
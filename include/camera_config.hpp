@@ -0,0 +1,140 @@
+#ifndef FOG_SW_DEPTHAI_CAMERA_CONFIG_H
+#define FOG_SW_DEPTHAI_CAMERA_CONFIG_H
+#include <algorithm>
+#include <cstdint>
+
+namespace depthai_ctrl
+{
+
+//! @brief Region of the color image in pixels, a zero size means the whole image
+struct CameraRegion
+{
+  uint16_t x = 0;
+  uint16_t y = 0;
+  uint16_t width = 0;
+  uint16_t height = 0;
+
+  bool IsSet() const {return width > 0 && height > 0;}
+  bool operator==(const CameraRegion & other) const
+  {
+    return x == other.x && y == other.y && width == other.width && height == other.height;
+  }
+  bool operator!=(const CameraRegion & other) const {return !(*this == other);}
+};
+
+//! @brief Settings of the camera node which a command may change
+struct CameraConfig
+{
+  //! @brief Video encoder, part of the device pipeline
+  int width = 1280;
+  int height = 720;
+  int fps = 25;
+  int bitrate = 3000000;
+  bool h265 = false;
+  //! @brief Output streams, each one is an XLinkOut of the device pipeline
+  bool useMonoCams = false;
+  bool useRawColorCam = false;
+  bool useStereoDepth = false;
+  //! @brief Color camera controls, sent to the running camera
+  bool autoFocus = false;
+  int lensPosition = 120;
+  //! @brief Manual exposure time and sensitivity, 0 for auto exposure
+  int exposureUs = 0;
+  int iso = 0;
+  //! @brief Auto focus and auto exposure region
+  CameraRegion region {};
+};
+
+//! @brief Cheapest way to apply a new configuration, ordered by cost
+enum class ReconfigureKind
+{
+  //! @brief Nothing changed
+  None,
+  //! @brief Camera control message to the running device
+  Control,
+  //! @brief Host side only, e.g. an output stream of the running pipeline turned on or off
+  Host,
+  //! @brief Another device pipeline, the device is opened again
+  Reboot
+};
+
+//! @brief Number of ReconfigureKind values
+constexpr int kReconfigureKinds = 4;
+
+//! @brief Return the name of a reconfiguration kind
+inline const char * ReconfigureKindName(ReconfigureKind kind)
+{
+  switch (kind) {
+    case ReconfigureKind::Control: return "control";
+    case ReconfigureKind::Host: return "host";
+    case ReconfigureKind::Reboot: return "reboot";
+    default: return "none";
+  }
+}
+
+//! @brief Return true if the camera control settings differ
+inline bool CameraControlsDiffer(const CameraConfig & a, const CameraConfig & b)
+{
+  return a.autoFocus != b.autoFocus || a.lensPosition != b.lensPosition ||
+         a.exposureUs != b.exposureUs || a.iso != b.iso || a.region != b.region;
+}
+
+//! @brief Return true if the output streams differ
+inline bool OutputStreamsDiffer(const CameraConfig & a, const CameraConfig & b)
+{
+  return a.useMonoCams != b.useMonoCams || a.useRawColorCam != b.useRawColorCam ||
+         a.useStereoDepth != b.useStereoDepth;
+}
+
+//! @brief Diff of a requested configuration against the running one.
+//! The device pipeline cannot be changed while it runs, so encoder settings and streams the
+//! pipeline was built without need a reboot. Streams of the running pipeline are turned off
+//! and on again on the host, camera controls go to the running camera.
+//! @param[in] pipeline - configuration the running device pipeline was built with
+//! @param[in] current - configuration applied so far
+//! @param[in] requested - new configuration
+//! @return the most expensive change, all cheaper changes are applied with it
+//!
+inline ReconfigureKind ClassifyReconfigure(
+  const CameraConfig & pipeline, const CameraConfig & current,
+  const CameraConfig & requested)
+{
+  const bool encoder = requested.width != pipeline.width ||
+    requested.height != pipeline.height || requested.fps != pipeline.fps ||
+    requested.bitrate != pipeline.bitrate || requested.h265 != pipeline.h265;
+  const bool newStream = (requested.useMonoCams && !pipeline.useMonoCams) ||
+    (requested.useRawColorCam && !pipeline.useRawColorCam) ||
+    (requested.useStereoDepth && !pipeline.useStereoDepth);
+  if (encoder || newStream) {
+    return ReconfigureKind::Reboot;
+  }
+  if (OutputStreamsDiffer(current, requested)) {
+    return ReconfigureKind::Host;
+  }
+  if (CameraControlsDiffer(current, requested)) {
+    return ReconfigureKind::Control;
+  }
+  return ReconfigureKind::None;
+}
+
+//! @brief Latency of the reconfigurations of one kind, from the command to the first
+//! encoded frame after the change was applied
+struct ReconfigureStats
+{
+  uint64_t count = 0;
+  double lastMs = 0.0;
+  double maxMs = 0.0;
+  double meanMs = 0.0;
+
+  void Add(double latencyMs)
+  {
+    count++;
+    lastMs = latencyMs;
+    maxMs = std::max(maxMs, latencyMs);
+    meanMs += (latencyMs - meanMs) / (double)count;
+  }
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_CAMERA_CONFIG_H
@@ -0,0 +1,240 @@
+#ifndef FOG_SW_DEPTHAI_CLOCK_DRIFT_H
+#define FOG_SW_DEPTHAI_CLOCK_DRIFT_H
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <mutex>
+
+namespace depthai_ctrl
+{
+
+//! @brief Current state of the clock model
+struct ClockDriftStats
+{
+  uint64_t samples = 0;         //!< Samples in the fit window
+  uint64_t resets = 0;          //!< Restarts of the model on device clock jumps
+  int64_t offsetNs = 0;         //!< Host minus device time at the newest sample
+  double skewPpm = 0.0;         //!< Host clock rate relative to the device clock, minus one
+  double residualRmsUs = 0.0;   //!< Spread of the receive times around the fit
+  double residualMaxUs = 0.0;
+  double receiveDelayMeanUs = 0.0;  //!< Mean receive delay above the fastest frame of the window
+};
+
+//! @brief Online estimate of the host steady clock as a linear function of the device clock.
+//! Every frame gives a pair of device capture time and host receive time. The fit follows
+//! the lower envelope of a sliding window, the frames which crossed the link fastest, so
+//! that late callbacks do not move the estimate. Mapped stamps are smooth from the first
+//! frame on, unlike the host synchronized device stamps during the first seconds after boot.
+//! The model is fitted again every 100 ms of device time and on frames below the envelope.
+//! Thread-safe, all output streams of the device feed one estimator.
+class ClockDriftEstimator
+{
+public:
+  //! @brief Constructor
+  //! @param[in] windowNs - time span of the samples of the fit
+  //! @param[in] maxSamples - maximum number of samples of the fit
+  //! @param[in] resetNs - device clock jump which restarts the model
+  //!
+  explicit ClockDriftEstimator(
+    int64_t windowNs = 60000000000LL, size_t maxSamples = 2048,
+    int64_t resetNs = 1000000000LL)
+  : _windowNs(windowNs),
+    _maxSamples(maxSamples),
+    _resetNs(resetNs)
+  {
+  }
+
+  //! @brief Add a frame
+  //! @param[in] deviceNs - device capture time
+  //! @param[in] hostReceiveNs - host steady clock time when the frame was received
+  //! @return void
+  //!
+  void AddSample(int64_t deviceNs, int64_t hostReceiveNs)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    bool belowEnvelope = false;
+    if (!_samples.empty()) {
+      // A device restart moves its clock back, a stall or reconnect makes the receive
+      // time jump away from the model. The streams arrive interleaved, a frame a little
+      // older than the newest one is no jump.
+      const bool backwards = deviceNs < _samples.back().deviceNs - _resetNs;
+      const int64_t error = hostReceiveNs - MapLocked(deviceNs);
+      if (backwards || error > _resetNs || error < -_resetNs) {
+        _samples.clear();
+        _stats.resets++;
+      }
+      belowEnvelope = error < 0;
+    }
+    // Kept in device time order, a late frame goes in just before the newest ones.
+    auto it = _samples.end();
+    while (it != _samples.begin() && std::prev(it)->deviceNs > deviceNs) {
+      --it;
+    }
+    // Frames of several streams may arrive with the same device time, one sample is enough.
+    if (it != _samples.begin() && std::prev(it)->deviceNs == deviceNs) {
+      std::prev(it)->hostNs = std::min(std::prev(it)->hostNs, hostReceiveNs);
+    } else {
+      _samples.insert(it, Sample{deviceNs, hostReceiveNs});
+    }
+    while (_samples.size() > _maxSamples ||
+      (_samples.size() > 2 && _samples.back().deviceNs - _samples.front().deviceNs > _windowNs))
+    {
+      _samples.pop_front();
+    }
+    _stats.samples = _samples.size();
+    // A fit takes a few passes over the window, the frames in between use the last one
+    // unless they crossed the link faster than the envelope.
+    if (_samples.size() == 1 || belowEnvelope ||
+      _samples.back().deviceNs - _referenceDeviceNs >= kFitIntervalNs)
+    {
+      FitLocked();
+    }
+  }
+
+  //! @brief Return true once a sample was added
+  bool IsValid() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return !_samples.empty();
+  }
+
+  //! @brief Map a device time to the host steady clock
+  //! @param[in] deviceNs - device time
+  //! @return host time, deviceNs if there are no samples yet
+  //!
+  int64_t ToHostNs(int64_t deviceNs) const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return MapLocked(deviceNs);
+  }
+
+  ClockDriftStats GetStats() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+  }
+
+private:
+  struct Sample
+  {
+    int64_t deviceNs;
+    int64_t hostNs;
+  };
+
+  int64_t MapLocked(int64_t deviceNs) const
+  {
+    if (_samples.empty()) {
+      return deviceNs;
+    }
+    // Relative to the reference sample, doubles keep sub-microsecond precision.
+    return _referenceHostNs + (int64_t)std::llround(
+      (double)(deviceNs - _referenceDeviceNs) * _slope + _interceptNs);
+  }
+
+  void FitLocked()
+  {
+    const Sample & newest = _samples.back();
+    _referenceDeviceNs = newest.deviceNs;
+    _referenceHostNs = newest.hostNs;
+    const double n = (double)_samples.size();
+
+    double meanX = 0.0, meanY = 0.0;
+    for (const Sample & sample : _samples) {
+      meanX += (double)(sample.deviceNs - _referenceDeviceNs);
+      meanY += (double)(sample.hostNs - _referenceHostNs);
+    }
+    meanX /= n;
+    meanY /= n;
+
+    // Least squares slope through the fastest frame of each slice of the window. The
+    // latency of the fastest frames hardly varies, a fit through all frames would carry
+    // the whole callback jitter into the skew.
+    const int64_t spanNs = newest.deviceNs - _samples.front().deviceNs;
+    _slope = 1.0;
+    // Over short spans the latency noise outweighs the skew, the clocks are assumed equal.
+    if (spanNs >= kMinSkewSpanNs) {
+      const int64_t slices = std::min<int64_t>((int64_t)kSlices, (int64_t)_samples.size());
+      Sample fastest[kSlices];
+      bool used[kSlices] = {};
+      for (const Sample & sample : _samples) {
+        const int64_t slice = std::min<int64_t>(
+          slices - 1, (sample.deviceNs - _samples.front().deviceNs) * slices / spanNs);
+        if (!used[slice] ||
+          sample.hostNs - sample.deviceNs < fastest[slice].hostNs - fastest[slice].deviceNs)
+        {
+          fastest[slice] = sample;
+          used[slice] = true;
+        }
+      }
+      double sx = 0.0, sy = 0.0, count = 0.0;
+      for (int64_t i = 0; i < slices; i++) {
+        if (used[i]) {
+          sx += (double)(fastest[i].deviceNs - _referenceDeviceNs);
+          sy += (double)(fastest[i].hostNs - _referenceHostNs);
+          count++;
+        }
+      }
+      double sxx = 0.0, sxy = 0.0;
+      for (int64_t i = 0; i < slices; i++) {
+        if (used[i]) {
+          const double dx = (double)(fastest[i].deviceNs - _referenceDeviceNs) - sx / count;
+          const double dy = (double)(fastest[i].hostNs - _referenceHostNs) - sy / count;
+          sxx += dx * dx;
+          sxy += dx * dy;
+        }
+      }
+      if (sxx > 0.0) {
+        // Crystal oscillators stay well within this, more is a fit on bad samples.
+        _slope = std::min(std::max(sxy / sxx, 1.0 - kMaxSkew), 1.0 + kMaxSkew);
+      }
+    }
+
+    // Lower envelope: the line through the sample with the least latency
+    double minLatency = 0.0, sumSquares = 0.0, maxResidual = 0.0;
+    bool first = true;
+    for (const Sample & sample : _samples) {
+      const double latency = (double)(sample.hostNs - _referenceHostNs) -
+        (double)(sample.deviceNs - _referenceDeviceNs) * _slope;
+      if (first || latency < minLatency) {
+        minLatency = latency;
+      }
+      first = false;
+    }
+    const double meanLatency = meanY - meanX * _slope;
+    for (const Sample & sample : _samples) {
+      const double residual = (double)(sample.hostNs - _referenceHostNs) -
+        (double)(sample.deviceNs - _referenceDeviceNs) * _slope - meanLatency;
+      sumSquares += residual * residual;
+      maxResidual = std::max(maxResidual, std::fabs(residual));
+    }
+    _interceptNs = minLatency;
+
+    _stats.offsetNs = MapLocked(newest.deviceNs) - newest.deviceNs;
+    _stats.skewPpm = (_slope - 1.0) * 1e6;
+    _stats.residualRmsUs = std::sqrt(sumSquares / n) / 1000.0;
+    _stats.residualMaxUs = maxResidual / 1000.0;
+    _stats.receiveDelayMeanUs = (meanLatency - minLatency) / 1000.0;
+  }
+
+  static constexpr int64_t kSlices = 16;
+  static constexpr int64_t kMinSkewSpanNs = 10000000000LL;
+  static constexpr int64_t kFitIntervalNs = 100000000LL;
+  static constexpr double kMaxSkew = 500e-6;
+
+  const int64_t _windowNs;
+  const size_t _maxSamples;
+  const int64_t _resetNs;
+  mutable std::mutex _mutex;
+  std::deque<Sample> _samples;
+  int64_t _referenceDeviceNs = 0;
+  int64_t _referenceHostNs = 0;
+  double _slope = 1.0;
+  double _interceptNs = 0.0;
+  ClockDriftStats _stats;
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_CLOCK_DRIFT_H
@@ -6,6 +6,7 @@
 #include <depthai/pipeline/datatype/ImgFrame.hpp>
 #include <depthai/pipeline/node/ColorCamera.hpp>
 #include <depthai/pipeline/node/MonoCamera.hpp>
+#include <depthai/pipeline/node/StereoDepth.hpp>
 #include <depthai/pipeline/node/VideoEncoder.hpp>
 #include <depthai/pipeline/node/XLinkIn.hpp>
 #include <depthai/pipeline/node/XLinkOut.hpp>
@@ -15,8 +16,19 @@
 #include <rclcpp/rclcpp.hpp>
 #include <sensor_msgs/msg/compressed_image.hpp>
 #include <sensor_msgs/msg/image.hpp>
+#include <sensor_msgs/msg/point_cloud2.hpp>
 #include <std_msgs/msg/string.hpp>
+#include <future>
 #include <iostream>
+#include "bitrate_controller.hpp"
+#include "camera_config.hpp"
+#include "clock_drift.hpp"
+#include "frame_source.h"
+#include "frame_watchdog.hpp"
+#include "image_kernels.hpp"
+#include "latency_tracer.hpp"
+#include "message_pool.hpp"
+#include "point_cloud.hpp"
 
 namespace depthai_ctrl
 {
@@ -29,6 +41,7 @@ class DepthAICamera : public rclcpp::Node
 public:
   using ImageMsg = sensor_msgs::msg::Image;
   using CompressedImageMsg = sensor_msgs::msg::CompressedImage;
+  using PointCloudMsg = sensor_msgs::msg::PointCloud2;
 
   DepthAICamera()
   : Node("depthai_camera"),
@@ -42,17 +55,15 @@ public:
     _useRawColorCam(false),
     _useAutoFocus(false),
     _useUSB3(false),
+    _useStereoDepth(false),
+    _latencyTracing(false),
     _thread_running(false),
     _left_camera_frame("left_camera_frame"),
     _right_camera_frame("right_camera_frame"),
-    _color_camera_frame("color_camera_frame"),
-    _leftCamCallback(0),
-    _rightCamCallback(0),
-    _colorCamCallback(0),
-    _videoEncoderCallback(0)
+    _color_camera_frame("color_camera_frame")
   {
     Initialize();
-    TryRestarting();
+    StartBoot();
   }
 
   DepthAICamera(const rclcpp::NodeOptions & options)
@@ -67,18 +78,16 @@ public:
     _useRawColorCam(false),
     _useAutoFocus(false),
     _useUSB3(false),
+    _useStereoDepth(false),
+    _latencyTracing(false),
     _thread_running(false),
     _left_camera_frame("left_camera_frame"),
     _right_camera_frame("right_camera_frame"),
-    _color_camera_frame("color_camera_frame"),
-    _leftCamCallback(0),
-    _rightCamCallback(0),
-    _colorCamCallback(0),
-    _videoEncoderCallback(0)
+    _color_camera_frame("color_camera_frame")
   {
 
     Initialize();
-    TryRestarting();
+    StartBoot();
   }
 
   ~DepthAICamera()
@@ -86,60 +95,228 @@ public:
     Stop();
   }
 
-  bool IsNodeRunning() {return bool(_device) && !_device->isClosed() && _thread_running;}
+  bool IsNodeRunning() {return bool(_frameSource) && _frameSource->IsRunning() && _thread_running;}
 
   void Stop()
   {
-    // TODO, maybe remove callbacks?
-    if (bool(_device)) {
-      _device->close();
+    // Closed on purpose, not an outage.
+    if (_watchdogTimer) {
+      _watchdogTimer->cancel();
+    }
+    _watchdog.Disarm();
+    // The device cannot be closed while it is being opened.
+    if (_bootFuture.valid()) {
+      _bootFuture.wait();
+    }
+    if (bool(_frameSource)) {
+      _frameSource->Close();
     }
   }
 
   void TryRestarting();
 
+  /// Wait for the device boot started by the constructor
+  /// Returns true if the camera is running, false on a timeout or a failed boot
+  bool WaitForBoot(std::chrono::milliseconds timeout);
+
+  /// Duration of the last device open, -1 before the first one finished
+  int64_t GetBootTimeMs() {return _bootTimeMs;}
+
+  /// Time from the process start to the first encoded frame, -1 before it
+  int64_t GetTimeToFirstFrameMs() {return _timeToFirstFrameMs;}
+
+  /// Apply a new configuration to the running camera with the cheapest kind of change:
+  /// camera controls, host side stream switches, or a new device pipeline. A new pipeline
+  /// is booted in the background. During a boot the configuration waits for it and None
+  /// is returned, a newer configuration replaces a waiting one.
+  ReconfigureKind Reconfigure(const CameraConfig & requested);
+
+  /// Configuration applied so far
+  CameraConfig GetConfig() const;
+
+  /// Latencies of the reconfigurations of one kind
+  ReconfigureStats GetReconfigureStats(ReconfigureKind kind);
+
+  /// Number of image messages allocated by the node for the raw, pyramid and depth topics,
+  /// constant in steady state
+  uint64_t GetImageMessageAllocations()
+  {
+    return _leftMessagePool.Allocations() + _rightMessagePool.Allocations() +
+           _colorMessagePool.Allocations() + _pyramidMessagePool.Allocations() +
+           _depthMessagePool.Allocations();
+  }
+
+  /// Number of raw images published in middleware loaned messages
+  uint64_t GetLoanedImageMessages() {return _loanedImageMessages;}
+
+  /// Number of raw images published from the preallocated message pools
+  uint64_t GetPooledImageMessages() {return _pooledImageMessages;}
+
+  /// Number of computed pyramid level images, levels without subscribers are skipped
+  uint64_t GetPyramidImages() {return _pyramidImages;}
+
+  /// Number of computed point clouds, none are computed without subscribers
+  uint64_t GetPointClouds() {return _pointClouds;}
+
+  /// State of the device to host clock model
+  ClockDriftStats GetClockDriftStats() const {return _clockEstimator.GetStats();}
+
+  /// Bitrate of the device video encoder
+  int GetVideoBitrate() const {return GetConfig().bitrate;}
+
+  /// Number of encoder bitrate changes requested by the adaptive bitrate target
+  uint64_t GetBitrateChanges() {return _bitrateChanges;}
+
+  /// Outages of the device frames and their recoveries
+  FrameWatchdogStats GetWatchdogStats() const {return _watchdog.GetStats();}
+
+  /// Fill and drops of the host queues of the output streams
+  std::map<std::string, QueueStats> GetQueueStats() const {return _frameSource->GetQueueStats();}
+
 private:
   void ProcessingThread();
   void changeLensPosition(int lens_position);
   void changeFocusMode(bool use_auto_focus);
-  void onLeftCamCallback(const std::shared_ptr<dai::ADatatype> data);
-  void onRightCallback(const std::shared_ptr<dai::ADatatype> data);
-  void onColorCamCallback(const std::shared_ptr<dai::ADatatype> data);
-  void onVideoEncoderCallback(const std::shared_ptr<dai::ADatatype> data);
-  std::shared_ptr<ImageMsg> ConvertImage(std::shared_ptr<dai::ImgFrame>, const std::string &);
+  void onLeftCamCallback(std::vector<std::shared_ptr<dai::ImgFrame>> & frames);
+  void onRightCallback(std::vector<std::shared_ptr<dai::ImgFrame>> & frames);
+  void onColorCamCallback(std::vector<std::shared_ptr<dai::ImgFrame>> & frames);
+  void onVideoEncoderCallback(std::vector<std::shared_ptr<dai::ImgFrame>> & frames);
+  void onDepthCallback(std::vector<std::shared_ptr<dai::ImgFrame>> & frames);
+  void PublishImage(
+    rclcpp::Publisher<ImageMsg> & publisher, MessagePool<ImageMsg> & pool,
+    const std::shared_ptr<dai::ImgFrame> & frame, const std::string & frame_id,
+    OutputEncoding outputEncoding);
+  /// Fill the message from the frame, converted to the output encoding if it is not Native.
+  /// Returns true if the frame data was moved into the message instead.
+  bool ConvertImage(
+    const std::shared_ptr<dai::ImgFrame> & input, const std::string & frame_id,
+    OutputEncoding outputEncoding, ImageMsg & message);
+  OutputEncoding GetOutputEncodingParameter(const std::string & name);
+  void PublishPyramid(const std::shared_ptr<dai::ImgFrame> & frame);
+  void PublishPointCloud(const std::shared_ptr<dai::ImgFrame> & frame);
+  void AddClockSamples(const std::vector<std::shared_ptr<dai::ImgFrame>> & frames);
+  rclcpp::Time FrameStamp(const std::shared_ptr<dai::ImgFrame> & frame) const;
+  void PublishClockDrift();
   void Initialize();
+  void StartBoot();
+  /// Open the device on a background thread, see RunBoot
+  void BootAsync(bool reconfigure);
+  /// Open the device, then apply the configurations posted meanwhile
+  void RunBoot(bool reconfigure);
+  bool IsBooting() const;
+  /// Apply a configuration to the running camera, except for a new pipeline
+  ReconfigureKind ApplyConfig(const CameraConfig & requested);
   void VideoStreamCommand(std_msgs::msg::String::SharedPtr);
+  void StoreConfig(const CameraConfig & config);
+  void SendCameraControls();
+  void CompleteReconfigure();
+  /// Announce a reboot of a reconfiguration, or its end with the first frame or a failure
+  void PublishBootState(bool rebooting);
+  void BitrateTargetCallback(std_msgs::msg::String::SharedPtr msg);
+  /// Report the frames of a stream to the watchdog
+  void WatchFrames(const std::string & stream, const std::vector<std::shared_ptr<dai::ImgFrame>> & frames);
+  void CheckFrameWatchdog();
+  StreamQueueConfig DeclareQueueParameters(
+    const std::string & prefix, const std::string & policy,
+    int depth);
+  /// Queue of a device output stream, with the depth in frames at the pipeline frame rate
+  StreamQueueConfig GetQueueConfig(const std::string & stream) const;
+  void PublishQueueStats();
 
-  std::shared_ptr<dai::Device> _device;
+  std::shared_ptr<FrameSource> _frameSource;
   std::shared_ptr<dai::Pipeline> _pipeline;
-  std::shared_ptr<dai::DataOutputQueue> _videoQueue;
-  std::shared_ptr<dai::DataOutputQueue> _leftQueue;
-  std::shared_ptr<dai::DataOutputQueue> _rightQueue;
-  std::shared_ptr<dai::DataOutputQueue> _colorQueue;
-  std::shared_ptr<dai::DataInputQueue> _colorCamInputQueue;
 
+  // Applied configuration, see GetConfig. Written under _configMutex, the stream switches
+  // are also read by the frame callbacks.
+  mutable std::mutex _configMutex;
   int _videoWidth;
   int _videoHeight;
   int _videoFps;
   int _videoBitrate;
   int _videoLensPosition;
-  bool _videoH265;
-  bool _useMonoCams;
-  bool _useRawColorCam;
+  std::atomic<bool> _videoH265;
+  std::atomic<bool> _useMonoCams;
+  std::atomic<bool> _useRawColorCam;
   bool _useAutoFocus;
   bool _useUSB3;
+  std::atomic<bool> _useStereoDepth;
+  bool _latencyTracing;
+  int _exposureUs = 0;
+  int _iso = 0;
+  CameraRegion _region;
   rclcpp::Time _lastFrameTime;
+  // Configuration of the running device pipeline, changes against it need a reboot
+  CameraConfig _pipelineConfig;
+  // Device discovery and boot, off the constructor so the executor spins meanwhile
+  std::mutex _restartMutex;
+  std::shared_future<void> _bootFuture;
+  // Under _configMutex: a boot is running, and the configuration posted during it
+  bool _booting = false;
+  bool _configQueued = false;
+  CameraConfig _queuedConfig;
+  std::atomic<int64_t> _bootTimeMs {-1};
+  std::atomic<int64_t> _timeToFirstFrameMs {-1};
+  std::mutex _reconfigureMutex;
+  ReconfigureKind _reconfigureKind = ReconfigureKind::None;
+  std::chrono::steady_clock::time_point _reconfigureStart;
+  ReconfigureStats _reconfigureStats[kReconfigureKinds];
+  std::atomic<bool> _reconfigurePending {false};
+  std::shared_ptr<rclcpp::Publisher<std_msgs::msg::String>> _reconfiguration_publisher;
+  std::shared_ptr<rclcpp::Publisher<std_msgs::msg::String>> _boot_state_publisher;
+  std::atomic<bool> _rebootAnnounced {false};
 
   std::shared_ptr<rclcpp::Publisher<ImageMsg>> _left_publisher;
   std::shared_ptr<rclcpp::Publisher<ImageMsg>> _right_publisher;
   std::shared_ptr<rclcpp::Publisher<ImageMsg>> _color_publisher;
   std::shared_ptr<rclcpp::Publisher<CompressedImageMsg>> _video_publisher;
+  // Raw image messages are reused, each stream callback runs on one thread at a time.
+  MessagePool<ImageMsg> _leftMessagePool {4};
+  MessagePool<ImageMsg> _rightMessagePool {4};
+  MessagePool<ImageMsg> _colorMessagePool {4};
+  std::atomic<uint64_t> _loanedImageMessages {0};
+  std::atomic<uint64_t> _pooledImageMessages {0};
+  // Encoding of the published raw images, Native publishes the device layout as is
+  OutputEncoding _leftOutputEncoding = OutputEncoding::Native;
+  OutputEncoding _rightOutputEncoding = OutputEncoding::Native;
+  OutputEncoding _colorOutputEncoding = OutputEncoding::Native;
+  // Downscaled color topics, level n is 1/2^n of the color image
+  std::vector<std::shared_ptr<rclcpp::Publisher<ImageMsg>>> _pyramidPublishers;
+  OutputEncoding _pyramidEncoding = OutputEncoding::BGR8;
+  MessagePool<ImageMsg> _pyramidMessagePool {4};
+  std::vector<uint8_t> _pyramidBase;
+  std::atomic<uint64_t> _pyramidImages {0};
+  // Depth of the StereoDepth node, aligned to the rectified right camera
+  std::shared_ptr<rclcpp::Publisher<ImageMsg>> _depth_publisher;
+  std::shared_ptr<rclcpp::Publisher<PointCloudMsg>> _points_publisher;
+  MessagePool<ImageMsg> _depthMessagePool {4};
+  MessagePool<PointCloudMsg> _pointsMessagePool {2};
+  std::mutex _depthIntrinsicsMutex;
+  DepthIntrinsics _depthIntrinsics;
+  DepthRayTable _depthRays;
+  double _depthHfovDeg = 71.9;
+  std::atomic<uint64_t> _pointClouds {0};
+  // Host time of the device capture stamps, shared by all topics
+  bool _useClockEstimator = true;
+  ClockDriftEstimator _clockEstimator;
+  std::shared_ptr<rclcpp::Publisher<std_msgs::msg::String>> _clock_drift_publisher;
+  rclcpp::TimerBase::SharedPtr _clockDriftTimer;
   rclcpp::Subscription<std_msgs::msg::String>::SharedPtr _stream_command_subscriber;
+  // Target bitrate of the GStreamer node, applied with hysteresis by restarting the encoder
+  rclcpp::Subscription<std_msgs::msg::String>::SharedPtr _bitrate_target_subscriber;
+  BitrateHysteresis _bitrateHysteresis;
+  std::atomic<uint64_t> _bitrateChanges {0};
+  // Reopens the device when its frames stop, the outages are published as JSON
+  FrameWatchdog _watchdog;
+  rclcpp::TimerBase::SharedPtr _watchdogTimer;
+  std::shared_ptr<rclcpp::Publisher<std_msgs::msg::String>> _watchdog_publisher;
+  uint64_t _watchdogEvents = 0;
+  // Latency against loss policy of the host queue of each device output stream
+  std::map<std::string, StreamQueueConfig> _queueConfigs;
+  std::shared_ptr<rclcpp::Publisher<std_msgs::msg::String>> _queue_stats_publisher;
+  rclcpp::TimerBase::SharedPtr _queueStatsTimer;
 
   std::atomic<bool> _thread_running;
   std::string _left_camera_frame, _right_camera_frame, _color_camera_frame;
-  dai::DataOutputQueue::CallbackId _leftCamCallback, _rightCamCallback, _colorCamCallback,
-    _videoEncoderCallback;
 
   std::unordered_map<dai::RawImgFrame::Type, std::string> encodingEnumMap = {
     {dai::RawImgFrame::Type::YUV422i, "yuv422"},
@@ -150,6 +327,16 @@ private:
     {dai::RawImgFrame::Type::RAW8, "8UC1"},
     {dai::RawImgFrame::Type::RAW16, "16UC1"}};
 
+  /// Device layouts the image kernels can convert to an output encoding
+  std::unordered_map<dai::RawImgFrame::Type, PixelFormat> pixelFormatEnumMap = {
+    {dai::RawImgFrame::Type::NV12, PixelFormat::NV12},
+    {dai::RawImgFrame::Type::YUV422i, PixelFormat::YUV422i},
+    {dai::RawImgFrame::Type::BGR888p, PixelFormat::BGR888p},
+    {dai::RawImgFrame::Type::RGB888p, PixelFormat::RGB888p},
+    {dai::RawImgFrame::Type::BGR888i, PixelFormat::BGR888i},
+    {dai::RawImgFrame::Type::RGB888i, PixelFormat::RGB888i},
+    {dai::RawImgFrame::Type::GRAY8, PixelFormat::GRAY8}};
+
 };
 
 }  // namespace depthai_ctrl
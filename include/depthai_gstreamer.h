@@ -17,6 +17,7 @@ class DepthAIGStreamer : public rclcpp::Node
     using CompressedImageMsg = sensor_msgs::msg::CompressedImage;
 
     DepthAIGStreamer(int argc, char* argv[]);
+    DepthAIGStreamer(int argc, char* argv[], const rclcpp::NodeOptions & options);
     DepthAIGStreamer(const rclcpp::NodeOptions & options);
     ~DepthAIGStreamer();
 
@@ -28,18 +29,34 @@ class DepthAIGStreamer : public rclcpp::Node
     GstInterface *_impl;
     rclcpp::Subscription<CompressedImageMsg>::SharedPtr _video_subscriber;
     rclcpp::Subscription<std_msgs::msg::String>::SharedPtr _stream_command_subscriber;
+    rclcpp::Subscription<std_msgs::msg::String>::SharedPtr _camera_boot_subscriber;
+    rclcpp::Publisher<std_msgs::msg::String>::SharedPtr _stream_stats_publisher;
+    rclcpp::Publisher<std_msgs::msg::String>::SharedPtr _stream_state_publisher;
+    rclcpp::Publisher<std_msgs::msg::String>::SharedPtr _stream_latency_publisher;
+    rclcpp::Publisher<std_msgs::msg::String>::SharedPtr _bitrate_target_publisher;
     rclcpp::TimerBase::SharedPtr _handle_stream_status_timer;
+    rclcpp::TimerBase::SharedPtr _stream_stats_timer;
+    rclcpp::TimerBase::SharedPtr _bitrate_timer;
 
     rclcpp::CallbackGroup::SharedPtr _callback_group_timer;
     rclcpp::CallbackGroup::SharedPtr _callback_group_video_subscriber;
     rclcpp::CallbackGroup::SharedPtr _callback_group_cmd_subscriber;
 
-    bool _is_stop_requested;
+    std::unique_ptr<StreamStateMachine> _stream_state;
+    uint64_t _last_bytes_pushed;
+    uint64_t _last_bytes_copied;
+    rclcpp::Time _last_stats_time;
+    int _camera_wait_ms = 2000;
     
     void Initialize();
-    void GrabVideoMsg(CompressedImageMsg::SharedPtr video_msg);
+    void GrabVideoMsg(CompressedImageMsg::UniquePtr video_msg);
     void HandleStreamStatus();
+    void PublishStreamStats();
+    void PublishLatencyStats();
+    void PublishBitrateTarget();
+    void PublishStreamState(const StreamTransition & transition);
     void VideoStreamCommand(const std_msgs::msg::String::SharedPtr msg);
+    void CameraBootState(const std_msgs::msg::String::SharedPtr msg);
 
 };
 
@@ -6,6 +6,11 @@
 #define FOG_SW_DEPTHAI_UTILS_H
 
 #include <arpa/inet.h>
+#include <time.h>
+#include <unistd.h>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
 #include <string>
 
 namespace depthai_ctrl
@@ -181,6 +186,45 @@ struct DepthAIUtils
         return true;
     }
 
+    /// Time since the process was started, from the start time the kernel keeps for it,
+    /// so it includes everything that ran before main. Resolution is one clock tick.
+    /// Returns -1 if /proc is not available.
+    static int64_t GetProcessUptimeMs()
+    {
+        std::ifstream stat("/proc/self/stat");
+        std::string line;
+        if (!std::getline(stat, line))
+        {
+            return -1;
+        }
+        // The command name may contain spaces, the fields are counted after it.
+        const size_t commandEnd = line.rfind(')');
+        if (commandEnd == std::string::npos)
+        {
+            return -1;
+        }
+        std::istringstream fields(line.substr(commandEnd + 1));
+        std::string field;
+        // starttime is field 22, the command name is field 2.
+        for (int i = 3; i <= 22; i++)
+        {
+            if (!(fields >> field))
+            {
+                return -1;
+            }
+        }
+        const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+        struct timespec now
+        {
+        };
+        if (ticksPerSecond <= 0 || clock_gettime(CLOCK_BOOTTIME, &now) != 0)
+        {
+            return -1;
+        }
+        const int64_t startMs = (int64_t)std::stoull(field) * 1000 / ticksPerSecond;
+        return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000 - startMs;
+    }
+
 };
 
 }  // namespace depthai_ctrl
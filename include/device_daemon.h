@@ -0,0 +1,75 @@
+#ifndef FOG_SW_DEPTHAI_DEVICE_DAEMON_H
+#define FOG_SW_DEPTHAI_DEVICE_DAEMON_H
+#include <rclcpp/rclcpp.hpp>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include "camera_config.hpp"
+#include "frame_source.h"
+#include "shm_frame_ring.hpp"
+
+namespace depthai_ctrl
+{
+
+/// ROS2 Node which owns the DepthAI device and shares it with other processes.
+/// The device stays booted while camera nodes with frame_source "shm" come and go. Every
+/// output stream of the device pipeline is written to a shared memory ring, see
+/// ShmFrameRing, and the clients post the configuration they need to a control block, see
+/// ShmDeviceControl. The device is rebooted only if the pipeline has to change, camera
+/// controls go to the running camera.
+class DeviceDaemon : public rclcpp::Node
+{
+public:
+  DeviceDaemon();
+  explicit DeviceDaemon(const rclcpp::NodeOptions & options);
+  ~DeviceDaemon() override;
+
+  /// Return true once the control block is published and clients may attach
+  bool IsReady() const {return bool(_control);}
+  /// Return true while the device delivers frames
+  bool IsDeviceRunning() const {return _device && _device->IsRunning();}
+  /// Return number of device boots, the first one included
+  uint64_t GetBoots() const {return _boots;}
+  /// Return number of frames written to the rings
+  uint64_t GetFramesWritten() const {return _framesWritten;}
+
+  /// Return the slot size of a ring, the largest frame of the stream
+  static uint32_t GetSlotBytes(const std::string & stream, const CameraConfig & config);
+
+private:
+  void Initialize();
+  /// Apply the configuration the clients posted, retry a failed boot
+  void Poll();
+  /// Close the device, create the rings of the pipeline and open the device again
+  bool Boot(const CameraConfig & config);
+  /// Publish the device state and release the slots of clients which are gone
+  void Housekeeping();
+  void WriteFrames(ShmFrameRing & ring, std::vector<std::shared_ptr<dai::ImgFrame>> & frames);
+
+  std::string _shmName;
+  uint32_t _shmSlots;
+  bool _useUSB3;
+  std::unique_ptr<ShmDeviceControl> _control;
+  // Declared before the device, its callbacks write the rings.
+  std::map<std::string, std::unique_ptr<ShmFrameRing>> _rings;
+  std::unique_ptr<DeviceFrameSource> _device;
+  std::shared_ptr<dai::Pipeline> _pipeline;
+  /// Configuration of the device pipeline and the applied one
+  CameraConfig _pipelineConfig;
+  CameraConfig _config;
+  bool _bootPending;
+  /// Calibration of the booted device, published with its state
+  bool _haveIntrinsics = false;
+  float _rightIntrinsics[9] = {};
+  std::chrono::steady_clock::time_point _nextBoot;
+  std::atomic<uint64_t> _boots;
+  std::atomic<uint64_t> _framesWritten;
+  rclcpp::TimerBase::SharedPtr _pollTimer;
+  rclcpp::TimerBase::SharedPtr _housekeepingTimer;
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_DEVICE_DAEMON_H
@@ -0,0 +1,213 @@
+#ifndef FOG_SW_DEPTHAI_FRAME_RECORDING_H
+#define FOG_SW_DEPTHAI_FRAME_RECORDING_H
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace depthai_ctrl
+{
+
+//! @brief One frame of a recording, encoded chunk or raw image of a device output stream
+struct RecordedFrame
+{
+  std::string stream;           //!< Output stream name, e.g. "enc26xColor" or "left"
+  uint32_t type = 0;            //!< dai::RawImgFrame::Type
+  uint32_t width = 0;
+  uint32_t height = 0;
+  int64_t sequenceNum = 0;
+  int64_t timestampNs = 0;      //!< Host synchronized capture time, steady clock
+  int64_t timestampDeviceNs = 0;  //!< Device capture time
+  std::vector<uint8_t> data;
+};
+
+//! @brief Recording file layout, host byte order:
+//! "DAIREC01", then per frame: u16 stream length, stream, u32 type, u32 width, u32 height,
+//! i64 sequence number, i64 timestamp, i64 device timestamp, u32 data size, data.
+namespace recording
+{
+inline const char * Magic() {return "DAIREC01";}
+constexpr size_t kMagicSize = 8;
+}  // namespace recording
+
+//! @brief Appends device frames to a recording file. Write is thread-safe,
+//! the device output queues call it from their own callback threads.
+class FrameRecordWriter
+{
+public:
+  FrameRecordWriter() = default;
+  ~FrameRecordWriter() {Close();}
+
+  FrameRecordWriter(const FrameRecordWriter &) = delete;
+  FrameRecordWriter & operator=(const FrameRecordWriter &) = delete;
+
+  //! @brief Create or truncate the recording file
+  //! @param[in] path - file path
+  //! @return true on success
+  //!
+  bool Open(const std::string & path)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    CloseLocked();
+    _file = std::fopen(path.c_str(), "wb");
+    if (_file == nullptr) {
+      return false;
+    }
+    if (std::fwrite(recording::Magic(), 1, recording::kMagicSize, _file) != recording::kMagicSize) {
+      CloseLocked();
+      return false;
+    }
+    return true;
+  }
+
+  bool IsOpen() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _file != nullptr;
+  }
+
+  //! @brief Append one frame
+  //! @param[in] frame - frame to write
+  //! @return true on success
+  //!
+  bool Write(const RecordedFrame & frame)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_file == nullptr) {
+      return false;
+    }
+    const uint16_t streamSize = (uint16_t)frame.stream.size();
+    const uint32_t dataSize = (uint32_t)frame.data.size();
+    bool ok = Put(streamSize) &&
+      std::fwrite(frame.stream.data(), 1, streamSize, _file) == streamSize &&
+      Put(frame.type) && Put(frame.width) && Put(frame.height) &&
+      Put(frame.sequenceNum) && Put(frame.timestampNs) && Put(frame.timestampDeviceNs) &&
+      Put(dataSize) &&
+      std::fwrite(frame.data.data(), 1, dataSize, _file) == dataSize;
+    _frames += ok ? 1 : 0;
+    return ok;
+  }
+
+  //! @brief Return number of written frames
+  uint64_t GetFrameCount() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _frames;
+  }
+
+  void Close()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    CloseLocked();
+  }
+
+private:
+  template<typename T>
+  bool Put(const T & value)
+  {
+    return std::fwrite(&value, sizeof(T), 1, _file) == 1;
+  }
+
+  void CloseLocked()
+  {
+    if (_file != nullptr) {
+      std::fclose(_file);
+      _file = nullptr;
+    }
+  }
+
+  mutable std::mutex _mutex;
+  std::FILE * _file = nullptr;
+  uint64_t _frames = 0;
+};
+
+//! @brief Reads the frames of a recording file in order
+class FrameRecordReader
+{
+public:
+  FrameRecordReader() = default;
+  ~FrameRecordReader() {Close();}
+
+  FrameRecordReader(const FrameRecordReader &) = delete;
+  FrameRecordReader & operator=(const FrameRecordReader &) = delete;
+
+  //! @brief Open a recording file and check its header
+  //! @param[in] path - file path
+  //! @return true if the file is a recording
+  //!
+  bool Open(const std::string & path)
+  {
+    Close();
+    _file = std::fopen(path.c_str(), "rb");
+    if (_file == nullptr) {
+      return false;
+    }
+    char magic[recording::kMagicSize];
+    if (std::fread(magic, 1, sizeof(magic), _file) != sizeof(magic) ||
+      std::memcmp(magic, recording::Magic(), sizeof(magic)) != 0)
+    {
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  bool IsOpen() const {return _file != nullptr;}
+
+  //! @brief Read the next frame. The data vector of the frame is reused.
+  //! @param[out] frame - next frame
+  //! @return false at the end of the file or on a truncated frame
+  //!
+  bool Read(RecordedFrame & frame)
+  {
+    if (_file == nullptr) {
+      return false;
+    }
+    uint16_t streamSize = 0;
+    uint32_t dataSize = 0;
+    if (!Get(streamSize)) {
+      return false;
+    }
+    frame.stream.resize(streamSize);
+    if (std::fread(&frame.stream[0], 1, streamSize, _file) != streamSize ||
+      !Get(frame.type) || !Get(frame.width) || !Get(frame.height) ||
+      !Get(frame.sequenceNum) || !Get(frame.timestampNs) || !Get(frame.timestampDeviceNs) ||
+      !Get(dataSize))
+    {
+      return false;
+    }
+    frame.data.resize(dataSize);
+    return std::fread(frame.data.data(), 1, dataSize, _file) == dataSize;
+  }
+
+  //! @brief Restart from the first frame
+  //! @return true on success
+  //!
+  bool Rewind()
+  {
+    return _file != nullptr && std::fseek(_file, (long)recording::kMagicSize, SEEK_SET) == 0;
+  }
+
+  void Close()
+  {
+    if (_file != nullptr) {
+      std::fclose(_file);
+      _file = nullptr;
+    }
+  }
+
+private:
+  template<typename T>
+  bool Get(T & value)
+  {
+    return std::fread(&value, sizeof(T), 1, _file) == 1;
+  }
+
+  std::FILE * _file = nullptr;
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_FRAME_RECORDING_H
@@ -0,0 +1,224 @@
+#ifndef FOG_SW_DEPTHAI_FRAME_SOURCE_H
+#define FOG_SW_DEPTHAI_FRAME_SOURCE_H
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#include <depthai/device/Device.hpp>
+#include <depthai/pipeline/datatype/CameraControl.hpp>
+#include <depthai/pipeline/datatype/ImgFrame.hpp>
+//restore compiler switches
+#pragma GCC diagnostic pop
+#include <rclcpp/rclcpp.hpp>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "camera_config.hpp"
+#include "frame_recording.hpp"
+#include "queue_policy.hpp"
+#include "shm_frame_ring.hpp"
+
+namespace depthai_ctrl
+{
+
+/// Source of the device output streams of DepthAICamera.
+/// The camera node builds the dai::Pipeline and registers one callback per output stream,
+/// the source delivers the frames of the stream in batches, like DataOutputQueue::tryGetAll.
+/// Callbacks are registered before Open, Close drops them.
+class FrameSource
+{
+public:
+  using FramesCallback = std::function<void (std::vector<std::shared_ptr<dai::ImgFrame>> &)>;
+
+  virtual ~FrameSource() = default;
+
+  /// Start the source with the pipeline, returns false if the source is not available
+  virtual bool Open(const dai::Pipeline & pipeline, bool usb2Mode) = 0;
+  /// Stop delivering frames and release the device or the recording
+  virtual void Close() = 0;
+  /// Return true while the source delivers frames
+  virtual bool IsRunning() const = 0;
+  /// Register the callback of an output stream with the policy of its queue, takes effect
+  /// with the next Open
+  virtual void AddCallback(
+    const std::string & stream, const StreamQueueConfig & queue,
+    FramesCallback callback) = 0;
+  /// Send a control message to the color camera, ignored if the source has no camera
+  virtual void SendColorCameraControl(const dai::CameraControl & control) = 0;
+  /// Configuration the pipeline and the camera controls were made from, for sources which
+  /// do not own the device and pass the configuration to its owner instead
+  virtual void SetCameraConfig(const CameraConfig & config) {(void)config;}
+  /// Return a short description of the connection for the logs
+  virtual std::string GetConnection() const = 0;
+  /// Return the queue telemetry of the output streams, empty if the source has no queues
+  virtual std::map<std::string, QueueStats> GetQueueStats() const {return {};}
+  /// Return the 3x3 intrinsic matrix of a camera at the given resolution, empty if unknown
+  virtual std::vector<std::vector<float>> GetCameraIntrinsics(
+    dai::CameraBoardSocket socket, int width,
+    int height) const
+  {
+    (void)socket;
+    (void)width;
+    (void)height;
+    return {};
+  }
+};
+
+/// Build the device pipeline of a configuration: color camera, video encoder and the
+/// XLinkOut streams the configuration uses, plus the "colorCamCtrl" control input
+std::shared_ptr<dai::Pipeline> CreateDevicePipeline(const CameraConfig & config);
+
+/// Return the output streams of the device pipeline of a configuration
+std::vector<std::string> GetDevicePipelineStreams(const CameraConfig & config);
+
+/// Color camera control of a configuration: focus, exposure and their region
+dai::CameraControl CreateCameraControl(const CameraConfig & config);
+
+/// Frame source backed by a connected DepthAI device.
+/// Optionally records every delivered frame, the recording can be played back with
+/// ReplayFrameSource.
+class DeviceFrameSource : public FrameSource
+{
+public:
+  explicit DeviceFrameSource(rclcpp::Logger logger, const std::string & recordPath = "");
+  ~DeviceFrameSource() override;
+
+  bool Open(const dai::Pipeline & pipeline, bool usb2Mode) override;
+  void Close() override;
+  bool IsRunning() const override;
+  void AddCallback(
+    const std::string & stream, const StreamQueueConfig & queue,
+    FramesCallback callback) override;
+  void SendColorCameraControl(const dai::CameraControl & control) override;
+  std::string GetConnection() const override;
+  std::map<std::string, QueueStats> GetQueueStats() const override;
+  std::vector<std::vector<float>> GetCameraIntrinsics(
+    dai::CameraBoardSocket socket, int width,
+    int height) const override;
+
+private:
+  struct StreamCallback
+  {
+    StreamQueueConfig queue;
+    FramesCallback callback;
+  };
+
+  void ReadThread(
+    const std::string & stream, std::shared_ptr<dai::DataOutputQueue> queue,
+    std::shared_ptr<QueueMonitor> monitor, FramesCallback callback);
+  void StopReading();
+  void Record(const std::string & stream, std::vector<std::shared_ptr<dai::ImgFrame>> & frames);
+
+  rclcpp::Logger _logger;
+  std::string _recordPath;
+  std::shared_ptr<dai::Device> _device;
+  std::shared_ptr<dai::DataInputQueue> _colorCamInputQueue;
+  std::map<std::string, StreamCallback> _callbacks;
+  std::map<std::string, std::shared_ptr<dai::DataOutputQueue>> _outputQueues;
+  std::vector<std::thread> _threads;
+  std::atomic<bool> _running;
+  QueueMonitorSet _queueMonitors;
+  FrameRecordWriter _recorder;
+};
+
+/// Frame source which plays back a recording made by DeviceFrameSource.
+/// Frames keep their original device timestamps and sequence numbers. The host synchronized
+/// timestamps are moved to the current steady clock, keeping their spacing, so that host
+/// side latencies stay meaningful. Playback runs at the recorded pace or as fast as possible.
+/// When looping, the timestamps and sequence numbers continue from the end of the recording.
+class ReplayFrameSource : public FrameSource
+{
+public:
+  ReplayFrameSource(rclcpp::Logger logger, const std::string & path, bool realtime, bool loop);
+  ~ReplayFrameSource() override;
+
+  bool Open(const dai::Pipeline & pipeline, bool usb2Mode) override;
+  void Close() override;
+  bool IsRunning() const override;
+  void AddCallback(
+    const std::string & stream, const StreamQueueConfig & queue,
+    FramesCallback callback) override;
+  void SendColorCameraControl(const dai::CameraControl & control) override;
+  std::string GetConnection() const override;
+
+  /// Return number of frames delivered since Open
+  uint64_t GetFrameCount() const {return _frames;}
+
+private:
+  void ReplayThread();
+  std::shared_ptr<dai::ImgFrame> CreateFrame(
+    RecordedFrame & record, int64_t deviceOffsetNs,
+    int64_t hostOffsetNs, int64_t sequenceOffset);
+
+  rclcpp::Logger _logger;
+  std::string _path;
+  bool _realtime;
+  bool _loop;
+  FrameRecordReader _reader;
+  std::map<std::string, FramesCallback> _callbacks;
+  std::thread _thread;
+  std::atomic<bool> _running;
+  std::atomic<uint64_t> _frames;
+};
+
+/// Frame source of a device owned by another process, see DeviceDaemon.
+/// The frames are read from the shared memory rings of the owner, one per output stream,
+/// and the camera configuration is posted to the owner, which reboots the device only if
+/// its pipeline has to change. The first client to post holds the configuration, the posts
+/// of other clients which conflict with it are rejected. Opening takes milliseconds while
+/// the owner keeps the device booted. The owner may be restarted, the rings are attached again.
+class SharedMemoryFrameSource : public FrameSource
+{
+public:
+  SharedMemoryFrameSource(rclcpp::Logger logger, const std::string & name);
+  ~SharedMemoryFrameSource() override;
+
+  bool Open(const dai::Pipeline & pipeline, bool usb2Mode) override;
+  void Close() override;
+  bool IsRunning() const override;
+  void AddCallback(
+    const std::string & stream, const StreamQueueConfig & queue,
+    FramesCallback callback) override;
+  /// The controls travel with the configuration, see SetCameraConfig
+  void SendColorCameraControl(const dai::CameraControl & control) override;
+  void SetCameraConfig(const CameraConfig & config) override;
+  std::string GetConnection() const override;
+  std::map<std::string, QueueStats> GetQueueStats() const override;
+  std::vector<std::vector<float>> GetCameraIntrinsics(
+    dai::CameraBoardSocket socket, int width,
+    int height) const override;
+
+  /// Return number of frames delivered since Open
+  uint64_t GetFrameCount() const {return _frames;}
+
+private:
+  struct StreamCallback
+  {
+    StreamQueueConfig queue;
+    FramesCallback callback;
+  };
+
+  void ReadThread(
+    const std::string & stream, std::shared_ptr<QueueMonitor> monitor,
+    FramesCallback callback);
+  /// Post the configuration to the owner, under _controlMutex
+  void PostConfig();
+
+  rclcpp::Logger _logger;
+  std::string _name;
+  std::map<std::string, StreamCallback> _callbacks;
+  QueueMonitorSet _queueMonitors;
+  mutable std::mutex _controlMutex;
+  std::unique_ptr<ShmDeviceControl> _control;
+  CameraConfig _config;
+  std::vector<std::thread> _threads;
+  std::atomic<bool> _running;
+  std::atomic<uint64_t> _frames;
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_FRAME_SOURCE_H
@@ -0,0 +1,204 @@
+#ifndef FOG_SW_DEPTHAI_FRAME_WATCHDOG_H
+#define FOG_SW_DEPTHAI_FRAME_WATCHDOG_H
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace depthai_ctrl
+{
+
+//! @brief Stall detection and recovery pacing of the frame watchdog
+struct FrameWatchdogConfig
+{
+  //! @brief Frame intervals without a frame of a stream which count as a stall
+  int missedIntervals = 10;
+  //! @brief Time for the first frame of a stream after the device was opened
+  int64_t firstFrameTimeoutMs = 5000;
+  //! @brief Wait after a reopen before the next one, doubled per attempt up to the maximum
+  int64_t minBackoffMs = 500;
+  int64_t maxBackoffMs = 10000;
+};
+
+//! @brief Outages seen by the watchdog
+struct FrameWatchdogStats
+{
+  uint64_t stalls = 0;          //!< Outages detected
+  uint64_t attempts = 0;        //!< Reopens of the device
+  uint64_t recoveries = 0;      //!< Outages which ended with frames of every stream
+  double lastDowntimeMs = 0.0;  //!< Last frame before the outage to every stream back
+  double maxDowntimeMs = 0.0;
+  double totalDowntimeMs = 0.0;
+  bool stalled = false;         //!< An outage is going on
+  std::string stalledStream;    //!< Stream of the last stall, "device" if the source stopped
+};
+
+//! @brief Watches the inter-frame gaps of the output streams against the frame rate.
+//! A stream which misses missedIntervals frame intervals, or a source which stopped, starts
+//! an outage. The owner then reopens the device when Check says so, with a backoff between
+//! the attempts. The outage ends when every stream delivered again. Thread-safe, the frame
+//! callbacks report frames while a timer checks.
+class FrameWatchdog
+{
+public:
+  explicit FrameWatchdog(const FrameWatchdogConfig & config = FrameWatchdogConfig())
+  : _config(config),
+    _backoffMs(config.minBackoffMs)
+  {
+  }
+
+  void SetConfig(const FrameWatchdogConfig & config)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _config = config;
+    _backoffMs = config.minBackoffMs;
+  }
+
+  //! @brief Watch the streams of a newly opened device, an outage goes on until they deliver
+  //! @param[in] streams - output streams of the device pipeline
+  //! @param[in] fps - frame rate of the streams
+  //! @param[in] nowMs - monotonic time of the open
+  //! @return void
+  //!
+  void Arm(const std::vector<std::string> & streams, int fps, int64_t nowMs)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _armed = true;
+    _stallMs = (int64_t)_config.missedIntervals * 1000 / std::max(fps, 1);
+    _streams.clear();
+    for (const std::string & stream : streams) {
+      _streams[stream] = Stream{nowMs, false};
+    }
+    if (_stats.stalled) {
+      // The device takes a while to open, the backoff counts from the end of the open.
+      _nextAttemptMs = std::max(_nextAttemptMs, nowMs + _lastBackoffMs);
+    }
+  }
+
+  //! @brief Stop watching, e.g. when the device is closed on purpose
+  void Disarm()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _armed = false;
+  }
+
+  //! @brief Report frames of a stream
+  //! @param[in] stream - output stream
+  //! @param[in] nowMs - monotonic receive time
+  //! @return true if the frames ended an outage
+  //!
+  bool OnFrames(const std::string & stream, int64_t nowMs)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _streams.find(stream);
+    if (it == _streams.end()) {
+      return false;
+    }
+    it->second.lastFrameMs = nowMs;
+    it->second.delivered = true;
+    if (!_stats.stalled) {
+      return false;
+    }
+    for (const auto & entry : _streams) {
+      if (!entry.second.delivered) {
+        return false;
+      }
+    }
+    const double downtime = (double)(nowMs - _outageStartMs);
+    _stats.recoveries++;
+    _stats.lastDowntimeMs = downtime;
+    _stats.maxDowntimeMs = std::max(_stats.maxDowntimeMs, downtime);
+    _stats.totalDowntimeMs += downtime;
+    _stats.stalled = false;
+    _backoffMs = _config.minBackoffMs;
+    return true;
+  }
+
+  //! @brief Look for a stall
+  //! @param[in] nowMs - monotonic time
+  //! @param[in] sourceRunning - false if the frame source stopped, a stall of its own
+  //! @return true if the device should be reopened now
+  //!
+  bool Check(int64_t nowMs, bool sourceRunning)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_armed) {
+      return false;
+    }
+    if (!_stats.stalled) {
+      std::string stalled;
+      int64_t lastFrameMs = nowMs;
+      if (!sourceRunning) {
+        stalled = "device";
+        for (const auto & entry : _streams) {
+          lastFrameMs = std::min(lastFrameMs, entry.second.lastFrameMs);
+        }
+      }
+      for (auto it = _streams.begin(); stalled.empty() && it != _streams.end(); ++it) {
+        const int64_t timeoutMs = it->second.delivered ? _stallMs : _config.firstFrameTimeoutMs;
+        if (nowMs - it->second.lastFrameMs > timeoutMs) {
+          stalled = it->first;
+          lastFrameMs = it->second.lastFrameMs;
+        }
+      }
+      if (stalled.empty()) {
+        return false;
+      }
+      _stats.stalls++;
+      _stats.stalled = true;
+      _stats.stalledStream = stalled;
+      _outageStartMs = lastFrameMs;
+      _nextAttemptMs = nowMs;
+      // Every stream has to deliver again to end the outage.
+      for (auto & entry : _streams) {
+        entry.second.delivered = false;
+      }
+    }
+    return nowMs >= _nextAttemptMs;
+  }
+
+  //! @brief Record a reopen of the device, the next one waits for the backoff
+  //! @param[in] nowMs - monotonic time of the attempt
+  //! @return the backoff until the next attempt
+  //!
+  int64_t OnRecoveryAttempt(int64_t nowMs)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.attempts++;
+    _lastBackoffMs = _backoffMs;
+    _nextAttemptMs = nowMs + _backoffMs;
+    _backoffMs = std::min(_config.maxBackoffMs, _backoffMs * 2);
+    return _lastBackoffMs;
+  }
+
+  FrameWatchdogStats GetStats() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+  }
+
+private:
+  struct Stream
+  {
+    int64_t lastFrameMs;
+    //! @brief Frames since the open, or since the stall during an outage
+    bool delivered;
+  };
+
+  mutable std::mutex _mutex;
+  FrameWatchdogConfig _config;
+  bool _armed = false;
+  int64_t _stallMs = 0;
+  std::map<std::string, Stream> _streams;
+  int64_t _backoffMs;
+  int64_t _lastBackoffMs = 0;
+  int64_t _outageStartMs = 0;
+  int64_t _nextAttemptMs = 0;
+  FrameWatchdogStats _stats;
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_FRAME_WATCHDOG_H
@@ -13,16 +13,24 @@
 #include <arpa/inet.h>
 
 #include "depthai_utils.h"
+#include "spsc_ring.hpp"
+#include "h26x_parser.hpp"
+#include "latency_tracer.hpp"
+#include "stream_state_machine.hpp"
+#include "bitrate_controller.hpp"
+#include <gst/app/gstappsink.h>
 #include <gst/app/gstappsrc.h>
 #include <gst/gst.h>
 #include <gst/gstbus.h>
 #include <gst/gstcaps.h>
 #include <gst/gstelement.h>
 #include <gst/gstpipeline.h>
+#include <gst/rtsp-server/rtsp-server.h>
 #include <sensor_msgs/msg/compressed_image.hpp>
 #include <std_msgs/msg/string.hpp>
 #include <mutex>
-#include <queue>
+#include <atomic>
+#include <vector>
 
 
 namespace depthai_ctrl
@@ -32,6 +40,42 @@ using std::placeholders::_1;
 
 using namespace std::chrono_literals;
 using CompressedImageMsg = sensor_msgs::msg::CompressedImage;
+
+//! @brief Connection and receiver report statistics of one embedded RTSP server client
+struct RtspClientStats
+{
+  //! @brief IP address of the client
+  std::string address;
+  //! @brief Time since the client connected
+  int64_t connectedMs;
+  //! @brief True once the client sent an RTCP receiver report
+  bool haveReceiverReport;
+  //! @brief Cumulative number of lost packets, from the last receiver report
+  int64_t packetsLost;
+  //! @brief Fraction of packets lost since the previous report, 0.0 - 1.0
+  double fractionLost;
+  //! @brief Interarrival jitter in milliseconds
+  double jitterMs;
+  //! @brief Round trip time in milliseconds
+  double roundTripMs;
+};
+
+//! @brief On-board recording settings, see GstInterface::SetRecording
+struct RecordingConfig
+{
+  //! @brief splitmuxsink location pattern, e.g. "/data/video_%05d.mkv", empty disables recording.
+  //! A ".mkv" extension selects Matroska, anything else fragmented MP4.
+  std::string location;
+  //! @brief Segment duration limit in nanoseconds, 0 for no limit
+  uint64_t maxSegmentTimeNs = 60 * GST_SECOND;
+  //! @brief Segment size limit in bytes, 0 for no limit
+  uint64_t maxSegmentBytes = 0;
+  //! @brief Number of segments kept, the oldest one is overwritten, 0 keeps all
+  unsigned maxFiles = 0;
+  //! @brief Disk space reserved for each segment when it is opened, 0 for none
+  uint64_t preallocateBytes = 0;
+};
+
 class GstInterface
 {
 public:
@@ -82,6 +126,31 @@ public:
   //!
   void BuildPipeline();
 
+  //! @brief Build the hot-standby pipeline
+  //! The default and the camera branches both feed an input-selector, the active
+  //! input is switched on the first camera key frame and after the last camera frame,
+  //! without restarting the pipeline or the RTSP session.
+  //! @return void
+  //!
+  void BuildStandbyPipeline();
+
+  //! @brief Set encoder width
+  //! @param[in] width - width of the encoder
+  //! @return void
+  //!
+  void SetEncoderWidth(int width)
+  {
+    if (width > 4096) {
+      g_printerr("Width must be smaller than 4096 for H26x encoder profile.\n");
+      return;
+    }
+    if (width % 8 != 0) {
+      g_printerr("Width must be multiple of 8 for H26x encoder profile.\n");
+      return;
+    }
+    _encoderWidth = width;
+  }
+
   //! @brief Return encoder width
   //! @return encoder width
   //!
@@ -120,6 +189,7 @@ public:
       return;
     }
     _encoderFps = fps;
+    _queue.SetLimits((size_t)_encoderFps * 2, _queueMaxBytes);
   }
   //! @brief Return encoder fps
   //!
@@ -202,12 +272,324 @@ public:
   //!
   bool IsErrorDetected() {return _isErrorDetected;}
 
-  //! @brief Incoming message queue, shared with ROS2 node.
-  std::queue<CompressedImageMsg::SharedPtr> queue {};
+  //! @brief Enable or disable zero-copy wrapping of incoming chunks.
+  //! When disabled, each chunk is copied into a newly allocated GstBuffer.
+  //! @param[in] zeroCopy - true to wrap message storage directly
+  //! @return void
+  //!
+  void SetZeroCopy(bool zeroCopy) {_zeroCopy = zeroCopy;}
+
+  //! @brief Return is zero-copy buffer wrapping enabled.
+  //! @return true if chunks are wrapped without copying, false otherwise.
+  //!
+  bool IsZeroCopy() {return _zeroCopy;}
+
+  //! @brief Enable or disable push-mode feeding of the appsrc.
+  //! In push mode the chunks are pushed to the appsrc as they arrive, instead of
+  //! blocking the streaming thread in the need-data callback. Applied on the next StartStream.
+  //! @param[in] pushMode - true to push chunks as they arrive
+  //! @return void
+  //!
+  void SetPushMode(bool pushMode) {_pushMode = pushMode;}
+
+  //! @brief Return is push-mode feeding enabled.
+  //! @return true if chunks are pushed as they arrive, false otherwise.
+  //!
+  bool IsPushMode() {return _pushMode;}
+
+  //! @brief Set max-bytes of the appsrc internal queue, used in push mode.
+  //! @param[in] maxBytes - max-bytes of the appsrc
+  //! @return void
+  //!
+  void SetAppSrcMaxBytes(guint64 maxBytes) {_appSrcMaxBytes = maxBytes;}
+
+  //! @brief Return number of backlog batches pushed as GstBufferList in push mode.
+  //! @return buffer list pushes since construction
+  //!
+  uint64_t GetBufferListPushes() {return _bufferListPushes;}
+
+  //! @brief Return total number of bytes pushed to the appsrc.
+  //! @return pushed bytes since construction
+  //!
+  uint64_t GetBytesPushed() {return _bytesPushed;}
+
+  //! @brief Return total number of bytes copied while handing chunks to GStreamer.
+  //! Stays at zero as long as the zero-copy path is used.
+  //! @return copied bytes since construction
+  //!
+  uint64_t GetBytesCopied() {return _bytesCopied;}
+
+  //! @brief Queue an incoming video chunk for the pipeline.
+  //! Must be called from a single producer thread, the ROS2 video subscriber.
+  //! Overflow handling is GOP-aware: above three quarters of the queue limits
+  //! non-reference pictures are dropped first. When a chunk does not fit, the rest
+  //! of its GOP is skipped and queuing resumes at the next key frame.
+  //! @param[in] videoPtr - the incoming video chunk
+  //! @return false if the queue was full and the chunk was dropped
+  //!
+  bool PushFrame(const CompressedImageMsg::SharedPtr & videoPtr);
+
+  //! @brief Take the oldest queued video chunk, as the pipeline does.
+  //! Only to be called while the stream is stopped, the queue has a single consumer.
+  //! @param[out] videoPtr - the oldest queued chunk, if any
+  //! @return false if the queue is empty
+  //!
+  bool PopFrame(CompressedImageMsg::SharedPtr & videoPtr) {return _queue.Pop(videoPtr);}
+
+  //! @brief Drop all queued video chunks.
+  //! Safe to call from any thread, the chunks are dropped before the next dequeue.
+  //! @return void
+  //!
+  void ClearQueue() {_queue.RequestClear();}
+
+  //! @brief Set byte budget of the incoming chunk queue.
+  //! The frame count limit follows the encoder fps (two seconds of video).
+  //! @param[in] maxBytes - maximum number of queued bytes
+  //! @return void
+  //!
+  void SetQueueMaxBytes(size_t maxBytes)
+  {
+    _queueMaxBytes = maxBytes;
+    _queue.SetLimits((size_t)_encoderFps * 2, _queueMaxBytes);
+  }
+
+  //! @brief Return number of queued video chunks
+  size_t GetQueueSize() {return _queue.Size();}
+
+  //! @brief Return number of queued video bytes
+  size_t GetQueueBytes() {return _queue.Bytes();}
+
+  //! @brief Return the highest queued chunk count since the last reset
+  size_t GetQueueHighWaterFrames() {return _queue.HighWaterFrames();}
+
+  //! @brief Return the highest queued byte count since the last reset
+  size_t GetQueueHighWaterBytes() {return _queue.HighWaterBytes();}
+
+  //! @brief Restart queue high-water mark tracking from the current occupancy
+  void ResetQueueHighWaterMarks() {_queue.ResetHighWaterMarks();}
+
+  //! @brief Return number of chunks dropped because the queue was full
+  uint64_t GetQueueDroppedFrames() {return _queueDroppedFrames;}
+
+  //! @brief Return number of non-reference pictures dropped early on a filling queue
+  uint64_t GetNonReferenceDroppedFrames() {return _nonReferenceDroppedFrames;}
+
+  //! @brief Return number of GOP tails skipped until the next key frame
+  uint64_t GetSkippedGops() {return _skippedGops;}
+
+  //! @brief Send the cached parameter sets and current GOP before the next queued chunk.
+  //! Called on pipeline start and whenever a new receiver needs a decodable picture.
+  //! @return void
+  //!
+  void RequestGopReplay() {_gopReplayPending = true;}
+
+  //! @brief Add a destination streamed in addition to the stream address.
+  //! Each destination gets its own branch after the tee, with a leaky queue.
+  //! A running pipeline gets the new branch without restart.
+  //! @param[in] address - UDP or RTSP address
+  //! @return false if the destination is already streamed, or is the RTSP server or the
+  //! recording
+  //!
+  bool AddDestination(const std::string & address);
+
+  //! @brief Remove an additional destination, without restarting the pipeline.
+  //! @param[in] address - address given to AddDestination
+  //! @return false if there is no such destination
+  //!
+  bool RemoveDestination(const std::string & address);
+
+  //! @brief Return the stream address followed by the additional destinations
+  std::vector<std::string> GetDestinations();
+
+  //! @brief Return number of additional destination branches dropped on errors
+  uint64_t GetDestinationErrors() {return _destinationErrors;}
+
+  //! @brief Enable the embedded RTSP server. Must be called before the first StartStream.
+  //! The encoded stream is served to any number of clients through one shared media,
+  //! fed from a branch of the destination tee. The stream address may be left empty
+  //! to stream through the embedded server only.
+  //! @param[in] port - server port, 0 disables the server
+  //! @param[in] mount - mount point of the stream, e.g. "/video"
+  //! @return void
+  //!
+  void SetRtspServer(int port, const std::string & mount)
+  {
+    _rtspServerPort = port;
+    _rtspServerMount = mount;
+  }
+
+  //! @brief Return is the embedded RTSP server enabled
+  bool IsRtspServerEnabled() {return _rtspServerPort > 0;}
+
+  //! @brief Return the URL served by the embedded RTSP server, for a local client
+  std::string GetRtspServerUrl()
+  {
+    return "rtsp://127.0.0.1:" + std::to_string(_rtspServerPort) + _rtspServerMount;
+  }
+
+  //! @brief Return statistics of the clients connected to the embedded RTSP server
+  std::vector<RtspClientStats> GetRtspClientStats();
+
+  //! @brief Return number of buffers handed to the shared media of the embedded server
+  uint64_t GetRtspServerBuffers() {return _rtspServerBuffers;}
+
+  //! @brief Enable on-board recording of the encoded stream. Applied on the next StartStream.
+  //! The chunks are muxed without re-encoding into segments, which splitmuxsink only
+  //! cuts at key frames. The recording branch is fed from the destination tee through
+  //! a leaky queue, a slow disk drops recorded buffers instead of stalling the stream.
+  //! The default "Camera not detected" stream is not recorded.
+  //! @param[in] config - recording settings, an empty location disables recording
+  //! @return void
+  //!
+  void SetRecording(const RecordingConfig & config) {_recordingConfig = config;}
+
+  //! @brief Return is on-board recording enabled
+  bool IsRecordingEnabled() {return !_recordingConfig.location.empty();}
+
+  //! @brief Return the destination name of the recording branch
+  std::string GetRecordingAddress() {return "file://" + _recordingConfig.location;}
+
+  //! @brief Return the file of the segment being recorded, empty before the first one
+  std::string GetRecordingSegment()
+  {
+    std::lock_guard<std::mutex> lock(_recordingMutex);
+    return _recordingSegment;
+  }
+
+  //! @brief Return number of opened recording segments
+  uint64_t GetRecordedSegments() {return _recordedSegments;}
+
+  //! @brief Return number of times the recording queue was full and dropped buffers
+  uint64_t GetRecordingOverruns() {return _recordingOverruns;}
+
+  //! @brief Set the handler receiving pipeline state events from the bus watch.
+  //! Must be set before StartStream. The handler is called from GStreamer threads.
+  //! @param[in] handler - event handler, e.g. posting to a StreamStateMachine
+  //! @return void
+  //!
+  void SetStreamEventHandler(std::function<void(StreamEvent)> handler)
+  {
+    _streamEventHandler = handler;
+  }
+
+  //! @brief Set how long pipeline creation waits for camera data before choosing
+  //! the default stream. Applied on the next StartStream.
+  //! @param[in] waitMs - waiting time in milliseconds, 0 decides on the queued data only
+  //! @return void
+  //!
+  void SetPipelineDataWaitMs(int waitMs) {_pipelineDataWaitMs = waitMs;}
+
+  //! @brief Enable or disable the hot-standby pipeline. Applied on the next StartStream.
+  //! @param[in] hotStandby - true to keep default and camera branches in one pipeline
+  //! @return void
+  //!
+  void SetHotStandby(bool hotStandby) {_hotStandby = hotStandby;}
+
+  //! @brief Return is the hot-standby pipeline enabled.
+  //! @return true if default and camera branches share one pipeline, false otherwise.
+  //!
+  bool IsHotStandby() {return _hotStandby;}
+
+  //! @brief Set time without camera frames before switching back to the default input.
+  //! @param[in] timeoutMs - timeout in milliseconds
+  //! @return void
+  //!
+  void SetHotStandbyTimeoutMs(int64_t timeoutMs) {_hotStandbyTimeoutMs = timeoutMs;}
+
+  //! @brief Return number of input switches of the hot-standby pipeline
+  uint64_t GetStreamSwitches() {return _streamSwitches;}
+
+  //! @brief Return latency of the last input switch.
+  //! Measured from the first camera chunk, or from the last one when switching back.
+  //! @return milliseconds, or -1 if no switch has happened yet
+  //!
+  int64_t GetLastSwitchLatencyMs() {return _lastSwitchLatencyMs;}
+
+  //! @brief Enable or disable end-to-end latency tracing of the camera chunks.
+  //! The pad probes are added on the next StartStream.
+  //! @param[in] enabled - true to trace the chunks stamped by the camera node
+  //! @return void
+  //!
+  void SetLatencyTracing(bool enabled) {_latencyTracer.SetEnabled(enabled);}
+
+  //! @brief Return is latency tracing enabled
+  bool IsLatencyTracing() {return _latencyTracer.IsEnabled();}
+
+  //! @brief Return the latency percentiles of every traced interval and restart them
+  std::vector<LatencyStats> TakeLatencyStats() {return _latencyTracer.TakeStats();}
+
+  //! @brief Return time from StartStream to the first key frame pushed to the appsrc.
+  //! @return milliseconds, or -1 if no key frame has been pushed yet
+  //!
+  int64_t GetTimeToFirstDecodableFrameMs() {return _timeToFirstDecodableFrameMs;}
+
+  //! @brief Return time from the process start to the first camera packet handed to a
+  //! network sink, the boot-to-video time of the whole process. Restarts keep the first value.
+  //! @return milliseconds, or -1 if no camera packet has been sent yet
+  //!
+  int64_t GetTimeToFirstPacketMs() {return _timeToFirstPacketMs;}
+
+  //! @brief Enable the adaptive bitrate, see UpdateTargetBitrate
+  //! @param[in] config - target range and reaction speed
+  //! @return void
+  //!
+  void SetAdaptiveBitrate(const BitrateControllerConfig & config)
+  {
+    std::lock_guard<std::mutex> lock(_bitrateMutex);
+    _adaptiveBitrate = true;
+    _bitrateController = BitrateController(config);
+  }
+
+  //! @brief Return is the adaptive bitrate enabled
+  bool IsAdaptiveBitrate() {return _adaptiveBitrate;}
+
+  //! @brief Change the target range of the adaptive bitrate, the target restarts from the maximum
+  //! @param[in] minBitrate - lowest target
+  //! @param[in] maxBitrate - highest target, usually the bitrate the camera was started with
+  //! @return void
+  //!
+  void SetAdaptiveBitrateRange(int minBitrate, int maxBitrate)
+  {
+    std::lock_guard<std::mutex> lock(_bitrateMutex);
+    _bitrateController.SetRange(minBitrate, maxBitrate);
+  }
+
+  //! @brief Sample the congestion of the stream and update the target bitrate.
+  //! Combines the RTCP receiver reports of the embedded server clients and of the
+  //! rtspclientsink, the fill of the destination queues in front of the network sinks,
+  //! the incoming chunk queue and the dropped chunks. Called periodically, e.g. every 500 ms.
+  //! @return the target bitrate
+  //!
+  int UpdateTargetBitrate();
+
+  //! @brief Return the target bitrate of the last update
+  int GetTargetBitrate()
+  {
+    std::lock_guard<std::mutex> lock(_bitrateMutex);
+    return _bitrateController.GetTarget();
+  }
+
+  //! @brief Return the congestion signals of the last update
+  CongestionSample GetCongestion()
+  {
+    std::lock_guard<std::mutex> lock(_bitrateMutex);
+    return _congestion;
+  }
+
+  //! @brief Return number of target decreases and increases
+  uint64_t GetBitrateDecreases()
+  {
+    std::lock_guard<std::mutex> lock(_bitrateMutex);
+    return _bitrateController.GetDecreases();
+  }
+  uint64_t GetBitrateIncreases()
+  {
+    std::lock_guard<std::mutex> lock(_bitrateMutex);
+    return _bitrateController.GetIncreases();
+  }
 
-  //! @brief GCond for queue
-  GCond haveDataCond {};
-  GMutex haveDataCondMutex {};
+  //! @brief Return number of times a network destination queue was full and dropped buffers
+  uint64_t GetDestinationOverruns() {return _destinationOverruns;}
 
 protected:
   //! @brief GThreadFunc for gstreamer main loop
@@ -216,15 +598,230 @@ protected:
   //!
   static void * PlayStream(gpointer data);
 
+  //! @brief Pass an event to the stream event handler, if any
+  //! @param[in] event - the event
+  //! @return void
+  //!
+  void NotifyStreamEvent(StreamEvent event)
+  {
+    if (_streamEventHandler) {
+      _streamEventHandler(event);
+    }
+  }
+
+  //! @brief Report the playing pipeline with its current input
+  //! @return void
+  //!
+  void NotifyStreamPlaying()
+  {
+    NotifyStreamEvent(
+      _isStreamDefault ? StreamEvent::PipelinePlayingDefault : StreamEvent::PipelinePlaying);
+  }
+
+  //! @brief Add the bus watch and start the main loop thread for the built pipeline
+  //! @return void
+  //!
+  void StartPipelineLoop();
+
+  //! @brief Feed the destination branches through a tee from the upstream element
+  //! @param[in] upstream - last element of the encoded stream, already in the pipeline
+  //! @return void
+  //!
+  void LinkDestinations(GstElement * upstream);
+
+  //! @brief Create the sink bin of a destination: leaky queue, payloader and sink
+  //! @param[in] address - UDP or RTSP address
+  //! @param[in] primary - true for the stream address, its elements are kept in members
+  //! @return the bin with a "sink" ghost pad
+  //!
+  GstElement * CreateDestinationBin(const std::string & address, bool primary);
+
+  //! @brief Read the congestion signals of the running pipeline
+  //! @return the sample, all zero without a pipeline
+  //!
+  CongestionSample SampleCongestion();
+
+  //! @brief Read the RTCP receiver reports of an RTP session
+  //! @param[in] session - RTPSession object
+  //! @param[out] reports - one entry per reporting source, address is the "rtcp-from" host:port
+  //! @return void
+  //!
+  static void ReadReceiverReports(GObject * session, std::vector<RtspClientStats> & reports);
+
+  //! @brief rtspclientsink "new-manager" signal, keeps the rtpbin for its receiver reports
+  static void RtspSinkManagerCallBack(GstElement * sink, GstElement * manager, gpointer data);
+
+  //! @brief queue "overrun" signal of the network destinations, counts the dropped buffers
+  static void DestinationOverrunCallBack(GstElement * queue, gpointer data);
+
+  //! @brief Add a destination bin to the pipeline and link it to the tee.
+  //! Caller holds _destinationsMutex.
+  //! @param[in] address - UDP or RTSP address
+  //! @param[in] primary - true for the stream address
+  //! @return void
+  //!
+  void AddDestinationBranch(const std::string & address, bool primary);
+
+  //! @brief Unlink a destination bin from the tee once its pad is idle, then remove it.
+  //! Caller holds _destinationsMutex.
+  //! @param[in] address - UDP or RTSP address
+  //! @return void
+  //!
+  void RemoveDestinationBranch(const std::string & address);
+
+  //! @brief GstPadProbeCallback, unlinks a destination from the idle tee pad
+  static GstPadProbeReturn UnlinkDestinationProbe(
+    GstPad * pad, GstPadProbeInfo * info,
+    gpointer data);
+
+  //! @brief GSourceFunc, shuts down and removes an unlinked destination bin
+  static gboolean FinishDestinationRemoval(gpointer data);
+
+  //! @brief Return true if the element belongs to an additional destination branch
+  //! @param[in] object - element, e.g. the source of a bus message
+  //!
+  bool IsExtraDestinationElement(GstObject * object);
+
+  //! @brief Remove the additional destination branch the failed element belongs to
+  //! @param[in] object - element that posted the error
+  //! @return void
+  //!
+  void DropFailedDestination(GstObject * object);
+
+  //! @brief Create the tee branch feeding the embedded RTSP server: leaky queue and appsink
+  //! @return the bin with a "sink" ghost pad
+  //!
+  GstElement * CreateServerBin();
+
+  //! @brief Create the tee branch of the on-board recording: leaky queue, parser and splitmuxsink
+  //! @return the bin with a "sink" ghost pad
+  //!
+  GstElement * CreateRecordingBin();
+
+  //! @brief Track the segments of the recording from the splitmuxsink bus messages.
+  //! Disk space is reserved for an opened segment and the unused rest released
+  //! when it is closed.
+  //! @param[in] message - splitmuxsink-fragment-opened or -closed element message
+  //! @return void
+  //!
+  void HandleRecordingMessage(GstMessage * message);
+
+  //! @brief Callback for the overrun signal of the recording queue
+  static void RecordingOverrunCallBack(GstElement * queue, gpointer data);
+
+  //! @brief Start the embedded RTSP server on its own main loop thread, if enabled
+  //! @return void
+  //!
+  void StartRtspServer();
+
+  //! @brief Stop the embedded RTSP server and disconnect its clients
+  //! @return void
+  //!
+  void StopRtspServer();
+
+  //! @brief GThreadFunc, runs the main loop of the embedded RTSP server
+  //! @param[in] data - GstInterface object
+  //! @return nullptr
+  //!
+  static void * RtspServerLoop(gpointer data);
+
+  //! @brief Ask the upstream encoder for a key frame, so a new client starts decoding
+  //! without waiting for the end of the GOP. The camera stream ignores the request,
+  //! its clients join at the next camera key frame.
+  //! @return void
+  //!
+  void RequestServerKeyFrame();
+
+  //! @brief Callback for the media-configure signal, keeps the appsrc of the shared media
+  static void RtspMediaConfigureCallBack(
+    GstRTSPMediaFactory * factory, GstRTSPMedia * media,
+    gpointer data);
+
+  //! @brief Callback for the unprepared signal, releases the appsrc of the shared media
+  static void RtspMediaUnpreparedCallBack(GstRTSPMedia * media, gpointer data);
+
+  //! @brief Callback for the client-connected signal, starts tracking the client
+  static void RtspClientConnectedCallBack(
+    GstRTSPServer * server, GstRTSPClient * client,
+    gpointer data);
+
+  //! @brief Callback for the play-request signal of a client
+  static void RtspClientPlayCallBack(
+    GstRTSPClient * client, GstRTSPContext * context,
+    gpointer data);
+
+  //! @brief Callback for the closed signal of a client, stops tracking the client
+  static void RtspClientClosedCallBack(GstRTSPClient * client, gpointer data);
+
+  //! @brief Callback for the new-sample signal of the server branch appsink.
+  //! Hands the buffer to the shared media appsrc, without copying the memory.
+  //! Delta units are dropped until the first key frame of a new media.
+  //! @param[in] sink The appsink element.
+  //! @param[in] data GstInterface object
+  //! @return GST_FLOW_OK
+  //!
+  static GstFlowReturn ServerNewSampleCallBack(GstAppSink * sink, gpointer data);
+
+  //! @brief Watch the first buffer reaching a network sink until a camera packet was sent
+  //! @param[in] upstream - element linked to the sink, its src pad peer is probed
+  //! @return void
+  //!
+  void AddFirstPacketProbe(GstElement * upstream);
+
+  //! @brief GstPadProbeCallback on the network sink input, records the first camera packet
+  static GstPadProbeReturn FirstPacketProbe(
+    GstPad * pad, GstPadProbeInfo * info,
+    gpointer data);
+
+  //! @brief GstPadProbeCallback on the appsrc output, matches the buffers to the traced chunks
+  static GstPadProbeReturn TraceSourceProbe(
+    GstPad * pad, GstPadProbeInfo * info,
+    gpointer data);
+
+  //! @brief GstPadProbeCallback on the network sink input, completes the traces
+  static GstPadProbeReturn TraceSinkProbe(
+    GstPad * pad, GstPadProbeInfo * info,
+    gpointer data);
+
+  //! @brief Create and configure the appsrc of the camera branch
+  //! @return the appsrc element, not yet added to the pipeline
+  //!
+  GstElement * CreateAppSource();
+
+  //! @brief Publish the appsrc to the feeding side and connect the need-data signal
+  //! @param[in] appSource - the appsrc element of the pipeline
+  //! @return void
+  //!
+  void AttachAppSource(GstElement * appSource);
+
+  //! @brief Switch the active input of the hot-standby pipeline
+  //! @param[in] camera - true for the camera branch, false for the default branch
+  //! @return void
+  //!
+  void SwitchStandbyInput(bool camera);
+
+  //! @brief GSourceFunc, switches back to the default input when camera frames stop
+  //! @param[in] data - GstInterface object
+  //! @return G_SOURCE_CONTINUE
+  //!
+  static gboolean StandbyWatchdogCallBack(gpointer data);
+
   //! @brief Create pipeline for the stream
   //! This function is called from StartStream function in a g_thread
-  //! It waits two seconds for the data to be received from the ROS2 node
+  //! It waits (two seconds by default) for the data to be received from the ROS2 node,
+  //! the element plugins are loaded meanwhile
   //! If no data is received, it will create a default pipeline(Camera Not Found! stream)
   //! otherwise normal stream from camera
   //! @param[in] data - GstInterface object
   //! @return void
   static void * CreatePipeline(gpointer data);
 
+  //! @brief Load the plugins of all pipeline elements once per process, so that the first
+  //! pipeline is built without the plugin loading while the camera is still booting
+  //! @return void
+  //!
+  static void PreloadElements();
+
   //! @brief Missing plugin message, used by StreamEventCallback
   //! @param[in] msg - GstMessage object pointer
   //! @return true if plugin is missing
@@ -322,6 +919,10 @@ protected:
 
           desc = gst_missing_plugin_message_get_description(message);
           g_print("Missing element: %s\n", desc ? desc : "(no description)");
+        } else if (gst_message_has_name(message, "splitmuxsink-fragment-opened") ||
+          gst_message_has_name(message, "splitmuxsink-fragment-closed"))
+        {
+          depthAIGst->HandleRecordingMessage(message);
         }
         break;
 
@@ -335,16 +936,23 @@ protected:
           gst_element_state_get_name(old_state),
           gst_element_state_get_name(new_state));
         if (new_state == GST_STATE_PLAYING) {
-          if (g_strrstr(GST_OBJECT_NAME(message->src), "rtspbin"))
+          if (g_strrstr(GST_OBJECT_NAME(message->src), "rtspbin") &&
+            !depthAIGst->IsExtraDestinationElement(message->src))
           {
             depthAIGst->_isStreamPlaying = true;
             depthAIGst->_isErrorDetected = false;
+            depthAIGst->NotifyStreamPlaying();
           }
-          if ((depthAIGst->_streamAddress.find("udp://") == 0)){
+          // UDP and server-only pipelines have no rtspbin to wait for.
+          if (depthAIGst->_streamAddress.find("udp://") == 0 ||
+            depthAIGst->_streamAddress.empty())
+          {
             if (g_strrstr(GST_OBJECT_NAME(message->src), "default_pipeline")||
-              g_strrstr(GST_OBJECT_NAME(message->src), "rgbCamSink_pipeline")){
+              g_strrstr(GST_OBJECT_NAME(message->src), "rgbCamSink_pipeline")||
+              g_strrstr(GST_OBJECT_NAME(message->src), "standby_pipeline")){
               depthAIGst->_isStreamPlaying = true;
               depthAIGst->_isErrorDetected = false;
+              depthAIGst->NotifyStreamPlaying();
             }
           }
         }
@@ -354,6 +962,7 @@ protected:
       case GST_MESSAGE_EOS:
         g_print("End of stream.\n");
         g_main_loop_quit(depthAIGst->_mLoop);
+        depthAIGst->NotifyStreamEvent(StreamEvent::PipelineError);
         break;
 
       case GST_MESSAGE_TAG:
@@ -386,8 +995,16 @@ protected:
           "ERROR from element %s: %s\n",
           GST_OBJECT_NAME(message->src), error->message);
         g_printerr("Debugging info: %s\n", (errDebug) ? errDebug : "none");
+        if (depthAIGst->IsExtraDestinationElement(message->src)) {
+          // A failing additional destination must not take the others down.
+          depthAIGst->DropFailedDestination(message->src);
+          g_error_free(error);
+          g_free(errDebug);
+          break;
+        }
         depthAIGst->_isStreamPlaying = false;
         depthAIGst->_isErrorDetected = true;
+        depthAIGst->NotifyStreamEvent(StreamEvent::PipelineError);
         g_error_free(error);
         g_free(errDebug);
         break;
@@ -408,6 +1025,65 @@ protected:
   //!
   static void NeedDataCallBack(GstElement * appsrc, guint unused_size, gpointer user_data);
 
+  //! @brief Callback for the need-data signal in push mode.
+  //! Never blocks, it only hands the queued backlog to the appsrc.
+  //! @param[in] appsrc The appsrc element.
+  //! @param[in] user_data GstInterface object
+  //! @param[in] unused_size The unused size of the buffer.
+  //! @return void
+  //!
+  static void NeedDataPushModeCallBack(GstElement * appsrc, guint unused_size, gpointer user_data);
+
+  //! @brief Push queued chunks to the appsrc in push mode.
+  //! A single chunk is pushed as a buffer, a backlog as one GstBufferList.
+  //! Stops at the appsrc max-bytes, the rest stays queued for the next call.
+  //! @return void
+  //!
+  void PushQueuedFrames();
+
+  //! @brief Create a timestamped GstBuffer holding the chunk of the given message.
+  //! In zero-copy mode the buffer wraps the message storage and keeps
+  //! the message alive until GStreamer releases the memory.
+  //! Must only be called by the queue consumer, it advances the stream timestamps.
+  //! @param[in] videoPtr - the incoming video chunk
+  //! @return new GstBuffer, owned by the caller
+  //!
+  GstBuffer * CreateBuffer(const CompressedImageMsg::SharedPtr & videoPtr);
+
+  //! @brief Parse the NAL unit headers of a chunk, the codec is taken from the
+  //! message format or from the encoder profile if the format is empty.
+  //! @param[in] videoPtr - the video chunk
+  //! @return NAL unit summary of the chunk
+  //!
+  H26xFrameInfo ParseFrame(const CompressedImageMsg::SharedPtr & videoPtr);
+
+  //! @brief Keep the latest parameter sets and the chunks since the last key frame.
+  //! Called by the producer for every classified chunk.
+  //! @param[in] videoPtr - the incoming video chunk
+  //! @param[in] info - NAL unit summary of the chunk
+  //! @return void
+  //!
+  void UpdateGopCache(const CompressedImageMsg::SharedPtr & videoPtr, const H26xFrameInfo & info);
+
+  //! @brief Take the cached GOP if a replay was requested.
+  //! Parameter sets are prepended when the cached key frame does not carry them.
+  //! @param[out] replay - chunks to be pushed before the queued ones
+  //! @return true if there is something to replay
+  //!
+  bool TakeGopReplay(std::vector<CompressedImageMsg::SharedPtr> & replay);
+
+  //! @brief Check if a dequeued chunk was already sent with the GOP replay.
+  //! @param[in] videoPtr - the dequeued chunk
+  //! @return true if the chunk must be skipped
+  //!
+  bool IsAlreadyReplayed(const CompressedImageMsg::SharedPtr & videoPtr);
+
+  //! @brief GDestroyNotify for wrapped buffers, releases the message reference.
+  //! @param[in] data - heap allocated CompressedImageMsg::SharedPtr
+  //! @return void
+  //!
+  static void ReleaseWrappedMessage(gpointer data);
+
 private:
   //! @brief The gst pipeline element
   GstElement * _pipeline {};
@@ -425,11 +1101,129 @@ private:
   //! If gst pipeline returns an error, it will be set to false.
   bool _isStreamPlaying = false;
   //! @brief is stream default private boolean
-  bool _isStreamDefault = false;
+  //! Flipped by the streaming threads when the hot-standby pipeline switches input.
+  std::atomic<bool> _isStreamDefault {false};
   //! @brief is stream shutdown started flag
   bool _isStreamShutdown = false;
   //! @brief is error detected flag
   bool _isErrorDetected = false;
+  //! @brief Wrap message storage in GstBuffers instead of copying it
+  bool _zeroCopy = true;
+  //! @brief Push chunks to the appsrc as they arrive instead of on need-data
+  bool _pushMode = false;
+  //! @brief max-bytes of the appsrc in push mode
+  guint64 _appSrcMaxBytes = 2 * 1024 * 1024;
+  //! @brief Guards _appSource between push-mode feeding and StopStream
+  std::mutex _appSourceMutex;
+  //! @brief Number of backlog batches pushed as GstBufferList
+  std::atomic<uint64_t> _bufferListPushes {0};
+  //! @brief Byte counters for the appsrc hand-off, read from the ROS2 node
+  std::atomic<uint64_t> _bytesPushed {0};
+  std::atomic<uint64_t> _bytesCopied {0};
+  //! @brief Incoming chunk queue. ROS2 video subscriber is the producer,
+  //! the appsrc need-data callback is the consumer.
+  SpscRing<CompressedImageMsg::SharedPtr> _queue {128};
+  //! @brief Byte budget of the incoming chunk queue
+  size_t _queueMaxBytes = 8 * 1024 * 1024;
+  //! @brief Number of chunks dropped on queue overflow
+  std::atomic<uint64_t> _queueDroppedFrames {0};
+  //! @brief Number of non-reference pictures dropped before the queue is full
+  std::atomic<uint64_t> _nonReferenceDroppedFrames {0};
+  //! @brief Number of GOP tails skipped on queue overflow
+  std::atomic<uint64_t> _skippedGops {0};
+  //! @brief Set on overflow, chunks are dropped until the next key frame.
+  //! Only accessed by the producer.
+  bool _skipUntilKeyFrame = false;
+  //! @brief Latest parameter sets and the chunks since the last key frame
+  std::mutex _gopCacheMutex;
+  CompressedImageMsg::SharedPtr _parameterSetsChunk {};
+  std::vector<CompressedImageMsg::SharedPtr> _gopCache {};
+  size_t _gopCacheBytes = 0;
+  std::chrono::steady_clock::time_point _gopCacheUpdateTime {};
+  //! @brief Raised on pipeline start, the consumer sends the cached GOP first
+  std::atomic<bool> _gopReplayPending {false};
+  //! @brief Stamp of the last replayed chunk, older queued chunks are skipped.
+  //! Only accessed by the consumer.
+  uint64_t _replayedUntilNs = 0;
+  //! @brief Sink branch of one destination, linked to a tee request pad
+  struct DestinationBranch
+  {
+    std::string address;
+    bool primary;
+    GstElement * bin;
+    GstPad * teePad;
+  };
+  //! @brief Guards the destination list, the tee and the branches
+  std::mutex _destinationsMutex;
+  //! @brief Destinations streamed in addition to _streamAddress
+  std::vector<std::string> _destinations {};
+  std::vector<DestinationBranch> _branches {};
+  GstElement * _tee = nullptr;
+  unsigned _destinationCounter = 0;
+  std::atomic<uint64_t> _destinationErrors {0};
+  //! @brief Embedded RTSP server settings and state
+  int _rtspServerPort = 0;
+  std::string _rtspServerMount = "/video";
+  GstRTSPServer * _rtspServer = nullptr;
+  GstRTSPMediaFactory * _rtspMediaFactory = nullptr;
+  GMainContext * _rtspServerContext = nullptr;
+  GMainLoop * _rtspServerLoop = nullptr;
+  GThread * _rtspServerThread = nullptr;
+  guint _rtspServerSourceId = 0;
+  //! @brief Guards the shared media, its appsrc, the server branch appsink and the clients
+  std::mutex _rtspServerMutex;
+  GstRTSPMedia * _serverMedia = nullptr;
+  GstElement * _serverAppSrc = nullptr;
+  GstElement * _serverSink = nullptr;
+  //! @brief Raised for a new shared media, cleared by the first key frame handed to it
+  bool _serverWaitKeyFrame = true;
+  //! @brief Connected clients and their connection time
+  struct RtspClient
+  {
+    GstRTSPClient * client;
+    std::string address;
+    std::chrono::steady_clock::time_point connected;
+  };
+  std::vector<RtspClient> _rtspClients {};
+  std::atomic<uint64_t> _rtspServerBuffers {0};
+  //! @brief On-board recording settings and state
+  RecordingConfig _recordingConfig {};
+  std::mutex _recordingMutex;
+  std::string _recordingSegment {};
+  std::atomic<uint64_t> _recordedSegments {0};
+  std::atomic<uint64_t> _recordingOverruns {0};
+  //! @brief Receives pipeline state events, see SetStreamEventHandler
+  std::function<void(StreamEvent)> _streamEventHandler {};
+  //! @brief CreatePipeline waiting time for camera data
+  int _pipelineDataWaitMs = 2000;
+  //! @brief Hot-standby pipeline settings and state
+  bool _hotStandby = false;
+  std::atomic<bool> _isStandbyPipeline {false};
+  int64_t _hotStandbyTimeoutMs = 500;
+  std::mutex _selectorMutex;
+  GstElement * _inputSelector = nullptr;
+  GstPad * _defaultSelectorPad = nullptr;
+  GstPad * _cameraSelectorPad = nullptr;
+  guint _standbyWatchdogId = 0;
+  //! @brief Steady clock times of the last chunk and of the first chunk waiting for a switch
+  std::atomic<int64_t> _lastFrameTimeNs {0};
+  std::atomic<int64_t> _pendingSwitchSinceNs {0};
+  std::atomic<uint64_t> _streamSwitches {0};
+  std::atomic<int64_t> _lastSwitchLatencyMs {-1};
+  //! @brief Adaptive bitrate state, guards the controller, the last sample and the rtpbin
+  std::mutex _bitrateMutex;
+  bool _adaptiveBitrate = false;
+  BitrateController _bitrateController {};
+  CongestionSample _congestion {};
+  GstElement * _rtspSinkManager = nullptr;
+  std::atomic<uint64_t> _destinationOverruns {0};
+  //! @brief Per-stage latency tracing of the camera chunks
+  LatencyTracer _latencyTracer {};
+  //! @brief StartStream time and the time to the first key frame pushed after it
+  std::chrono::steady_clock::time_point _streamStartTime {};
+  std::atomic<int64_t> _timeToFirstDecodableFrameMs {-1};
+  //! @brief Process uptime when the first camera packet was sent
+  std::atomic<int64_t> _timeToFirstPacketMs {-1};
   //! @brief The main gst loop context
   GMainContext * _mLoopContext;
   //! @brief Pipeline creating thread, only ran once
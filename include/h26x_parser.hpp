@@ -0,0 +1,100 @@
+#ifndef FOG_SW_DEPTHAI_H26X_PARSER_H
+#define FOG_SW_DEPTHAI_H26X_PARSER_H
+#include <cstddef>
+#include <cstdint>
+
+namespace depthai_ctrl
+{
+
+//! @brief Summary of the NAL units found in one encoded video chunk
+struct H26xFrameInfo
+{
+  //! @brief At least one NAL unit start code was found
+  bool valid = false;
+  //! @brief The chunk contains a coded picture (VCL NAL unit)
+  bool hasPicture = false;
+  //! @brief The picture is an IDR (H.264) or IRAP (H.265) picture
+  bool isKeyFrame = false;
+  //! @brief The chunk carries SPS/PPS (and VPS for H.265)
+  bool hasParameterSets = false;
+  //! @brief Other pictures may reference this picture
+  bool isReference = false;
+};
+
+//! @brief Minimal Annex B NAL unit header parser for H.264 and H.265 byte streams
+struct H26xParser
+{
+  //! @brief Parse the NAL unit headers of an Annex B chunk
+  //! @param[in] data - chunk data
+  //! @param[in] size - chunk size in bytes
+  //! @param[in] h265 - true for H.265, false for H.264
+  //! @return summary of the chunk
+  //!
+  static H26xFrameInfo Parse(const uint8_t * data, size_t size, bool h265)
+  {
+    H26xFrameInfo info{};
+    size_t i = 0;
+    while (i + 3 < size) {
+      // Start code is 00 00 01, a four byte start code has an extra leading zero.
+      if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) {
+        i++;
+        continue;
+      }
+      const size_t header = i + 3;
+      i = header;
+      info.valid = true;
+      if (h265) {
+        ParseH265NalHeader(data[header], info);
+      } else {
+        ParseH264NalHeader(data[header], info);
+      }
+      // Parameter sets precede the slices, the remaining slices of the picture
+      // have the same type. Skip scanning the slice data.
+      if (info.hasPicture) {
+        break;
+      }
+    }
+    return info;
+  }
+
+  //! @brief Update frame info from an H.264 NAL unit header byte
+  static void ParseH264NalHeader(uint8_t header, H26xFrameInfo & info)
+  {
+    const uint8_t nalRefIdc = (header >> 5) & 0x03;
+    const uint8_t nalType = header & 0x1f;
+    if (nalType >= 1 && nalType <= 5) {
+      info.hasPicture = true;
+      if (nalType == 5) {
+        info.isKeyFrame = true;
+      }
+      if (nalRefIdc != 0) {
+        info.isReference = true;
+      }
+    } else if (nalType == 7 || nalType == 8) {
+      info.hasParameterSets = true;
+    }
+  }
+
+  //! @brief Update frame info from the first H.265 NAL unit header byte
+  static void ParseH265NalHeader(uint8_t header, H26xFrameInfo & info)
+  {
+    const uint8_t nalType = (header >> 1) & 0x3f;
+    if (nalType <= 31) {
+      info.hasPicture = true;
+      // BLA, IDR and CRA pictures, decoding can start here.
+      if (nalType >= 16 && nalType <= 21) {
+        info.isKeyFrame = true;
+      }
+      // Even types below 16 are sub-layer non-reference pictures (TRAIL_N, TSA_N, ...).
+      if (nalType > 14 || (nalType % 2) == 1) {
+        info.isReference = true;
+      }
+    } else if (nalType >= 32 && nalType <= 34) {
+      info.hasParameterSets = true;
+    }
+  }
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_H26X_PARSER_H
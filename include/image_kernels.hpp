@@ -0,0 +1,1024 @@
+#ifndef FOG_SW_DEPTHAI_IMAGE_KERNELS_H
+#define FOG_SW_DEPTHAI_IMAGE_KERNELS_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DEPTHAI_KERNELS_AVX2 1
+#define DEPTHAI_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DEPTHAI_KERNELS_NEON 1
+#endif
+
+namespace depthai_ctrl
+{
+
+//! @brief Pixel layouts of the raw device frames the kernels take
+enum class PixelFormat
+{
+  NV12,       //!< Y plane, then interleaved UV plane at half resolution
+  YUV422i,    //!< Interleaved Y0 U Y1 V
+  BGR888p,    //!< B, G and R planes
+  RGB888p,    //!< R, G and B planes
+  BGR888i,    //!< Interleaved B G R
+  RGB888i,    //!< Interleaved R G B
+  GRAY8       //!< Single plane
+};
+
+//! @brief Encoding of a published image, Native publishes the device layout as is
+enum class OutputEncoding
+{
+  Native,
+  BGR8,
+  RGB8,
+  Mono8
+};
+
+//! @brief Instruction set of the conversion kernels
+enum class SimdLevel
+{
+  Scalar,
+  AVX2,
+  NEON
+};
+
+namespace image_kernels
+{
+
+//! @brief Return the ROS encoding name of an output encoding, empty for Native
+inline const char * EncodingName(OutputEncoding encoding)
+{
+  switch (encoding) {
+    case OutputEncoding::BGR8: return "bgr8";
+    case OutputEncoding::RGB8: return "rgb8";
+    case OutputEncoding::Mono8: return "mono8";
+    default: return "";
+  }
+}
+
+//! @brief Parse an output encoding parameter: "native", "bgr8", "rgb8" or "mono8"
+//! @param[in] name - parameter value
+//! @param[out] encoding - parsed encoding
+//! @return false if the name is unknown
+//!
+inline bool ParseOutputEncoding(const std::string & name, OutputEncoding & encoding)
+{
+  if (name == "native" || name.empty()) {
+    encoding = OutputEncoding::Native;
+  } else if (name == "bgr8") {
+    encoding = OutputEncoding::BGR8;
+  } else if (name == "rgb8") {
+    encoding = OutputEncoding::RGB8;
+  } else if (name == "mono8") {
+    encoding = OutputEncoding::Mono8;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+//! @brief Return the number of bytes of a frame in the given layout
+inline size_t InputSize(PixelFormat format, uint32_t width, uint32_t height)
+{
+  const size_t pixels = (size_t)width * height;
+  switch (format) {
+    case PixelFormat::NV12: return pixels + pixels / 2;
+    case PixelFormat::YUV422i: return pixels * 2;
+    case PixelFormat::GRAY8: return pixels;
+    default: return pixels * 3;
+  }
+}
+
+//! @brief Return the number of bytes of a converted image
+inline size_t OutputSize(OutputEncoding encoding, uint32_t width, uint32_t height)
+{
+  const size_t pixels = (size_t)width * height;
+  return encoding == OutputEncoding::Mono8 ? pixels : pixels * 3;
+}
+
+//! @brief Return the bytes per pixel of an output encoding
+inline uint32_t OutputPixelSize(OutputEncoding encoding)
+{
+  return encoding == OutputEncoding::Mono8 ? 1 : 3;
+}
+
+//! @brief Return the best instruction set of the running CPU
+inline SimdLevel DetectSimdLevel()
+{
+#if defined(DEPTHAI_KERNELS_AVX2)
+  return __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 : SimdLevel::Scalar;
+#elif defined(DEPTHAI_KERNELS_NEON)
+  return SimdLevel::NEON;
+#else
+  return SimdLevel::Scalar;
+#endif
+}
+
+//! @brief Scalar reference. The SIMD paths use the same fixed point arithmetic,
+//! their output is identical to it.
+namespace scalar
+{
+
+inline uint8_t Clamp(int value)
+{
+  return (uint8_t)std::min(std::max(value, 0), 255);
+}
+
+//! @brief BT.601 limited range YUV to RGB, 10 bit fixed point
+inline void YuvToRgb(int y, int u, int v, uint8_t & r, uint8_t & g, uint8_t & b)
+{
+  const int c = std::max(y - 16, 0) * 1192 + 512;
+  const int du = u - 128;
+  const int dv = v - 128;
+  r = Clamp((c + 1634 * dv) >> 10);
+  g = Clamp((c - 833 * dv - 400 * du) >> 10);
+  b = Clamp((c + 2066 * du) >> 10);
+}
+
+//! @brief BT.601 luma of an RGB pixel, 8 bit fixed point
+inline uint8_t RgbToLuma(int r, int g, int b)
+{
+  return (uint8_t)((29 * b + 150 * g + 77 * r + 128) >> 8);
+}
+
+//! @brief Access to one pixel of a frame, specialized per layout
+template<PixelFormat In>
+struct Pixel;
+
+template<>
+struct Pixel<PixelFormat::NV12>
+{
+  static void Rgb(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row,
+    uint8_t & r, uint8_t & g, uint8_t & b)
+  {
+    const uint8_t * uv = src + (size_t)w * h + (size_t)(row / 2) * w + (x & ~1u);
+    YuvToRgb(src[(size_t)row * w + x], uv[0], uv[1], r, g, b);
+  }
+  static uint8_t Luma(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    (void)h;
+    return src[(size_t)row * w + x];
+  }
+};
+
+template<>
+struct Pixel<PixelFormat::YUV422i>
+{
+  static void Rgb(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row,
+    uint8_t & r, uint8_t & g, uint8_t & b)
+  {
+    (void)h;
+    const uint8_t * pair = src + ((size_t)row * w + (x & ~1u)) * 2;
+    YuvToRgb(pair[(x & 1) * 2], pair[1], pair[3], r, g, b);
+  }
+  static uint8_t Luma(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    (void)h;
+    return src[((size_t)row * w + x) * 2];
+  }
+};
+
+//! @brief Three planes, Swap exchanges the first and the last one
+template<bool Swap>
+struct PlanarPixel
+{
+  static void Rgb(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row,
+    uint8_t & r, uint8_t & g, uint8_t & b)
+  {
+    const size_t plane = (size_t)w * h;
+    const size_t i = (size_t)row * w + x;
+    b = src[i + (Swap ? 2 * plane : 0)];
+    g = src[i + plane];
+    r = src[i + (Swap ? 0 : 2 * plane)];
+  }
+  static uint8_t Luma(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    uint8_t r, g, b;
+    Rgb(src, w, h, x, row, r, g, b);
+    return RgbToLuma(r, g, b);
+  }
+};
+
+//! @brief Interleaved channels, Swap exchanges the first and the last one
+template<bool Swap>
+struct InterleavedPixel
+{
+  static void Rgb(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row,
+    uint8_t & r, uint8_t & g, uint8_t & b)
+  {
+    (void)h;
+    const uint8_t * p = src + ((size_t)row * w + x) * 3;
+    b = p[Swap ? 2 : 0];
+    g = p[1];
+    r = p[Swap ? 0 : 2];
+  }
+  static uint8_t Luma(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    uint8_t r, g, b;
+    Rgb(src, w, h, x, row, r, g, b);
+    return RgbToLuma(r, g, b);
+  }
+};
+
+template<>
+struct Pixel<PixelFormat::BGR888p>: PlanarPixel<false> {};
+template<>
+struct Pixel<PixelFormat::RGB888p>: PlanarPixel<true> {};
+template<>
+struct Pixel<PixelFormat::BGR888i>: InterleavedPixel<false> {};
+template<>
+struct Pixel<PixelFormat::RGB888i>: InterleavedPixel<true> {};
+
+template<>
+struct Pixel<PixelFormat::GRAY8>
+{
+  static void Rgb(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row,
+    uint8_t & r, uint8_t & g, uint8_t & b)
+  {
+    (void)h;
+    r = g = b = src[(size_t)row * w + x];
+  }
+  static uint8_t Luma(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    (void)h;
+    return src[(size_t)row * w + x];
+  }
+};
+
+//! @brief Convert the pixels of one row from the given column on
+template<PixelFormat In, OutputEncoding Out>
+inline void ConvertRow(
+  const uint8_t * src, uint32_t w, uint32_t h, uint8_t * dst,
+  uint32_t row, uint32_t x)
+{
+  uint8_t * out = dst + ((size_t)row * w + x) * OutputPixelSize(Out);
+  for (; x < w; x++) {
+    if (Out == OutputEncoding::Mono8) {
+      *out++ = Pixel<In>::Luma(src, w, h, x, row);
+    } else {
+      uint8_t r, g, b;
+      Pixel<In>::Rgb(src, w, h, x, row, r, g, b);
+      *out++ = Out == OutputEncoding::BGR8 ? b : r;
+      *out++ = g;
+      *out++ = Out == OutputEncoding::BGR8 ? r : b;
+    }
+  }
+}
+
+template<PixelFormat In, OutputEncoding Out>
+inline void Convert(const uint8_t * src, uint32_t w, uint32_t h, uint8_t * dst)
+{
+  for (uint32_t row = 0; row < h; row++) {
+    ConvertRow<In, Out>(src, w, h, dst, row, 0);
+  }
+}
+
+//! @brief Average 2x2 blocks of one output row from the given output column on
+template<int Channels>
+inline void DownsampleRow(const uint8_t * src, uint32_t w, uint8_t * dst, uint32_t row, uint32_t x)
+{
+  const size_t stride = (size_t)w * Channels;
+  const uint8_t * top = src + 2 * row * stride;
+  const uint8_t * bottom = top + stride;
+  uint8_t * out = dst + (size_t)row * (w / 2) * Channels;
+  for (; x < w / 2; x++) {
+    for (int c = 0; c < Channels; c++) {
+      const size_t left = 2 * x * Channels + c;
+      out[x * Channels + c] = (uint8_t)(
+        (top[left] + top[left + Channels] + bottom[left] + bottom[left + Channels] + 2) >> 2);
+    }
+  }
+}
+
+template<int Channels>
+inline void Downsample(const uint8_t * src, uint32_t w, uint32_t h, uint8_t * dst)
+{
+  for (uint32_t row = 0; row < h / 2; row++) {
+    DownsampleRow<Channels>(src, w, dst, row, 0);
+  }
+}
+
+}  // namespace scalar
+
+#if defined(DEPTHAI_KERNELS_AVX2)
+//! @brief AVX2 kernels, 16 pixels per step. Compiled for AVX2 with a target
+//! attribute, the rest of the node keeps the baseline instruction set.
+namespace avx2
+{
+
+struct Rgb16
+{
+  __m128i r, g, b;
+};
+
+//! @brief Saturate 16 int32 values to bytes
+DEPTHAI_TARGET_AVX2 inline __m128i PackToBytes(__m256i lo, __m256i hi)
+{
+  const __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+  return _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+}
+
+//! @brief YUV to RGB of 16 pixels sharing 8 chroma samples
+DEPTHAI_TARGET_AVX2 inline Rgb16 YuvToRgb(__m128i y, __m128i u8, __m128i v8)
+{
+  const __m128i u = _mm_unpacklo_epi8(u8, u8);
+  const __m128i v = _mm_unpacklo_epi8(v8, v8);
+  const __m256i ys[2] = {_mm256_cvtepu8_epi32(y), _mm256_cvtepu8_epi32(_mm_srli_si128(y, 8))};
+  const __m256i us[2] = {_mm256_cvtepu8_epi32(u), _mm256_cvtepu8_epi32(_mm_srli_si128(u, 8))};
+  const __m256i vs[2] = {_mm256_cvtepu8_epi32(v), _mm256_cvtepu8_epi32(_mm_srli_si128(v, 8))};
+  __m256i r[2], g[2], b[2];
+  for (int i = 0; i < 2; i++) {
+    const __m256i c = _mm256_add_epi32(
+      _mm256_mullo_epi32(
+        _mm256_max_epi32(_mm256_sub_epi32(ys[i], _mm256_set1_epi32(16)), _mm256_setzero_si256()),
+        _mm256_set1_epi32(1192)),
+      _mm256_set1_epi32(512));
+    const __m256i du = _mm256_sub_epi32(us[i], _mm256_set1_epi32(128));
+    const __m256i dv = _mm256_sub_epi32(vs[i], _mm256_set1_epi32(128));
+    r[i] = _mm256_srai_epi32(
+      _mm256_add_epi32(c, _mm256_mullo_epi32(dv, _mm256_set1_epi32(1634))), 10);
+    g[i] = _mm256_srai_epi32(
+      _mm256_sub_epi32(
+        _mm256_sub_epi32(c, _mm256_mullo_epi32(dv, _mm256_set1_epi32(833))),
+        _mm256_mullo_epi32(du, _mm256_set1_epi32(400))), 10);
+    b[i] = _mm256_srai_epi32(
+      _mm256_add_epi32(c, _mm256_mullo_epi32(du, _mm256_set1_epi32(2066))), 10);
+  }
+  return Rgb16{PackToBytes(r[0], r[1]), PackToBytes(g[0], g[1]), PackToBytes(b[0], b[1])};
+}
+
+//! @brief Luma of 16 RGB pixels
+DEPTHAI_TARGET_AVX2 inline __m128i RgbToLuma(const Rgb16 & p)
+{
+  __m256i sum = _mm256_mullo_epi16(_mm256_cvtepu8_epi16(p.b), _mm256_set1_epi16(29));
+  sum = _mm256_add_epi16(
+    sum, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(p.g), _mm256_set1_epi16(150)));
+  sum = _mm256_add_epi16(
+    sum, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(p.r), _mm256_set1_epi16(77)));
+  sum = _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(128)), 8);
+  return _mm_packus_epi16(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+}
+
+//! @brief Split 48 interleaved bytes into three 16 byte channels
+DEPTHAI_TARGET_AVX2 inline void Load3(
+  const uint8_t * src, __m128i & c0, __m128i & c1,
+  __m128i & c2)
+{
+  const __m128i a = _mm_loadu_si128((const __m128i *)src);
+  const __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+  const __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+  const char z = -128;
+  c0 = _mm_or_si128(
+    _mm_or_si128(
+      _mm_shuffle_epi8(a, _mm_setr_epi8(0, 3, 6, 9, 12, 15, z, z, z, z, z, z, z, z, z, z)),
+      _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, z, z, z, z, 2, 5, 8, 11, 14, z, z, z, z, z))),
+    _mm_shuffle_epi8(c, _mm_setr_epi8(z, z, z, z, z, z, z, z, z, z, z, 1, 4, 7, 10, 13)));
+  c1 = _mm_or_si128(
+    _mm_or_si128(
+      _mm_shuffle_epi8(a, _mm_setr_epi8(1, 4, 7, 10, 13, z, z, z, z, z, z, z, z, z, z, z)),
+      _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, z, z, z, 0, 3, 6, 9, 12, 15, z, z, z, z, z))),
+    _mm_shuffle_epi8(c, _mm_setr_epi8(z, z, z, z, z, z, z, z, z, z, z, 2, 5, 8, 11, 14)));
+  c2 = _mm_or_si128(
+    _mm_or_si128(
+      _mm_shuffle_epi8(a, _mm_setr_epi8(2, 5, 8, 11, 14, z, z, z, z, z, z, z, z, z, z, z)),
+      _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, z, z, z, 1, 4, 7, 10, 13, z, z, z, z, z, z))),
+    _mm_shuffle_epi8(c, _mm_setr_epi8(z, z, z, z, z, z, z, z, z, z, 0, 3, 6, 9, 12, 15)));
+}
+
+//! @brief Interleave three 16 byte channels into 48 bytes
+DEPTHAI_TARGET_AVX2 inline void Store3(uint8_t * dst, __m128i c0, __m128i c1, __m128i c2)
+{
+  const char z = -128;
+  const __m128i a = _mm_or_si128(
+    _mm_or_si128(
+      _mm_shuffle_epi8(c0, _mm_setr_epi8(0, z, z, 1, z, z, 2, z, z, 3, z, z, 4, z, z, 5)),
+      _mm_shuffle_epi8(c1, _mm_setr_epi8(z, 0, z, z, 1, z, z, 2, z, z, 3, z, z, 4, z, z))),
+    _mm_shuffle_epi8(c2, _mm_setr_epi8(z, z, 0, z, z, 1, z, z, 2, z, z, 3, z, z, 4, z)));
+  const __m128i b = _mm_or_si128(
+    _mm_or_si128(
+      _mm_shuffle_epi8(c0, _mm_setr_epi8(z, z, 6, z, z, 7, z, z, 8, z, z, 9, z, z, 10, z)),
+      _mm_shuffle_epi8(c1, _mm_setr_epi8(5, z, z, 6, z, z, 7, z, z, 8, z, z, 9, z, z, 10))),
+    _mm_shuffle_epi8(c2, _mm_setr_epi8(z, 5, z, z, 6, z, z, 7, z, z, 8, z, z, 9, z, z)));
+  const __m128i c = _mm_or_si128(
+    _mm_or_si128(
+      _mm_shuffle_epi8(c0, _mm_setr_epi8(z, 11, z, z, 12, z, z, 13, z, z, 14, z, z, 15, z, z)),
+      _mm_shuffle_epi8(c1, _mm_setr_epi8(z, z, 11, z, z, 12, z, z, 13, z, z, 14, z, z, 15, z))),
+    _mm_shuffle_epi8(c2, _mm_setr_epi8(10, z, z, 11, z, z, 12, z, z, 13, z, z, 14, z, z, 15)));
+  _mm_storeu_si128((__m128i *)dst, a);
+  _mm_storeu_si128((__m128i *)(dst + 16), b);
+  _mm_storeu_si128((__m128i *)(dst + 32), c);
+}
+
+//! @brief Access to 16 pixels of a frame, specialized per layout
+template<PixelFormat In>
+struct Block;
+
+template<>
+struct Block<PixelFormat::NV12>
+{
+  DEPTHAI_TARGET_AVX2 static __m128i Luma(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x,
+    uint32_t row)
+  {
+    (void)h;
+    return _mm_loadu_si128((const __m128i *)(src + (size_t)row * w + x));
+  }
+  DEPTHAI_TARGET_AVX2 static Rgb16 Rgb(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x,
+    uint32_t row)
+  {
+    const char z = -128;
+    const __m128i uv = _mm_loadu_si128(
+      (const __m128i *)(src + (size_t)w * h + (size_t)(row / 2) * w + x));
+    const __m128i u = _mm_shuffle_epi8(
+      uv, _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, z, z, z, z, z, z, z, z));
+    const __m128i v = _mm_shuffle_epi8(
+      uv, _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, z, z, z, z, z, z, z, z));
+    return YuvToRgb(Luma(src, w, h, x, row), u, v);
+  }
+};
+
+template<>
+struct Block<PixelFormat::YUV422i>
+{
+  DEPTHAI_TARGET_AVX2 static __m128i Luma(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x,
+    uint32_t row)
+  {
+    (void)h;
+    const char z = -128;
+    const uint8_t * p = src + ((size_t)row * w + x) * 2;
+    const __m128i even = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, z, z, z, z, z, z, z, z);
+    return _mm_unpacklo_epi64(
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), even),
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 16)), even));
+  }
+  DEPTHAI_TARGET_AVX2 static Rgb16 Rgb(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x,
+    uint32_t row)
+  {
+    const char z = -128;
+    const uint8_t * p = src + ((size_t)row * w + x) * 2;
+    const __m128i a = _mm_loadu_si128((const __m128i *)p);
+    const __m128i b = _mm_loadu_si128((const __m128i *)(p + 16));
+    const __m128i u = _mm_or_si128(
+      _mm_shuffle_epi8(a, _mm_setr_epi8(1, 5, 9, 13, z, z, z, z, z, z, z, z, z, z, z, z)),
+      _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, z, z, 1, 5, 9, 13, z, z, z, z, z, z, z, z)));
+    const __m128i v = _mm_or_si128(
+      _mm_shuffle_epi8(a, _mm_setr_epi8(3, 7, 11, 15, z, z, z, z, z, z, z, z, z, z, z, z)),
+      _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, z, z, 3, 7, 11, 15, z, z, z, z, z, z, z, z)));
+    return YuvToRgb(Luma(src, w, h, x, row), u, v);
+  }
+};
+
+template<bool Swap>
+struct PlanarBlock
+{
+  DEPTHAI_TARGET_AVX2 static Rgb16 Rgb(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x,
+    uint32_t row)
+  {
+    const size_t plane = (size_t)w * h;
+    const uint8_t * p = src + (size_t)row * w + x;
+    const __m128i first = _mm_loadu_si128((const __m128i *)p);
+    const __m128i second = _mm_loadu_si128((const __m128i *)(p + plane));
+    const __m128i third = _mm_loadu_si128((const __m128i *)(p + 2 * plane));
+    return Swap ? Rgb16{first, second, third} : Rgb16{third, second, first};
+  }
+  DEPTHAI_TARGET_AVX2 static __m128i Luma(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x,
+    uint32_t row)
+  {
+    return RgbToLuma(Rgb(src, w, h, x, row));
+  }
+};
+
+template<bool Swap>
+struct InterleavedBlock
+{
+  DEPTHAI_TARGET_AVX2 static Rgb16 Rgb(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x,
+    uint32_t row)
+  {
+    (void)h;
+    __m128i first, second, third;
+    Load3(src + ((size_t)row * w + x) * 3, first, second, third);
+    return Swap ? Rgb16{first, second, third} : Rgb16{third, second, first};
+  }
+  DEPTHAI_TARGET_AVX2 static __m128i Luma(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x,
+    uint32_t row)
+  {
+    return RgbToLuma(Rgb(src, w, h, x, row));
+  }
+};
+
+template<>
+struct Block<PixelFormat::BGR888p>: PlanarBlock<false> {};
+template<>
+struct Block<PixelFormat::RGB888p>: PlanarBlock<true> {};
+template<>
+struct Block<PixelFormat::BGR888i>: InterleavedBlock<false> {};
+template<>
+struct Block<PixelFormat::RGB888i>: InterleavedBlock<true> {};
+
+template<>
+struct Block<PixelFormat::GRAY8>
+{
+  DEPTHAI_TARGET_AVX2 static __m128i Luma(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x,
+    uint32_t row)
+  {
+    (void)h;
+    return _mm_loadu_si128((const __m128i *)(src + (size_t)row * w + x));
+  }
+  DEPTHAI_TARGET_AVX2 static Rgb16 Rgb(
+    const uint8_t * src, uint32_t w, uint32_t h, uint32_t x,
+    uint32_t row)
+  {
+    const __m128i gray = Luma(src, w, h, x, row);
+    return Rgb16{gray, gray, gray};
+  }
+};
+
+template<PixelFormat In, OutputEncoding Out>
+DEPTHAI_TARGET_AVX2 inline void Convert(
+  const uint8_t * src, uint32_t w, uint32_t h,
+  uint8_t * dst)
+{
+  for (uint32_t row = 0; row < h; row++) {
+    uint32_t x = 0;
+    uint8_t * out = dst + (size_t)row * w * OutputPixelSize(Out);
+    for (; x + 16 <= w; x += 16, out += 16 * OutputPixelSize(Out)) {
+      if (Out == OutputEncoding::Mono8) {
+        _mm_storeu_si128((__m128i *)out, Block<In>::Luma(src, w, h, x, row));
+      } else {
+        const Rgb16 p = Block<In>::Rgb(src, w, h, x, row);
+        if (Out == OutputEncoding::BGR8) {
+          Store3(out, p.b, p.g, p.r);
+        } else {
+          Store3(out, p.r, p.g, p.b);
+        }
+      }
+    }
+    scalar::ConvertRow<In, Out>(src, w, h, dst, row, x);
+  }
+}
+
+//! @brief Average 2x2 blocks of 32 samples of one channel, top and bottom row
+DEPTHAI_TARGET_AVX2 inline __m128i AverageQuads(
+  __m128i top0, __m128i top1, __m128i bottom0,
+  __m128i bottom1)
+{
+  const __m128i ones = _mm_set1_epi8(1);
+  const __m128i round = _mm_set1_epi16(2);
+  const __m128i lo = _mm_add_epi16(_mm_maddubs_epi16(top0, ones), _mm_maddubs_epi16(bottom0, ones));
+  const __m128i hi = _mm_add_epi16(_mm_maddubs_epi16(top1, ones), _mm_maddubs_epi16(bottom1, ones));
+  return _mm_packus_epi16(
+    _mm_srli_epi16(_mm_add_epi16(lo, round), 2),
+    _mm_srli_epi16(_mm_add_epi16(hi, round), 2));
+}
+
+template<int Channels>
+DEPTHAI_TARGET_AVX2 inline void Downsample(
+  const uint8_t * src, uint32_t w, uint32_t h,
+  uint8_t * dst)
+{
+  const size_t stride = (size_t)w * Channels;
+  for (uint32_t row = 0; row < h / 2; row++) {
+    const uint8_t * top = src + 2 * row * stride;
+    const uint8_t * bottom = top + stride;
+    uint8_t * out = dst + (size_t)row * (w / 2) * Channels;
+    uint32_t x = 0;
+    for (; x + 16 <= w / 2; x += 16) {
+      const size_t in = 2 * x * Channels;
+      if (Channels == 1) {
+        _mm_storeu_si128(
+          (__m128i *)(out + x),
+          AverageQuads(
+            _mm_loadu_si128((const __m128i *)(top + in)),
+            _mm_loadu_si128((const __m128i *)(top + in + 16)),
+            _mm_loadu_si128((const __m128i *)(bottom + in)),
+            _mm_loadu_si128((const __m128i *)(bottom + in + 16))));
+      } else {
+        __m128i t[2][3], b[2][3];
+        Load3(top + in, t[0][0], t[0][1], t[0][2]);
+        Load3(top + in + 48, t[1][0], t[1][1], t[1][2]);
+        Load3(bottom + in, b[0][0], b[0][1], b[0][2]);
+        Load3(bottom + in + 48, b[1][0], b[1][1], b[1][2]);
+        Store3(
+          out + x * Channels,
+          AverageQuads(t[0][0], t[1][0], b[0][0], b[1][0]),
+          AverageQuads(t[0][1], t[1][1], b[0][1], b[1][1]),
+          AverageQuads(t[0][2], t[1][2], b[0][2], b[1][2]));
+      }
+    }
+    scalar::DownsampleRow<Channels>(src, w, dst, row, x);
+  }
+}
+
+}  // namespace avx2
+#endif  // DEPTHAI_KERNELS_AVX2
+
+#if defined(DEPTHAI_KERNELS_NEON)
+//! @brief NEON kernels, 16 pixels per step
+namespace neon
+{
+
+struct Rgb16
+{
+  uint8x16_t r, g, b;
+};
+
+//! @brief Saturate 2x4 int32 values to bytes
+inline uint8x8_t PackToBytes(int32x4_t lo, int32x4_t hi)
+{
+  return vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+}
+
+//! @brief YUV to RGB of 4 pixels
+inline void YuvToRgb4(
+  int16x4_t y, int16x4_t u, int16x4_t v, int32x4_t & r, int32x4_t & g,
+  int32x4_t & b)
+{
+  const int32x4_t c = vaddq_s32(
+    vmulq_n_s32(vmaxq_s32(vsubq_s32(vmovl_s16(y), vdupq_n_s32(16)), vdupq_n_s32(0)), 1192),
+    vdupq_n_s32(512));
+  const int32x4_t du = vsubq_s32(vmovl_s16(u), vdupq_n_s32(128));
+  const int32x4_t dv = vsubq_s32(vmovl_s16(v), vdupq_n_s32(128));
+  r = vshrq_n_s32(vaddq_s32(c, vmulq_n_s32(dv, 1634)), 10);
+  g = vshrq_n_s32(vsubq_s32(vsubq_s32(c, vmulq_n_s32(dv, 833)), vmulq_n_s32(du, 400)), 10);
+  b = vshrq_n_s32(vaddq_s32(c, vmulq_n_s32(du, 2066)), 10);
+}
+
+//! @brief YUV to RGB of 8 pixels
+inline void YuvToRgb8(
+  uint8x8_t y, uint8x8_t u, uint8x8_t v, uint8x8_t & r, uint8x8_t & g,
+  uint8x8_t & b)
+{
+  const int16x8_t y16 = vreinterpretq_s16_u16(vmovl_u8(y));
+  const int16x8_t u16 = vreinterpretq_s16_u16(vmovl_u8(u));
+  const int16x8_t v16 = vreinterpretq_s16_u16(vmovl_u8(v));
+  int32x4_t r0, g0, b0, r1, g1, b1;
+  YuvToRgb4(vget_low_s16(y16), vget_low_s16(u16), vget_low_s16(v16), r0, g0, b0);
+  YuvToRgb4(vget_high_s16(y16), vget_high_s16(u16), vget_high_s16(v16), r1, g1, b1);
+  r = PackToBytes(r0, r1);
+  g = PackToBytes(g0, g1);
+  b = PackToBytes(b0, b1);
+}
+
+//! @brief YUV to RGB of 16 pixels sharing 8 chroma samples
+inline Rgb16 YuvToRgb(uint8x16_t y, uint8x8_t u8, uint8x8_t v8)
+{
+  const uint8x8x2_t u = vzip_u8(u8, u8);
+  const uint8x8x2_t v = vzip_u8(v8, v8);
+  uint8x8_t r0, g0, b0, r1, g1, b1;
+  YuvToRgb8(vget_low_u8(y), u.val[0], v.val[0], r0, g0, b0);
+  YuvToRgb8(vget_high_u8(y), u.val[1], v.val[1], r1, g1, b1);
+  return Rgb16{vcombine_u8(r0, r1), vcombine_u8(g0, g1), vcombine_u8(b0, b1)};
+}
+
+//! @brief Luma of 8 RGB pixels
+inline uint8x8_t RgbToLuma8(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+  uint16x8_t sum = vmull_u8(b, vdup_n_u8(29));
+  sum = vmlal_u8(sum, g, vdup_n_u8(150));
+  sum = vmlal_u8(sum, r, vdup_n_u8(77));
+  return vshrn_n_u16(vaddq_u16(sum, vdupq_n_u16(128)), 8);
+}
+
+//! @brief Luma of 16 RGB pixels
+inline uint8x16_t RgbToLuma(const Rgb16 & p)
+{
+  return vcombine_u8(
+    RgbToLuma8(vget_low_u8(p.r), vget_low_u8(p.g), vget_low_u8(p.b)),
+    RgbToLuma8(vget_high_u8(p.r), vget_high_u8(p.g), vget_high_u8(p.b)));
+}
+
+template<PixelFormat In>
+struct Block;
+
+template<>
+struct Block<PixelFormat::NV12>
+{
+  static uint8x16_t Luma(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    (void)h;
+    return vld1q_u8(src + (size_t)row * w + x);
+  }
+  static Rgb16 Rgb(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    const uint8x8x2_t uv = vld2_u8(src + (size_t)w * h + (size_t)(row / 2) * w + x);
+    return YuvToRgb(Luma(src, w, h, x, row), uv.val[0], uv.val[1]);
+  }
+};
+
+template<>
+struct Block<PixelFormat::YUV422i>
+{
+  static uint8x16_t Luma(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    (void)h;
+    const uint8x16x2_t yuyv = vld2q_u8(src + ((size_t)row * w + x) * 2);
+    return yuyv.val[0];
+  }
+  static Rgb16 Rgb(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    (void)h;
+    // Groups of Y0 U Y1 V, the two luma lanes are zipped back into pixel order.
+    const uint8x8x4_t yuyv = vld4_u8(src + ((size_t)row * w + x) * 2);
+    const uint8x8x2_t y = vzip_u8(yuyv.val[0], yuyv.val[2]);
+    return YuvToRgb(vcombine_u8(y.val[0], y.val[1]), yuyv.val[1], yuyv.val[3]);
+  }
+};
+
+template<bool Swap>
+struct PlanarBlock
+{
+  static Rgb16 Rgb(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    const size_t plane = (size_t)w * h;
+    const uint8_t * p = src + (size_t)row * w + x;
+    const uint8x16_t first = vld1q_u8(p);
+    const uint8x16_t second = vld1q_u8(p + plane);
+    const uint8x16_t third = vld1q_u8(p + 2 * plane);
+    return Swap ? Rgb16{first, second, third} : Rgb16{third, second, first};
+  }
+  static uint8x16_t Luma(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    return RgbToLuma(Rgb(src, w, h, x, row));
+  }
+};
+
+template<bool Swap>
+struct InterleavedBlock
+{
+  static Rgb16 Rgb(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    (void)h;
+    const uint8x16x3_t p = vld3q_u8(src + ((size_t)row * w + x) * 3);
+    return Swap ? Rgb16{p.val[0], p.val[1], p.val[2]} : Rgb16{p.val[2], p.val[1], p.val[0]};
+  }
+  static uint8x16_t Luma(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    return RgbToLuma(Rgb(src, w, h, x, row));
+  }
+};
+
+template<>
+struct Block<PixelFormat::BGR888p>: PlanarBlock<false> {};
+template<>
+struct Block<PixelFormat::RGB888p>: PlanarBlock<true> {};
+template<>
+struct Block<PixelFormat::BGR888i>: InterleavedBlock<false> {};
+template<>
+struct Block<PixelFormat::RGB888i>: InterleavedBlock<true> {};
+
+template<>
+struct Block<PixelFormat::GRAY8>
+{
+  static uint8x16_t Luma(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    (void)h;
+    return vld1q_u8(src + (size_t)row * w + x);
+  }
+  static Rgb16 Rgb(const uint8_t * src, uint32_t w, uint32_t h, uint32_t x, uint32_t row)
+  {
+    const uint8x16_t gray = Luma(src, w, h, x, row);
+    return Rgb16{gray, gray, gray};
+  }
+};
+
+template<PixelFormat In, OutputEncoding Out>
+inline void Convert(const uint8_t * src, uint32_t w, uint32_t h, uint8_t * dst)
+{
+  for (uint32_t row = 0; row < h; row++) {
+    uint32_t x = 0;
+    uint8_t * out = dst + (size_t)row * w * OutputPixelSize(Out);
+    for (; x + 16 <= w; x += 16, out += 16 * OutputPixelSize(Out)) {
+      if (Out == OutputEncoding::Mono8) {
+        vst1q_u8(out, Block<In>::Luma(src, w, h, x, row));
+      } else {
+        const Rgb16 p = Block<In>::Rgb(src, w, h, x, row);
+        uint8x16x3_t pixels;
+        pixels.val[0] = Out == OutputEncoding::BGR8 ? p.b : p.r;
+        pixels.val[1] = p.g;
+        pixels.val[2] = Out == OutputEncoding::BGR8 ? p.r : p.b;
+        vst3q_u8(out, pixels);
+      }
+    }
+    scalar::ConvertRow<In, Out>(src, w, h, dst, row, x);
+  }
+}
+
+//! @brief Average 2x2 blocks of 32 samples of one channel, top and bottom row
+inline uint8x16_t AverageQuads(
+  uint8x16_t top0, uint8x16_t top1, uint8x16_t bottom0,
+  uint8x16_t bottom1)
+{
+  const uint16x8_t lo = vpadalq_u8(vpaddlq_u8(top0), bottom0);
+  const uint16x8_t hi = vpadalq_u8(vpaddlq_u8(top1), bottom1);
+  return vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2));
+}
+
+template<int Channels>
+inline void Downsample(const uint8_t * src, uint32_t w, uint32_t h, uint8_t * dst)
+{
+  const size_t stride = (size_t)w * Channels;
+  for (uint32_t row = 0; row < h / 2; row++) {
+    const uint8_t * top = src + 2 * row * stride;
+    const uint8_t * bottom = top + stride;
+    uint8_t * out = dst + (size_t)row * (w / 2) * Channels;
+    uint32_t x = 0;
+    for (; x + 16 <= w / 2; x += 16) {
+      const size_t in = 2 * x * Channels;
+      if (Channels == 1) {
+        vst1q_u8(
+          out + x,
+          AverageQuads(
+            vld1q_u8(top + in), vld1q_u8(top + in + 16),
+            vld1q_u8(bottom + in), vld1q_u8(bottom + in + 16)));
+      } else {
+        const uint8x16x3_t t0 = vld3q_u8(top + in);
+        const uint8x16x3_t t1 = vld3q_u8(top + in + 48);
+        const uint8x16x3_t b0 = vld3q_u8(bottom + in);
+        const uint8x16x3_t b1 = vld3q_u8(bottom + in + 48);
+        uint8x16x3_t pixels;
+        for (int c = 0; c < 3; c++) {
+          pixels.val[c] = AverageQuads(t0.val[c], t1.val[c], b0.val[c], b1.val[c]);
+        }
+        vst3q_u8(out + x * Channels, pixels);
+      }
+    }
+    scalar::DownsampleRow<Channels>(src, w, dst, row, x);
+  }
+}
+
+}  // namespace neon
+#endif  // DEPTHAI_KERNELS_NEON
+
+template<PixelFormat In, OutputEncoding Out>
+inline void ConvertWith(
+  SimdLevel level, const uint8_t * src, uint32_t w, uint32_t h,
+  uint8_t * dst)
+{
+  switch (level) {
+#if defined(DEPTHAI_KERNELS_AVX2)
+    case SimdLevel::AVX2:
+      avx2::Convert<In, Out>(src, w, h, dst);
+      return;
+#endif
+#if defined(DEPTHAI_KERNELS_NEON)
+    case SimdLevel::NEON:
+      neon::Convert<In, Out>(src, w, h, dst);
+      return;
+#endif
+    default:
+      scalar::Convert<In, Out>(src, w, h, dst);
+      return;
+  }
+}
+
+template<PixelFormat In>
+inline bool ConvertFormat(
+  OutputEncoding out, SimdLevel level, const uint8_t * src, uint32_t w,
+  uint32_t h, uint8_t * dst)
+{
+  switch (out) {
+    case OutputEncoding::BGR8:
+      ConvertWith<In, OutputEncoding::BGR8>(level, src, w, h, dst);
+      return true;
+    case OutputEncoding::RGB8:
+      ConvertWith<In, OutputEncoding::RGB8>(level, src, w, h, dst);
+      return true;
+    case OutputEncoding::Mono8:
+      ConvertWith<In, OutputEncoding::Mono8>(level, src, w, h, dst);
+      return true;
+    default:
+      return false;
+  }
+}
+
+template<int Channels>
+inline void DownsampleWith(
+  SimdLevel level, const uint8_t * src, uint32_t w, uint32_t h,
+  uint8_t * dst)
+{
+  switch (level) {
+#if defined(DEPTHAI_KERNELS_AVX2)
+    case SimdLevel::AVX2:
+      avx2::Downsample<Channels>(src, w, h, dst);
+      return;
+#endif
+#if defined(DEPTHAI_KERNELS_NEON)
+    case SimdLevel::NEON:
+      neon::Downsample<Channels>(src, w, h, dst);
+      return;
+#endif
+    default:
+      scalar::Downsample<Channels>(src, w, h, dst);
+      return;
+  }
+}
+
+}  // namespace image_kernels
+
+//! @brief Convert a raw frame to a published encoding. The kernel is specialized per
+//! layout and encoding at compile time, the instruction set is chosen at runtime.
+//! @param[in] in - layout of the source frame, stride equal to the width
+//! @param[in] out - output encoding, Native is rejected
+//! @param[in] src - source frame of InputSize bytes
+//! @param[in] width - frame width, even for the YUV layouts
+//! @param[in] height - frame height, even for NV12
+//! @param[out] dst - destination of OutputSize bytes
+//! @param[in] level - instruction set, falls back to scalar if not compiled in
+//! @return false if the conversion is not possible
+//!
+inline bool ConvertPixels(
+  PixelFormat in, OutputEncoding out, const uint8_t * src, uint32_t width,
+  uint32_t height, uint8_t * dst, SimdLevel level)
+{
+  using namespace image_kernels;
+  if ((in == PixelFormat::NV12 || in == PixelFormat::YUV422i) && (width & 1) != 0) {
+    return false;
+  }
+  if (in == PixelFormat::NV12 && (height & 1) != 0) {
+    return false;
+  }
+  switch (in) {
+    case PixelFormat::NV12:
+      return ConvertFormat<PixelFormat::NV12>(out, level, src, width, height, dst);
+    case PixelFormat::YUV422i:
+      return ConvertFormat<PixelFormat::YUV422i>(out, level, src, width, height, dst);
+    case PixelFormat::BGR888p:
+      return ConvertFormat<PixelFormat::BGR888p>(out, level, src, width, height, dst);
+    case PixelFormat::RGB888p:
+      return ConvertFormat<PixelFormat::RGB888p>(out, level, src, width, height, dst);
+    case PixelFormat::BGR888i:
+      return ConvertFormat<PixelFormat::BGR888i>(out, level, src, width, height, dst);
+    case PixelFormat::RGB888i:
+      return ConvertFormat<PixelFormat::RGB888i>(out, level, src, width, height, dst);
+    case PixelFormat::GRAY8:
+      return ConvertFormat<PixelFormat::GRAY8>(out, level, src, width, height, dst);
+    default:
+      return false;
+  }
+}
+
+//! @brief Convert with the best instruction set of the running CPU
+inline bool ConvertPixels(
+  PixelFormat in, OutputEncoding out, const uint8_t * src, uint32_t width,
+  uint32_t height, uint8_t * dst)
+{
+  static const SimdLevel level = image_kernels::DetectSimdLevel();
+  return ConvertPixels(in, out, src, width, height, dst, level);
+}
+
+//! @brief Halve an image by averaging 2x2 pixel blocks, the area filter of an image pyramid.
+//! An odd last row or column is dropped.
+//! @param[in] src - packed image of width * height * channels bytes
+//! @param[in] width - image width
+//! @param[in] height - image height
+//! @param[in] channels - 1 for mono8, 3 for bgr8 and rgb8
+//! @param[out] dst - destination of (width / 2) * (height / 2) * channels bytes
+//! @param[in] level - instruction set, falls back to scalar if not compiled in
+//! @return false if the channel count is not supported
+//!
+inline bool DownsampleHalf(
+  const uint8_t * src, uint32_t width, uint32_t height, uint32_t channels,
+  uint8_t * dst, SimdLevel level)
+{
+  switch (channels) {
+    case 1:
+      image_kernels::DownsampleWith<1>(level, src, width, height, dst);
+      return true;
+    case 3:
+      image_kernels::DownsampleWith<3>(level, src, width, height, dst);
+      return true;
+    default:
+      return false;
+  }
+}
+
+//! @brief Halve an image with the best instruction set of the running CPU
+inline bool DownsampleHalf(
+  const uint8_t * src, uint32_t width, uint32_t height, uint32_t channels,
+  uint8_t * dst)
+{
+  static const SimdLevel level = image_kernels::DetectSimdLevel();
+  return DownsampleHalf(src, width, height, channels, dst, level);
+}
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_IMAGE_KERNELS_H
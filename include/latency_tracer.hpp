@@ -0,0 +1,339 @@
+#ifndef FOG_SW_DEPTHAI_LATENCY_TRACER_H
+#define FOG_SW_DEPTHAI_LATENCY_TRACER_H
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace depthai_ctrl
+{
+
+//! @brief Points of the video path where a traced chunk is stamped
+enum class TraceStage
+{
+  Capture,    //!< Device capture, host synchronized
+  Callback,   //!< Encoder output callback entry in the camera node
+  Publish,    //!< Handed to the ROS2 publisher
+  Receive,    //!< Received by the GStreamer node
+  Dequeue,    //!< Taken from the chunk queue for the appsrc
+  Sink,       //!< Reached the network sink of the stream address
+  Count
+};
+
+//! @brief Steady clock stamps of one chunk in nanoseconds, 0 if not recorded
+struct FrameTrace
+{
+  std::array<int64_t, (size_t)TraceStage::Count> stampNs {};
+
+  int64_t & operator[](TraceStage stage) {return stampNs[(size_t)stage];}
+  int64_t operator[](TraceStage stage) const {return stampNs[(size_t)stage];}
+};
+
+//! @brief Percentiles of one traced interval
+struct LatencyStats
+{
+  const char * name;
+  uint64_t count;
+  double p50Ms;
+  double p95Ms;
+  double p99Ms;
+};
+
+//! @brief Latency histogram with logarithmic buckets, 8 per octave (about 6 % error).
+//! Recording is lock-free, reading and resetting races only cost a few samples.
+class LatencyHistogram
+{
+public:
+  //! @brief Add one sample
+  //! @param[in] latencyNs - latency in nanoseconds, negative values count as zero
+  //! @return void
+  //!
+  void Record(int64_t latencyNs)
+  {
+    const uint64_t us = latencyNs > 0 ? (uint64_t)latencyNs / 1000 : 0;
+    _buckets[BucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  //! @brief Return the latency below which the given fraction of the samples fall
+  //! @param[in] fraction - 0.0 - 1.0, e.g. 0.99 for p99
+  //! @return latency in milliseconds, 0 without samples
+  //!
+  double Percentile(double fraction) const
+  {
+    std::array<uint64_t, kBuckets> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBuckets; i++) {
+      counts[i] = _buckets[i].load(std::memory_order_relaxed);
+      total += counts[i];
+    }
+    if (total == 0) {
+      return 0.0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, (uint64_t)(fraction * total + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; i++) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return (LowerBound(i) + LowerBound(i + 1)) / 2.0 / 1000.0;
+      }
+    }
+    return LowerBound(kBuckets - 1) / 1000.0;
+  }
+
+  //! @brief Return number of samples
+  uint64_t Count() const
+  {
+    uint64_t total = 0;
+    for (const auto & bucket : _buckets) {
+      total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  //! @brief Drop all samples
+  void Reset()
+  {
+    for (auto & bucket : _buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  //! @brief Microsecond values below 16 get a bucket each, the rest 8 buckets per octave
+  static constexpr size_t kLinear = 16;
+  static constexpr size_t kBuckets = kLinear + 60 * 8;
+
+  static size_t BucketOf(uint64_t us)
+  {
+    if (us < kLinear) {
+      return (size_t)us;
+    }
+    const int exponent = 63 - __builtin_clzll(us);
+    const size_t sub = (size_t)(us >> (exponent - 3)) & 7;
+    return std::min(kLinear + (size_t)(exponent - 4) * 8 + sub, kBuckets - 1);
+  }
+
+  static double LowerBound(size_t bucket)
+  {
+    if (bucket < kLinear) {
+      return (double)bucket;
+    }
+    const size_t exponent = (bucket - kLinear) / 8 + 4;
+    const size_t sub = (bucket - kLinear) % 8;
+    return (double)((8 + sub) << (exponent - 3));
+  }
+
+  std::array<std::atomic<uint64_t>, kBuckets> _buckets {};
+};
+
+//! @brief End-to-end latency tracing of the video chunks.
+//! The camera node appends the capture, callback and publish stamps to the message format
+//! ("H264;trace=<ns>,<ns>,<ns>") and the GStreamer node the receive stamp. The chunk is
+//! matched to its GstBuffer by the order of the appsrc output, and to the sink buffers by
+//! the PTS. Untraced messages keep the plain format, so the disabled path costs one flag check.
+class LatencyTracer
+{
+public:
+  //! @brief Traced intervals between the stages
+  enum Interval
+  {
+    CaptureToCallback,
+    CallbackToPublish,
+    PublishToReceive,
+    ReceiveToDequeue,
+    DequeueToSink,
+    CaptureToSink,
+    IntervalCount
+  };
+
+  //! @brief Return the current steady clock time, the clock of all stamps
+  static int64_t Now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  //! @brief Return true if the message format carries trace stamps
+  static bool IsTraced(const std::string & format)
+  {
+    return format.find(FormatMarker()) != std::string::npos;
+  }
+
+  //! @brief Append the stamp of the next stage to the message format
+  //! @param[in,out] format - message format, e.g. "H264"
+  //! @param[in] stampNs - steady clock stamp
+  //! @return void
+  //!
+  static void AppendStamp(std::string & format, int64_t stampNs)
+  {
+    format += IsTraced(format) ? "," : FormatMarker();
+    format += std::to_string(stampNs);
+  }
+
+  //! @brief Read the stamps of a message format, in stage order from Capture
+  //! @param[in] format - message format
+  //! @return stamps, all zero if the format is not traced
+  //!
+  static FrameTrace ParseFormat(const std::string & format)
+  {
+    FrameTrace trace{};
+    size_t pos = format.find(FormatMarker());
+    if (pos == std::string::npos) {
+      return trace;
+    }
+    pos += std::strlen(FormatMarker());
+    for (size_t stage = 0; stage < (size_t)TraceStage::Dequeue && pos < format.size(); stage++) {
+      char * end = nullptr;
+      trace.stampNs[stage] = std::strtoll(format.c_str() + pos, &end, 10);
+      pos = (size_t)(end - format.c_str()) + 1;
+    }
+    return trace;
+  }
+
+  static const char * IntervalName(Interval interval)
+  {
+    switch (interval) {
+      case CaptureToCallback: return "CaptureToCallback";
+      case CallbackToPublish: return "CallbackToPublish";
+      case PublishToReceive: return "PublishToReceive";
+      case ReceiveToDequeue: return "ReceiveToDequeue";
+      case DequeueToSink: return "DequeueToSink";
+      case CaptureToSink: return "CaptureToSink";
+      default: return "Unknown";
+    }
+  }
+
+  //! @brief Enable or disable tracing
+  void SetEnabled(bool enabled) {_enabled.store(enabled, std::memory_order_relaxed);}
+
+  //! @brief Return is tracing enabled
+  bool IsEnabled() const {return _enabled.load(std::memory_order_relaxed);}
+
+  //! @brief Forget the chunks in flight, called when a new pipeline starts
+  void Clear()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pending.clear();
+    _inFlight.clear();
+  }
+
+  //! @brief Record a chunk taken from the queue. Must be called for every chunk handed
+  //! to the appsrc, in order, so that OnSourceOutput can match the buffers.
+  //! @param[in] format - message format of the chunk
+  //! @param[in] nowNs - dequeue stamp
+  //! @return void
+  //!
+  void OnDequeue(const std::string & format, int64_t nowNs)
+  {
+    FrameTrace trace = ParseFormat(format);
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Chunks sent again with a GOP replay keep their old stamps, they are traced once.
+    const int64_t received = trace[TraceStage::Receive];
+    if (trace[TraceStage::Capture] == 0 || (received != 0 && received <= _lastReceiveNs)) {
+      trace = FrameTrace{};
+    } else {
+      _lastReceiveNs = received;
+      trace[TraceStage::Dequeue] = nowNs;
+      RecordBetween(trace, TraceStage::Capture, TraceStage::Callback, CaptureToCallback);
+      RecordBetween(trace, TraceStage::Callback, TraceStage::Publish, CallbackToPublish);
+      RecordBetween(trace, TraceStage::Publish, TraceStage::Receive, PublishToReceive);
+      RecordBetween(trace, TraceStage::Receive, TraceStage::Dequeue, ReceiveToDequeue);
+    }
+    _pending.push_back(trace);
+    if (_pending.size() > kMaxTracked) {
+      _pending.pop_front();
+    }
+  }
+
+  //! @brief Match the next dequeued chunk to the buffer leaving the appsrc
+  //! @param[in] key - PTS of the buffer
+  //! @return void
+  //!
+  void OnSourceOutput(uint64_t key)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_pending.empty()) {
+      return;
+    }
+    const FrameTrace trace = _pending.front();
+    _pending.pop_front();
+    if (trace[TraceStage::Dequeue] == 0) {
+      return;
+    }
+    _inFlight.push_back(InFlight{key, trace});
+    if (_inFlight.size() > kMaxTracked) {
+      _inFlight.pop_front();
+    }
+  }
+
+  //! @brief Record a buffer reaching the sink, the first one with the key completes the trace
+  //! @param[in] key - PTS of the buffer
+  //! @param[in] nowNs - sink stamp
+  //! @return void
+  //!
+  void OnSink(uint64_t key, int64_t nowNs)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _inFlight.begin(); it != _inFlight.end(); ++it) {
+      if (it->key != key) {
+        continue;
+      }
+      it->trace[TraceStage::Sink] = nowNs;
+      RecordBetween(it->trace, TraceStage::Dequeue, TraceStage::Sink, DequeueToSink);
+      RecordBetween(it->trace, TraceStage::Capture, TraceStage::Sink, CaptureToSink);
+      // Older chunks did not make it to the sink, e.g. dropped by a leaky queue.
+      _inFlight.erase(_inFlight.begin(), it + 1);
+      return;
+    }
+  }
+
+  //! @brief Return the percentiles of every interval and restart the histograms
+  std::vector<LatencyStats> TakeStats()
+  {
+    std::vector<LatencyStats> stats;
+    for (int i = 0; i < IntervalCount; i++) {
+      auto & histogram = _histograms[i];
+      stats.push_back(
+        LatencyStats{IntervalName((Interval)i), histogram.Count(),
+          histogram.Percentile(0.50), histogram.Percentile(0.95), histogram.Percentile(0.99)});
+      histogram.Reset();
+    }
+    return stats;
+  }
+
+private:
+  static const char * FormatMarker() {return ";trace=";}
+  //! @brief Bound of the tracked chunks, lost ones must not pile up
+  static constexpr size_t kMaxTracked = 256;
+
+  struct InFlight
+  {
+    uint64_t key;
+    FrameTrace trace;
+  };
+
+  void RecordBetween(const FrameTrace & trace, TraceStage from, TraceStage to, Interval interval)
+  {
+    if (trace[from] != 0 && trace[to] != 0) {
+      _histograms[interval].Record(trace[to] - trace[from]);
+    }
+  }
+
+  std::atomic<bool> _enabled {false};
+  std::mutex _mutex;
+  std::deque<FrameTrace> _pending {};
+  std::deque<InFlight> _inFlight {};
+  int64_t _lastReceiveNs = 0;
+  std::array<LatencyHistogram, IntervalCount> _histograms {};
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_LATENCY_TRACER_H
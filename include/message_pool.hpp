@@ -0,0 +1,79 @@
+#ifndef FOG_SW_DEPTHAI_MESSAGE_POOL_H
+#define FOG_SW_DEPTHAI_MESSAGE_POOL_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace depthai_ctrl
+{
+
+//! @brief Fixed set of preallocated messages, reused from frame to frame.
+//! Acquire only allocates when every message is in use, Release keeps at most
+//! the preallocated number of messages, so the steady state does not touch the heap.
+//! Allocations counts every message ever allocated, including the preallocated ones.
+template<typename T>
+class MessagePool
+{
+public:
+  //! @brief Constructor
+  //! @param[in] size - number of preallocated messages
+  //!
+  explicit MessagePool(size_t size)
+  : _capacity(size)
+  {
+    _free.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+      _free.push_back(std::unique_ptr<T>(new T()));
+    }
+    _allocations = size;
+  }
+
+  MessagePool(const MessagePool &) = delete;
+  MessagePool & operator=(const MessagePool &) = delete;
+
+  //! @brief Take a message out of the pool. Its fields keep the values and the
+  //! capacity of their previous use.
+  //! @return message, newly allocated if the pool is empty
+  //!
+  std::unique_ptr<T> Acquire()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (!_free.empty()) {
+        std::unique_ptr<T> message = std::move(_free.back());
+        _free.pop_back();
+        return message;
+      }
+    }
+    _allocations++;
+    return std::unique_ptr<T>(new T());
+  }
+
+  //! @brief Give a message back to the pool, it is freed if the pool is full
+  //! @param[in] message - message taken with Acquire
+  //! @return void
+  //!
+  void Release(std::unique_ptr<T> message)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_free.size() < _capacity) {
+      _free.push_back(std::move(message));
+    }
+  }
+
+  //! @brief Return number of allocated messages, constant once the pool is warmed up
+  uint64_t Allocations() const {return _allocations;}
+
+private:
+  const size_t _capacity;
+  std::mutex _mutex;
+  std::vector<std::unique_ptr<T>> _free;
+  std::atomic<uint64_t> _allocations {0};
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_MESSAGE_POOL_H
@@ -0,0 +1,207 @@
+#ifndef FOG_SW_DEPTHAI_POINT_CLOUD_H
+#define FOG_SW_DEPTHAI_POINT_CLOUD_H
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "image_kernels.hpp"
+
+namespace depthai_ctrl
+{
+
+//! @brief Pinhole camera model of a depth image
+struct DepthIntrinsics
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  float fx = 0.0f;
+  float fy = 0.0f;
+  float cx = 0.0f;
+  float cy = 0.0f;
+
+  bool operator==(const DepthIntrinsics & other) const
+  {
+    return width == other.width && height == other.height && fx == other.fx &&
+           fy == other.fy && cx == other.cx && cy == other.cy;
+  }
+  bool operator!=(const DepthIntrinsics & other) const {return !(*this == other);}
+};
+
+//! @brief Per-pixel viewing rays of a depth image, (u - cx) / fx and (v - cy) / fy.
+//! Built once per camera model, a point is then the ray scaled by the depth of its pixel.
+class DepthRayTable
+{
+public:
+  //! @brief Compute the rays of every pixel, nothing is done if the model did not change
+  //! @param[in] intrinsics - camera model of the depth image
+  //! @return void
+  //!
+  void Build(const DepthIntrinsics & intrinsics)
+  {
+    if (intrinsics == _intrinsics && !_rayX.empty()) {
+      return;
+    }
+    _intrinsics = intrinsics;
+    const size_t pixels = (size_t)intrinsics.width * intrinsics.height;
+    _rayX.resize(pixels);
+    _rayY.resize(pixels);
+    for (uint32_t v = 0; v < intrinsics.height; v++) {
+      const float y = ((float)v - intrinsics.cy) / intrinsics.fy;
+      for (uint32_t u = 0; u < intrinsics.width; u++) {
+        const size_t i = (size_t)v * intrinsics.width + u;
+        _rayX[i] = ((float)u - intrinsics.cx) / intrinsics.fx;
+        _rayY[i] = y;
+      }
+    }
+  }
+
+  const DepthIntrinsics & Intrinsics() const {return _intrinsics;}
+  const float * RayX() const {return _rayX.data();}
+  const float * RayY() const {return _rayY.data();}
+  size_t Size() const {return _rayX.size();}
+
+private:
+  DepthIntrinsics _intrinsics;
+  std::vector<float> _rayX;
+  std::vector<float> _rayY;
+};
+
+namespace point_cloud
+{
+
+//! @brief Bytes per point: float32 x, y, z and one float of padding, PointCloud2 point_step
+constexpr uint32_t kPointStep = 16;
+
+namespace scalar
+{
+
+inline void DepthToPoints(
+  const uint16_t * depth, const float * rayX, const float * rayY,
+  size_t begin, size_t end, float scale, float * points)
+{
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for (size_t i = begin; i < end; i++) {
+    const float z = (float)depth[i] * scale;
+    float * point = points + i * 4;
+    point[0] = depth[i] != 0 ? rayX[i] * z : nan;
+    point[1] = depth[i] != 0 ? rayY[i] * z : nan;
+    point[2] = depth[i] != 0 ? z : nan;
+    point[3] = 0.0f;
+  }
+}
+
+}  // namespace scalar
+
+#if defined(DEPTHAI_KERNELS_AVX2)
+namespace avx2
+{
+
+//! @brief 8 pixels per step, transposed to 16 byte points in two 4x4 blocks
+DEPTHAI_TARGET_AVX2 inline void DepthToPoints(
+  const uint16_t * depth, const float * rayX,
+  const float * rayY, size_t pixels, float scale, float * points)
+{
+  const __m256 nan = _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN());
+  const __m256 scales = _mm256_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 8 <= pixels; i += 8) {
+    const __m256i d = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(depth + i)));
+    const __m256 invalid = _mm256_castsi256_ps(_mm256_cmpeq_epi32(d, _mm256_setzero_si256()));
+    const __m256 z = _mm256_mul_ps(_mm256_cvtepi32_ps(d), scales);
+    const __m256 x = _mm256_blendv_ps(_mm256_mul_ps(_mm256_loadu_ps(rayX + i), z), nan, invalid);
+    const __m256 y = _mm256_blendv_ps(_mm256_mul_ps(_mm256_loadu_ps(rayY + i), z), nan, invalid);
+    const __m256 zs = _mm256_blendv_ps(z, nan, invalid);
+    for (int half = 0; half < 2; half++) {
+      __m128 px = half ? _mm256_extractf128_ps(x, 1) : _mm256_castps256_ps128(x);
+      __m128 py = half ? _mm256_extractf128_ps(y, 1) : _mm256_castps256_ps128(y);
+      __m128 pz = half ? _mm256_extractf128_ps(zs, 1) : _mm256_castps256_ps128(zs);
+      __m128 pw = _mm_setzero_ps();
+      _MM_TRANSPOSE4_PS(px, py, pz, pw);
+      float * out = points + (i + half * 4) * 4;
+      _mm_storeu_ps(out, px);
+      _mm_storeu_ps(out + 4, py);
+      _mm_storeu_ps(out + 8, pz);
+      _mm_storeu_ps(out + 12, pw);
+    }
+  }
+  scalar::DepthToPoints(depth, rayX, rayY, i, pixels, scale, points);
+}
+
+}  // namespace avx2
+#endif  // DEPTHAI_KERNELS_AVX2
+
+#if defined(DEPTHAI_KERNELS_NEON)
+namespace neon
+{
+
+//! @brief 4 pixels per step, vst4q interleaves them into 16 byte points
+inline void DepthToPoints(
+  const uint16_t * depth, const float * rayX, const float * rayY,
+  size_t pixels, float scale, float * points)
+{
+  const float32x4_t nan = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+  size_t i = 0;
+  for (; i + 4 <= pixels; i += 4) {
+    const uint32x4_t d = vmovl_u16(vld1_u16(depth + i));
+    const uint32x4_t invalid = vceqq_u32(d, vdupq_n_u32(0));
+    const float32x4_t z = vmulq_n_f32(vcvtq_f32_u32(d), scale);
+    float32x4x4_t point;
+    point.val[0] = vbslq_f32(invalid, nan, vmulq_f32(vld1q_f32(rayX + i), z));
+    point.val[1] = vbslq_f32(invalid, nan, vmulq_f32(vld1q_f32(rayY + i), z));
+    point.val[2] = vbslq_f32(invalid, nan, z);
+    point.val[3] = vdupq_n_f32(0.0f);
+    vst4q_f32(points + i * 4, point);
+  }
+  scalar::DepthToPoints(depth, rayX, rayY, i, pixels, scale, points);
+}
+
+}  // namespace neon
+#endif  // DEPTHAI_KERNELS_NEON
+
+}  // namespace point_cloud
+
+//! @brief Turn a depth image into an organized point cloud, in the optical frame of the camera.
+//! Pixels without depth become NaN points, so the cloud keeps the image layout.
+//! @param[in] depth - depth image of rays.Size() pixels
+//! @param[in] rays - ray table of the depth image
+//! @param[in] scale - meters per depth unit, 0.001 for millimeters
+//! @param[out] points - point_cloud::kPointStep bytes per pixel, x, y, z, padding
+//! @param[in] level - instruction set, falls back to scalar if not compiled in
+//! @return void
+//!
+inline void DepthToPoints(
+  const uint16_t * depth, const DepthRayTable & rays, float scale, uint8_t * points,
+  SimdLevel level)
+{
+  float * out = reinterpret_cast<float *>(points);
+  switch (level) {
+#if defined(DEPTHAI_KERNELS_AVX2)
+    case SimdLevel::AVX2:
+      point_cloud::avx2::DepthToPoints(depth, rays.RayX(), rays.RayY(), rays.Size(), scale, out);
+      return;
+#endif
+#if defined(DEPTHAI_KERNELS_NEON)
+    case SimdLevel::NEON:
+      point_cloud::neon::DepthToPoints(depth, rays.RayX(), rays.RayY(), rays.Size(), scale, out);
+      return;
+#endif
+    default:
+      point_cloud::scalar::DepthToPoints(
+        depth, rays.RayX(), rays.RayY(), 0, rays.Size(), scale, out);
+      return;
+  }
+}
+
+//! @brief Turn a depth image into points with the best instruction set of the running CPU
+inline void DepthToPoints(
+  const uint16_t * depth, const DepthRayTable & rays, float scale,
+  uint8_t * points)
+{
+  static const SimdLevel level = image_kernels::DetectSimdLevel();
+  DepthToPoints(depth, rays, scale, points, level);
+}
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_POINT_CLOUD_H
@@ -0,0 +1,231 @@
+#ifndef FOG_SW_DEPTHAI_QUEUE_POLICY_H
+#define FOG_SW_DEPTHAI_QUEUE_POLICY_H
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace depthai_ctrl
+{
+
+//! @brief Latency against loss trade-off of the host queue of a device output stream
+enum class QueuePolicy
+{
+  //! @brief Only the newest frame is delivered, the host never works on a stale frame
+  NewestOnly,
+  //! @brief Every frame while the host is at most the queue depth behind. Up to twice the
+  //! depth behind, the host drops the oldest frames and counts them as discarded. Further
+  //! behind, the device queue drops them, counted as lost. The device is not held back.
+  Bounded,
+  //! @brief Every frame, a full queue holds back the device stream
+  Blocking
+};
+
+//! @brief Return the parameter name of a queue policy
+inline const char * QueuePolicyName(QueuePolicy policy)
+{
+  switch (policy) {
+    case QueuePolicy::NewestOnly: return "newest";
+    case QueuePolicy::Blocking: return "blocking";
+    default: return "bounded";
+  }
+}
+
+//! @brief Parse a queue policy parameter: "newest", "bounded" or "blocking"
+//! @param[in] name - parameter value
+//! @param[out] policy - parsed policy, unchanged on failure
+//! @return false if the name is unknown
+//!
+inline bool ParseQueuePolicy(const std::string & name, QueuePolicy & policy)
+{
+  if (name == "newest") {
+    policy = QueuePolicy::NewestOnly;
+  } else if (name == "bounded") {
+    policy = QueuePolicy::Bounded;
+  } else if (name == "blocking") {
+    policy = QueuePolicy::Blocking;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+//! @brief Host queue of one output stream
+struct StreamQueueConfig
+{
+  QueuePolicy policy = QueuePolicy::Bounded;
+  //! @brief Queue depth in frames
+  int depth = 30;
+  //! @brief Queue depth in milliseconds of frames, replaces depth if > 0
+  int depthMs = 0;
+
+  //! @brief Frames the host may fall behind before the policy drops any
+  int Depth() const {return policy == QueuePolicy::NewestOnly ? 1 : std::max(depth, 1);}
+  //! @brief Maximum size of the device output queue. A bounded queue has room for twice its
+  //! depth, so a full depth of backlog reaches the host and the host drops and counts it.
+  int MaxSize() const {return policy == QueuePolicy::Bounded ? 2 * Depth() : Depth();}
+  //! @brief Whether the device output queue is blocking, i.e. holds back the device stream
+  bool IsBlocking() const {return policy == QueuePolicy::Blocking;}
+  //! @brief Whether the host drops the frames of a batch beyond the depth
+  bool IsLossy() const {return policy != QueuePolicy::Blocking;}
+};
+
+//! @brief Turn a depth in milliseconds into frames at a frame rate, at least one frame
+inline StreamQueueConfig ResolveQueueDepth(const StreamQueueConfig & config, int fps)
+{
+  StreamQueueConfig resolved = config;
+  if (config.depthMs > 0) {
+    resolved.depth = std::max(1, (int)std::ceil(config.depthMs * std::max(fps, 1) / 1000.0));
+    resolved.depthMs = 0;
+  }
+  return resolved;
+}
+
+//! @brief Read the next batch of a queue: wait for a frame, then take all frames behind it.
+//! The queue is read from its own thread, so a slow stream callback finds a backlog in
+//! the next batch, which the QueueMonitor then trims to the policy.
+//! @param[in] queue - e.g. dai::DataOutputQueue, with get(timeout, hasTimedout) and tryGetAll()
+//! @param[in] timeout - longest wait for the first frame
+//! @param[out] frames - batch, oldest frame first
+//! @return false if no frame came within the timeout
+//!
+template<typename Frame, typename Queue>
+bool ReadQueueBatch(
+  Queue & queue, std::chrono::milliseconds timeout,
+  std::vector<std::shared_ptr<Frame>> & frames)
+{
+  frames.clear();
+  bool timedOut = false;
+  std::shared_ptr<Frame> first = queue.template get<Frame>(timeout, timedOut);
+  if (timedOut || !first) {
+    return false;
+  }
+  frames = queue.template tryGetAll<Frame>();
+  frames.insert(frames.begin(), first);
+  return true;
+}
+
+//! @brief Queue telemetry of one output stream
+struct QueueStats
+{
+  QueuePolicy policy = QueuePolicy::Bounded;
+  int depth = 0;
+  uint64_t batches = 0;     //!< Reads of the queue
+  uint64_t frames = 0;      //!< Frames delivered to the stream callback
+  uint64_t discarded = 0;   //!< Frames dropped on the host by the policy
+  uint64_t lost = 0;        //!< Gaps of the sequence numbers, dropped before the host
+  double fillLast = 0.0;    //!< Frames waiting at a read over the depth, 0.0 - 1.0
+  double fillMax = 0.0;
+  double fillMean = 0.0;
+};
+
+//! @brief Applies the policy of a stream to each batch read from its queue and keeps the
+//! telemetry. Frames are anything with getSequenceNum(), e.g. dai::ImgFrame.
+//! Thread-safe, the stream callback applies while the telemetry is read.
+class QueueMonitor
+{
+public:
+  explicit QueueMonitor(const StreamQueueConfig & config = StreamQueueConfig())
+  {
+    SetConfig(config);
+  }
+
+  //! @brief Change the policy, e.g. when the device is opened again. Telemetry is kept.
+  void SetConfig(const StreamQueueConfig & config)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _config = config;
+    _stats.policy = config.policy;
+    _stats.depth = config.Depth();
+  }
+
+  //! @brief Apply the policy to a batch read from the queue, oldest frame first
+  //! @param[in,out] frames - batch, the frames the policy drops are removed
+  //! @return void
+  //!
+  template<typename Frame>
+  void Apply(std::vector<std::shared_ptr<Frame>> & frames)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (frames.empty()) {
+      return;
+    }
+    for (const std::shared_ptr<Frame> & frame : frames) {
+      const int64_t sequence = frame->getSequenceNum();
+      // A restarted device counts from zero again.
+      if (_haveSequence && sequence > _lastSequence + 1) {
+        _stats.lost += (uint64_t)(sequence - _lastSequence - 1);
+      }
+      _haveSequence = true;
+      _lastSequence = sequence;
+    }
+    const size_t depth = (size_t)_config.Depth();
+    const double fill = std::min(1.0, (double)frames.size() / (double)depth);
+    // A blocking stream delivers all, the others keep the newest frames up to the depth.
+    if (_config.IsLossy() && frames.size() > depth) {
+      const size_t excess = frames.size() - depth;
+      frames.erase(frames.begin(), frames.begin() + excess);
+      _stats.discarded += excess;
+    }
+    _stats.batches++;
+    _stats.frames += frames.size();
+    _stats.fillLast = fill;
+    _stats.fillMax = std::max(_stats.fillMax, fill);
+    _stats.fillMean += (fill - _stats.fillMean) / (double)_stats.batches;
+  }
+
+  QueueStats GetStats() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+  }
+
+private:
+  mutable std::mutex _mutex;
+  StreamQueueConfig _config;
+  bool _haveSequence = false;
+  int64_t _lastSequence = 0;
+  QueueStats _stats;
+};
+
+//! @brief Queue monitors of the output streams of a frame source. They are kept over
+//! reopens of the device, so the telemetry adds up. Thread-safe.
+class QueueMonitorSet
+{
+public:
+  //! @brief Return the monitor of a stream with a new policy, created on first use
+  std::shared_ptr<QueueMonitor> Get(const std::string & stream, const StreamQueueConfig & config)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::shared_ptr<QueueMonitor> & monitor = _monitors[stream];
+    if (!monitor) {
+      monitor = std::make_shared<QueueMonitor>(config);
+    } else {
+      monitor->SetConfig(config);
+    }
+    return monitor;
+  }
+
+  std::map<std::string, QueueStats> GetStats() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::map<std::string, QueueStats> stats;
+    for (const auto & entry : _monitors) {
+      stats[entry.first] = entry.second->GetStats();
+    }
+    return stats;
+  }
+
+private:
+  mutable std::mutex _mutex;
+  std::map<std::string, std::shared_ptr<QueueMonitor>> _monitors;
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_QUEUE_POLICY_H
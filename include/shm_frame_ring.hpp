@@ -0,0 +1,710 @@
+#ifndef FOG_SW_DEPTHAI_SHM_FRAME_RING_H
+#define FOG_SW_DEPTHAI_SHM_FRAME_RING_H
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "camera_config.hpp"
+
+namespace depthai_ctrl
+{
+
+#if ATOMIC_INT_LOCK_FREE != 2 || ATOMIC_LLONG_LOCK_FREE != 2
+#error "The shared memory rings need lock-free 32 and 64 bit atomics"
+#endif
+
+//! @brief Metadata of one frame in a shared memory slot, the fields of a dai::ImgFrame
+struct ShmFrameInfo
+{
+  uint32_t type = 0;            //!< dai::RawImgFrame::Type
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t size = 0;            //!< Bytes of frame data
+  int64_t sequenceNum = 0;
+  int64_t timestampNs = 0;      //!< Host synchronized capture time, steady clock
+  int64_t timestampDeviceNs = 0;  //!< Device capture time
+};
+
+namespace shm
+{
+
+constexpr uint64_t kRingMagic = 0x3130474e49524144ULL;     //!< "DARING01"
+constexpr uint64_t kControlMagic = 0x31304c5254434144ULL;  //!< "DACTRL01"
+//! @brief Clients of one ring, each holds slots through one bit of the slot holder mask
+constexpr int kMaxClients = 31;
+//! @brief Holder bit of the producer while it writes a slot
+constexpr uint32_t kWriterBit = 0x80000000U;
+constexpr size_t kAlignment = 64;
+
+inline size_t Align(size_t size) {return (size + kAlignment - 1) / kAlignment * kAlignment;}
+
+//! @brief POSIX shared memory object name, e.g. "/depthai_ctrl_enc26xColor"
+inline std::string ObjectName(const std::string & prefix, const std::string & suffix)
+{
+  return "/" + prefix + "_" + suffix;
+}
+
+//! @brief Return true if a process of the PID namespace of the caller has the pid. The
+//! daemon and its clients must share one PID namespace, see README.md.
+inline bool IsProcessAlive(int32_t pid)
+{
+  return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+//! @brief Block on a 32 bit word shared between processes while it holds value
+inline void FutexWait(std::atomic<uint32_t> & word, uint32_t value, int timeoutMs)
+{
+  struct timespec timeout;
+  timeout.tv_sec = timeoutMs / 1000;
+  timeout.tv_nsec = (long)(timeoutMs % 1000) * 1000000L;
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+}
+
+inline void FutexWakeAll(std::atomic<uint32_t> & word)
+{
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+//! @brief Mapping of a shared memory object, unmapped on destruction
+class Mapping
+{
+public:
+  Mapping() = default;
+  ~Mapping() {Unmap();}
+
+  Mapping(const Mapping &) = delete;
+  Mapping & operator=(const Mapping &) = delete;
+
+  //! @brief Create the object, an existing object of the name is replaced
+  bool Create(const std::string & name, size_t size)
+  {
+    Unmap();
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0660);
+    if (fd < 0) {
+      return false;
+    }
+    const bool ok = ftruncate(fd, (off_t)size) == 0 && Map(fd, size);
+    close(fd);
+    if (!ok) {
+      shm_unlink(name.c_str());
+    }
+    return ok;
+  }
+
+  //! @brief Map an existing object
+  bool Open(const std::string & name)
+  {
+    Unmap();
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info;
+    const bool ok = fstat(fd, &info) == 0 && info.st_size > 0 && Map(fd, (size_t)info.st_size);
+    close(fd);
+    return ok;
+  }
+
+  void Unmap()
+  {
+    if (_address != nullptr) {
+      munmap(_address, _size);
+      _address = nullptr;
+      _size = 0;
+    }
+  }
+
+  uint8_t * Address() const {return static_cast<uint8_t *>(_address);}
+  size_t Size() const {return _size;}
+
+private:
+  bool Map(int fd, size_t size)
+  {
+    void * address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+      return false;
+    }
+    _address = address;
+    _size = size;
+    return true;
+  }
+
+  void * _address = nullptr;
+  size_t _size = 0;
+};
+
+}  // namespace shm
+
+//! @brief Ring of frame slots in shared memory, one producer process and up to
+//! shm::kMaxClients reading processes. Every client reads every frame without copying it
+//! out of the ring first. A slot is reference counted by a mask of the clients holding it,
+//! the producer only reuses slots nobody holds and drops the frame when all are held.
+//! A client which fell behind skips to the oldest frame still in the ring. Slots held by
+//! a crashed client are reclaimed by the producer. Readers block on a futex in the ring,
+//! they wake up with the write and need no polling.
+class ShmFrameRing
+{
+  struct Header;
+  struct Slot;
+
+public:
+  //! @brief A frame held in its slot, the slot is released on destruction
+  class Ref
+  {
+  public:
+    Ref() = default;
+    ~Ref() {Reset();}
+
+    Ref(const Ref &) = delete;
+    Ref & operator=(const Ref &) = delete;
+    Ref(Ref && other) noexcept {*this = std::move(other);}
+    Ref & operator=(Ref && other) noexcept
+    {
+      if (this != &other) {
+        Reset();
+        std::swap(_slot, other._slot);
+        std::swap(_bit, other._bit);
+        std::swap(_data, other._data);
+      }
+      return *this;
+    }
+
+    bool IsValid() const {return _slot != nullptr;}
+    const ShmFrameInfo & Info() const {return _slot->info;}
+    const uint8_t * Data() const {return _data;}
+    uint64_t Sequence() const {return _slot->seq.load(std::memory_order_relaxed);}
+
+    void Reset()
+    {
+      if (_slot != nullptr) {
+        _slot->holders.fetch_and(~_bit, std::memory_order_release);
+        _slot = nullptr;
+      }
+    }
+
+  private:
+    friend class ShmFrameRing;
+    Slot * _slot = nullptr;
+    uint32_t _bit = 0;
+    const uint8_t * _data = nullptr;
+  };
+
+  ~ShmFrameRing()
+  {
+    if (_header == nullptr) {
+      return;
+    }
+    if (_producer) {
+      _header->closed.store(1, std::memory_order_release);
+      _header->notify.fetch_add(1, std::memory_order_release);
+      shm::FutexWakeAll(_header->notify);
+      shm_unlink(_name.c_str());
+    } else if (_client >= 0) {
+      ReleaseClient(_client);
+    }
+  }
+
+  ShmFrameRing(const ShmFrameRing &) = delete;
+  ShmFrameRing & operator=(const ShmFrameRing &) = delete;
+
+  //! @brief Create a ring as its producer, an existing ring of the name is replaced
+  //! @param[in] name - shared memory object name, see shm::ObjectName
+  //! @param[in] slots - number of frames in the ring
+  //! @param[in] slotBytes - largest frame
+  //! @return the ring, nullptr on failure
+  //!
+  static std::unique_ptr<ShmFrameRing> Create(
+    const std::string & name, uint32_t slots,
+    uint32_t slotBytes)
+  {
+    std::unique_ptr<ShmFrameRing> ring(new ShmFrameRing(name, true));
+    const size_t size = Layout(slots, slotBytes);
+    if (slots == 0 || !ring->_mapping.Create(name, size)) {
+      return nullptr;
+    }
+    Header * header = new (ring->_mapping.Address()) Header();
+    header->slotCount = slots;
+    header->slotBytes = slotBytes;
+    header->producerPid.store(getpid(), std::memory_order_relaxed);
+    for (uint32_t i = 0; i < slots; i++) {
+      new (ring->_mapping.Address() + SlotOffset(i)) Slot();
+    }
+    // Published last, a client never sees a ring which is still being set up.
+    header->magic.store(shm::kRingMagic, std::memory_order_release);
+    ring->Bind();
+    return ring;
+  }
+
+  //! @brief Attach to a ring as a client. Reading starts with the next written frame.
+  //! @param[in] name - shared memory object name
+  //! @return the ring, nullptr if there is no ring, it was closed or all clients are taken
+  //!
+  static std::unique_ptr<ShmFrameRing> Attach(const std::string & name)
+  {
+    std::unique_ptr<ShmFrameRing> ring(new ShmFrameRing(name, false));
+    if (!ring->_mapping.Open(name) || ring->_mapping.Size() < sizeof(Header)) {
+      return nullptr;
+    }
+    const Header * header = reinterpret_cast<const Header *>(ring->_mapping.Address());
+    if (header->magic.load(std::memory_order_acquire) != shm::kRingMagic ||
+      header->slotCount == 0 ||
+      ring->_mapping.Size() < Layout(header->slotCount, header->slotBytes))
+    {
+      return nullptr;
+    }
+    ring->Bind();
+    if (ring->IsClosed()) {
+      return nullptr;
+    }
+    const int32_t pid = getpid();
+    for (int i = 0; i < shm::kMaxClients; i++) {
+      int32_t free = 0;
+      if (ring->_header->clients[i].compare_exchange_strong(free, pid)) {
+        ring->_client = i;
+        break;
+      }
+    }
+    if (ring->_client < 0) {
+      return nullptr;
+    }
+    ring->_lastSeq = ring->_header->writeSeq.load(std::memory_order_acquire);
+    return ring;
+  }
+
+  //! @brief Copy a frame into the oldest slot nobody holds. Producer only.
+  //! @param[in] info - frame metadata, info.size bytes of data
+  //! @param[in] data - frame data
+  //! @return false if the frame is larger than a slot or every slot is held
+  //!
+  bool Write(const ShmFrameInfo & info, const uint8_t * data)
+  {
+    if (!_producer || info.size > _header->slotBytes) {
+      _drops++;
+      return false;
+    }
+    for (int attempt = 0; attempt < 2; attempt++) {
+      for (uint32_t i = 0; i < _header->slotCount; i++) {
+        const uint32_t index = (_nextSlot + i) % _header->slotCount;
+        Slot & slot = SlotAt(index);
+        uint32_t free = 0;
+        if (!slot.holders.compare_exchange_strong(free, shm::kWriterBit, std::memory_order_acquire)) {
+          continue;
+        }
+        // Readers check the sequence again after they took the slot.
+        slot.seq.store(0, std::memory_order_release);
+        slot.info = info;
+        std::memcpy(DataAt(index), data, info.size);
+        slot.seq.store(
+          _header->writeSeq.fetch_add(1, std::memory_order_acq_rel) + 1, std::memory_order_release);
+        slot.holders.fetch_and(~shm::kWriterBit, std::memory_order_release);
+        _nextSlot = (index + 1) % _header->slotCount;
+        _header->notify.fetch_add(1, std::memory_order_release);
+        shm::FutexWakeAll(_header->notify);
+        return true;
+      }
+      // All slots are held, maybe by a client which is gone.
+      if (ReclaimDeadClients() == 0) {
+        break;
+      }
+    }
+    _drops++;
+    return false;
+  }
+
+  //! @brief Take the oldest frame not read yet. Client only.
+  //! @param[out] ref - the frame, held until ref is reset or destroyed
+  //! @return false if there is no new frame
+  //!
+  bool Read(Ref & ref)
+  {
+    ref.Reset();
+    if (_client < 0) {
+      return false;
+    }
+    const uint32_t bit = 1U << _client;
+    while (true) {
+      uint64_t oldest = 0;
+      uint32_t index = 0;
+      for (uint32_t i = 0; i < _header->slotCount; i++) {
+        const uint64_t seq = SlotAt(i).seq.load(std::memory_order_acquire);
+        if (seq > _lastSeq && (oldest == 0 || seq < oldest)) {
+          oldest = seq;
+          index = i;
+        }
+      }
+      if (oldest == 0) {
+        return false;
+      }
+      Slot & slot = SlotAt(index);
+      if (slot.holders.fetch_or(bit, std::memory_order_acquire) & shm::kWriterBit) {
+        // Being rewritten, it holds a newer frame afterwards.
+        slot.holders.fetch_and(~bit, std::memory_order_release);
+        continue;
+      }
+      if (slot.seq.load(std::memory_order_acquire) != oldest) {
+        slot.holders.fetch_and(~bit, std::memory_order_release);
+        continue;
+      }
+      _skipped += oldest - _lastSeq - 1;
+      _lastSeq = oldest;
+      ref._slot = &slot;
+      ref._bit = bit;
+      ref._data = DataAt(index);
+      return true;
+    }
+  }
+
+  //! @brief Wait until a frame was written after the last Read, or the ring was closed
+  //! @param[in] timeoutMs - maximum waiting time
+  //! @return true if there may be a new frame
+  //!
+  bool WaitForData(int timeoutMs)
+  {
+    const uint32_t notify = _header->notify.load(std::memory_order_acquire);
+    if (_header->writeSeq.load(std::memory_order_acquire) > _lastSeq || IsClosed()) {
+      return true;
+    }
+    shm::FutexWait(_header->notify, notify, timeoutMs);
+    return _header->writeSeq.load(std::memory_order_acquire) > _lastSeq || IsClosed();
+  }
+
+  //! @brief Release the slots and the client entries of clients which are gone. Producer only.
+  //! @return number of reclaimed clients
+  //!
+  int ReclaimDeadClients()
+  {
+    int reclaimed = 0;
+    for (int i = 0; _producer && i < shm::kMaxClients; i++) {
+      const int32_t pid = _header->clients[i].load(std::memory_order_acquire);
+      if (pid != 0 && !shm::IsProcessAlive(pid)) {
+        ReleaseClient(i);
+        reclaimed++;
+      }
+    }
+    return reclaimed;
+  }
+
+  //! @brief Return true once the producer closed the ring or is gone, clients attach again
+  bool IsClosed() const
+  {
+    return _header->closed.load(std::memory_order_acquire) != 0 ||
+           !shm::IsProcessAlive(_header->producerPid.load(std::memory_order_relaxed));
+  }
+
+  //! @brief Return number of attached clients
+  int GetClients() const
+  {
+    int clients = 0;
+    for (int i = 0; i < shm::kMaxClients; i++) {
+      clients += _header->clients[i].load(std::memory_order_relaxed) != 0 ? 1 : 0;
+    }
+    return clients;
+  }
+
+  uint32_t GetSlotCount() const {return _header->slotCount;}
+  uint32_t GetSlotBytes() const {return _header->slotBytes;}
+  //! @brief Return number of frames written to the ring
+  uint64_t GetWrites() const {return _header->writeSeq.load(std::memory_order_relaxed);}
+  //! @brief Return number of frames the producer could not write
+  uint64_t GetDrops() const {return _drops;}
+  //! @brief Return number of frames this client missed because it fell behind
+  uint64_t GetSkipped() const {return _skipped;}
+
+private:
+  struct Header
+  {
+    std::atomic<uint64_t> magic {0};
+    uint32_t slotCount = 0;
+    uint32_t slotBytes = 0;
+    std::atomic<uint32_t> closed {0};
+    //! @brief Futex word, changes with every write
+    std::atomic<uint32_t> notify {0};
+    std::atomic<uint64_t> writeSeq {0};
+    std::atomic<int32_t> producerPid {0};
+    std::atomic<int32_t> clients[shm::kMaxClients] {};
+  };
+
+  struct Slot
+  {
+    //! @brief Bit i set while client i holds the slot, kWriterBit while it is written
+    std::atomic<uint32_t> holders {0};
+    //! @brief Write sequence of the frame in the slot, 0 while empty or being written
+    std::atomic<uint64_t> seq {0};
+    ShmFrameInfo info {};
+  };
+
+  ShmFrameRing(const std::string & name, bool producer)
+  : _name(name),
+    _producer(producer)
+  {
+  }
+
+  static size_t SlotOffset(uint32_t index)
+  {
+    return shm::Align(sizeof(Header)) + index * shm::Align(sizeof(Slot));
+  }
+
+  static size_t Layout(uint32_t slots, uint32_t slotBytes)
+  {
+    return SlotOffset(slots) + (size_t)slots * shm::Align(slotBytes);
+  }
+
+  void Bind()
+  {
+    _header = reinterpret_cast<Header *>(_mapping.Address());
+  }
+
+  Slot & SlotAt(uint32_t index)
+  {
+    return *reinterpret_cast<Slot *>(_mapping.Address() + SlotOffset(index));
+  }
+
+  uint8_t * DataAt(uint32_t index)
+  {
+    return _mapping.Address() + SlotOffset(_header->slotCount) +
+           index * shm::Align(_header->slotBytes);
+  }
+
+  void ReleaseClient(int client)
+  {
+    for (uint32_t i = 0; i < _header->slotCount; i++) {
+      SlotAt(i).holders.fetch_and(~(1U << client), std::memory_order_release);
+    }
+    _header->clients[client].store(0, std::memory_order_release);
+  }
+
+  std::string _name;
+  bool _producer;
+  shm::Mapping _mapping;
+  Header * _header = nullptr;
+  int _client = -1;
+  uint64_t _lastSeq = 0;
+  uint32_t _nextSlot = 0;
+  uint64_t _drops = 0;
+  uint64_t _skipped = 0;
+};
+
+//! @brief State of the device owner, published in shared memory next to the frame rings
+struct ShmDeviceState
+{
+  bool running = false;
+  char connection[64] = {};
+  //! @brief Intrinsics of the right camera at 1280x720, the depth image is aligned to it
+  bool haveIntrinsics = false;
+  float rightIntrinsics[9] = {};
+};
+
+//! @brief Control block of the device owner: clients post the camera configuration they
+//! need, the owner applies it to the device and publishes its state. The first client to
+//! post holds the configuration until it detaches or is gone. Another client may only post
+//! a configuration the device already runs with, a conflicting one is rejected instead of
+//! rebooting the device under the holder. The fields are guarded by a robust process shared
+//! mutex, a process which dies holding it does not block the others.
+class ShmDeviceControl
+{
+  static_assert(std::is_trivially_copyable<CameraConfig>::value, "CameraConfig is copied to shared memory");
+
+public:
+  ~ShmDeviceControl()
+  {
+    if (_block == nullptr) {
+      return;
+    }
+    if (_owner) {
+      _block->ownerPid.store(0, std::memory_order_release);
+      shm_unlink(_name.c_str());
+      return;
+    }
+    Lock();
+    if (_block->holder == _clientId) {
+      _block->holder = 0;
+      _block->holderPid = 0;
+    }
+    Unlock();
+  }
+
+  ShmDeviceControl(const ShmDeviceControl &) = delete;
+  ShmDeviceControl & operator=(const ShmDeviceControl &) = delete;
+
+  //! @brief Create the control block as the device owner
+  static std::unique_ptr<ShmDeviceControl> Create(const std::string & name)
+  {
+    std::unique_ptr<ShmDeviceControl> control(new ShmDeviceControl(name, true));
+    if (!control->_mapping.Create(name, sizeof(Block))) {
+      return nullptr;
+    }
+    Block * block = new (control->_mapping.Address()) Block();
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    const int result = pthread_mutex_init(&block->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    if (result != 0) {
+      return nullptr;
+    }
+    block->ownerPid.store(getpid(), std::memory_order_relaxed);
+    // Published last, a client never sees a block which is still being set up.
+    block->magic.store(shm::kControlMagic, std::memory_order_release);
+    control->_block = block;
+    return control;
+  }
+
+  //! @brief Attach to the control block of a running device owner
+  static std::unique_ptr<ShmDeviceControl> Attach(const std::string & name)
+  {
+    std::unique_ptr<ShmDeviceControl> control(new ShmDeviceControl(name, false));
+    if (!control->_mapping.Open(name) || control->_mapping.Size() < sizeof(Block)) {
+      return nullptr;
+    }
+    Block * block = reinterpret_cast<Block *>(control->_mapping.Address());
+    if (block->magic.load(std::memory_order_acquire) != shm::kControlMagic) {
+      return nullptr;
+    }
+    control->_block = block;
+    if (!control->IsOwnerAlive()) {
+      return nullptr;
+    }
+    control->_clientId = block->nextClientId.fetch_add(1, std::memory_order_relaxed) + 1;
+    return control;
+  }
+
+  bool IsOwnerAlive() const
+  {
+    return shm::IsProcessAlive(_block->ownerPid.load(std::memory_order_acquire));
+  }
+
+  //! @brief Post the configuration a client needs. Client only.
+  //! @param[in] config - the configuration
+  //! @return false if another client holds a configuration it conflicts with. The device
+  //! keeps running with the configuration of the holder then.
+  //!
+  bool PostConfig(const CameraConfig & config)
+  {
+    Lock();
+    const bool held = _block->holder != 0 && _block->holder != _clientId &&
+      shm::IsProcessAlive(_block->holderPid);
+    if (held) {
+      // Streams of the running pipeline are turned off on the host of each client.
+      const ReconfigureKind kind =
+        ClassifyReconfigure(_block->config, _block->config, config);
+      const bool conflict = kind == ReconfigureKind::Reboot || kind == ReconfigureKind::Control;
+      if (conflict) {
+        _block->rejected++;
+      }
+      Unlock();
+      return !conflict;
+    }
+    _block->holder = _clientId;
+    _block->holderPid = getpid();
+    _block->config = config;
+    _block->requestSeq.store(
+      _block->requestSeq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    Unlock();
+    return true;
+  }
+
+  //! @brief Take the latest posted configuration. Owner only.
+  //! @param[out] config - the configuration
+  //! @return false if nothing was posted since the last call
+  //!
+  bool TakeConfig(CameraConfig & config)
+  {
+    if (_block->requestSeq.load(std::memory_order_acquire) == _takenSeq) {
+      return false;
+    }
+    Lock();
+    config = _block->config;
+    _takenSeq = _block->requestSeq.load(std::memory_order_relaxed);
+    Unlock();
+    return true;
+  }
+
+  //! @brief Publish the device state. Owner only.
+  void SetState(const ShmDeviceState & state)
+  {
+    Lock();
+    _block->state = state;
+    Unlock();
+  }
+
+  ShmDeviceState GetState()
+  {
+    Lock();
+    const ShmDeviceState state = _block->state;
+    Unlock();
+    return state;
+  }
+
+  //! @brief Return number of configurations rejected for a conflict with the holder
+  uint64_t GetRejectedConfigs()
+  {
+    Lock();
+    const uint64_t rejected = _block->rejected;
+    Unlock();
+    return rejected;
+  }
+
+private:
+  struct Block
+  {
+    std::atomic<uint64_t> magic {0};
+    std::atomic<int32_t> ownerPid {0};
+    std::atomic<uint64_t> nextClientId {0};
+    std::atomic<uint64_t> requestSeq {0};
+    //! @brief Robust process shared mutex of the fields below, set up by the owner
+    pthread_mutex_t mutex;
+    //! @brief Client holding the configuration and its process, 0 if none
+    uint64_t holder = 0;
+    int32_t holderPid = 0;
+    uint64_t rejected = 0;
+    CameraConfig config {};
+    ShmDeviceState state {};
+  };
+
+  ShmDeviceControl(const std::string & name, bool owner)
+  : _name(name),
+    _owner(owner)
+  {
+  }
+
+  void Lock()
+  {
+    if (pthread_mutex_lock(&_block->mutex) == EOWNERDEAD) {
+      // The fields are only copied under the lock, a copy cut short by the crash is
+      // replaced by the next one. A posted configuration counts once its sequence is set.
+      pthread_mutex_consistent(&_block->mutex);
+    }
+  }
+
+  void Unlock() {pthread_mutex_unlock(&_block->mutex);}
+
+  std::string _name;
+  bool _owner;
+  shm::Mapping _mapping;
+  Block * _block = nullptr;
+  //! @brief Id of an attached client, unique per control block
+  uint64_t _clientId = 0;
+  uint64_t _takenSeq = 0;
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_SHM_FRAME_RING_H
@@ -0,0 +1,247 @@
+#ifndef FOG_SW_DEPTHAI_SPSC_RING_H
+#define FOG_SW_DEPTHAI_SPSC_RING_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace depthai_ctrl
+{
+
+//! @brief Bounded single-producer/single-consumer ring buffer.
+//! The producer and the consumer never share a lock. The ring is bounded both by
+//! frame count and by byte budget, a push beyond either limit is rejected.
+//! A blocked consumer is woken up through an eventfd, which is only written
+//! when the consumer is actually waiting.
+//! Clear requests may come from any thread, they are executed by the consumer.
+template<typename T>
+class SpscRing
+{
+public:
+  //! @brief Constructor
+  //! @param[in] capacity - number of slots, rounded up to a power of two
+  //!
+  explicit SpscRing(size_t capacity)
+  {
+    size_t slots = 1;
+    while (slots < capacity) {
+      slots <<= 1;
+    }
+    _slots.resize(slots);
+    _mask = slots - 1;
+    _maxFrames.store(slots, std::memory_order_relaxed);
+    _eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  }
+
+  ~SpscRing()
+  {
+    if (_eventFd >= 0) {
+      close(_eventFd);
+    }
+  }
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing & operator=(const SpscRing &) = delete;
+
+  //! @brief Set the frame count and byte budget limits
+  //! Safe to call from any thread, the producer applies the limits from its next push.
+  //! @param[in] maxFrames - maximum number of queued items, capped to the capacity
+  //! @param[in] maxBytes - maximum number of queued bytes
+  //! @return void
+  //!
+  void SetLimits(size_t maxFrames, size_t maxBytes)
+  {
+    _maxFrames.store(
+      (maxFrames == 0 || maxFrames > _slots.size()) ? _slots.size() : maxFrames,
+      std::memory_order_relaxed);
+    _maxBytes.store(maxBytes, std::memory_order_relaxed);
+  }
+
+  //! @brief Producer side: append an item
+  //! A single item larger than the byte budget is still accepted into an empty ring,
+  //! so that a large key frame cannot block the queue forever.
+  //! @param[in] item - item to be moved into the ring
+  //! @param[in] bytes - payload size of the item, counted against the byte budget
+  //! @return false if the ring is full and the item was not queued
+  //!
+  bool Push(T && item, size_t bytes)
+  {
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    const size_t head = _head.load(std::memory_order_acquire);
+    const size_t size = tail - head;
+    if (size >= _maxFrames.load(std::memory_order_relaxed) ||
+      (size > 0 &&
+      _bytes.load(std::memory_order_relaxed) + bytes > _maxBytes.load(std::memory_order_relaxed)))
+    {
+      return false;
+    }
+    Slot & slot = _slots[tail & _mask];
+    slot.item = std::move(item);
+    slot.bytes = bytes;
+    const size_t queuedBytes = _bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    _tail.store(tail + 1, std::memory_order_seq_cst);
+
+    if (size + 1 > _highWaterFrames.load(std::memory_order_relaxed)) {
+      _highWaterFrames.store(size + 1, std::memory_order_relaxed);
+    }
+    if (queuedBytes > _highWaterBytes.load(std::memory_order_relaxed)) {
+      _highWaterBytes.store(queuedBytes, std::memory_order_relaxed);
+    }
+    if (_consumerWaiting.load(std::memory_order_seq_cst)) {
+      Wake();
+    }
+    return true;
+  }
+
+  //! @brief Consumer side: take the oldest item
+  //! @param[out] item - the oldest item, if any
+  //! @return false if the ring is empty
+  //!
+  bool Pop(T & item)
+  {
+    if (_clearRequested.exchange(false, std::memory_order_acq_rel)) {
+      Drain();
+    }
+    const size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    Slot & slot = _slots[head & _mask];
+    item = std::move(slot.item);
+    slot.item = T{};
+    _bytes.fetch_sub(slot.bytes, std::memory_order_relaxed);
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  //! @brief Consumer side: wait until the ring has data
+  //! Returns early when Wake is called, e.g. during shutdown.
+  //! @param[in] timeoutMs - maximum waiting time in milliseconds, -1 waits forever
+  //! @return true if the ring has data
+  //!
+  bool WaitForData(int timeoutMs)
+  {
+    if (_clearRequested.exchange(false, std::memory_order_acq_rel)) {
+      Drain();
+    }
+    if (!Empty()) {
+      return true;
+    }
+    _consumerWaiting.store(true, std::memory_order_seq_cst);
+    if (Empty()) {
+      struct pollfd pfd {};
+      pfd.fd = _eventFd;
+      pfd.events = POLLIN;
+      if (poll(&pfd, 1, timeoutMs) > 0 && (pfd.revents & POLLIN)) {
+        uint64_t value;
+        (void)!read(_eventFd, &value, sizeof(value));
+      }
+    }
+    _consumerWaiting.store(false, std::memory_order_seq_cst);
+    return !Empty();
+  }
+
+  //! @brief Wake up a waiting consumer
+  //! @return void
+  //!
+  void Wake()
+  {
+    const uint64_t value = 1;
+    (void)!write(_eventFd, &value, sizeof(value));
+  }
+
+  //! @brief Drop all queued items
+  //! Safe to call from any thread, the consumer drops the items before its next pop.
+  //! @return void
+  //!
+  void RequestClear() {_clearRequested.store(true, std::memory_order_release);}
+
+  //! @brief Return true if there is no queued item
+  bool Empty() const
+  {
+    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+  }
+
+  //! @brief Return number of queued items
+  size_t Size() const
+  {
+    const size_t head = _head.load(std::memory_order_acquire);
+    return _tail.load(std::memory_order_acquire) - head;
+  }
+
+  //! @brief Return number of queued bytes
+  size_t Bytes() const {return _bytes.load(std::memory_order_relaxed);}
+
+  //! @brief Return number of slots
+  size_t Capacity() const {return _slots.size();}
+
+  //! @brief Return the frame count limit
+  size_t MaxFrames() const {return _maxFrames.load(std::memory_order_relaxed);}
+
+  //! @brief Return the byte budget
+  size_t MaxBytes() const {return _maxBytes.load(std::memory_order_relaxed);}
+
+  //! @brief Return the highest item count since the last ResetHighWaterMarks call
+  size_t HighWaterFrames() const {return _highWaterFrames.load(std::memory_order_relaxed);}
+
+  //! @brief Return the highest byte count since the last ResetHighWaterMarks call
+  size_t HighWaterBytes() const {return _highWaterBytes.load(std::memory_order_relaxed);}
+
+  //! @brief Restart high-water mark tracking from the current occupancy
+  //! @return void
+  //!
+  void ResetHighWaterMarks()
+  {
+    _highWaterFrames.store(Size(), std::memory_order_relaxed);
+    _highWaterBytes.store(Bytes(), std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot
+  {
+    T item {};
+    size_t bytes {0};
+  };
+
+  void Drain()
+  {
+    const size_t tail = _tail.load(std::memory_order_acquire);
+    size_t head = _head.load(std::memory_order_relaxed);
+    for (; head != tail; head++) {
+      Slot & slot = _slots[head & _mask];
+      slot.item = T{};
+      _bytes.fetch_sub(slot.bytes, std::memory_order_relaxed);
+    }
+    _head.store(head, std::memory_order_release);
+  }
+
+  std::vector<Slot> _slots;
+  size_t _mask {0};
+  //! @brief Limits, set by the parameter thread and read by the producer
+  std::atomic<size_t> _maxFrames {0};
+  std::atomic<size_t> _maxBytes {SIZE_MAX};
+  int _eventFd {-1};
+
+  // Indices are padded apart to keep producer and consumer off each other's cache line.
+  // Padding instead of alignas, since C++14 operator new ignores extended alignment.
+  char _padHead[64];
+  //! @brief Consumer index, written by the consumer only
+  std::atomic<size_t> _head {0};
+  char _padTail[64];
+  //! @brief Producer index, written by the producer only
+  std::atomic<size_t> _tail {0};
+  char _padBytes[64];
+  std::atomic<size_t> _bytes {0};
+  std::atomic<size_t> _highWaterFrames {0};
+  std::atomic<size_t> _highWaterBytes {0};
+  std::atomic<bool> _consumerWaiting {false};
+  std::atomic<bool> _clearRequested {false};
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_SPSC_RING_H
@@ -0,0 +1,348 @@
+#ifndef FOG_SW_DEPTHAI_STREAM_STATE_MACHINE_H
+#define FOG_SW_DEPTHAI_STREAM_STATE_MACHINE_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
+
+namespace depthai_ctrl
+{
+
+//! @brief States of the video stream
+enum class StreamState
+{
+  Idle,       //!< Stopped by command, or never started
+  Starting,   //!< Pipeline is being built and connected
+  Playing,    //!< Camera stream is playing
+  Default,    //!< "Camera not detected" stream is playing
+  Backoff,    //!< Pipeline failed, waiting before the next start attempt
+  Stopping    //!< Stop command is being executed
+};
+
+//! @brief Inputs of the stream state machine
+enum class StreamEvent
+{
+  StartRequested,           //!< Start command or start on boot
+  StopRequested,            //!< Stop command
+  Stopped,                  //!< Stop action finished
+  PipelinePlaying,          //!< Bus: pipeline playing the camera stream
+  PipelinePlayingDefault,   //!< Bus: pipeline playing the default stream
+  PipelineError,            //!< Bus: error or unexpected end of stream
+  StartTimeout,             //!< Pipeline did not reach playing in time
+  BackoffElapsed,           //!< Retry delay is over
+  FramesArrived,            //!< Camera frames arrive while the default stream plays
+  FramesStopped,            //!< Camera frames stopped while the camera stream plays
+  CameraRebooting,          //!< Camera reboots on purpose, e.g. for a new bitrate
+  CameraRebooted            //!< Camera finished the reboot
+};
+
+//! @brief What the owner of the state machine has to do on a transition
+enum class StreamAction
+{
+  None,
+  Start,      //!< Start the stream
+  Stop,       //!< Stop the stream
+  Restart     //!< Stop and start the stream, to rebuild the pipeline for the other input
+};
+
+//! @brief One state transition, as returned by StreamStateMachine::Process
+struct StreamTransition
+{
+  StreamState from;
+  StreamState to;
+  StreamEvent event;
+  StreamAction action;
+  //! @brief Number of failed start attempts in a row
+  uint32_t attempt;
+  //! @brief Delay before the next start attempt, only set when entering Backoff
+  int64_t retryInMs;
+};
+
+//! @brief Timing settings of the stream state machine
+struct StreamStateMachineConfig
+{
+  //! @brief Retry delay after the first failure
+  std::chrono::milliseconds backoffInitial {100};
+  //! @brief Upper limit of the retry delay
+  std::chrono::milliseconds backoffMax {5000};
+  //! @brief Retry delay growth per failed attempt
+  double backoffMultiplier {2.0};
+  //! @brief Random spread of the retry delay, as a fraction of the delay
+  double backoffJitter {0.2};
+  //! @brief Starting longer than this counts as a failure
+  std::chrono::milliseconds startTimeout {5000};
+  //! @brief No camera frames for this long means the camera is gone
+  std::chrono::milliseconds frameTimeout {1000};
+  //! @brief Longest announced camera reboot the camera stream waits for, instead of
+  //! switching to the default stream and back
+  std::chrono::milliseconds rebootHoldTimeout {15000};
+  //! @brief Rebuild the pipeline to switch between camera and default stream.
+  //! False when the pipeline switches its input by itself (hot-standby).
+  bool switchInputByRestart {true};
+  //! @brief Jitter random seed, 0 seeds from std::random_device
+  uint32_t seed {0};
+};
+
+//! @brief Event-driven state machine of the video stream
+//! Events are posted from any thread (bus watch, frame subscriber, commands) and
+//! processed by a single thread calling Process, which also derives the timer
+//! events. The caller executes the returned actions in order.
+class StreamStateMachine
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  //! @brief Constructor
+  //! @param[in] config - timing settings
+  //!
+  explicit StreamStateMachine(const StreamStateMachineConfig & config)
+  : _config(config), _random(config.seed != 0 ? config.seed : std::random_device{}())
+  {
+  }
+
+  //! @brief Queue an event for the next Process call. Thread safe.
+  //! @param[in] event - the event
+  //! @return void
+  //!
+  void Post(StreamEvent event)
+  {
+    std::lock_guard<std::mutex> lock(_eventsMutex);
+    _events.push_back(event);
+  }
+
+  //! @brief Record the arrival of a camera frame. Lock-free, called for every frame.
+  //! @param[in] now - arrival time
+  //! @return void
+  //!
+  void OnFrame(Clock::time_point now)
+  {
+    _lastFrameNs.store(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count(),
+      std::memory_order_relaxed);
+  }
+
+  //! @brief Handle the posted events and the timer events that are due
+  //! @param[in] now - current time
+  //! @return transitions taken, with the actions to execute in order
+  //!
+  std::vector<StreamTransition> Process(Clock::time_point now)
+  {
+    std::deque<StreamEvent> events;
+    {
+      std::lock_guard<std::mutex> lock(_eventsMutex);
+      events.swap(_events);
+    }
+    std::vector<StreamTransition> transitions;
+    for (const StreamEvent event : events) {
+      Handle(event, now, transitions);
+    }
+
+    const bool frameSeen = _lastFrameNs.load(std::memory_order_relaxed) != 0;
+    const Clock::time_point lastFrame{std::chrono::duration_cast<Clock::duration>(
+        std::chrono::nanoseconds(_lastFrameNs.load(std::memory_order_relaxed)))};
+    switch (_state) {
+      case StreamState::Starting:
+        if (now - _stateEntered > _config.startTimeout) {
+          Handle(StreamEvent::StartTimeout, now, transitions);
+        }
+        break;
+      case StreamState::Backoff:
+        if (now >= _retryAt) {
+          Handle(StreamEvent::BackoffElapsed, now, transitions);
+        }
+        break;
+      case StreamState::Default:
+        if (frameSeen && lastFrame > _stateEntered && now - lastFrame < _config.frameTimeout) {
+          Handle(StreamEvent::FramesArrived, now, transitions);
+        }
+        break;
+      case StreamState::Playing:
+        // The frame timeout starts over at the end of an announced reboot.
+        if (now >= _holdUntil && now - std::max(_stateEntered, _holdUntil) > _config.frameTimeout &&
+          (!frameSeen || now - lastFrame > _config.frameTimeout))
+        {
+          Handle(StreamEvent::FramesStopped, now, transitions);
+        }
+        break;
+      default:
+        break;
+    }
+    return transitions;
+  }
+
+  //! @brief Return the current state. Only valid on the processing thread.
+  StreamState GetState() const {return _state;}
+
+  //! @brief Return number of failed start attempts in a row
+  uint32_t GetAttempt() const {return _attempt;}
+
+  //! @brief Return true if camera frames arrived within the frame timeout
+  //! @param[in] now - current time
+  //!
+  bool AreFramesFlowing(Clock::time_point now) const
+  {
+    const int64_t lastFrameNs = _lastFrameNs.load(std::memory_order_relaxed);
+    return lastFrameNs != 0 &&
+           now.time_since_epoch() - std::chrono::nanoseconds(lastFrameNs) < _config.frameTimeout;
+  }
+
+  //! @brief Return the retry delay for a number of failed attempts, jitter included
+  //! @param[in] attempt - failed attempts before this one
+  //! @return retry delay
+  //!
+  std::chrono::milliseconds BackoffDelay(uint32_t attempt)
+  {
+    double delayMs = (double)_config.backoffInitial.count();
+    for (uint32_t i = 0; i < attempt && delayMs < _config.backoffMax.count(); i++) {
+      delayMs *= _config.backoffMultiplier;
+    }
+    delayMs = std::min(delayMs, (double)_config.backoffMax.count());
+    // Jitter keeps several drones from hammering a recovering server in lockstep.
+    std::uniform_real_distribution<double> jitter(-_config.backoffJitter, _config.backoffJitter);
+    return std::chrono::milliseconds((int64_t)(delayMs * (1.0 + jitter(_random))));
+  }
+
+  static const char * ToString(StreamState state)
+  {
+    switch (state) {
+      case StreamState::Idle: return "Idle";
+      case StreamState::Starting: return "Starting";
+      case StreamState::Playing: return "Playing";
+      case StreamState::Default: return "Default";
+      case StreamState::Backoff: return "Backoff";
+      case StreamState::Stopping: return "Stopping";
+    }
+    return "Unknown";
+  }
+
+  static const char * ToString(StreamEvent event)
+  {
+    switch (event) {
+      case StreamEvent::StartRequested: return "StartRequested";
+      case StreamEvent::StopRequested: return "StopRequested";
+      case StreamEvent::Stopped: return "Stopped";
+      case StreamEvent::PipelinePlaying: return "PipelinePlaying";
+      case StreamEvent::PipelinePlayingDefault: return "PipelinePlayingDefault";
+      case StreamEvent::PipelineError: return "PipelineError";
+      case StreamEvent::StartTimeout: return "StartTimeout";
+      case StreamEvent::BackoffElapsed: return "BackoffElapsed";
+      case StreamEvent::FramesArrived: return "FramesArrived";
+      case StreamEvent::FramesStopped: return "FramesStopped";
+      case StreamEvent::CameraRebooting: return "CameraRebooting";
+      case StreamEvent::CameraRebooted: return "CameraRebooted";
+    }
+    return "Unknown";
+  }
+
+  static const char * ToString(StreamAction action)
+  {
+    switch (action) {
+      case StreamAction::None: return "None";
+      case StreamAction::Start: return "Start";
+      case StreamAction::Stop: return "Stop";
+      case StreamAction::Restart: return "Restart";
+    }
+    return "Unknown";
+  }
+
+private:
+  void Handle(StreamEvent event, Clock::time_point now, std::vector<StreamTransition> & out)
+  {
+    const StreamState state = _state;
+    switch (event) {
+      case StreamEvent::StartRequested:
+        // A start command during the retry delay starts at once, as a fresh attempt.
+        if (state == StreamState::Idle || state == StreamState::Backoff) {
+          _attempt = 0;
+          Enter(StreamState::Starting, event, StreamAction::Start, now, out);
+        }
+        break;
+      case StreamEvent::StopRequested:
+        if (state != StreamState::Idle && state != StreamState::Stopping) {
+          Enter(StreamState::Stopping, event, StreamAction::Stop, now, out);
+        }
+        break;
+      case StreamEvent::Stopped:
+        if (state == StreamState::Stopping) {
+          Enter(StreamState::Idle, event, StreamAction::None, now, out);
+        }
+        break;
+      case StreamEvent::PipelinePlaying:
+      case StreamEvent::PipelinePlayingDefault:
+        if (state == StreamState::Starting || state == StreamState::Playing ||
+          state == StreamState::Default)
+        {
+          const StreamState next = (event == StreamEvent::PipelinePlaying) ?
+            StreamState::Playing : StreamState::Default;
+          _attempt = 0;
+          if (next != state) {
+            Enter(next, event, StreamAction::None, now, out);
+          }
+        }
+        break;
+      case StreamEvent::PipelineError:
+      case StreamEvent::StartTimeout:
+        if (state == StreamState::Starting || state == StreamState::Playing ||
+          state == StreamState::Default)
+        {
+          const auto delay = BackoffDelay(_attempt);
+          _attempt++;
+          _retryAt = now + delay;
+          Enter(StreamState::Backoff, event, StreamAction::Stop, now, out, delay.count());
+        }
+        break;
+      case StreamEvent::BackoffElapsed:
+        if (state == StreamState::Backoff) {
+          Enter(StreamState::Starting, event, StreamAction::Start, now, out);
+        }
+        break;
+      case StreamEvent::FramesArrived:
+        if (state == StreamState::Default && _config.switchInputByRestart) {
+          Enter(StreamState::Starting, event, StreamAction::Restart, now, out);
+        }
+        break;
+      case StreamEvent::FramesStopped:
+        if (state == StreamState::Playing && _config.switchInputByRestart) {
+          Enter(StreamState::Starting, event, StreamAction::Restart, now, out);
+        }
+        break;
+      // No transition, the camera stream is kept while the camera comes back.
+      case StreamEvent::CameraRebooting:
+        _holdUntil = now + _config.rebootHoldTimeout;
+        break;
+      case StreamEvent::CameraRebooted:
+        _holdUntil = std::min(_holdUntil, now);
+        break;
+    }
+  }
+
+  void Enter(
+    StreamState next, StreamEvent event, StreamAction action, Clock::time_point now,
+    std::vector<StreamTransition> & out, int64_t retryInMs = 0)
+  {
+    out.push_back(StreamTransition{_state, next, event, action, _attempt, retryInMs});
+    _state = next;
+    _stateEntered = now;
+  }
+
+  const StreamStateMachineConfig _config;
+  std::mt19937 _random;
+  std::mutex _eventsMutex;
+  std::deque<StreamEvent> _events {};
+  std::atomic<int64_t> _lastFrameNs {0};
+  //! @brief Processing thread only
+  StreamState _state {StreamState::Idle};
+  Clock::time_point _stateEntered {};
+  Clock::time_point _retryAt {};
+  //! @brief End of an announced camera reboot
+  Clock::time_point _holdUntil {};
+  uint32_t _attempt {0};
+};
+
+}  // namespace depthai_ctrl
+
+#endif  // FOG_SW_DEPTHAI_STREAM_STATE_MACHINE_H
@@ -45,7 +45,7 @@ def generate_launch_description():
                 ],
                 remappings=[
                 ],
-
+                extra_arguments=[{"use_intra_process_comms": True}],
             ),
             # DepthAI GStreamer
             ComposableNode(
@@ -61,6 +61,7 @@ def generate_launch_description():
                     {"start_stream_on_boot": True},
                     #{"use_sim_time": launch.substitutions.LaunchConfiguration("use_sim_time")},
                 ],
+                extra_arguments=[{"use_intra_process_comms": True}],
             ),
         ],
         output='screen',
@@ -1,17 +1,26 @@
 #include "depthai_camera.h"
 #include "depthai_utils.h"
 #include <nlohmann/json.hpp>
+#include <cmath>
 
 using namespace depthai_ctrl;
 
 using std::placeholders::_1;
 using std::placeholders::_2;
-using Profile = dai::VideoEncoderProperties::Profile;
 
 using std::chrono::duration_cast;
 using std::chrono::nanoseconds;
 using std::chrono::seconds;
 
+namespace
+{
+int64_t SteadyNowMs()
+{
+  return duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}  // namespace
+
 void DepthAICamera::Initialize()
 {
   RCLCPP_INFO(get_logger(), "[%s]: Initializing...", get_name());
@@ -30,12 +39,64 @@ void DepthAICamera::Initialize()
   _left_publisher = create_publisher<ImageMsg>(left_camera_topic, rclcpp::SensorDataQoS());
   _right_publisher = create_publisher<ImageMsg>(right_camera_topic, rclcpp::SensorDataQoS());
   _color_publisher = create_publisher<ImageMsg>(color_camera_topic, rclcpp::SensorDataQoS());
+  declare_parameter<std::string>("depth_topic", "camera/depth/image_raw");
+  declare_parameter<std::string>("points_topic", "camera/depth/points");
+  _depth_publisher = create_publisher<ImageMsg>(
+    get_parameter("depth_topic").as_string(), rclcpp::SensorDataQoS());
+  _points_publisher = create_publisher<PointCloudMsg>(
+    get_parameter("points_topic").as_string(), rclcpp::SensorDataQoS());
+  // Device to host clock model, its state is published every second as JSON
+  declare_parameter<bool>("use_clock_estimator", true);
+  declare_parameter<std::string>("clock_drift_topic", "camera/clock_drift");
+  _useClockEstimator = get_parameter("use_clock_estimator").as_bool();
+  if (_useClockEstimator) {
+    _clock_drift_publisher = create_publisher<std_msgs::msg::String>(
+      get_parameter("clock_drift_topic").as_string(), rclcpp::QoS(rclcpp::KeepLast(10)));
+    _clockDriftTimer = create_wall_timer(
+      std::chrono::seconds(1), std::bind(&DepthAICamera::PublishClockDrift, this));
+  }
+  // Optional pyramid of the color image, published on <color_pyramid_topic>/level_<n>
+  declare_parameter<int>("color_pyramid_levels", 0);
+  declare_parameter<std::string>("color_pyramid_topic", "camera/color/pyramid");
+  declare_parameter<std::string>("color_pyramid_encoding", "bgr8");
+  const std::string color_pyramid_topic = get_parameter("color_pyramid_topic").as_string();
+  for (int level = 1; level <= get_parameter("color_pyramid_levels").as_int(); level++) {
+    _pyramidPublishers.push_back(
+      create_publisher<ImageMsg>(
+        color_pyramid_topic + "/level_" + std::to_string(level), rclcpp::SensorDataQoS()));
+  }
+  _pyramidEncoding = GetOutputEncodingParameter("color_pyramid_encoding");
+  if (_pyramidEncoding == OutputEncoding::Native) {
+    _pyramidEncoding = OutputEncoding::BGR8;
+  }
+  // Intra-process delivery needs an explicit keep-last depth, system defaults have none.
   _video_publisher = create_publisher<CompressedImageMsg>(
     video_stream_topic,
-    rclcpp::SystemDefaultsQoS());
+    rclcpp::QoS(rclcpp::KeepLast(10)));
   _stream_command_subscriber = create_subscription<std_msgs::msg::String>(
-    stream_control_topic, rclcpp::SystemDefaultsQoS(),
+    stream_control_topic, rclcpp::QoS(rclcpp::KeepLast(10)),
     std::bind(&DepthAICamera::VideoStreamCommand, this, _1));
+  // Latency of every reconfiguration, per kind of change, as JSON
+  declare_parameter<std::string>("reconfiguration_topic", "camera/reconfiguration");
+  _reconfiguration_publisher = create_publisher<std_msgs::msg::String>(
+    get_parameter("reconfiguration_topic").as_string(), rclcpp::QoS(rclcpp::KeepLast(10)));
+  // Reboots of a reconfiguration as JSON, the GStreamer node keeps the stream while they last
+  declare_parameter<std::string>("boot_state_topic", "videostreamboot");
+  _boot_state_publisher = create_publisher<std_msgs::msg::String>(
+    get_parameter("boot_state_topic").as_string(), rclcpp::QoS(rclcpp::KeepLast(10)));
+  // Target bitrate published by the GStreamer node from the state of the network link
+  declare_parameter<bool>("adaptive_bitrate", false);
+  declare_parameter<std::string>("bitrate_target_topic", "videostreambitrate");
+  declare_parameter<double>("adaptive_bitrate_hysteresis", 0.15);
+  declare_parameter<int>("adaptive_bitrate_interval_ms", 10000);
+  if (get_parameter("adaptive_bitrate").as_bool()) {
+    _bitrateHysteresis = BitrateHysteresis(
+      get_parameter("adaptive_bitrate_hysteresis").as_double(),
+      get_parameter("adaptive_bitrate_interval_ms").as_int());
+    _bitrate_target_subscriber = create_subscription<std_msgs::msg::String>(
+      get_parameter("bitrate_target_topic").as_string(), rclcpp::QoS(rclcpp::KeepLast(10)),
+      std::bind(&DepthAICamera::BitrateTargetCallback, this, _1));
+  }
 
   // Video Stream parameters
   declare_parameter<std::string>("encoding", "H264");
@@ -48,6 +109,45 @@ void DepthAICamera::Initialize()
   declare_parameter<bool>("use_raw_color_cam", false);
   declare_parameter<bool>("use_auto_focus", false);
   declare_parameter<bool>("use_usb_three", false);
+  declare_parameter<bool>("use_stereo_depth", false);
+  // Horizontal field of view of the depth image, used when the device has no calibration
+  declare_parameter<double>("depth_hfov_deg", 71.9);
+  declare_parameter<bool>("latency_tracing", false);
+  // Frame source: "device" for a connected camera, "replay" to play back a recording,
+  // "shm" for the device of a device_daemon process
+  declare_parameter<std::string>("frame_source", "device");
+  declare_parameter<std::string>("shm_name", "depthai_ctrl");
+  declare_parameter<std::string>("replay_path", "");
+  declare_parameter<bool>("replay_realtime", true);
+  declare_parameter<bool>("replay_loop", false);
+  declare_parameter<std::string>("record_path", "");
+  // Open the device on a background thread, the constructor returns before the boot is done.
+  declare_parameter<bool>("async_boot", true);
+  // Reopen the device when a stream misses watchdog_missed_intervals frame intervals,
+  // outages and recoveries are published as JSON on watchdog_topic
+  declare_parameter<bool>("watchdog", true);
+  declare_parameter<int>("watchdog_missed_intervals", 10);
+  declare_parameter<int>("watchdog_first_frame_timeout_ms", 5000);
+  declare_parameter<int>("watchdog_min_backoff_ms", 500);
+  declare_parameter<int>("watchdog_max_backoff_ms", 10000);
+  declare_parameter<std::string>("watchdog_topic", "camera/watchdog");
+  // Host queue of each output stream: <prefix>_queue_policy "newest", "bounded" or "blocking",
+  // <prefix>_queue_depth in frames or <prefix>_queue_depth_ms in milliseconds of frames
+  _queueConfigs["left"] = DeclareQueueParameters("left", "bounded", 30);
+  _queueConfigs["right"] = DeclareQueueParameters("right", "bounded", 30);
+  _queueConfigs["color"] = DeclareQueueParameters("color", "bounded", 30);
+  _queueConfigs["depth"] = DeclareQueueParameters("depth", "bounded", 8);
+  _queueConfigs["enc26xColor"] = DeclareQueueParameters("video", "blocking", 30);
+  // Fill and drops of the queues, published every second as JSON
+  declare_parameter<std::string>("queue_stats_topic", "camera/queue_stats");
+  _queue_stats_publisher = create_publisher<std_msgs::msg::String>(
+    get_parameter("queue_stats_topic").as_string(), rclcpp::QoS(rclcpp::KeepLast(10)));
+  _queueStatsTimer = create_wall_timer(
+    std::chrono::seconds(1), std::bind(&DepthAICamera::PublishQueueStats, this));
+  // Encoding of the raw image topics: "native" for the device layout, "bgr8", "rgb8" or "mono8"
+  declare_parameter<std::string>("left_output_encoding", "native");
+  declare_parameter<std::string>("right_output_encoding", "native");
+  declare_parameter<std::string>("color_output_encoding", "native");
 
   _videoWidth = get_parameter("width").as_int();
   _videoHeight = get_parameter("height").as_int();
@@ -58,14 +158,165 @@ void DepthAICamera::Initialize()
   _useMonoCams = get_parameter("use_mono_cams").as_bool();
   _useRawColorCam = get_parameter("use_raw_color_cam").as_bool();
   _useAutoFocus = get_parameter("use_auto_focus").as_bool();
+  _useStereoDepth = get_parameter("use_stereo_depth").as_bool();
+  _depthHfovDeg = get_parameter("depth_hfov_deg").as_double();
+  // Stamps the video chunks for the end-to-end latency tracing of the GStreamer node.
+  _latencyTracing = get_parameter("latency_tracing").as_bool();
+  _leftOutputEncoding = GetOutputEncodingParameter("left_output_encoding");
+  _rightOutputEncoding = GetOutputEncodingParameter("right_output_encoding");
+  _colorOutputEncoding = GetOutputEncodingParameter("color_output_encoding");
 
   // USB2 can only handle one H264 stream from camera. Adding raw camera or mono cameras will
   // cause dropped messages and unstable latencies between frames. When using USB3, we can
   // support multiple streams without any bandwidth issues.
   _useUSB3 = get_parameter("use_usb_three").as_bool();
   _lastFrameTime = get_clock()->now();
+
+  const std::string frame_source = get_parameter("frame_source").as_string();
+  if (frame_source == "replay") {
+    _frameSource = std::make_shared<ReplayFrameSource>(
+      get_logger(), get_parameter("replay_path").as_string(),
+      get_parameter("replay_realtime").as_bool(), get_parameter("replay_loop").as_bool());
+  } else if (frame_source == "shm") {
+    _frameSource = std::make_shared<SharedMemoryFrameSource>(
+      get_logger(), get_parameter("shm_name").as_string());
+  } else {
+    if (frame_source != "device") {
+      RCLCPP_ERROR(
+        get_logger(), "Unknown frame_source '%s', using the device",
+        frame_source.c_str());
+    }
+    _frameSource = std::make_shared<DeviceFrameSource>(
+      get_logger(), get_parameter("record_path").as_string());
+  }
+
+  // The end of a recording is not an outage.
+  if (get_parameter("watchdog").as_bool() && frame_source != "replay") {
+    FrameWatchdogConfig watchdog_config;
+    watchdog_config.missedIntervals = get_parameter("watchdog_missed_intervals").as_int();
+    watchdog_config.firstFrameTimeoutMs = get_parameter("watchdog_first_frame_timeout_ms").as_int();
+    watchdog_config.minBackoffMs = get_parameter("watchdog_min_backoff_ms").as_int();
+    watchdog_config.maxBackoffMs = std::max(
+      watchdog_config.minBackoffMs, get_parameter("watchdog_max_backoff_ms").as_int());
+    _watchdog.SetConfig(watchdog_config);
+    _watchdog_publisher = create_publisher<std_msgs::msg::String>(
+      get_parameter("watchdog_topic").as_string(), rclcpp::QoS(rclcpp::KeepLast(10)));
+    _watchdogTimer = create_wall_timer(
+      std::chrono::milliseconds(100), std::bind(&DepthAICamera::CheckFrameWatchdog, this));
+  }
 }
 
+void DepthAICamera::StartBoot()
+{
+  if (!get_parameter("async_boot").as_bool()) {
+    TryRestarting();
+    return;
+  }
+  // Runs in parallel with the executor and the GStreamer pipeline.
+  BootAsync(false);
+}
+
+void DepthAICamera::BootAsync(bool reconfigure)
+{
+  {
+    std::lock_guard<std::mutex> lock(_configMutex);
+    _booting = true;
+  }
+  _bootFuture = std::async(
+    std::launch::async, &DepthAICamera::RunBoot, this, reconfigure).share();
+}
+
+void DepthAICamera::RunBoot(bool reconfigure)
+{
+  bool restart = true;
+  while (true) {
+    if (restart) {
+      if (reconfigure) {
+        PublishBootState(true);
+      }
+      TryRestarting();
+      // Completed by the first encoded frame of the new pipeline.
+      if (reconfigure && _thread_running) {
+        _reconfigurePending = true;
+      } else if (_rebootAnnounced) {
+        // The stream goes to the default one without waiting for the hold timeout.
+        PublishBootState(false);
+      }
+    }
+    CameraConfig config;
+    {
+      std::lock_guard<std::mutex> lock(_configMutex);
+      if (!_configQueued) {
+        _booting = false;
+        return;
+      }
+      config = _queuedConfig;
+      _configQueued = false;
+    }
+    if (_thread_running) {
+      restart = ApplyConfig(config) == ReconfigureKind::Reboot;
+      reconfigure = restart;
+    } else {
+      // The failed boot is tried again with the new configuration.
+      StoreConfig(config);
+      restart = true;
+      reconfigure = false;
+    }
+  }
+}
+
+bool DepthAICamera::IsBooting() const
+{
+  std::lock_guard<std::mutex> lock(_configMutex);
+  return _booting;
+}
+
+bool DepthAICamera::WaitForBoot(std::chrono::milliseconds timeout)
+{
+  if (_bootFuture.valid() && _bootFuture.wait_for(timeout) != std::future_status::ready) {
+    return false;
+  }
+  return IsNodeRunning();
+}
+
+OutputEncoding DepthAICamera::GetOutputEncodingParameter(const std::string & name)
+{
+  const std::string value = get_parameter(name).as_string();
+  OutputEncoding encoding = OutputEncoding::Native;
+  if (!image_kernels::ParseOutputEncoding(value, encoding)) {
+    RCLCPP_ERROR(
+      get_logger(), "Unknown %s '%s', publishing the native encoding",
+      name.c_str(), value.c_str());
+  }
+  return encoding;
+}
+
+
+StreamQueueConfig DepthAICamera::DeclareQueueParameters(
+  const std::string & prefix,
+  const std::string & policy, int depth)
+{
+  declare_parameter<std::string>(prefix + "_queue_policy", policy);
+  declare_parameter<int>(prefix + "_queue_depth", depth);
+  declare_parameter<int>(prefix + "_queue_depth_ms", 0);
+  StreamQueueConfig config;
+  const std::string value = get_parameter(prefix + "_queue_policy").as_string();
+  if (!ParseQueuePolicy(value, config.policy)) {
+    RCLCPP_ERROR(
+      get_logger(), "Unknown %s_queue_policy '%s', using '%s'",
+      prefix.c_str(), value.c_str(), policy.c_str());
+    ParseQueuePolicy(policy, config.policy);
+  }
+  config.depth = get_parameter(prefix + "_queue_depth").as_int();
+  config.depthMs = get_parameter(prefix + "_queue_depth_ms").as_int();
+  return config;
+}
+
+StreamQueueConfig DepthAICamera::GetQueueConfig(const std::string & stream) const
+{
+  // A depth in milliseconds follows the frame rate of the pipeline.
+  return ResolveQueueDepth(_queueConfigs.at(stream), _pipelineConfig.fps);
+}
 
 void DepthAICamera::VideoStreamCommand(std_msgs::msg::String::SharedPtr msg)
 {
@@ -81,73 +332,89 @@ void DepthAICamera::VideoStreamCommand(std_msgs::msg::String::SharedPtr msg)
     std::transform(
       command.begin(), command.end(), command.begin(),
       [](unsigned char c) {return std::tolower(c);});
-    if (command == "start" && !_thread_running) {
-      int width = _videoWidth;
-      int height = _videoHeight;
-      int fps = _videoFps;
-      int bitrate = _videoBitrate;
-
-      int videoLensPosition = _videoLensPosition;
-      std::string encoding = _videoH265 ? "H265" : "H264";
+    if (command == "start") {
+      CameraConfig config = GetConfig();
+      std::string encoding = config.h265 ? "H265" : "H264";
       std::string error_message{};
-      bool useMonoCams = _useMonoCams;
-      bool useRawColorCam = _useRawColorCam;
-      bool useAutoFocus = _useAutoFocus;
 
       if (!cmd["Width"].empty() && cmd["Width"].is_number_integer()) {
-        nlohmann::from_json(cmd["Width"], width);
+        nlohmann::from_json(cmd["Width"], config.width);
       }
       if (!cmd["Height"].empty() && cmd["Height"].is_number_integer()) {
-        nlohmann::from_json(cmd["Height"], height);
+        nlohmann::from_json(cmd["Height"], config.height);
       }
       if (!cmd["Fps"].empty() && cmd["Fps"].is_number_integer()) {
-        nlohmann::from_json(cmd["Fps"], fps);
+        nlohmann::from_json(cmd["Fps"], config.fps);
       }
       if (!cmd["Bitrate"].empty() && cmd["Bitrate"].is_number_integer()) {
-        nlohmann::from_json(cmd["Bitrate"], bitrate);
+        nlohmann::from_json(cmd["Bitrate"], config.bitrate);
       }
       if (!cmd["Encoding"].empty() && cmd["Encoding"].is_string()) {
         nlohmann::from_json(cmd["Encoding"], encoding);
       }
-      if (!cmd["UseMonoCams"].empty() && cmd["UseMonoCams"].is_string()) {
-        nlohmann::from_json(cmd["UseMonoCams"], useMonoCams);
+      if (!cmd["UseMonoCams"].empty() && cmd["UseMonoCams"].is_boolean()) {
+        nlohmann::from_json(cmd["UseMonoCams"], config.useMonoCams);
+      }
+      if (!cmd["UseRawColorCam"].empty() && cmd["UseRawColorCam"].is_boolean()) {
+        nlohmann::from_json(cmd["UseRawColorCam"], config.useRawColorCam);
+      }
+      if (!cmd["UseStereoDepth"].empty() && cmd["UseStereoDepth"].is_boolean()) {
+        nlohmann::from_json(cmd["UseStereoDepth"], config.useStereoDepth);
       }
       if (!cmd["UseAutoFocus"].empty() && cmd["UseAutoFocus"].is_boolean()) {
-        nlohmann::from_json(cmd["UseAutoFocus"], useAutoFocus);
+        nlohmann::from_json(cmd["UseAutoFocus"], config.autoFocus);
       }
       if (!cmd["LensPosition"].empty() && cmd["LensPosition"].is_number_integer()) {
-        nlohmann::from_json(cmd["LensPosition"], videoLensPosition);
+        nlohmann::from_json(cmd["LensPosition"], config.lensPosition);
+      }
+      if (!cmd["ExposureUs"].empty() && cmd["ExposureUs"].is_number_integer()) {
+        nlohmann::from_json(cmd["ExposureUs"], config.exposureUs);
       }
+      if (!cmd["Iso"].empty() && cmd["Iso"].is_number_integer()) {
+        nlohmann::from_json(cmd["Iso"], config.iso);
+      }
+      // [x, y, width, height] in pixels of the 1080p sensor image, [] for the whole image
+      if (cmd["Region"].is_array()) {
+        config.region = CameraRegion();
+        if (cmd["Region"].size() == 4) {
+          config.region.x = cmd["Region"][0].get<uint16_t>();
+          config.region.y = cmd["Region"][1].get<uint16_t>();
+          config.region.width = cmd["Region"][2].get<uint16_t>();
+          config.region.height = cmd["Region"][3].get<uint16_t>();
+        }
+      }
+      config.h265 = (encoding == "H265");
 
       if (DepthAIUtils::ValidateCameraParameters(
-          width, height, fps, bitrate, videoLensPosition, encoding,
+          config.width, config.height, config.fps, config.bitrate, config.lensPosition, encoding,
           error_message))
       {
-        _videoWidth = width;
-        _videoHeight = height;
-        _videoFps = fps;
-        _videoBitrate = bitrate;
-        _videoLensPosition = videoLensPosition;
-        _videoH265 = (encoding == "H265");
-        _useMonoCams = useMonoCams;
-        _useRawColorCam = useRawColorCam;
-        _useAutoFocus = useAutoFocus;
-
-        TryRestarting();
+        if (_thread_running || IsBooting()) {
+          // A running camera only changes what differs, see ClassifyReconfigure. A command
+          // during a boot changes the booted camera instead of booting twice.
+          Reconfigure(config);
+        } else {
+          StoreConfig(config);
+          BootAsync(false);
+        }
       } else {
         RCLCPP_ERROR(this->get_logger(), error_message.c_str());
       }
     }
     if (command == "change_focus" && _thread_running) {
-      bool useAutoFocus = _useAutoFocus;
+      const bool currentAutoFocus = GetConfig().autoFocus;
+      bool useAutoFocus = currentAutoFocus;
       if (!cmd["UseAutoFocus"].empty() && cmd["UseAutoFocus"].is_boolean()) {
         nlohmann::from_json(cmd["UseAutoFocus"], useAutoFocus);
       }
-      if (_useAutoFocus != useAutoFocus) {
-        _useAutoFocus = useAutoFocus;
-        changeFocusMode(_useAutoFocus);
+      if (currentAutoFocus != useAutoFocus) {
+        {
+          std::lock_guard<std::mutex> lock(_configMutex);
+          _useAutoFocus = useAutoFocus;
+        }
+        changeFocusMode(useAutoFocus);
         RCLCPP_INFO(this->get_logger(), "Change focus mode to %s",
-          _useAutoFocus ? "auto" : "manual");
+          useAutoFocus ? "auto" : "manual");
       }
       if (useAutoFocus) {
         RCLCPP_ERROR(this->get_logger(), "Cannot change focus while auto focus is enabled");
@@ -161,8 +428,11 @@ void DepthAICamera::VideoStreamCommand(std_msgs::msg::String::SharedPtr msg)
         }
         if (videoLensPosition >= 0 || videoLensPosition <= 255) {
           RCLCPP_INFO(this->get_logger(), "Changing focus to %d", videoLensPosition);
-          _videoLensPosition = videoLensPosition;
-          changeLensPosition(_videoLensPosition);
+          {
+            std::lock_guard<std::mutex> lock(_configMutex);
+            _videoLensPosition = videoLensPosition;
+          }
+          changeLensPosition(videoLensPosition);
         } else {
           RCLCPP_ERROR(
             this->get_logger(), "Required video stream 'lens_position' is incorrect.\
@@ -174,167 +444,277 @@ void DepthAICamera::VideoStreamCommand(std_msgs::msg::String::SharedPtr msg)
   }
 }
 
+void DepthAICamera::BitrateTargetCallback(std_msgs::msg::String::SharedPtr msg)
+{
+  nlohmann::json target{};
+  try {
+    target = nlohmann::json::parse(msg->data.c_str());
+  } catch (...) {
+    RCLCPP_ERROR(this->get_logger(), "Error while parsing JSON string from bitrate target");
+    return;
+  }
+  // Targets during a boot are skipped, the next one follows within a second.
+  if (!_thread_running || IsBooting() || !target["TargetBitrate"].is_number_integer()) {
+    return;
+  }
+  const int bitrate = target["TargetBitrate"];
+  CameraConfig config = GetConfig();
+  if (!_bitrateHysteresis.Apply(config.bitrate, bitrate, SteadyNowMs())) {
+    return;
+  }
+  RCLCPP_INFO(
+    this->get_logger(), "Changing video bitrate from %d to %d", config.bitrate, bitrate);
+  config.bitrate = bitrate;
+  _bitrateChanges++;
+  Reconfigure(config);
+}
+
+CameraConfig DepthAICamera::GetConfig() const
+{
+  std::lock_guard<std::mutex> lock(_configMutex);
+  CameraConfig config;
+  config.width = _videoWidth;
+  config.height = _videoHeight;
+  config.fps = _videoFps;
+  config.bitrate = _videoBitrate;
+  config.h265 = _videoH265;
+  config.useMonoCams = _useMonoCams;
+  config.useRawColorCam = _useRawColorCam;
+  config.useStereoDepth = _useStereoDepth;
+  config.autoFocus = _useAutoFocus;
+  config.lensPosition = _videoLensPosition;
+  config.exposureUs = _exposureUs;
+  config.iso = _iso;
+  config.region = _region;
+  return config;
+}
+
+void DepthAICamera::StoreConfig(const CameraConfig & config)
+{
+  std::lock_guard<std::mutex> lock(_configMutex);
+  _videoWidth = config.width;
+  _videoHeight = config.height;
+  _videoFps = config.fps;
+  _videoBitrate = config.bitrate;
+  _videoH265 = config.h265;
+  _useMonoCams = config.useMonoCams;
+  _useRawColorCam = config.useRawColorCam;
+  _useStereoDepth = config.useStereoDepth;
+  _useAutoFocus = config.autoFocus;
+  _videoLensPosition = config.lensPosition;
+  _exposureUs = config.exposureUs;
+  _iso = config.iso;
+  _region = config.region;
+}
+
+ReconfigureKind DepthAICamera::Reconfigure(const CameraConfig & requested)
+{
+  {
+    std::lock_guard<std::mutex> lock(_configMutex);
+    if (_booting) {
+      // Applied when the boot is done, a newer configuration replaces this one.
+      _queuedConfig = requested;
+      _configQueued = true;
+      return ReconfigureKind::None;
+    }
+  }
+  const ReconfigureKind kind = ApplyConfig(requested);
+  if (kind == ReconfigureKind::Reboot) {
+    // Off the executor like the first boot.
+    BootAsync(true);
+  }
+  return kind;
+}
+
+ReconfigureKind DepthAICamera::ApplyConfig(const CameraConfig & requested)
+{
+  const auto start = std::chrono::steady_clock::now();
+  const CameraConfig current = GetConfig();
+  CameraConfig pipeline;
+  {
+    std::lock_guard<std::mutex> lock(_restartMutex);
+    pipeline = _pipelineConfig;
+  }
+  const ReconfigureKind kind = ClassifyReconfigure(pipeline, current, requested);
+  if (kind == ReconfigureKind::None) {
+    return kind;
+  }
+  RCLCPP_INFO(
+    this->get_logger(), "[%s]: Reconfiguring the camera, %s change",
+    get_name(), ReconfigureKindName(kind));
+  {
+    // Completed by the first encoded frame after the change.
+    std::lock_guard<std::mutex> lock(_reconfigureMutex);
+    _reconfigureKind = kind;
+    _reconfigureStart = start;
+  }
+  StoreConfig(requested);
+  if (kind == ReconfigureKind::Reboot) {
+    // The caller boots the new pipeline.
+    return kind;
+  }
+  if (CameraControlsDiffer(current, requested)) {
+    // Streams turned off are dropped in their callbacks, the device keeps sending them.
+    SendCameraControls();
+  }
+  _reconfigurePending = true;
+  return kind;
+}
+
+void DepthAICamera::CompleteReconfigure()
+{
+  ReconfigureKind kind;
+  double latency_ms;
+  {
+    std::lock_guard<std::mutex> lock(_reconfigureMutex);
+    kind = _reconfigureKind;
+    latency_ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - _reconfigureStart).count();
+    _reconfigureStats[(int)kind].Add(latency_ms);
+  }
+  _reconfigurePending = false;
+  RCLCPP_INFO(
+    this->get_logger(), "[%s]: Reconfiguration (%s) took %.1f ms",
+    get_name(), ReconfigureKindName(kind), latency_ms);
+  if (_rebootAnnounced) {
+    PublishBootState(false);
+  }
+
+  nlohmann::json json;
+  json["Kind"] = ReconfigureKindName(kind);
+  json["LatencyMs"] = latency_ms;
+  for (int i = (int)ReconfigureKind::Control; i < kReconfigureKinds; i++) {
+    const ReconfigureStats stats = GetReconfigureStats((ReconfigureKind)i);
+    nlohmann::json entry;
+    entry["Count"] = stats.count;
+    entry["LastMs"] = stats.lastMs;
+    entry["MeanMs"] = stats.meanMs;
+    entry["MaxMs"] = stats.maxMs;
+    json[ReconfigureKindName((ReconfigureKind)i)] = entry;
+  }
+  std_msgs::msg::String message;
+  message.data = json.dump();
+  _reconfiguration_publisher->publish(message);
+}
+
+void DepthAICamera::PublishBootState(bool rebooting)
+{
+  _rebootAnnounced = rebooting;
+  nlohmann::json json;
+  json["Rebooting"] = rebooting;
+  json["Running"] = _thread_running.load();
+  json["LastBootMs"] = _bootTimeMs.load();
+  std_msgs::msg::String message;
+  message.data = json.dump();
+  _boot_state_publisher->publish(message);
+}
+
+ReconfigureStats DepthAICamera::GetReconfigureStats(ReconfigureKind kind)
+{
+  std::lock_guard<std::mutex> lock(_reconfigureMutex);
+  return _reconfigureStats[(int)kind];
+}
+
 void DepthAICamera::TryRestarting()
 {
+  std::lock_guard<std::mutex> lock(_restartMutex);
   if (_thread_running) {
     _thread_running = false;
   }
 
   RCLCPP_INFO(this->get_logger(), "[%s]: (Re)Starting...", get_name());
 
-  _pipeline = std::make_shared<dai::Pipeline>();
-
-  // Using mono cameras adds additional CPU consumption, therefore it is disabled by default
-  if (_useMonoCams) {
-    auto monoLeft = _pipeline->create<dai::node::MonoCamera>();
-    auto monoRight = _pipeline->create<dai::node::MonoCamera>();
-    auto xoutLeft = _pipeline->create<dai::node::XLinkOut>();
-    auto xoutRight = _pipeline->create<dai::node::XLinkOut>();
-    // Setup Grayscale Cameras
-    monoLeft->setResolution(dai::MonoCameraProperties::SensorResolution::THE_720_P);
-    monoLeft->setBoardSocket(dai::CameraBoardSocket::LEFT);
-    monoRight->setResolution(dai::MonoCameraProperties::SensorResolution::THE_720_P);
-    monoRight->setBoardSocket(dai::CameraBoardSocket::RIGHT);
-    monoLeft->out.link(xoutLeft->input);
-    monoRight->out.link(xoutRight->input);
-    xoutLeft->setStreamName("left");
-    xoutRight->setStreamName("right");
-  }
-  auto colorCamera = _pipeline->create<dai::node::ColorCamera>();
-  auto videoEncoder = _pipeline->create<dai::node::VideoEncoder>();
-
-  auto xoutVideo = _pipeline->create<dai::node::XLinkOut>();
-  xoutVideo->setStreamName("enc26xColor");
-  // Setup Color Camera
-  colorCamera->setBoardSocket(dai::CameraBoardSocket::RGB);
-  colorCamera->setResolution(dai::ColorCameraProperties::SensorResolution::THE_1080_P);
-
-  // Preview resolution cannot be larger than Video's, thus resolution color camera image is limited
-  colorCamera->setPreviewSize(_videoWidth, _videoHeight);
-  colorCamera->setVideoSize(_videoWidth, _videoHeight);
-  colorCamera->setFps(_videoFps);
-
-  // Like mono cameras, color camera is disabled by default to reduce computational load.
-  if (_useRawColorCam) {
-    auto xoutColor = _pipeline->create<dai::node::XLinkOut>();
-    xoutColor->setStreamName("color");
-    colorCamera->preview.link(xoutColor->input);
-  }
-
-  Profile encoding = _videoH265 ? Profile::H265_MAIN : Profile::H264_MAIN;
-  videoEncoder->setDefaultProfilePreset(_videoWidth, _videoHeight, _videoFps, encoding);
-  videoEncoder->setBitrate(_videoBitrate);
+  _pipelineConfig = GetConfig();
+  _pipeline = CreateDevicePipeline(_pipelineConfig);
   RCLCPP_INFO(
-    this->get_logger(), "[%s]: VideoEncoder FPS: %f",
-    get_name(), videoEncoder->getFrameRate());
-
-  colorCamera->video.link(videoEncoder->input);
-  videoEncoder->bitstream.link(xoutVideo->input);
-  auto xinColor = _pipeline->create<dai::node::XLinkIn>();
-  xinColor->setStreamName("colorCamCtrl");
+    this->get_logger(), "[%s]: VideoEncoder %dx%d, FPS: %d", get_name(),
+    _pipelineConfig.width, _pipelineConfig.height, _pipelineConfig.fps);
 
-  xinColor->out.link(colorCamera->inputControl);
-  RCLCPP_INFO(this->get_logger(), "[%s]: Initializing DepthAI camera...", get_name());
-  for (int i = 0; i < 5 && !_device; i++) {
-    try {
-      _device = std::make_shared<dai::Device>(*_pipeline, !_useUSB3);
-    } catch (const std::runtime_error & err) {
-      RCLCPP_ERROR(get_logger(), "Cannot start DepthAI camera: %s", err.what());
-      _device.reset();
-    }
+  // Callbacks are registered before opening, the source attaches them to its output queues.
+  _frameSource->Close();
+  _frameSource->SetCameraConfig(_pipelineConfig);
+  if (_pipelineConfig.useRawColorCam) {
+    _frameSource->AddCallback(
+      "color", GetQueueConfig("color"),
+      std::bind(&DepthAICamera::onColorCamCallback, this, std::placeholders::_1));
   }
-  if (!_device) {
-    return;
+  if (_pipelineConfig.useMonoCams) {
+    _frameSource->AddCallback(
+      "left", GetQueueConfig("left"),
+      std::bind(&DepthAICamera::onLeftCamCallback, this, std::placeholders::_1));
+    _frameSource->AddCallback(
+      "right", GetQueueConfig("right"),
+      std::bind(&DepthAICamera::onRightCallback, this, std::placeholders::_1));
   }
+  if (_pipelineConfig.useStereoDepth) {
+    _frameSource->AddCallback(
+      "depth", GetQueueConfig("depth"),
+      std::bind(&DepthAICamera::onDepthCallback, this, std::placeholders::_1));
+  }
+  _frameSource->AddCallback(
+    "enc26xColor", GetQueueConfig("enc26xColor"),
+    std::bind(&DepthAICamera::onVideoEncoderCallback, this, std::placeholders::_1));
 
-  std::string usbSpeed;
-  switch (_device->getUsbSpeed()) {
-    case dai::UsbSpeed::UNKNOWN:
-      usbSpeed = "Unknown";
-      break;
-    case dai::UsbSpeed::LOW:
-      usbSpeed = "Low";
-      break;
-    case dai::UsbSpeed::FULL:
-      usbSpeed = "Full";
-      break;
-    case dai::UsbSpeed::HIGH:
-      usbSpeed = "High";
-      break;
-    case dai::UsbSpeed::SUPER:
-      usbSpeed = "Super";
-      break;
-    case dai::UsbSpeed::SUPER_PLUS:
-      usbSpeed = "SuperPlus";
-      break;
-    default:
-      usbSpeed = "Not valid";
-      break;
+  RCLCPP_INFO(this->get_logger(), "[%s]: Initializing DepthAI camera...", get_name());
+  const auto open_start = std::chrono::steady_clock::now();
+  if (!_frameSource->Open(*_pipeline, !_useUSB3)) {
+    // The stopped source is an outage, the watchdog tries again with its backoff. Without it
+    // a device missing at startup would never be opened.
+    _watchdog.Arm(GetDevicePipelineStreams(_pipelineConfig), _pipelineConfig.fps, SteadyNowMs());
+    return;
   }
+  _bootTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - open_start).count();
   RCLCPP_INFO(
-    this->get_logger(), "[%s]: DepthAI Camera USB Speed: %s", get_name(),
-    usbSpeed.c_str());
-
-  //_device->startPipeline();
-  _colorCamInputQueue = _device->getInputQueue("colorCamCtrl");
-  dai::CameraControl colorCamCtrl;
-  if (_useAutoFocus) {
-    colorCamCtrl.setAutoFocusMode(dai::RawCameraControl::AutoFocusMode::CONTINUOUS_VIDEO);
-  } else {
-    colorCamCtrl.setAutoFocusMode(dai::RawCameraControl::AutoFocusMode::OFF);
-    colorCamCtrl.setManualFocus(_videoLensPosition);
-  }
-
-  _colorCamInputQueue->send(colorCamCtrl);
-
-  if (_useRawColorCam) {
-    _colorQueue = _device->getOutputQueue("color", 30, false);
-    _colorCamCallback =
-      _colorQueue->addCallback(
-      std::bind(
-        &DepthAICamera::onColorCamCallback, this,
-        std::placeholders::_1));
-  }
-  _videoQueue = _device->getOutputQueue("enc26xColor", 30, true);
-  if (_useMonoCams) {
-    _leftQueue = _device->getOutputQueue("left", 30, false);
-    _rightQueue = _device->getOutputQueue("right", 30, false);
-
-    _leftCamCallback =
-      _leftQueue->addCallback(
-      std::bind(
-        &DepthAICamera::onLeftCamCallback, this,
-        std::placeholders::_1));
-    _rightCamCallback =
-      _rightQueue->addCallback(
-      std::bind(
-        &DepthAICamera::onRightCallback, this,
-        std::placeholders::_1));
+    this->get_logger(), "[%s]: DepthAI Camera connection: %s", get_name(),
+    _frameSource->GetConnection().c_str());
+  RCLCPP_INFO(
+    this->get_logger(), "[%s]: Device opened in %ld ms", get_name(), (long)_bootTimeMs);
+  if (_pipelineConfig.useStereoDepth) {
+    // The depth image is aligned to the rectified right camera.
+    const std::vector<std::vector<float>> matrix =
+      _frameSource->GetCameraIntrinsics(dai::CameraBoardSocket::RIGHT, 1280, 720);
+    std::lock_guard<std::mutex> lock(_depthIntrinsicsMutex);
+    _depthIntrinsics = DepthIntrinsics();
+    if (matrix.size() == 3 && matrix[0].size() == 3 && matrix[1].size() == 3) {
+      _depthIntrinsics.width = 1280;
+      _depthIntrinsics.height = 720;
+      _depthIntrinsics.fx = matrix[0][0];
+      _depthIntrinsics.fy = matrix[1][1];
+      _depthIntrinsics.cx = matrix[0][2];
+      _depthIntrinsics.cy = matrix[1][2];
+    }
   }
-  _thread_running = true;
 
-  _videoEncoderCallback =
-    _videoQueue->addCallback(
-    std::bind(
-      &DepthAICamera::onVideoEncoderCallback, this,
-      std::placeholders::_1));
+  SendCameraControls();
+
+  _thread_running = true;
+  _watchdog.Arm(GetDevicePipelineStreams(_pipelineConfig), _pipelineConfig.fps, SteadyNowMs());
+}
 
+void DepthAICamera::SendCameraControls()
+{
+  const CameraConfig config = GetConfig();
+  // A device owned by another process takes the whole configuration instead.
+  _frameSource->SetCameraConfig(config);
+  _frameSource->SendColorCameraControl(CreateCameraControl(config));
 }
 
 void DepthAICamera::changeLensPosition(int lens_position)
 {
-  if (!_device) {
+  if (!_frameSource->IsRunning()) {
     return;
   }
   dai::CameraControl colorCamCtrl;
   colorCamCtrl.setAutoFocusMode(dai::RawCameraControl::AutoFocusMode::OFF);
   colorCamCtrl.setManualFocus(lens_position);
-  _colorCamInputQueue->send(colorCamCtrl);
+  _frameSource->SetCameraConfig(GetConfig());
+  _frameSource->SendColorCameraControl(colorCamCtrl);
 }
 
 void DepthAICamera::changeFocusMode(bool use_auto_focus)
 {
-  if (!_device) {
+  if (!_frameSource->IsRunning()) {
     return;
   }
   dai::CameraControl colorCamCtrl;
@@ -342,67 +722,109 @@ void DepthAICamera::changeFocusMode(bool use_auto_focus)
     colorCamCtrl.setAutoFocusMode(dai::RawCameraControl::AutoFocusMode::CONTINUOUS_VIDEO);
   } else {
     colorCamCtrl.setAutoFocusMode(dai::RawCameraControl::AutoFocusMode::OFF);
-    colorCamCtrl.setManualFocus(_videoLensPosition);
+    colorCamCtrl.setManualFocus(GetConfig().lensPosition);
   }
-  _colorCamInputQueue->send(colorCamCtrl);
+  _frameSource->SetCameraConfig(GetConfig());
+  _frameSource->SendColorCameraControl(colorCamCtrl);
 }
 
 void DepthAICamera::onLeftCamCallback(
-  const std::shared_ptr<dai::ADatatype> data)
+  std::vector<std::shared_ptr<dai::ImgFrame>> & leftPtrVector)
 {
-  (void)data; // Using this pointer does not pop from queue, so we don't need to do anything with it.
-  std::vector<std::shared_ptr<dai::ImgFrame>> leftPtrVector =
-    _leftQueue->tryGetAll<dai::ImgFrame>();
+  WatchFrames("left", leftPtrVector);
+  // Turned off on the host, the running pipeline still sends the stream.
+  if (!_useMonoCams) {
+    return;
+  }
   RCLCPP_DEBUG(
     this->get_logger(), "[%s]: Received %ld left camera frames...",
     get_name(), leftPtrVector.size());
+  AddClockSamples(leftPtrVector);
   for (std::shared_ptr<dai::ImgFrame> & leftPtr : leftPtrVector) {
-    auto image = ConvertImage(leftPtr, _left_camera_frame);
-    _left_publisher->publish(*image);
+    PublishImage(
+      *_left_publisher, _leftMessagePool, leftPtr, _left_camera_frame,
+      _leftOutputEncoding);
   }
 
 }
 
 void DepthAICamera::onRightCallback(
-  const std::shared_ptr<dai::ADatatype> data)
+  std::vector<std::shared_ptr<dai::ImgFrame>> & rightPtrVector)
 {
-  (void)data;
-  std::vector<std::shared_ptr<dai::ImgFrame>> rightPtrVector =
-    _rightQueue->tryGetAll<dai::ImgFrame>();
+  WatchFrames("right", rightPtrVector);
+  if (!_useMonoCams) {
+    return;
+  }
   RCLCPP_DEBUG(
     this->get_logger(), "[%s]: Received %ld right camera frames...",
     get_name(), rightPtrVector.size());
+  AddClockSamples(rightPtrVector);
   for (std::shared_ptr<dai::ImgFrame> & rightPtr : rightPtrVector) {
-    auto image = ConvertImage(rightPtr, _right_camera_frame);
-    _right_publisher->publish(*image);
+    PublishImage(
+      *_right_publisher, _rightMessagePool, rightPtr, _right_camera_frame,
+      _rightOutputEncoding);
   }
 }
 
 void DepthAICamera::onColorCamCallback(
-  const std::shared_ptr<dai::ADatatype> data)
+  std::vector<std::shared_ptr<dai::ImgFrame>> & colorPtrVector)
 {
-  (void)data;
-  std::vector<std::shared_ptr<dai::ImgFrame>> colorPtrVector =
-    _colorQueue->tryGetAll<dai::ImgFrame>();
+  WatchFrames("color", colorPtrVector);
+  if (!_useRawColorCam) {
+    return;
+  }
   RCLCPP_DEBUG(
     this->get_logger(), "[%s]: Received %ld color camera frames...",
     get_name(), colorPtrVector.size());
+  AddClockSamples(colorPtrVector);
   for (std::shared_ptr<dai::ImgFrame> & colorPtr : colorPtrVector) {
-    auto image = ConvertImage(colorPtr, _color_camera_frame);
-    _color_publisher->publish(*image);
+    // Before publishing, the published image takes the frame data.
+    PublishPyramid(colorPtr);
+    PublishImage(
+      *_color_publisher, _colorMessagePool, colorPtr, _color_camera_frame,
+      _colorOutputEncoding);
   }
 }
 
 
+void DepthAICamera::onDepthCallback(
+  std::vector<std::shared_ptr<dai::ImgFrame>> & depthPtrVector)
+{
+  WatchFrames("depth", depthPtrVector);
+  if (!_useStereoDepth) {
+    return;
+  }
+  RCLCPP_DEBUG(
+    this->get_logger(), "[%s]: Received %ld depth frames...",
+    get_name(), depthPtrVector.size());
+  AddClockSamples(depthPtrVector);
+  for (std::shared_ptr<dai::ImgFrame> & depthPtr : depthPtrVector) {
+    // Before publishing, the published image takes the frame data.
+    PublishPointCloud(depthPtr);
+    PublishImage(
+      *_depth_publisher, _depthMessagePool, depthPtr, _right_camera_frame,
+      OutputEncoding::Native);
+  }
+}
+
 void DepthAICamera::onVideoEncoderCallback(
-  const std::shared_ptr<dai::ADatatype> data)
+  std::vector<std::shared_ptr<dai::ImgFrame>> & videoPtrVector)
 {
-  (void)data;
-  std::vector<std::shared_ptr<dai::ImgFrame>> videoPtrVector =
-    _videoQueue->tryGetAll<dai::ImgFrame>();
+  const int64_t callbackStamp = _latencyTracing ? LatencyTracer::Now() : 0;
+  WatchFrames("enc26xColor", videoPtrVector);
   RCLCPP_DEBUG(
     this->get_logger(), "[%s]: Received %ld video frames...",
     get_name(), videoPtrVector.size());
+  AddClockSamples(videoPtrVector);
+  if (_reconfigurePending && !videoPtrVector.empty()) {
+    CompleteReconfigure();
+  }
+  if (_timeToFirstFrameMs < 0 && !videoPtrVector.empty()) {
+    _timeToFirstFrameMs = DepthAIUtils::GetProcessUptimeMs();
+    RCLCPP_INFO(
+      this->get_logger(), "[%s]: First video frame %ld ms after the process start",
+      get_name(), (long)_timeToFirstFrameMs);
+  }
   for (std::shared_ptr<dai::ImgFrame> & videoPtr : videoPtrVector) {
 
     /*
@@ -419,43 +841,381 @@ void DepthAICamera::onVideoEncoderCallback(
       However, it might still be problematic with the raw color camera. It will be investigated later.
     */
     //const auto stamp = videoPtr->getTimestamp().time_since_epoch().count();
-    const auto stamp = videoPtr->getTimestampDevice().time_since_epoch().count();
+    // The clock estimator maps the device time to the host clock without the boot time jumps.
+    const int64_t deviceStamp = duration_cast<nanoseconds>(
+      videoPtr->getTimestampDevice().time_since_epoch()).count();
+    const int64_t stamp = _useClockEstimator ? _clockEstimator.ToHostNs(deviceStamp) : deviceStamp;
     //const auto seq = videoPtr->getSequenceNum();
     //int64_t stamp = (int64_t)seq * (1e9/_videoFps); // Use sequence number for timestamp
 
-    CompressedImageMsg video_stream_chunk{};
-    video_stream_chunk.header.frame_id = _color_camera_frame;
+    // Published as unique_ptr, so an intra-process subscriber takes the ownership without a copy.
+    auto video_stream_chunk = std::make_unique<CompressedImageMsg>();
+    video_stream_chunk->header.frame_id = _color_camera_frame;
 
     // rclcpp::Time can be initialized directly with nanoseconds only.
     // Internally, when given with seconds and nanoseconds, it casts it to nanoseconds anyways.
-    video_stream_chunk.header.stamp = rclcpp::Time(stamp, RCL_STEADY_TIME);
-    video_stream_chunk.data.swap(videoPtr->getData());
-    video_stream_chunk.format = _videoH265 ? "H265" : "H264";
-    _video_publisher->publish(video_stream_chunk);
+    video_stream_chunk->header.stamp = rclcpp::Time(stamp, RCL_STEADY_TIME);
+    video_stream_chunk->data.swap(videoPtr->getData());
+    video_stream_chunk->format = _videoH265 ? "H265" : "H264";
+    if (_latencyTracing) {
+      // The device clock is not comparable to the host, capture uses the host synced stamp.
+      LatencyTracer::AppendStamp(
+        video_stream_chunk->format,
+        duration_cast<nanoseconds>(videoPtr->getTimestamp().time_since_epoch()).count());
+      LatencyTracer::AppendStamp(video_stream_chunk->format, callbackStamp);
+      LatencyTracer::AppendStamp(video_stream_chunk->format, LatencyTracer::Now());
+    }
+    _video_publisher->publish(std::move(video_stream_chunk));
+  }
+}
+
+void DepthAICamera::PublishImage(
+  rclcpp::Publisher<ImageMsg> & publisher,
+  MessagePool<ImageMsg> & pool,
+  const std::shared_ptr<dai::ImgFrame> & frame,
+  const std::string & frame_id,
+  OutputEncoding outputEncoding)
+{
+  if (publisher.can_loan_messages()) {
+    // The middleware owns the loaned message, the frame data moves into it.
+    auto loaned = publisher.borrow_loaned_message();
+    ConvertImage(frame, frame_id, outputEncoding, loaned.get());
+    publisher.publish(std::move(loaned));
+    _loanedImageMessages++;
+    return;
+  }
+  // Published by reference, the message can be reused as soon as publish returns.
+  // An intra-process subscription still gets its own copy from rclcpp.
+  std::unique_ptr<ImageMsg> message = pool.Acquire();
+  const bool swapped = ConvertImage(frame, frame_id, outputEncoding, *message);
+  publisher.publish(*message);
+  if (swapped) {
+    // The frame takes its buffer back and frees it, the pooled message stays small.
+    message->data.swap(frame->getData());
+  }
+  // A converted image stays in the message, its buffer is reused by the next frame.
+  pool.Release(std::move(message));
+  _pooledImageMessages++;
+}
+
+bool DepthAICamera::ConvertImage(
+  const std::shared_ptr<dai::ImgFrame> & input,
+  const std::string & frame_id,
+  OutputEncoding outputEncoding,
+  ImageMsg & message)
+{
+  message.header.stamp = FrameStamp(input);
+  message.header.frame_id = frame_id;
+  message.height = input->getHeight();
+  message.width = input->getWidth();
+
+  auto pixelFormat = pixelFormatEnumMap.find(input->getType());
+  if (outputEncoding != OutputEncoding::Native && pixelFormat != pixelFormatEnumMap.end() &&
+    input->getData().size() >= image_kernels::InputSize(
+      pixelFormat->second, message.width, message.height))
+  {
+    // Converted into the buffer the message kept from its previous use.
+    message.encoding = image_kernels::EncodingName(outputEncoding);
+    message.step = message.width * image_kernels::OutputPixelSize(outputEncoding);
+    message.data.resize(image_kernels::OutputSize(outputEncoding, message.width, message.height));
+    if (ConvertPixels(
+        pixelFormat->second, outputEncoding, input->getData().data(),
+        message.width, message.height, message.data.data()))
+    {
+      return false;
+    }
+  }
+  if (outputEncoding != OutputEncoding::Native) {
+    RCLCPP_WARN_ONCE(
+      get_logger(), "[%s]: Cannot convert frame type %d to %s, publishing the native encoding",
+      get_name(), (int)input->getType(), image_kernels::EncodingName(outputEncoding));
+  }
+
+  auto encoding = encodingEnumMap.find(input->getType());
+  if (encoding != encodingEnumMap.end()) {
+    message.encoding = encoding->second;
+  } else {
+    message.encoding.clear();
+  }
+
+  message.step = input->getData().size() / input->getHeight();
+  message.data.swap(input->getData());
+  return true;
+}
+
+void DepthAICamera::PublishPyramid(const std::shared_ptr<dai::ImgFrame> & frame)
+{
+  // Levels past the last one with subscribers are not computed.
+  size_t levels = 0;
+  for (size_t i = 0; i < _pyramidPublishers.size(); i++) {
+    if (_pyramidPublishers[i]->get_subscription_count() +
+      _pyramidPublishers[i]->get_intra_process_subscription_count() > 0)
+    {
+      levels = i + 1;
+    }
   }
+  if (levels == 0) {
+    return;
+  }
+
+  uint32_t width = frame->getWidth();
+  uint32_t height = frame->getHeight();
+  auto pixelFormat = pixelFormatEnumMap.find(frame->getType());
+  if (pixelFormat == pixelFormatEnumMap.end() ||
+    frame->getData().size() < image_kernels::InputSize(pixelFormat->second, width, height))
+  {
+    RCLCPP_WARN_ONCE(
+      get_logger(), "[%s]: Cannot build the pyramid of frame type %d",
+      get_name(), (int)frame->getType());
+    return;
+  }
+  // The level 0 image in the pyramid encoding, the frame itself if it already has it
+  const uint8_t * source = frame->getData().data();
+  const bool packed =
+    (pixelFormat->second == PixelFormat::GRAY8 && _pyramidEncoding == OutputEncoding::Mono8) ||
+    (pixelFormat->second == PixelFormat::BGR888i && _pyramidEncoding == OutputEncoding::BGR8) ||
+    (pixelFormat->second == PixelFormat::RGB888i && _pyramidEncoding == OutputEncoding::RGB8);
+  if (!packed) {
+    _pyramidBase.resize(image_kernels::OutputSize(_pyramidEncoding, width, height));
+    if (!ConvertPixels(
+        pixelFormat->second, _pyramidEncoding, source, width, height,
+        _pyramidBase.data()))
+    {
+      RCLCPP_WARN_ONCE(
+        get_logger(), "[%s]: Cannot convert frame type %d for the pyramid",
+        get_name(), (int)frame->getType());
+      return;
+    }
+    source = _pyramidBase.data();
+  }
+
+  const rclcpp::Time stamp = FrameStamp(frame);
+  const uint32_t channels = image_kernels::OutputPixelSize(_pyramidEncoding);
+  // Each level is computed from the previous one, which is kept until then.
+  std::unique_ptr<ImageMsg> previous;
+  for (size_t i = 0; i < levels && width >= 2 && height >= 2; i++) {
+    std::unique_ptr<ImageMsg> message = _pyramidMessagePool.Acquire();
+    message->header.stamp = stamp;
+    message->header.frame_id = _color_camera_frame;
+    message->encoding = image_kernels::EncodingName(_pyramidEncoding);
+    message->width = width / 2;
+    message->height = height / 2;
+    message->step = message->width * channels;
+    message->data.resize((size_t)message->step * message->height);
+    DownsampleHalf(source, width, height, channels, message->data.data());
+    _pyramidImages++;
+    if (_pyramidPublishers[i]->get_subscription_count() +
+      _pyramidPublishers[i]->get_intra_process_subscription_count() > 0)
+    {
+      _pyramidPublishers[i]->publish(*message);
+    }
+    if (previous) {
+      _pyramidMessagePool.Release(std::move(previous));
+    }
+    previous = std::move(message);
+    source = previous->data.data();
+    width /= 2;
+    height /= 2;
+  }
+  if (previous) {
+    _pyramidMessagePool.Release(std::move(previous));
+  }
+}
+
+void DepthAICamera::PublishPointCloud(const std::shared_ptr<dai::ImgFrame> & frame)
+{
+  if (_points_publisher->get_subscription_count() +
+    _points_publisher->get_intra_process_subscription_count() == 0)
+  {
+    return;
+  }
+  const uint32_t width = frame->getWidth();
+  const uint32_t height = frame->getHeight();
+  if (frame->getData().size() < (size_t)width * height * sizeof(uint16_t)) {
+    RCLCPP_WARN_ONCE(
+      get_logger(), "[%s]: Depth frame of %lu bytes is too small for %ux%u",
+      get_name(), (unsigned long)frame->getData().size(), width, height);
+    return;
+  }
+
+  DepthIntrinsics intrinsics;
+  {
+    std::lock_guard<std::mutex> lock(_depthIntrinsicsMutex);
+    intrinsics = _depthIntrinsics;
+  }
+  if (intrinsics.width != width || intrinsics.height != height) {
+    if (intrinsics.width != 0) {
+      // Calibrated at another resolution, the pinhole model scales with the image.
+      const float scaleX = (float)width / intrinsics.width;
+      const float scaleY = (float)height / intrinsics.height;
+      intrinsics.fx *= scaleX;
+      intrinsics.cx *= scaleX;
+      intrinsics.fy *= scaleY;
+      intrinsics.cy *= scaleY;
+    } else {
+      // No calibration, square pixels and the principal point in the image center
+      intrinsics.fx = intrinsics.fy =
+        (float)(0.5 * width / std::tan(_depthHfovDeg * M_PI / 360.0));
+      intrinsics.cx = (width - 1) * 0.5f;
+      intrinsics.cy = (height - 1) * 0.5f;
+    }
+    intrinsics.width = width;
+    intrinsics.height = height;
+  }
+  // Only rebuilt when the camera model changes
+  _depthRays.Build(intrinsics);
+
+  std::unique_ptr<PointCloudMsg> message = _pointsMessagePool.Acquire();
+  message->header.stamp = FrameStamp(frame);
+  message->header.frame_id = _right_camera_frame;
+  if (message->fields.empty()) {
+    const char * names[] = {"x", "y", "z"};
+    for (uint32_t i = 0; i < 3; i++) {
+      sensor_msgs::msg::PointField field;
+      field.name = names[i];
+      field.offset = i * sizeof(float);
+      field.datatype = sensor_msgs::msg::PointField::FLOAT32;
+      field.count = 1;
+      message->fields.push_back(field);
+    }
+  }
+  // Organized cloud, pixels without depth are NaN points.
+  message->height = height;
+  message->width = width;
+  message->is_bigendian = false;
+  message->point_step = point_cloud::kPointStep;
+  message->row_step = width * point_cloud::kPointStep;
+  message->is_dense = false;
+  message->data.resize((size_t)message->row_step * height);
+  // Depth is in millimeters, the cloud in meters.
+  DepthToPoints(
+    reinterpret_cast<const uint16_t *>(frame->getData().data()), _depthRays, 0.001f,
+    message->data.data());
+  _points_publisher->publish(*message);
+  _pointsMessagePool.Release(std::move(message));
+  _pointClouds++;
 }
 
-std::shared_ptr<DepthAICamera::ImageMsg> DepthAICamera::ConvertImage(
-  const std::shared_ptr<dai::ImgFrame> input,
-  const std::string & frame_id)
+void DepthAICamera::AddClockSamples(const std::vector<std::shared_ptr<dai::ImgFrame>> & frames)
 {
-  auto message = std::make_shared<ImageMsg>();
-  const auto stamp = input->getTimestamp();
+  if (!_useClockEstimator) {
+    return;
+  }
+  // Frames of one batch waited in the queue, the estimator keeps the fastest ones.
+  const int64_t receiveNs = LatencyTracer::Now();
+  for (const std::shared_ptr<dai::ImgFrame> & frame : frames) {
+    _clockEstimator.AddSample(
+      duration_cast<nanoseconds>(frame->getTimestampDevice().time_since_epoch()).count(),
+      receiveNs);
+  }
+}
+
+rclcpp::Time DepthAICamera::FrameStamp(const std::shared_ptr<dai::ImgFrame> & frame) const
+{
+  if (_useClockEstimator) {
+    return rclcpp::Time(
+      _clockEstimator.ToHostNs(
+        duration_cast<nanoseconds>(frame->getTimestampDevice().time_since_epoch()).count()),
+      RCL_STEADY_TIME);
+  }
+  const auto stamp = frame->getTimestamp();
   const int32_t sec = duration_cast<seconds>(stamp.time_since_epoch()).count();
   const int32_t nsec = duration_cast<nanoseconds>(stamp.time_since_epoch()).count() % 1000000000UL;
+  return rclcpp::Time(sec, nsec, RCL_STEADY_TIME);
+}
 
-  message->header.stamp = rclcpp::Time(sec, nsec, RCL_STEADY_TIME);
-  message->header.frame_id = frame_id;
+void DepthAICamera::PublishClockDrift()
+{
+  const ClockDriftStats stats = _clockEstimator.GetStats();
+  if (stats.samples == 0) {
+    return;
+  }
+  nlohmann::json json;
+  json["Samples"] = stats.samples;
+  json["Resets"] = stats.resets;
+  json["OffsetNs"] = stats.offsetNs;
+  json["SkewPpm"] = stats.skewPpm;
+  json["ResidualRmsUs"] = stats.residualRmsUs;
+  json["ResidualMaxUs"] = stats.residualMaxUs;
+  json["ReceiveDelayMeanUs"] = stats.receiveDelayMeanUs;
+  std_msgs::msg::String message;
+  message.data = json.dump();
+  _clock_drift_publisher->publish(message);
+}
 
-  if (encodingEnumMap.find(input->getType()) != encodingEnumMap.end()) {
-    message->encoding = encodingEnumMap[input->getType()];
+void DepthAICamera::PublishQueueStats()
+{
+  const std::map<std::string, QueueStats> queues = _frameSource->GetQueueStats();
+  if (queues.empty()) {
+    return;
+  }
+  nlohmann::json json;
+  for (const auto & entry : queues) {
+    const QueueStats & stats = entry.second;
+    nlohmann::json queue;
+    queue["Policy"] = QueuePolicyName(stats.policy);
+    queue["Depth"] = stats.depth;
+    queue["Batches"] = stats.batches;
+    queue["Frames"] = stats.frames;
+    queue["Discarded"] = stats.discarded;
+    queue["Lost"] = stats.lost;
+    queue["FillLast"] = stats.fillLast;
+    queue["FillMax"] = stats.fillMax;
+    queue["FillMean"] = stats.fillMean;
+    json[entry.first] = queue;
   }
+  std_msgs::msg::String message;
+  message.data = json.dump();
+  _queue_stats_publisher->publish(message);
+}
 
-  message->height = input->getHeight();
-  message->width = input->getWidth();
-  message->step = input->getData().size() / input->getHeight();
-  message->data.swap(input->getData());
-  return message;
+void DepthAICamera::WatchFrames(
+  const std::string & stream,
+  const std::vector<std::shared_ptr<dai::ImgFrame>> & frames)
+{
+  if (frames.empty() || !_watchdog.OnFrames(stream, SteadyNowMs())) {
+    return;
+  }
+  RCLCPP_INFO(
+    this->get_logger(), "[%s]: Frames are back after %.0f ms", get_name(),
+    _watchdog.GetStats().lastDowntimeMs);
+}
+
+void DepthAICamera::CheckFrameWatchdog()
+{
+  // A boot or an earlier recovery is still opening the device.
+  if (IsBooting()) {
+    return;
+  }
+  const int64_t now_ms = SteadyNowMs();
+  if (_watchdog.Check(now_ms, _frameSource->IsRunning())) {
+    const int64_t backoff_ms = _watchdog.OnRecoveryAttempt(now_ms);
+    const FrameWatchdogStats stats = _watchdog.GetStats();
+    RCLCPP_WARN(
+      this->get_logger(), "[%s]: No %s frames, reopening the device (attempt %lu, next in %ld ms)",
+      get_name(), stats.stalledStream.c_str(), (unsigned long)stats.attempts, (long)backoff_ms);
+    // Off the executor like the first boot.
+    BootAsync(false);
+  }
+
+  const FrameWatchdogStats stats = _watchdog.GetStats();
+  const uint64_t events = stats.stalls + stats.attempts + stats.recoveries;
+  if (events == _watchdogEvents) {
+    return;
+  }
+  _watchdogEvents = events;
+  nlohmann::json json;
+  json["Stalled"] = stats.stalled;
+  json["StalledStream"] = stats.stalledStream;
+  json["Stalls"] = stats.stalls;
+  json["Attempts"] = stats.attempts;
+  json["Recoveries"] = stats.recoveries;
+  json["LastDowntimeMs"] = stats.lastDowntimeMs;
+  json["MaxDowntimeMs"] = stats.maxDowntimeMs;
+  json["TotalDowntimeMs"] = stats.totalDowntimeMs;
+  std_msgs::msg::String message;
+  message.data = json.dump();
+  _watchdog_publisher->publish(message);
 }
 
 #include <rclcpp_components/register_node_macro.hpp>
@@ -21,12 +21,15 @@ int main(int argc, char * argv[])
     // With this version, all callbacks will be called from within this thread (the main one).
     rclcpp::executors::MultiThreadedExecutor exec;
     rclcpp::NodeOptions options;
+    // Both nodes live in this process, video chunks are handed over without serialization.
+    options.use_intra_process_comms(true);
 
     // Add some nodes to the executor which provide work for the executor during its "spin" function.
     // An example of available work is executing a subscription callback, or a timer callback.
+    // The camera opens the device in the background, the pipeline below is built meanwhile.
     auto camera = std::make_shared<DepthAICamera>(options);
     exec.add_node(camera);
-    auto gstreamer = std::make_shared<DepthAIGStreamer>(argc, argv);
+    auto gstreamer = std::make_shared<DepthAIGStreamer>(argc, argv, options);
     exec.add_node(gstreamer);
     
     // spin will block until work comes in, execute work as it becomes available, and keep blocking.
@@ -9,22 +9,29 @@
 #include <gstreamer_interface.hpp>
 #include <nlohmann/json.hpp>
 #include <mutex>
-#include <queue>
 
 using namespace depthai_ctrl;
 using std::placeholders::_1;
 
 
 DepthAIGStreamer::DepthAIGStreamer(int argc, char * argv[])
-: Node("depthai_gstreamer"), _impl(nullptr)
+: Node("depthai_gstreamer"), _impl(nullptr), _last_bytes_pushed(0), _last_bytes_copied(0)
 {
   _impl = new GstInterface(argc, argv);
   
   Initialize();
 }
 
+DepthAIGStreamer::DepthAIGStreamer(int argc, char * argv[], const rclcpp::NodeOptions & options)
+: Node("depthai_gstreamer", options), _impl(nullptr), _last_bytes_pushed(0), _last_bytes_copied(0)
+{
+  _impl = new GstInterface(argc, argv);
+
+  Initialize();
+}
+
 DepthAIGStreamer::DepthAIGStreamer(const rclcpp::NodeOptions & options)
-: Node("depthai_gstreamer", options), _impl(nullptr)
+: Node("depthai_gstreamer", options), _impl(nullptr), _last_bytes_pushed(0), _last_bytes_copied(0)
 {
 
   _impl = new GstInterface(0, 0);
@@ -62,19 +69,39 @@ void DepthAIGStreamer::Initialize()
   auto cmd_sub_opt = rclcpp::SubscriptionOptions();
   cmd_sub_opt.callback_group = _callback_group_cmd_subscriber;
 
+  // Same explicit keep-last QoS as the camera publisher, required for intra-process delivery.
   _video_subscriber = create_subscription<CompressedImageMsg>(
     video_stream_topic,
-    rclcpp::SystemDefaultsQoS(),
+    rclcpp::QoS(rclcpp::KeepLast(10)),
     std::bind(&DepthAIGStreamer::GrabVideoMsg, this, std::placeholders::_1), video_sub_opt);
 
   _stream_command_subscriber = this->create_subscription<std_msgs::msg::String>(
     "videostreamcmd",
-    rclcpp::SystemDefaultsQoS(),
+    rclcpp::QoS(rclcpp::KeepLast(10)),
     std::bind(&DepthAIGStreamer::VideoStreamCommand, this, std::placeholders::_1), cmd_sub_opt);
 
+  // Reboots the camera announces, e.g. for a new bitrate, do not switch to the default stream.
+  _camera_boot_subscriber = this->create_subscription<std_msgs::msg::String>(
+    "videostreamboot",
+    rclcpp::QoS(rclcpp::KeepLast(10)),
+    std::bind(&DepthAIGStreamer::CameraBootState, this, std::placeholders::_1), cmd_sub_opt);
+
+  // Processes the stream state machine events, bus errors are handled within 100 ms.
   _handle_stream_status_timer = this->create_wall_timer(
-    std::chrono::milliseconds(10000),
-    std::bind(&DepthAIGStreamer::HandleStreamStatus, this), _callback_group_timer); // 10 sec
+    std::chrono::milliseconds(100),
+    std::bind(&DepthAIGStreamer::HandleStreamStatus, this), _callback_group_timer); // 100 ms
+
+  _stream_state_publisher = this->create_publisher<std_msgs::msg::String>(
+    "videostreamstate", rclcpp::QoS(rclcpp::KeepLast(10)));
+
+  _stream_stats_publisher = this->create_publisher<std_msgs::msg::String>(
+    "videostreamstats", rclcpp::QoS(rclcpp::KeepLast(10)));
+  _stream_latency_publisher = this->create_publisher<std_msgs::msg::String>(
+    "videostreamlatency", rclcpp::QoS(rclcpp::KeepLast(10)));
+  _last_stats_time = get_clock()->now();
+  _stream_stats_timer = this->create_wall_timer(
+    std::chrono::milliseconds(1000),
+    std::bind(&DepthAIGStreamer::PublishStreamStats, this), _callback_group_timer); // 1 sec
 
   declare_parameter<int>("width", 1280);
   declare_parameter<int>("height", 720);
@@ -114,27 +141,264 @@ void DepthAIGStreamer::Initialize()
   const std::string ns = std::string(get_namespace());
   declare_parameter<std::string>("address", default_stream_path + ns, address_desc);
 
+  rcl_interfaces::msg::ParameterDescriptor zero_copy_desc;
+  zero_copy_desc.name = "zero_copy_buffers";
+  zero_copy_desc.type = rclcpp::PARAMETER_BOOL;
+  zero_copy_desc.description =
+    "Wrap incoming video chunks in GstBuffers without copying them. "
+    "Copied bytes per second are reported on the videostreamstats topic.";
+  declare_parameter<bool>("zero_copy_buffers", true, zero_copy_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor queue_max_bytes_desc;
+  queue_max_bytes_desc.name = "queue_max_bytes";
+  queue_max_bytes_desc.type = rclcpp::PARAMETER_INTEGER;
+  queue_max_bytes_desc.description =
+    "Byte budget of the incoming video chunk queue. The queue is also limited "
+    "to two seconds of video frames.";
+  declare_parameter<int>("queue_max_bytes", 8 * 1024 * 1024, queue_max_bytes_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor push_mode_desc;
+  push_mode_desc.name = "appsrc_push_mode";
+  push_mode_desc.type = rclcpp::PARAMETER_BOOL;
+  push_mode_desc.description =
+    "Push video chunks into the GStreamer appsrc as soon as they arrive, "
+    "instead of waiting for the need-data signal.";
+  declare_parameter<bool>("appsrc_push_mode", false, push_mode_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor appsrc_max_bytes_desc;
+  appsrc_max_bytes_desc.name = "appsrc_max_bytes";
+  appsrc_max_bytes_desc.type = rclcpp::PARAMETER_INTEGER;
+  appsrc_max_bytes_desc.description =
+    "Maximum bytes queued inside the appsrc in push mode. The backlog beyond "
+    "this limit is pushed as one batch when the pipeline catches up.";
+  declare_parameter<int>("appsrc_max_bytes", 2 * 1024 * 1024, appsrc_max_bytes_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor hot_standby_desc;
+  hot_standby_desc.name = "hot_standby_pipeline";
+  hot_standby_desc.type = rclcpp::PARAMETER_BOOL;
+  hot_standby_desc.description =
+    "Keep the default and the camera streams in one long-lived pipeline and switch "
+    "between them with an input-selector, without reconnecting the stream.";
+  declare_parameter<bool>("hot_standby_pipeline", false, hot_standby_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor hot_standby_timeout_desc;
+  hot_standby_timeout_desc.name = "hot_standby_timeout_ms";
+  hot_standby_timeout_desc.type = rclcpp::PARAMETER_INTEGER;
+  hot_standby_timeout_desc.description =
+    "Time without camera frames before the hot-standby pipeline switches back "
+    "to the default stream.";
+  declare_parameter<int>("hot_standby_timeout_ms", 500, hot_standby_timeout_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor camera_wait_desc;
+  camera_wait_desc.name = "camera_wait_ms";
+  camera_wait_desc.type = rclcpp::PARAMETER_INTEGER;
+  camera_wait_desc.description =
+    "Time the first stream start waits for camera frames before it streams the default "
+    "pipeline. The element plugins are loaded meanwhile, in parallel with the camera boot.";
+  declare_parameter<int>("camera_wait_ms", 2000, camera_wait_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor extra_addresses_desc;
+  extra_addresses_desc.name = "extra_addresses";
+  extra_addresses_desc.type = rclcpp::PARAMETER_STRING_ARRAY;
+  extra_addresses_desc.description =
+    "Video stream destinations in addition to the address parameter. All destinations "
+    "are fed from one pipeline, a slow destination drops its own frames only.";
+  extra_addresses_desc.additional_constraints =
+    "UDP or RTSP addresses, like the address parameter. Destinations can be added and "
+    "removed at runtime with the add_destination and remove_destination commands.";
+  declare_parameter<std::vector<std::string>>(
+    "extra_addresses", std::vector<std::string>{}, extra_addresses_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor rtsp_server_port_desc;
+  rtsp_server_port_desc.name = "rtsp_server_port";
+  rtsp_server_port_desc.type = rclcpp::PARAMETER_INTEGER;
+  rtsp_server_port_desc.description =
+    "Port of the embedded RTSP server. The stream is served to any number of clients "
+    "through one shared media, without an external relay server.";
+  rtsp_server_port_desc.additional_constraints =
+    "0 disables the server. With the server enabled, an empty address parameter "
+    "streams through the embedded server only.";
+  declare_parameter<int>("rtsp_server_port", 0, rtsp_server_port_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor rtsp_server_mount_desc;
+  rtsp_server_mount_desc.name = "rtsp_server_mount";
+  rtsp_server_mount_desc.type = rclcpp::PARAMETER_STRING;
+  rtsp_server_mount_desc.description = "Mount point of the stream on the embedded RTSP server.";
+  declare_parameter<std::string>("rtsp_server_mount", "/video", rtsp_server_mount_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor recording_location_desc;
+  recording_location_desc.name = "recording_location";
+  recording_location_desc.type = rclcpp::PARAMETER_STRING;
+  recording_location_desc.description =
+    "On-board recording of the encoded stream, muxed into segments without re-encoding. "
+    "Empty disables recording.";
+  recording_location_desc.additional_constraints =
+    "splitmuxsink location pattern with a %d field, e.g. /data/video_%05d.mkv. "
+    "The .mkv extension records Matroska, anything else fragmented MP4.";
+  declare_parameter<std::string>("recording_location", "", recording_location_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor recording_segment_time_desc;
+  recording_segment_time_desc.name = "recording_segment_time_s";
+  recording_segment_time_desc.type = rclcpp::PARAMETER_INTEGER;
+  recording_segment_time_desc.description =
+    "Duration of a recording segment. Segments are cut at the first key frame past the limit.";
+  recording_segment_time_desc.additional_constraints = "0 for no duration limit.";
+  declare_parameter<int>("recording_segment_time_s", 60, recording_segment_time_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor recording_segment_size_desc;
+  recording_segment_size_desc.name = "recording_segment_size_mb";
+  recording_segment_size_desc.type = rclcpp::PARAMETER_INTEGER;
+  recording_segment_size_desc.description =
+    "Size of a recording segment. Segments are cut at the first key frame past the limit.";
+  recording_segment_size_desc.additional_constraints = "0 for no size limit.";
+  declare_parameter<int>("recording_segment_size_mb", 0, recording_segment_size_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor recording_max_files_desc;
+  recording_max_files_desc.name = "recording_max_files";
+  recording_max_files_desc.type = rclcpp::PARAMETER_INTEGER;
+  recording_max_files_desc.description =
+    "Number of recording segments kept, the oldest one is overwritten.";
+  recording_max_files_desc.additional_constraints = "0 keeps all segments.";
+  declare_parameter<int>("recording_max_files", 0, recording_max_files_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor recording_preallocate_desc;
+  recording_preallocate_desc.name = "recording_preallocate_mb";
+  recording_preallocate_desc.type = rclcpp::PARAMETER_INTEGER;
+  recording_preallocate_desc.description =
+    "Disk space reserved for a recording segment when it is opened. The unused "
+    "part is released when the segment is closed.";
+  recording_preallocate_desc.additional_constraints = "0 disables preallocation.";
+  declare_parameter<int>("recording_preallocate_mb", 64, recording_preallocate_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor latency_tracing_desc;
+  latency_tracing_desc.name = "latency_tracing";
+  latency_tracing_desc.type = rclcpp::PARAMETER_BOOL;
+  latency_tracing_desc.description =
+    "Trace every camera chunk from device capture to the network sink and publish "
+    "per-stage latency percentiles to the videostreamlatency topic.";
+  latency_tracing_desc.additional_constraints =
+    "Only chunks stamped by a camera node with latency_tracing enabled are traced.";
+  declare_parameter<bool>("latency_tracing", false, latency_tracing_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor backoff_initial_desc;
+  backoff_initial_desc.name = "stream_backoff_initial_ms";
+  backoff_initial_desc.type = rclcpp::PARAMETER_INTEGER;
+  backoff_initial_desc.description =
+    "Delay before restarting a failed stream. The delay doubles with every failed "
+    "attempt in a row, with 20 % random jitter.";
+  declare_parameter<int>("stream_backoff_initial_ms", 100, backoff_initial_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor backoff_max_desc;
+  backoff_max_desc.name = "stream_backoff_max_ms";
+  backoff_max_desc.type = rclcpp::PARAMETER_INTEGER;
+  backoff_max_desc.description = "Upper limit of the stream restart delay.";
+  declare_parameter<int>("stream_backoff_max_ms", 5000, backoff_max_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor adaptive_bitrate_desc;
+  adaptive_bitrate_desc.name = "adaptive_bitrate";
+  adaptive_bitrate_desc.type = rclcpp::PARAMETER_BOOL;
+  adaptive_bitrate_desc.description =
+    "Compute a target encoder bitrate from the RTCP receiver reports, the sink queue levels "
+    "and the chunk queue, published as JSON on the videostreambitrate topic twice a second.";
+  adaptive_bitrate_desc.additional_constraints =
+    "The target stays between adaptive_bitrate_min and bitrate. A camera node with "
+    "adaptive_bitrate enabled applies it to the device encoder.";
+  declare_parameter<bool>("adaptive_bitrate", false, adaptive_bitrate_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor adaptive_bitrate_min_desc;
+  adaptive_bitrate_min_desc.name = "adaptive_bitrate_min";
+  adaptive_bitrate_min_desc.type = rclcpp::PARAMETER_INTEGER;
+  adaptive_bitrate_min_desc.description = "Lowest target bitrate of the adaptive bitrate.";
+  declare_parameter<int>("adaptive_bitrate_min", 500000, adaptive_bitrate_min_desc);
+
+  rcl_interfaces::msg::ParameterDescriptor adaptive_bitrate_loss_desc;
+  adaptive_bitrate_loss_desc.name = "adaptive_bitrate_loss_threshold";
+  adaptive_bitrate_loss_desc.type = rclcpp::PARAMETER_DOUBLE;
+  adaptive_bitrate_loss_desc.description =
+    "Fraction of lost packets in a receiver report which lowers the target bitrate.";
+  declare_parameter<double>("adaptive_bitrate_loss_threshold", 0.02, adaptive_bitrate_loss_desc);
+
   _impl->SetEncoderProfile(get_parameter("encoding").as_string());
   _impl->SetStreamAddress(get_parameter("address").as_string());
+  _impl->SetZeroCopy(get_parameter("zero_copy_buffers").as_bool());
+  _impl->SetEncoderFps(get_parameter("fps").as_int());
+  _impl->SetQueueMaxBytes(get_parameter("queue_max_bytes").as_int());
+  _impl->SetPushMode(get_parameter("appsrc_push_mode").as_bool());
+  _impl->SetAppSrcMaxBytes(get_parameter("appsrc_max_bytes").as_int());
+  for (const auto & address : get_parameter("extra_addresses").as_string_array()) {
+    std::string res{};
+    if (!DepthAIUtils::ValidateAddressParameters(address, res)) {
+      RCLCPP_WARN(get_logger(), res.c_str());
+      continue;
+    }
+    _impl->AddDestination(address);
+  }
+  _impl->SetHotStandby(get_parameter("hot_standby_pipeline").as_bool());
+  _impl->SetHotStandbyTimeoutMs(get_parameter("hot_standby_timeout_ms").as_int());
+  _camera_wait_ms = get_parameter("camera_wait_ms").as_int();
+  _impl->SetLatencyTracing(get_parameter("latency_tracing").as_bool());
+  if (get_parameter("adaptive_bitrate").as_bool()) {
+    BitrateControllerConfig bitrate_config{};
+    bitrate_config.maxBitrate = get_parameter("bitrate").as_int();
+    bitrate_config.minBitrate =
+      std::min(bitrate_config.maxBitrate, (int)get_parameter("adaptive_bitrate_min").as_int());
+    bitrate_config.lossThreshold = get_parameter("adaptive_bitrate_loss_threshold").as_double();
+    _impl->SetAdaptiveBitrate(bitrate_config);
+    _bitrate_target_publisher = this->create_publisher<std_msgs::msg::String>(
+      "videostreambitrate", rclcpp::QoS(rclcpp::KeepLast(10)));
+    _bitrate_timer = this->create_wall_timer(
+      std::chrono::milliseconds(500),
+      std::bind(&DepthAIGStreamer::PublishBitrateTarget, this), _callback_group_timer); // 500 ms
+  }
+  _impl->SetRtspServer(
+    get_parameter("rtsp_server_port").as_int(),
+    get_parameter("rtsp_server_mount").as_string());
+  RecordingConfig recording_config{};
+  recording_config.location = get_parameter("recording_location").as_string();
+  recording_config.maxSegmentTimeNs =
+    (uint64_t)std::max<int64_t>(0, get_parameter("recording_segment_time_s").as_int()) *
+    GST_SECOND;
+  recording_config.maxSegmentBytes =
+    (uint64_t)std::max<int64_t>(0, get_parameter("recording_segment_size_mb").as_int()) << 20;
+  recording_config.maxFiles =
+    (unsigned)std::max<int64_t>(0, get_parameter("recording_max_files").as_int());
+  recording_config.preallocateBytes =
+    (uint64_t)std::max<int64_t>(0, get_parameter("recording_preallocate_mb").as_int()) << 20;
+  _impl->SetRecording(recording_config);
 
   RCLCPP_DEBUG(get_logger(), "Namespace: %s", (default_stream_path + ns).c_str());
   RCLCPP_INFO(get_logger(), "DepthAI GStreamer 1.0.2 started.");
   RCLCPP_INFO(
     get_logger(), "Streaming %s to address: %s",
     _impl->GetEncoderProfile().c_str(), _impl->GetStreamAddress().c_str());
-  _is_stop_requested = !get_parameter("start_stream_on_boot").as_bool();
+
+  StreamStateMachineConfig state_config{};
+  state_config.backoffInitial =
+    std::chrono::milliseconds(get_parameter("stream_backoff_initial_ms").as_int());
+  state_config.backoffMax =
+    std::chrono::milliseconds(get_parameter("stream_backoff_max_ms").as_int());
+  state_config.switchInputByRestart = !_impl->IsHotStandby();
+  _stream_state = std::make_unique<StreamStateMachine>(state_config);
+  _impl->SetStreamEventHandler([this](StreamEvent event) {_stream_state->Post(event);});
+
   if (get_parameter("start_stream_on_boot").as_bool()) {
     RCLCPP_INFO(get_logger(), "DepthAI GStreamer: start video stream on boot");
-
-    RCLCPP_INFO(this->get_logger(), "Resetting timer.");
-    _handle_stream_status_timer->reset();
-    _impl->StartStream();
+    _stream_state->Post(StreamEvent::StartRequested);
+    // Start right away, not only once the executor spins.
+    HandleStreamStatus();
   }
 
 }
 
-void DepthAIGStreamer::GrabVideoMsg(const CompressedImageMsg::SharedPtr video_msg)
+void DepthAIGStreamer::GrabVideoMsg(CompressedImageMsg::UniquePtr video_msg_unique)
 {
+  if (_impl->IsLatencyTracing() && LatencyTracer::IsTraced(video_msg_unique->format)) {
+    LatencyTracer::AppendStamp(video_msg_unique->format, LatencyTracer::Now());
+  }
+  // With intra-process communication the unique_ptr is the publisher's message itself.
+  // Moving it into a shared_ptr keeps it zero-copy all the way to the GstBuffer.
+  const CompressedImageMsg::SharedPtr video_msg = std::move(video_msg_unique);
+  _stream_state->OnFrame(StreamStateMachine::Clock::now());
   const auto stamp = video_msg->header.stamp;
 
   RCLCPP_DEBUG(
@@ -142,57 +406,190 @@ void DepthAIGStreamer::GrabVideoMsg(const CompressedImageMsg::SharedPtr video_ms
     "[GST %s]RECEIVED CHUNK # %d.%d", 
     _impl->IsStreamPlaying() ? "STREAMING" : "STOPPED", stamp.sec, stamp.nanosec);
 
-  g_mutex_lock(&_impl->haveDataCondMutex);
-  _impl->queue.push(video_msg);
-  // When message queue is too big - delete old messages
-  if (_impl->queue.size() > (size_t)_impl->GetEncoderFps() * 2) {
-    _impl->queue.pop();
+  // When message queue is too big, chunks are dropped without breaking the GOP structure
+  if (!_impl->PushFrame(video_msg)) {
+    RCLCPP_DEBUG(get_logger(), "Video chunk queue is full, dropping chunk");
   }
-  g_cond_signal(&_impl->haveDataCond);
-  g_mutex_unlock(&_impl->haveDataCondMutex);
 }
 
 
 void DepthAIGStreamer::HandleStreamStatus()
 {
-  if (!_is_stop_requested) {
-    if (!_impl->IsStreamPlaying()) {
-      if (!_impl->IsStreamStarting()) {
-        RCLCPP_INFO(get_logger(), "DepthAI GStreamer: try to start video stream");
-
+  const auto transitions = _stream_state->Process(StreamStateMachine::Clock::now());
+  for (const auto & transition : transitions) {
+    RCLCPP_INFO(
+      get_logger(), "DepthAI GStreamer: stream %s -> %s on %s",
+      StreamStateMachine::ToString(transition.from), StreamStateMachine::ToString(transition.to),
+      StreamStateMachine::ToString(transition.event));
+
+    switch (transition.action) {
+      case StreamAction::Start:
+        // The first start waits for the camera, retries decide on the chunks already queued.
+        _impl->SetPipelineDataWaitMs(
+          transition.event == StreamEvent::StartRequested ? _camera_wait_ms : 0);
         _impl->StartStream();
-      } else {
-        RCLCPP_INFO(get_logger(), "DepthAI GStreamer: Start failed, stop stream");
+        break;
+      case StreamAction::Stop:
         _impl->StopStream();
-      }
-    } else if (_impl->IsStreamPlaying()) {
-      RCLCPP_INFO(
-        get_logger(), "DepthAI GStreamer: Stream running okay in %s mode.",
-        _impl->IsStreamDefault() ? "default" : "camera streaming");
-
-      if (_impl->IsStreamDefault()) {
-        if (_impl->queue.size() > (size_t)_impl->GetEncoderFps()) {
-          RCLCPP_INFO(
-            get_logger(), "DepthAI GStreamer: Stream is default, but have data with size of %ld.",
-            _impl->queue.size());
-          RCLCPP_INFO(get_logger(), "DepthAI GStreamer: Switching to camera stream.");
-          _impl->StopStream();
+        if (transition.to == StreamState::Stopping) {
+          _stream_state->Post(StreamEvent::Stopped);
         }
-      } else {
-        if (_video_subscriber->get_publisher_count() == 0) {
-          RCLCPP_INFO(get_logger(), "DepthAI GStreamer: Stream is running, but no publisher.");
-          RCLCPP_INFO(get_logger(), "DepthAI GStreamer: Switching to default stream.");
-
-          g_mutex_lock(&_impl->haveDataCondMutex);
-          RCLCPP_INFO(get_logger(), "DepthAI GStreamer: Clearing queue for start");
-          std::queue<CompressedImageMsg::SharedPtr>().swap(_impl->queue);
-          g_mutex_unlock(&_impl->haveDataCondMutex);
-          _impl->StopStream();
+        break;
+      case StreamAction::Restart:
+        if (transition.event == StreamEvent::FramesStopped) {
+          RCLCPP_INFO(get_logger(), "DepthAI GStreamer: Clearing queue for default stream");
+          _impl->ClearQueue();
         }
+        _impl->StopStream();
+        _impl->SetPipelineDataWaitMs(0);
+        _impl->StartStream();
+        break;
+      default:
+        break;
+    }
+    PublishStreamState(transition);
+  }
+}
+
+void DepthAIGStreamer::PublishStreamState(const StreamTransition & transition)
+{
+  nlohmann::json state{};
+  state["From"] = StreamStateMachine::ToString(transition.from);
+  state["To"] = StreamStateMachine::ToString(transition.to);
+  state["Event"] = StreamStateMachine::ToString(transition.event);
+  state["Action"] = StreamStateMachine::ToString(transition.action);
+  state["Attempt"] = transition.attempt;
+  state["RetryInMs"] = transition.retryInMs;
+
+  std_msgs::msg::String msg{};
+  msg.data = state.dump();
+  _stream_state_publisher->publish(msg);
+}
+
+void DepthAIGStreamer::PublishLatencyStats()
+{
+  nlohmann::json latency{};
+  for (const auto & interval : _impl->TakeLatencyStats()) {
+    nlohmann::json entry{};
+    entry["Count"] = interval.count;
+    entry["P50Ms"] = interval.p50Ms;
+    entry["P95Ms"] = interval.p95Ms;
+    entry["P99Ms"] = interval.p99Ms;
+    latency[interval.name] = entry;
+  }
+  std_msgs::msg::String msg{};
+  msg.data = latency.dump();
+  _stream_latency_publisher->publish(msg);
+}
+
+void DepthAIGStreamer::CameraBootState(const std_msgs::msg::String::SharedPtr msg)
+{
+  nlohmann::json state{};
+  try {
+    state = nlohmann::json::parse(msg->data.c_str());
+  } catch (...) {
+    RCLCPP_ERROR(get_logger(), "Error while parsing JSON string from camera boot state");
+    return;
+  }
+  if (!state["Rebooting"].is_boolean()) {
+    return;
+  }
+  _stream_state->Post(
+    state["Rebooting"].get<bool>() ? StreamEvent::CameraRebooting : StreamEvent::CameraRebooted);
+}
+
+void DepthAIGStreamer::PublishBitrateTarget()
+{
+  // Without a stream there is no link to measure, the last target stays.
+  if (!_impl->IsStreamPlaying()) {
+    return;
+  }
+  const int target = _impl->UpdateTargetBitrate();
+  const CongestionSample congestion = _impl->GetCongestion();
+
+  nlohmann::json bitrate{};
+  bitrate["TargetBitrate"] = target;
+  bitrate["FractionLost"] = congestion.fractionLost;
+  bitrate["RoundTripMs"] = congestion.roundTripMs;
+  bitrate["SinkQueueFill"] = congestion.sinkQueueFill;
+  bitrate["QueueFill"] = congestion.queueFill;
+  bitrate["DroppedFrames"] = congestion.droppedFrames;
+
+  std_msgs::msg::String msg{};
+  msg.data = bitrate.dump();
+  _bitrate_target_publisher->publish(msg);
+}
+
+void DepthAIGStreamer::PublishStreamStats()
+{
+  const rclcpp::Time now = get_clock()->now();
+  const double elapsed = (now - _last_stats_time).seconds();
+  if (elapsed <= 0.0) {
+    return;
+  }
+  const uint64_t bytes_pushed = _impl->GetBytesPushed();
+  const uint64_t bytes_copied = _impl->GetBytesCopied();
+
+  nlohmann::json stats{};
+  stats["BytesPushedPerSec"] = (uint64_t)((bytes_pushed - _last_bytes_pushed) / elapsed);
+  stats["BytesCopiedPerSec"] = (uint64_t)((bytes_copied - _last_bytes_copied) / elapsed);
+  stats["ZeroCopy"] = _impl->IsZeroCopy();
+  stats["QueueFrames"] = _impl->GetQueueSize();
+  stats["QueueBytes"] = _impl->GetQueueBytes();
+  stats["QueueHighWaterFrames"] = _impl->GetQueueHighWaterFrames();
+  stats["QueueHighWaterBytes"] = _impl->GetQueueHighWaterBytes();
+  stats["QueueDroppedFrames"] = _impl->GetQueueDroppedFrames();
+  stats["NonReferenceDroppedFrames"] = _impl->GetNonReferenceDroppedFrames();
+  stats["SkippedGops"] = _impl->GetSkippedGops();
+  stats["TimeToFirstDecodableFrameMs"] = _impl->GetTimeToFirstDecodableFrameMs();
+  stats["TimeToFirstPacketMs"] = _impl->GetTimeToFirstPacketMs();
+  stats["StreamSwitches"] = _impl->GetStreamSwitches();
+  stats["LastSwitchLatencyMs"] = _impl->GetLastSwitchLatencyMs();
+  stats["Destinations"] = _impl->GetDestinations();
+  stats["DestinationErrors"] = _impl->GetDestinationErrors();
+  if (_impl->IsRtspServerEnabled()) {
+    nlohmann::json clients = nlohmann::json::array();
+    for (const auto & client : _impl->GetRtspClientStats()) {
+      nlohmann::json entry;
+      entry["Address"] = client.address;
+      entry["ConnectedMs"] = client.connectedMs;
+      if (client.haveReceiverReport) {
+        entry["PacketsLost"] = client.packetsLost;
+        entry["FractionLost"] = client.fractionLost;
+        entry["JitterMs"] = client.jitterMs;
+        entry["RoundTripMs"] = client.roundTripMs;
       }
+      clients.push_back(entry);
     }
-  } else {
-    RCLCPP_INFO(get_logger(), "DepthAI GStreamer: Waiting for start command.");
+    stats["RtspServerUrl"] = _impl->GetRtspServerUrl();
+    stats["RtspServerBuffers"] = _impl->GetRtspServerBuffers();
+    stats["RtspClients"] = clients;
+  }
+  if (_impl->IsRecordingEnabled()) {
+    stats["RecordingSegment"] = _impl->GetRecordingSegment();
+    stats["RecordedSegments"] = _impl->GetRecordedSegments();
+    stats["RecordingOverruns"] = _impl->GetRecordingOverruns();
+  }
+  stats["DestinationOverruns"] = _impl->GetDestinationOverruns();
+  if (_impl->IsAdaptiveBitrate()) {
+    stats["TargetBitrate"] = _impl->GetTargetBitrate();
+    stats["BitrateDecreases"] = _impl->GetBitrateDecreases();
+    stats["BitrateIncreases"] = _impl->GetBitrateIncreases();
+  }
+  stats["PushMode"] = _impl->IsPushMode();
+  stats["BufferListPushes"] = _impl->GetBufferListPushes();
+  _impl->ResetQueueHighWaterMarks();
+
+  _last_bytes_pushed = bytes_pushed;
+  _last_bytes_copied = bytes_copied;
+  _last_stats_time = now;
+
+  std_msgs::msg::String msg{};
+  msg.data = stats.dump();
+  _stream_stats_publisher->publish(msg);
+
+  if (_impl->IsLatencyTracing()) {
+    PublishLatencyStats();
   }
 }
 
@@ -212,6 +609,12 @@ void DepthAIGStreamer::VideoStreamCommand(const std_msgs::msg::String::SharedPtr
       command.begin(), command.end(), command.begin(),
       [](unsigned char c) {return std::tolower(c);});
     if (command == "start") {
+      // The camera restarts at this bitrate, the target starts over from it.
+      if (_impl->IsAdaptiveBitrate() && cmd["Bitrate"].is_number_integer()) {
+        const int bitrate = cmd["Bitrate"];
+        _impl->SetAdaptiveBitrateRange(
+          std::min(bitrate, (int)get_parameter("adaptive_bitrate_min").as_int()), bitrate);
+      }
       if (!_impl->IsStreamPlaying()) {
         if (!cmd["Address"].empty()) {
           std::string res{};
@@ -233,30 +636,33 @@ void DepthAIGStreamer::VideoStreamCommand(const std_msgs::msg::String::SharedPtr
         }
 
         RCLCPP_INFO(this->get_logger(), "Start video streaming.");
-        _is_stop_requested = false;
-        RCLCPP_INFO(this->get_logger(), "Resetting timer.");
-        _handle_stream_status_timer->reset();
-        RCLCPP_INFO(this->get_logger(), "Resetted timer.");
-        g_mutex_lock(&_impl->haveDataCondMutex);
         RCLCPP_INFO(get_logger(), "DepthAI GStreamer: Clearing queue for start");
-        std::queue<CompressedImageMsg::SharedPtr>().swap(_impl->queue);
-        g_mutex_unlock(&_impl->haveDataCondMutex);
-        _impl->StartStream();
+        _impl->ClearQueue();
+        _stream_state->Post(StreamEvent::StartRequested);
         return;
       }
       RCLCPP_INFO(this->get_logger(), "Video stream already running.");
     } else if (command == "stop") {
-      if (_impl->IsStreamPlaying()) {
-        RCLCPP_INFO(this->get_logger(), "Stop video streaming.");
-        _is_stop_requested = true;
-        RCLCPP_INFO(this->get_logger(), "Resetting timer.");
-        _handle_stream_status_timer->reset();
-        RCLCPP_INFO(this->get_logger(), "Resetted timer.");
-        _impl->StopStream();
-
-
-      } else {
-        RCLCPP_INFO(this->get_logger(), "Video stream already stopped.");
+      // Also stops a stream waiting for its next restart attempt.
+      RCLCPP_INFO(this->get_logger(), "Stop video streaming.");
+      _stream_state->Post(StreamEvent::StopRequested);
+    } else if (command == "add_destination" || command == "remove_destination") {
+      if (cmd["Address"].empty()) {
+        RCLCPP_WARN(this->get_logger(), "Address is missing from %s command", command.c_str());
+        return;
+      }
+      const std::string address = cmd["Address"];
+      if (command == "add_destination") {
+        std::string res{};
+        if (!DepthAIUtils::ValidateAddressParameters(address, res)) {
+          RCLCPP_WARN(this->get_logger(), res.c_str());
+          return;
+        }
+        if (!_impl->AddDestination(address)) {
+          RCLCPP_INFO(this->get_logger(), "Destination already streamed: %s", address.c_str());
+        }
+      } else if (!_impl->RemoveDestination(address)) {
+        RCLCPP_INFO(this->get_logger(), "Unknown destination: %s", address.c_str());
       }
     } else {
       RCLCPP_INFO(this->get_logger(), "Unknown command: %s", command.c_str());
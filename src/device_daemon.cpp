@@ -0,0 +1,247 @@
+#include "device_daemon.h"
+#include <algorithm>
+#include <cstdio>
+
+using namespace depthai_ctrl;
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+namespace
+{
+int64_t ToNs(const std::chrono::time_point<steady_clock, steady_clock::duration> & stamp)
+{
+  return duration_cast<nanoseconds>(stamp.time_since_epoch()).count();
+}
+}  // namespace
+
+DeviceDaemon::DeviceDaemon()
+: Node("depthai_device_daemon"),
+  _shmSlots(16),
+  _useUSB3(false),
+  _bootPending(true),
+  _boots(0),
+  _framesWritten(0)
+{
+  Initialize();
+}
+
+DeviceDaemon::DeviceDaemon(const rclcpp::NodeOptions & options)
+: Node("depthai_device_daemon", options),
+  _shmSlots(16),
+  _useUSB3(false),
+  _bootPending(true),
+  _boots(0),
+  _framesWritten(0)
+{
+  Initialize();
+}
+
+DeviceDaemon::~DeviceDaemon()
+{
+  if (_pollTimer) {
+    _pollTimer->cancel();
+  }
+  if (_housekeepingTimer) {
+    _housekeepingTimer->cancel();
+  }
+  // Stop the callbacks before the rings go, the clients see the rings closed.
+  if (_device) {
+    _device->Close();
+  }
+  _rings.clear();
+}
+
+void DeviceDaemon::Initialize()
+{
+  // Prefix of the shared memory objects, the clients use the same "shm_name"
+  declare_parameter<std::string>("shm_name", "depthai_ctrl");
+  // Frames of each ring, a client which falls behind by more skips to the oldest one
+  declare_parameter<int>("shm_slots", 16);
+  declare_parameter<bool>("use_usb_three", false);
+  // Configuration the device boots with, until a client posts its own
+  declare_parameter<int>("width", 1280);
+  declare_parameter<int>("height", 720);
+  declare_parameter<int>("fps", 25);
+  declare_parameter<int>("bitrate", 3000000);
+  declare_parameter<std::string>("encoding", "H264");
+  declare_parameter<bool>("use_mono_cams", false);
+  declare_parameter<bool>("use_raw_color_cam", false);
+  declare_parameter<bool>("use_stereo_depth", false);
+
+  _shmName = get_parameter("shm_name").as_string();
+  _shmSlots = (uint32_t)std::max<int64_t>(2, get_parameter("shm_slots").as_int());
+  _useUSB3 = get_parameter("use_usb_three").as_bool();
+  _config.width = get_parameter("width").as_int();
+  _config.height = get_parameter("height").as_int();
+  _config.fps = get_parameter("fps").as_int();
+  _config.bitrate = get_parameter("bitrate").as_int();
+  _config.h265 = (get_parameter("encoding").as_string() == "H265");
+  _config.useMonoCams = get_parameter("use_mono_cams").as_bool();
+  _config.useRawColorCam = get_parameter("use_raw_color_cam").as_bool();
+  _config.useStereoDepth = get_parameter("use_stereo_depth").as_bool();
+
+  _control = ShmDeviceControl::Create(shm::ObjectName(_shmName, "control"));
+  if (!_control) {
+    RCLCPP_ERROR(
+      get_logger(), "Cannot create the shared memory control block of %s", _shmName.c_str());
+    return;
+  }
+  _device = std::make_unique<DeviceFrameSource>(get_logger());
+  _nextBoot = steady_clock::now();
+
+  // Picks up the configuration of a starting client within a frame.
+  _pollTimer = create_wall_timer(milliseconds(20), std::bind(&DeviceDaemon::Poll, this));
+  _housekeepingTimer = create_wall_timer(
+    std::chrono::seconds(1), std::bind(&DeviceDaemon::Housekeeping, this));
+}
+
+uint32_t DeviceDaemon::GetSlotBytes(const std::string & stream, const CameraConfig & config)
+{
+  if (stream == "color") {
+    return (uint32_t)(config.width * config.height * 3);
+  }
+  if (stream == "depth") {
+    return 1280 * 720 * 2;
+  }
+  if (stream == "left" || stream == "right") {
+    return 1280 * 720;
+  }
+  // An encoded frame is far smaller than the raw one, even a key frame at a high bitrate.
+  return (uint32_t)(config.width * config.height);
+}
+
+void DeviceDaemon::Poll()
+{
+  CameraConfig requested = _config;
+  if (_control->TakeConfig(requested)) {
+    const ReconfigureKind kind = ClassifyReconfigure(_pipelineConfig, _config, requested);
+    _config = requested;
+    if (kind == ReconfigureKind::Reboot) {
+      _bootPending = true;
+    } else if (kind == ReconfigureKind::Control && _device->IsRunning()) {
+      _device->SendColorCameraControl(CreateCameraControl(_config));
+    }
+    // Host changes are for the client, the rings of the running pipeline stay.
+    RCLCPP_INFO(
+      get_logger(), "Configuration posted, applied by %s", ReconfigureKindName(kind));
+  }
+  if (_boots > 0 && !_bootPending && !_device->IsRunning()) {
+    RCLCPP_WARN(get_logger(), "Device lost, booting again");
+    _bootPending = true;
+  }
+  if (!_bootPending || steady_clock::now() < _nextBoot) {
+    return;
+  }
+  _bootPending = !Boot(_config);
+  if (_bootPending) {
+    _nextBoot = steady_clock::now() + std::chrono::seconds(1);
+  }
+  Housekeeping();
+}
+
+bool DeviceDaemon::Boot(const CameraConfig & config)
+{
+  _device->Close();
+  _pipelineConfig = config;
+  _pipeline = CreateDevicePipeline(config);
+
+  const std::vector<std::string> streams = GetDevicePipelineStreams(config);
+  for (auto it = _rings.begin(); it != _rings.end(); ) {
+    if (std::find(streams.begin(), streams.end(), it->first) == streams.end()) {
+      it = _rings.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (const std::string & stream : streams) {
+    const uint32_t slotBytes = GetSlotBytes(stream, config);
+    std::unique_ptr<ShmFrameRing> & ring = _rings[stream];
+    if (!ring || ring->GetSlotBytes() < slotBytes) {
+      // The old ring unlinks its name, it has to go before the new one is created.
+      // Its clients see it closed and attach to the new one.
+      ring.reset();
+      ring = ShmFrameRing::Create(shm::ObjectName(_shmName, stream), _shmSlots, slotBytes);
+      if (!ring) {
+        RCLCPP_ERROR(get_logger(), "Cannot create the shared memory ring of %s", stream.c_str());
+        continue;
+      }
+    }
+    ShmFrameRing * target = ring.get();
+    // Clients apply their own queue policies when they read the rings.
+    StreamQueueConfig queue;
+    queue.policy = stream == "enc26xColor" ? QueuePolicy::Blocking : QueuePolicy::Bounded;
+    queue.depth = stream == "depth" ? 8 : 30;
+    _device->AddCallback(
+      stream, queue,
+      [this, target](std::vector<std::shared_ptr<dai::ImgFrame>> & frames) {
+        WriteFrames(*target, frames);
+      });
+  }
+
+  _boots++;
+  _haveIntrinsics = false;
+  const auto start = steady_clock::now();
+  if (!_device->Open(*_pipeline, !_useUSB3)) {
+    RCLCPP_ERROR(get_logger(), "Cannot open the device, trying again in a second");
+    return false;
+  }
+  _device->SendColorCameraControl(CreateCameraControl(config));
+  // The calibration is read over XLink, once per boot.
+  const std::vector<std::vector<float>> intrinsics =
+    _device->GetCameraIntrinsics(dai::CameraBoardSocket::RIGHT, 1280, 720);
+  if (intrinsics.size() == 3 && intrinsics[0].size() == 3 && intrinsics[1].size() == 3 &&
+    intrinsics[2].size() == 3)
+  {
+    _haveIntrinsics = true;
+    for (int i = 0; i < 9; i++) {
+      _rightIntrinsics[i] = intrinsics[i / 3][i % 3];
+    }
+  }
+  RCLCPP_INFO(
+    get_logger(), "Device booted in %ld ms, %dx%d at %d FPS: %s",
+    (long)duration_cast<milliseconds>(steady_clock::now() - start).count(),
+    config.width, config.height, config.fps, _device->GetConnection().c_str());
+  return true;
+}
+
+void DeviceDaemon::Housekeeping()
+{
+  int reclaimed = 0;
+  for (auto & entry : _rings) {
+    if (entry.second) {
+      reclaimed += entry.second->ReclaimDeadClients();
+    }
+  }
+  if (reclaimed > 0) {
+    RCLCPP_INFO(get_logger(), "Released the slots of %d clients which are gone", reclaimed);
+  }
+
+  ShmDeviceState state;
+  state.running = _device->IsRunning();
+  std::snprintf(state.connection, sizeof(state.connection), "%s", _device->GetConnection().c_str());
+  state.haveIntrinsics = _haveIntrinsics;
+  std::copy(_rightIntrinsics, _rightIntrinsics + 9, state.rightIntrinsics);
+  _control->SetState(state);
+}
+
+void DeviceDaemon::WriteFrames(
+  ShmFrameRing & ring,
+  std::vector<std::shared_ptr<dai::ImgFrame>> & frames)
+{
+  for (const std::shared_ptr<dai::ImgFrame> & frame : frames) {
+    ShmFrameInfo info;
+    info.type = (uint32_t)frame->getType();
+    info.width = frame->getWidth();
+    info.height = frame->getHeight();
+    info.size = (uint32_t)frame->getData().size();
+    info.sequenceNum = frame->getSequenceNum();
+    info.timestampNs = ToNs(frame->getTimestamp());
+    info.timestampDeviceNs = ToNs(frame->getTimestampDevice());
+    if (ring.Write(info, frame->getData().data())) {
+      _framesWritten++;
+    }
+  }
+}
@@ -0,0 +1,21 @@
+#include "device_daemon.h"
+#include <rclcpp/rclcpp.hpp>
+#include <iostream>
+
+using namespace depthai_ctrl;
+
+
+int main(int argc, char * argv[])
+{
+    rclcpp::init(argc, argv);
+
+    std::cout << "DepthAI Device Daemon." << std::endl;
+    rclcpp::executors::SingleThreadedExecutor exec;
+    auto daemonNode = std::make_shared<DeviceDaemon>();
+    exec.add_node(daemonNode);
+    exec.spin();
+
+    rclcpp::shutdown();
+
+    return 0;
+}
@@ -0,0 +1,653 @@
+#include "frame_source.h"
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#include <depthai/pipeline/node/ColorCamera.hpp>
+#include <depthai/pipeline/node/MonoCamera.hpp>
+#include <depthai/pipeline/node/StereoDepth.hpp>
+#include <depthai/pipeline/node/VideoEncoder.hpp>
+#include <depthai/pipeline/node/XLinkIn.hpp>
+#include <depthai/pipeline/node/XLinkOut.hpp>
+#pragma GCC diagnostic pop
+#include <algorithm>
+#include <chrono>
+
+using namespace depthai_ctrl;
+
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+namespace
+{
+int64_t ToNs(const std::chrono::time_point<steady_clock, steady_clock::duration> & stamp)
+{
+  return duration_cast<nanoseconds>(stamp.time_since_epoch()).count();
+}
+
+std::chrono::time_point<steady_clock, steady_clock::duration> FromNs(int64_t stampNs)
+{
+  return std::chrono::time_point<steady_clock, steady_clock::duration>(
+    duration_cast<steady_clock::duration>(nanoseconds(stampNs)));
+}
+
+std::shared_ptr<dai::ImgFrame> CreateFrame(const ShmFrameRing::Ref & ref)
+{
+  const ShmFrameInfo & info = ref.Info();
+  auto frame = std::make_shared<dai::ImgFrame>();
+  frame->setType((dai::RawImgFrame::Type)info.type);
+  frame->setWidth(info.width);
+  frame->setHeight(info.height);
+  frame->setSequenceNum(info.sequenceNum);
+  // The steady clock is the same in every process of the host.
+  frame->setTimestamp(FromNs(info.timestampNs));
+  frame->setTimestampDevice(FromNs(info.timestampDeviceNs));
+  // The frame owns its data, this is the one copy out of the shared memory.
+  frame->getData().assign(ref.Data(), ref.Data() + info.size);
+  return frame;
+}
+}  // namespace
+
+std::shared_ptr<dai::Pipeline> depthai_ctrl::CreateDevicePipeline(const CameraConfig & config)
+{
+  using Profile = dai::VideoEncoderProperties::Profile;
+  auto pipeline = std::make_shared<dai::Pipeline>();
+
+  // Using mono cameras adds additional CPU consumption, therefore it is disabled by default
+  if (config.useMonoCams || config.useStereoDepth) {
+    auto monoLeft = pipeline->create<dai::node::MonoCamera>();
+    auto monoRight = pipeline->create<dai::node::MonoCamera>();
+    // Setup Grayscale Cameras
+    monoLeft->setResolution(dai::MonoCameraProperties::SensorResolution::THE_720_P);
+    monoLeft->setBoardSocket(dai::CameraBoardSocket::LEFT);
+    monoRight->setResolution(dai::MonoCameraProperties::SensorResolution::THE_720_P);
+    monoRight->setBoardSocket(dai::CameraBoardSocket::RIGHT);
+    if (config.useMonoCams) {
+      auto xoutLeft = pipeline->create<dai::node::XLinkOut>();
+      auto xoutRight = pipeline->create<dai::node::XLinkOut>();
+      monoLeft->out.link(xoutLeft->input);
+      monoRight->out.link(xoutRight->input);
+      xoutLeft->setStreamName("left");
+      xoutRight->setStreamName("right");
+    }
+    // Stereo matching on the device, only the depth image crosses the link.
+    if (config.useStereoDepth) {
+      auto stereo = pipeline->create<dai::node::StereoDepth>();
+      auto xoutDepth = pipeline->create<dai::node::XLinkOut>();
+      stereo->setDefaultProfilePreset(dai::node::StereoDepth::PresetMode::HIGH_DENSITY);
+      stereo->setLeftRightCheck(true);
+      monoLeft->out.link(stereo->left);
+      monoRight->out.link(stereo->right);
+      stereo->depth.link(xoutDepth->input);
+      xoutDepth->setStreamName("depth");
+    }
+  }
+  auto colorCamera = pipeline->create<dai::node::ColorCamera>();
+  auto videoEncoder = pipeline->create<dai::node::VideoEncoder>();
+
+  auto xoutVideo = pipeline->create<dai::node::XLinkOut>();
+  xoutVideo->setStreamName("enc26xColor");
+  // Setup Color Camera
+  colorCamera->setBoardSocket(dai::CameraBoardSocket::RGB);
+  colorCamera->setResolution(dai::ColorCameraProperties::SensorResolution::THE_1080_P);
+
+  // Preview resolution cannot be larger than Video's, thus resolution color camera image is limited
+  colorCamera->setPreviewSize(config.width, config.height);
+  colorCamera->setVideoSize(config.width, config.height);
+  colorCamera->setFps(config.fps);
+
+  // Like mono cameras, color camera is disabled by default to reduce computational load.
+  if (config.useRawColorCam) {
+    auto xoutColor = pipeline->create<dai::node::XLinkOut>();
+    xoutColor->setStreamName("color");
+    colorCamera->preview.link(xoutColor->input);
+  }
+
+  Profile encoding = config.h265 ? Profile::H265_MAIN : Profile::H264_MAIN;
+  videoEncoder->setDefaultProfilePreset(config.width, config.height, config.fps, encoding);
+  videoEncoder->setBitrate(config.bitrate);
+
+  colorCamera->video.link(videoEncoder->input);
+  videoEncoder->bitstream.link(xoutVideo->input);
+  auto xinColor = pipeline->create<dai::node::XLinkIn>();
+  xinColor->setStreamName("colorCamCtrl");
+
+  xinColor->out.link(colorCamera->inputControl);
+  return pipeline;
+}
+
+std::vector<std::string> depthai_ctrl::GetDevicePipelineStreams(const CameraConfig & config)
+{
+  std::vector<std::string> streams{"enc26xColor"};
+  if (config.useRawColorCam) {
+    streams.push_back("color");
+  }
+  if (config.useMonoCams) {
+    streams.push_back("left");
+    streams.push_back("right");
+  }
+  if (config.useStereoDepth) {
+    streams.push_back("depth");
+  }
+  return streams;
+}
+
+dai::CameraControl depthai_ctrl::CreateCameraControl(const CameraConfig & config)
+{
+  dai::CameraControl colorCamCtrl;
+  if (config.autoFocus) {
+    colorCamCtrl.setAutoFocusMode(dai::RawCameraControl::AutoFocusMode::CONTINUOUS_VIDEO);
+  } else {
+    colorCamCtrl.setAutoFocusMode(dai::RawCameraControl::AutoFocusMode::OFF);
+    colorCamCtrl.setManualFocus(config.lensPosition);
+  }
+  if (config.exposureUs > 0) {
+    colorCamCtrl.setManualExposure(config.exposureUs, config.iso > 0 ? config.iso : 100);
+  } else {
+    colorCamCtrl.setAutoExposureEnable();
+  }
+  // The regions are in sensor pixels, the whole 1080p image when no region is set.
+  const CameraRegion region = config.region.IsSet() ? config.region : CameraRegion{0, 0, 1920, 1080};
+  colorCamCtrl.setAutoFocusRegion(region.x, region.y, region.width, region.height);
+  colorCamCtrl.setAutoExposureRegion(region.x, region.y, region.width, region.height);
+  return colorCamCtrl;
+}
+
+DeviceFrameSource::DeviceFrameSource(rclcpp::Logger logger, const std::string & recordPath)
+: _logger(logger),
+  _recordPath(recordPath),
+  _running(false)
+{
+}
+
+DeviceFrameSource::~DeviceFrameSource()
+{
+  Close();
+}
+
+bool DeviceFrameSource::Open(const dai::Pipeline & pipeline, bool usb2Mode)
+{
+  StopReading();
+  if (_device) {
+    _device->close();
+    _outputQueues.clear();
+    _colorCamInputQueue.reset();
+    _device.reset();
+  }
+  for (int i = 0; i < 5 && !_device; i++) {
+    try {
+      _device = std::make_shared<dai::Device>(pipeline, usb2Mode);
+    } catch (const std::runtime_error & err) {
+      RCLCPP_ERROR(_logger, "Cannot start DepthAI camera: %s", err.what());
+      _device.reset();
+    }
+  }
+  if (!_device) {
+    return false;
+  }
+  if (!_recordPath.empty() && !_recorder.IsOpen()) {
+    if (_recorder.Open(_recordPath)) {
+      RCLCPP_INFO(_logger, "Recording device frames to %s", _recordPath.c_str());
+    } else {
+      RCLCPP_ERROR(_logger, "Cannot open recording file %s", _recordPath.c_str());
+    }
+  }
+
+  _colorCamInputQueue = _device->getInputQueue("colorCamCtrl");
+  _running = true;
+  for (auto & entry : _callbacks) {
+    const std::string & stream = entry.first;
+    const StreamQueueConfig & config = entry.second.queue;
+    auto queue = _device->getOutputQueue(stream, config.MaxSize(), config.IsBlocking());
+    _outputQueues[stream] = queue;
+    // A reader thread per queue, a callback on the XLink thread would only see one frame.
+    _threads.emplace_back(
+      &DeviceFrameSource::ReadThread, this, stream, queue,
+      _queueMonitors.Get(stream, config), entry.second.callback);
+  }
+  return true;
+}
+
+void DeviceFrameSource::Close()
+{
+  StopReading();
+  if (_device) {
+    _device->close();
+  }
+  _outputQueues.clear();
+  _colorCamInputQueue.reset();
+  _device.reset();
+  _callbacks.clear();
+  _recorder.Close();
+}
+
+bool DeviceFrameSource::IsRunning() const
+{
+  return bool(_device) && !_device->isClosed();
+}
+
+void DeviceFrameSource::AddCallback(
+  const std::string & stream, const StreamQueueConfig & queue,
+  FramesCallback callback)
+{
+  _callbacks[stream] = StreamCallback{queue, callback};
+}
+
+void DeviceFrameSource::SendColorCameraControl(const dai::CameraControl & control)
+{
+  if (_colorCamInputQueue) {
+    _colorCamInputQueue->send(control);
+  }
+}
+
+std::string DeviceFrameSource::GetConnection() const
+{
+  if (!_device) {
+    return "Not connected";
+  }
+  switch (_device->getUsbSpeed()) {
+    case dai::UsbSpeed::UNKNOWN:
+      return "USB Unknown";
+    case dai::UsbSpeed::LOW:
+      return "USB Low";
+    case dai::UsbSpeed::FULL:
+      return "USB Full";
+    case dai::UsbSpeed::HIGH:
+      return "USB High";
+    case dai::UsbSpeed::SUPER:
+      return "USB Super";
+    case dai::UsbSpeed::SUPER_PLUS:
+      return "USB SuperPlus";
+    default:
+      return "USB Not valid";
+  }
+}
+
+std::map<std::string, QueueStats> DeviceFrameSource::GetQueueStats() const
+{
+  return _queueMonitors.GetStats();
+}
+
+std::vector<std::vector<float>> DeviceFrameSource::GetCameraIntrinsics(
+  dai::CameraBoardSocket socket, int width, int height) const
+{
+  if (!_device) {
+    return {};
+  }
+  try {
+    return _device->readCalibration().getCameraIntrinsics(socket, width, height);
+  } catch (const std::runtime_error & err) {
+    RCLCPP_ERROR(_logger, "Cannot read the camera calibration: %s", err.what());
+    return {};
+  }
+}
+
+void DeviceFrameSource::ReadThread(
+  const std::string & stream, std::shared_ptr<dai::DataOutputQueue> queue,
+  std::shared_ptr<QueueMonitor> monitor, FramesCallback callback)
+{
+  std::vector<std::shared_ptr<dai::ImgFrame>> frames;
+  while (_running) {
+    try {
+      // The timeout lets the thread see a Close.
+      if (!ReadQueueBatch(*queue, std::chrono::milliseconds(100), frames)) {
+        continue;
+      }
+    } catch (const std::runtime_error & err) {
+      // The queue is closed with the device, the watchdog notices a device which closed.
+      RCLCPP_ERROR(_logger, "Reading the %s queue stopped: %s", stream.c_str(), err.what());
+      return;
+    }
+    Record(stream, frames);
+    monitor->Apply(frames);
+    if (!frames.empty() && _running) {
+      callback(frames);
+    }
+  }
+}
+
+void DeviceFrameSource::StopReading()
+{
+  _running = false;
+  for (std::thread & thread : _threads) {
+    thread.join();
+  }
+  _threads.clear();
+}
+
+void DeviceFrameSource::Record(
+  const std::string & stream,
+  std::vector<std::shared_ptr<dai::ImgFrame>> & frames)
+{
+  if (!_recorder.IsOpen()) {
+    return;
+  }
+  RecordedFrame record;
+  record.stream = stream;
+  for (std::shared_ptr<dai::ImgFrame> & frame : frames) {
+    record.type = (uint32_t)frame->getType();
+    record.width = frame->getWidth();
+    record.height = frame->getHeight();
+    record.sequenceNum = frame->getSequenceNum();
+    record.timestampNs = ToNs(frame->getTimestamp());
+    record.timestampDeviceNs = ToNs(frame->getTimestampDevice());
+    // Borrow the frame data for the write instead of copying it.
+    record.data.swap(frame->getData());
+    const bool written = _recorder.Write(record);
+    record.data.swap(frame->getData());
+    if (!written) {
+      RCLCPP_ERROR(_logger, "Writing to recording %s failed, recording stopped", _recordPath.c_str());
+      _recorder.Close();
+      break;
+    }
+  }
+}
+
+ReplayFrameSource::ReplayFrameSource(
+  rclcpp::Logger logger, const std::string & path, bool realtime,
+  bool loop)
+: _logger(logger),
+  _path(path),
+  _realtime(realtime),
+  _loop(loop),
+  _running(false),
+  _frames(0)
+{
+}
+
+ReplayFrameSource::~ReplayFrameSource()
+{
+  Close();
+}
+
+bool ReplayFrameSource::Open(const dai::Pipeline & pipeline, bool usb2Mode)
+{
+  // The recording defines the streams, the device pipeline has no use here.
+  (void)pipeline;
+  (void)usb2Mode;
+  if (_thread.joinable()) {
+    _running = false;
+    _thread.join();
+  }
+  if (!_reader.Open(_path)) {
+    RCLCPP_ERROR(_logger, "Cannot open recording %s", _path.c_str());
+    return false;
+  }
+  _frames = 0;
+  _running = true;
+  _thread = std::thread(&ReplayFrameSource::ReplayThread, this);
+  return true;
+}
+
+void ReplayFrameSource::Close()
+{
+  _running = false;
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+  _reader.Close();
+  _callbacks.clear();
+}
+
+bool ReplayFrameSource::IsRunning() const
+{
+  return _running;
+}
+
+void ReplayFrameSource::AddCallback(
+  const std::string & stream, const StreamQueueConfig & queue,
+  FramesCallback callback)
+{
+  // Frames are handed to the callback directly, there is no queue to drop from.
+  (void)queue;
+  _callbacks[stream] = callback;
+}
+
+void ReplayFrameSource::SendColorCameraControl(const dai::CameraControl & control)
+{
+  (void)control;
+}
+
+std::string ReplayFrameSource::GetConnection() const
+{
+  return std::string("Replay of ") + _path + (_realtime ? " (real-time)" : " (max speed)");
+}
+
+std::shared_ptr<dai::ImgFrame> ReplayFrameSource::CreateFrame(
+  RecordedFrame & record, int64_t deviceOffsetNs,
+  int64_t hostOffsetNs, int64_t sequenceOffset)
+{
+  auto frame = std::make_shared<dai::ImgFrame>();
+  frame->setType((dai::RawImgFrame::Type)record.type);
+  frame->setWidth(record.width);
+  frame->setHeight(record.height);
+  frame->setSequenceNum(record.sequenceNum + sequenceOffset);
+  frame->setTimestamp(FromNs(record.timestampNs + hostOffsetNs));
+  frame->setTimestampDevice(FromNs(record.timestampDeviceNs + deviceOffsetNs));
+  frame->getData().swap(record.data);
+  return frame;
+}
+
+void ReplayFrameSource::ReplayThread()
+{
+  RecordedFrame record;
+  std::vector<std::shared_ptr<dai::ImgFrame>> frames;
+  const int64_t startNs = ToNs(steady_clock::now());
+
+  // Bounds of the recording, known after the first pass
+  bool first = true;
+  int64_t firstDeviceNs = 0, lastDeviceNs = 0, firstHostNs = 0;
+  int64_t firstSequence = 0, lastSequence = 0;
+  std::map<std::string, int64_t> streamFrames;
+  // Shift of the current pass, so that a loop continues the timeline
+  int64_t deviceOffsetNs = 0, sequenceOffset = 0;
+
+  while (_running) {
+    if (!_reader.Read(record)) {
+      if (!_loop || first || !_reader.Rewind()) {
+        break;
+      }
+      // The next pass starts one frame interval of the fastest stream after the last frame.
+      int64_t maxFrames = 1;
+      for (const auto & entry : streamFrames) {
+        maxFrames = std::max(maxFrames, entry.second);
+      }
+      const int64_t span = lastDeviceNs - firstDeviceNs;
+      deviceOffsetNs += span + (maxFrames > 1 ? span / (maxFrames - 1) : 1000000);
+      sequenceOffset += lastSequence - firstSequence + 1;
+      streamFrames.clear();
+      continue;
+    }
+    if (first) {
+      firstDeviceNs = lastDeviceNs = record.timestampDeviceNs;
+      firstHostNs = record.timestampNs;
+      firstSequence = lastSequence = record.sequenceNum;
+      first = false;
+    }
+    firstSequence = std::min(firstSequence, record.sequenceNum);
+    lastSequence = std::max(lastSequence, record.sequenceNum);
+    lastDeviceNs = std::max(lastDeviceNs, record.timestampDeviceNs);
+    streamFrames[record.stream]++;
+
+    const int64_t elapsedNs = record.timestampDeviceNs + deviceOffsetNs - firstDeviceNs;
+    if (_realtime) {
+      // Sleep in short slices, so that Close does not wait for a long gap of the recording.
+      const auto due = steady_clock::time_point(
+        duration_cast<steady_clock::duration>(nanoseconds(startNs + elapsedNs)));
+      while (_running && steady_clock::now() < due) {
+        std::this_thread::sleep_for(
+          std::min<steady_clock::duration>(due - steady_clock::now(), std::chrono::milliseconds(50)));
+      }
+    }
+
+    auto callback = _callbacks.find(record.stream);
+    if (callback == _callbacks.end() || !_running) {
+      continue;
+    }
+    // Host stamps keep the device spacing and start from the replay start.
+    const int64_t hostOffsetNs = startNs - firstHostNs + deviceOffsetNs;
+    frames.clear();
+    frames.push_back(CreateFrame(record, deviceOffsetNs, hostOffsetNs, sequenceOffset));
+    callback->second(frames);
+    _frames++;
+  }
+  if (_running) {
+    RCLCPP_INFO(_logger, "Replay of %s finished after %lu frames", _path.c_str(), (unsigned long)_frames);
+  }
+  _running = false;
+}
+
+SharedMemoryFrameSource::SharedMemoryFrameSource(rclcpp::Logger logger, const std::string & name)
+: _logger(logger),
+  _name(name),
+  _running(false),
+  _frames(0)
+{
+}
+
+SharedMemoryFrameSource::~SharedMemoryFrameSource()
+{
+  Close();
+}
+
+bool SharedMemoryFrameSource::Open(const dai::Pipeline & pipeline, bool usb2Mode)
+{
+  // The owner builds the device pipeline from the posted configuration.
+  (void)pipeline;
+  (void)usb2Mode;
+  _running = false;
+  for (std::thread & thread : _threads) {
+    thread.join();
+  }
+  _threads.clear();
+  {
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    _control = ShmDeviceControl::Attach(shm::ObjectName(_name, "control"));
+    if (!_control) {
+      RCLCPP_ERROR(_logger, "No device owner at shared memory %s", _name.c_str());
+      return false;
+    }
+    PostConfig();
+  }
+  _frames = 0;
+  _running = true;
+  for (const auto & entry : _callbacks) {
+    _threads.emplace_back(
+      &SharedMemoryFrameSource::ReadThread, this, entry.first,
+      _queueMonitors.Get(entry.first, entry.second.queue), entry.second.callback);
+  }
+  return true;
+}
+
+void SharedMemoryFrameSource::Close()
+{
+  _running = false;
+  for (std::thread & thread : _threads) {
+    thread.join();
+  }
+  _threads.clear();
+  std::lock_guard<std::mutex> lock(_controlMutex);
+  _control.reset();
+  _callbacks.clear();
+}
+
+bool SharedMemoryFrameSource::IsRunning() const
+{
+  std::lock_guard<std::mutex> lock(_controlMutex);
+  return _running && _control && _control->IsOwnerAlive();
+}
+
+void SharedMemoryFrameSource::AddCallback(
+  const std::string & stream, const StreamQueueConfig & queue,
+  FramesCallback callback)
+{
+  // The ring of the stream is the queue, a slow client skips to the oldest frame in it.
+  // The owner cannot be held back, a blocking stream gets every frame the ring still has.
+  _callbacks[stream] = StreamCallback{queue, callback};
+}
+
+void SharedMemoryFrameSource::SendColorCameraControl(const dai::CameraControl & control)
+{
+  (void)control;
+}
+
+void SharedMemoryFrameSource::SetCameraConfig(const CameraConfig & config)
+{
+  std::lock_guard<std::mutex> lock(_controlMutex);
+  _config = config;
+  if (_control) {
+    PostConfig();
+  }
+}
+
+void SharedMemoryFrameSource::PostConfig()
+{
+  // The frames keep coming with the configuration of the other client.
+  if (!_control->PostConfig(_config)) {
+    RCLCPP_WARN(
+      _logger, "The configuration conflicts with another client of %s, the device is left as it is",
+      _name.c_str());
+  }
+}
+
+std::string SharedMemoryFrameSource::GetConnection() const
+{
+  std::lock_guard<std::mutex> lock(_controlMutex);
+  if (!_control) {
+    return "Not connected";
+  }
+  const ShmDeviceState state = _control->GetState();
+  return "Device owner " + _name + ": " + (state.running ? state.connection : "not running");
+}
+
+std::map<std::string, QueueStats> SharedMemoryFrameSource::GetQueueStats() const
+{
+  return _queueMonitors.GetStats();
+}
+
+std::vector<std::vector<float>> SharedMemoryFrameSource::GetCameraIntrinsics(
+  dai::CameraBoardSocket socket, int width, int height) const
+{
+  std::lock_guard<std::mutex> lock(_controlMutex);
+  if (!_control || socket != dai::CameraBoardSocket::RIGHT || width != 1280 || height != 720) {
+    return {};
+  }
+  const ShmDeviceState state = _control->GetState();
+  if (!state.haveIntrinsics) {
+    return {};
+  }
+  const float * m = state.rightIntrinsics;
+  return {{m[0], m[1], m[2]}, {m[3], m[4], m[5]}, {m[6], m[7], m[8]}};
+}
+
+void SharedMemoryFrameSource::ReadThread(
+  const std::string & stream, std::shared_ptr<QueueMonitor> monitor,
+  FramesCallback callback)
+{
+  const std::string name = shm::ObjectName(_name, stream);
+  std::unique_ptr<ShmFrameRing> ring;
+  ShmFrameRing::Ref ref;
+  std::vector<std::shared_ptr<dai::ImgFrame>> frames;
+  while (_running) {
+    if (!ring || ring->IsClosed()) {
+      // The owner creates the ring with a pipeline which has the stream, again after a restart.
+      ring = ShmFrameRing::Attach(name);
+      if (!ring) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        continue;
+      }
+    }
+    if (!ring->WaitForData(100)) {
+      continue;
+    }
+    frames.clear();
+    while (ring->Read(ref)) {
+      frames.push_back(CreateFrame(ref));
+      ref.Reset();
+    }
+    monitor->Apply(frames);
+    if (!frames.empty() && _running) {
+      callback(frames);
+      _frames += frames.size();
+    }
+  }
+}
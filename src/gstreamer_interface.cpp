@@ -1,4 +1,7 @@
 #include <gstreamer_interface.hpp>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 namespace depthai_ctrl
@@ -15,12 +18,13 @@ GstInterface::GstInterface(int argc, char * argv[])
   _encoderWidth(1280), _encoderHeight(720), _encoderFps(25), _encoderBitrate(3000000)
 {
   gst_init(&argc, &argv);
-  g_mutex_init(&haveDataCondMutex);
+  _queue.SetLimits((size_t)_encoderFps * 2, _queueMaxBytes);
 }
 
 GstInterface::~GstInterface()
 {
   StopStream();
+  StopRtspServer();
 }
 
 void GstInterface::StartStream(void)
@@ -32,6 +36,8 @@ void GstInterface::StartStream(void)
   _isStreamStarting = true;
   _gstTimestamp = 0;
   _gstStartTimestamp = 0;
+  _streamStartTime = std::chrono::steady_clock::now();
+  _timeToFirstDecodableFrameMs = -1;
   if (_mLoop != nullptr) {
     g_main_loop_quit(_mLoop);
     _mLoop = nullptr;
@@ -42,6 +48,7 @@ void GstInterface::StartStream(void)
   }
   _mLoopContext = g_main_context_default();
   _mLoop = g_main_loop_new(_mLoopContext, false);
+  StartRtspServer();
   std::cout << "Start stream called!" << std::endl;
   _mCreatePipelineThread = g_thread_new(
     "GstThreadCreatePipeline",
@@ -53,12 +60,19 @@ void GstInterface::StopStream(void)
   _isStreamShutdown = true;
   _isStreamStarting = false;
   _isStreamPlaying = false;
-  _isStreamDefault = false;
-  std::cout << "Broadcasting the GCond signal to unlock have-data!" << std::endl;
-  g_cond_broadcast(&haveDataCond);
+  std::cout << "Waking up the need-data callback!" << std::endl;
+  _queue.Wake();
   std::cout << "Sending end-of-stream!" << std::endl;
-  if (_appSource != nullptr) {
-    g_signal_emit_by_name(_appSource, "end-of-stream", &ret);
+  // Detach the appsrc first, so push-mode feeding stops right away. The lock must not
+  // be held while the pipeline goes to NULL, the streaming thread may be waiting for it.
+  GstElement * appSource = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(_appSourceMutex);
+    appSource = _appSource;
+    _appSource = nullptr;
+  }
+  if (appSource != nullptr) {
+    g_signal_emit_by_name(appSource, "end-of-stream", &ret);
     if (ret != GST_FLOW_OK) {
       g_printerr("Error: Emit end-of-stream failed\n");
     } else {
@@ -68,9 +82,32 @@ void GstInterface::StopStream(void)
 
   std::cout << "Disconnecting signal! Signal ID: " << _needDataSignalId << std::endl;
   if (_needDataSignalId != 0) {
-    g_signal_handler_disconnect(_appSource, _needDataSignalId);
+    g_signal_handler_disconnect(appSource, _needDataSignalId);
     _needDataSignalId = 0;
   }
+  if (_standbyWatchdogId != 0) {
+    g_source_remove(_standbyWatchdogId);
+    _standbyWatchdogId = 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_destinationsMutex);
+    for (const auto & branch : _branches) {
+      gst_object_unref(branch.teePad);
+    }
+    _branches.clear();
+    _tee = nullptr;
+    std::lock_guard<std::mutex> serverLock(_rtspServerMutex);
+    _serverSink = nullptr;
+  }
+  GstPad * defaultSelectorPad = nullptr;
+  GstPad * cameraSelectorPad = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(_selectorMutex);
+    _isStandbyPipeline = false;
+    _inputSelector = nullptr;
+    std::swap(defaultSelectorPad, _defaultSelectorPad);
+    std::swap(cameraSelectorPad, _cameraSelectorPad);
+  }
   if (_pipeline != nullptr) {
     std::cout << "Setting pipeline state to NULL!" << std::endl;
     gst_element_set_state(_pipeline, GST_STATE_NULL);
@@ -78,8 +115,20 @@ void GstInterface::StopStream(void)
     gst_object_unref(GST_OBJECT(_pipeline));
     //gst_object_unref(GST_OBJECT(_appSource));
     _pipeline = nullptr;
-    _appSource = nullptr;
-    
+    _h26xpay = nullptr;
+    _udpSink = nullptr;
+    _rtspSink = nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_bitrateMutex);
+    if (_rtspSinkManager != nullptr) {
+      gst_object_unref(_rtspSinkManager);
+      _rtspSinkManager = nullptr;
+    }
+  }
+  if (defaultSelectorPad != nullptr) {
+    gst_object_unref(defaultSelectorPad);
+    gst_object_unref(cameraSelectorPad);
   }
   std::cout << "Unreferencing bus element!" << std::endl;
   if (_bus != nullptr) {
@@ -99,11 +148,12 @@ void GstInterface::StopStream(void)
   std::cout << "Quitting main loop thread!" << std::endl;
   if (_mLoopThread != nullptr) {
     g_thread_join(_mLoopThread);
-
+    _mLoopThread = nullptr;
   }
   std::cout << "Quitting create pipeline thread!" << std::endl;
   if (_mCreatePipelineThread != nullptr) {
     g_thread_join(_mCreatePipelineThread);
+    _mCreatePipelineThread = nullptr;
   }
   std::cout << "Unreferencing main context!" << std::endl;
   if (_mLoopContext != nullptr) {
@@ -117,7 +167,6 @@ void GstInterface::BuildDefaultPipeline()
   std::cout << "Building default pipeline!" << std::endl;
   _isStreamDefault = true;
   const std::string gstFormat = (_encoderProfile == "H264") ? "video/x-h264" : "video/x-h265";
-  const bool is_udp_protocol = (_streamAddress.find("udp://") == 0);
   _pipeline = gst_pipeline_new("default_pipeline");
 
   // Video test source.
@@ -161,34 +210,6 @@ void GstInterface::BuildDefaultPipeline()
     _h26xparse = gst_element_factory_make("h264parse", "parser");
   }
 
-  _queue1 = gst_element_factory_make("queue", "queue1");
-  // Sink element. UDP or RTSP client.
-  if (is_udp_protocol) {
-    // UDP Sink
-    if (_encoderProfile == "H265") {
-      _h26xpay = gst_element_factory_make("rtph265pay", "payload");
-    } else {
-      _h26xpay = gst_element_factory_make("rtph264pay", "payload");
-    }
-    g_object_set(G_OBJECT(_h26xpay), "pt", 96, NULL);
-    _udpSink = gst_element_factory_make("udpsink", "udp_sink");
-    g_object_set(
-      G_OBJECT(_udpSink), "host", DepthAIUtils::ReadIpFromUdpAddress(
-        _streamAddress).c_str(), NULL);
-    g_object_set(
-      G_OBJECT(_udpSink), "port", DepthAIUtils::ReadPortFromUdpAddress(
-        _streamAddress), NULL);
-  } else {
-    // RTSP client sink
-    _rtspSink = gst_element_factory_make("rtspclientsink", "rtsp_sink");
-    g_object_set(
-      G_OBJECT(_rtspSink),
-      "protocols", 4,               // 4 = tcp
-      "tls-validation-flags", 0,
-      "location", _streamAddress.c_str(),
-      NULL);
-  }
-
   _h26xEncFilter = gst_element_factory_make("capsfilter", "encoder_filter");
   g_object_set(
     G_OBJECT(_h26xEncFilter), "caps",
@@ -203,116 +224,49 @@ void GstInterface::BuildDefaultPipeline()
       "subme", G_TYPE_INT, 1,
       "bitrate", G_TYPE_INT, 4000,
       NULL), NULL);
-  if (is_udp_protocol) {
-    if (_encoderProfile == "H265") {
-      gst_bin_add_many(
-        GST_BIN(
-          _pipeline), _testSrc, _testSrcFilter, _textOverlay, _videoConvert, _h26xEnc, _h26xparse, _h26xpay, _udpSink,
-        NULL);
-      gst_element_link_many(
-        _testSrc, _testSrcFilter, _textOverlay, _videoConvert, _h26xEnc,
-        _h26xparse, _h26xpay, _udpSink, NULL);
-    } else {
-      gst_bin_add_many(
-        GST_BIN(
-          _pipeline), _testSrc, _testSrcFilter, _textOverlay, _h26xEnc, _h26xEncFilter, _h26xparse, _h26xpay, _udpSink,
-        NULL);
-      gst_element_link_many(
-        _testSrc, _testSrcFilter, _textOverlay, _h26xEnc, _h26xEncFilter,
-        _h26xparse, _h26xpay, _udpSink, NULL);
-    }
+  if (_encoderProfile == "H265") {
+    gst_bin_add_many(
+      GST_BIN(
+        _pipeline), _testSrc, _testSrcFilter, _textOverlay, _videoConvert, _h26xEnc, _h26xparse,
+      NULL);
+    gst_element_link_many(
+      _testSrc, _testSrcFilter, _textOverlay, _videoConvert, _h26xEnc, _h26xparse, NULL);
   } else {
-    if (_encoderProfile == "H265") {
-      gst_bin_add_many(
-        GST_BIN(
-          _pipeline), _testSrc, _testSrcFilter, _textOverlay, _videoConvert, _h26xEnc, _h26xparse, _rtspSink,
-        NULL);
-      gst_element_link_many(
-        _testSrc, _testSrcFilter, _textOverlay, _videoConvert, _h26xEnc,
-        _h26xparse, _rtspSink, NULL);
-    } else {
-      gst_bin_add_many(
-        GST_BIN(
-          _pipeline), _testSrc, _testSrcFilter, _textOverlay, _h26xEnc, _h26xEncFilter, _h26xparse, _rtspSink,
-        NULL);
-      gst_element_link_many(
-        _testSrc, _testSrcFilter, _textOverlay, _h26xEnc, _h26xEncFilter,
-        _h26xparse, _rtspSink, NULL);
-    }
+    gst_bin_add_many(
+      GST_BIN(
+        _pipeline), _testSrc, _testSrcFilter, _textOverlay, _h26xEnc, _h26xEncFilter, _h26xparse,
+      NULL);
+    gst_element_link_many(
+      _testSrc, _testSrcFilter, _textOverlay, _h26xEnc, _h26xEncFilter, _h26xparse, NULL);
   }
+  LinkDestinations(_h26xparse);
 
   //GST_DEBUG_BIN_TO_DOT_FILE(GST_BIN(_pipeline), GST_DEBUG_GRAPH_SHOW_ALL, "pipeline_test");
 }
 
 void GstInterface::BuildPipeline()
 {
-  const bool is_udp_protocol = (_streamAddress.find("udp://") == 0);
   const std::string h26xparse = (_encoderProfile == "H264") ? "h264parse" : "h265parse";
   const std::string h26xencoder = (_encoderProfile == "H264") ? "x264enc" : "x265enc";
   const std::string gstFormat = (_encoderProfile == "H264") ? "video/x-h264" : "video/x-h265";
 
-  if (_isStreamDefault) {     // video-data is not available - use "default" video output
+  if (_hotStandby) {     // both outputs in one long-lived pipeline
+    BuildStandbyPipeline();
+    return;
+  } else if (_isStreamDefault) {     // video-data is not available - use "default" video output
     BuildDefaultPipeline();
   } else {
     std::cout << "Building camera streaming pipeline!" << std::endl;
 
     _pipeline = gst_pipeline_new("rgbCamSink_pipeline");
     // Source element.
-    _appSource = gst_element_factory_make("appsrc", "source");
-    g_object_set(
-      G_OBJECT(_appSource),
-      "do-timestamp", true,
-      "is-live", true,
-      "block", false,
-      "stream-type", 0,
-      NULL);
-    gst_util_set_object_arg(G_OBJECT(_appSource), "format", "GST_FORMAT_TIME");
+    GstElement * appSource = CreateAppSource();
     // H26x parser. Is this really needed?
     if (_encoderProfile == "H265") {
       _h26xparse = gst_element_factory_make("h265parse", "parser");
     } else {
       _h26xparse = gst_element_factory_make("h264parse", "parser");
     }
-    _queue1 = gst_element_factory_make("queue", "queue1");
-    // Sink element. UDP or RTSP client.
-    if (is_udp_protocol) {
-      // UDP Sink
-      if (_encoderProfile == "H265") {
-        _h26xpay = gst_element_factory_make("rtph265pay", "payload");
-      } else {
-        _h26xpay = gst_element_factory_make("rtph264pay", "payload");
-      }
-      g_object_set(G_OBJECT(_h26xpay), "pt", 96, NULL);
-      _udpSink = gst_element_factory_make("udpsink", "udp_sink");
-      g_object_set(
-        G_OBJECT(_udpSink), "host", DepthAIUtils::ReadIpFromUdpAddress(
-          _streamAddress).c_str(), NULL);
-      g_object_set(
-        G_OBJECT(_udpSink), "port", DepthAIUtils::ReadPortFromUdpAddress(
-          _streamAddress), NULL);
-    } else {
-      // RTSP client sink
-      _rtspSink = gst_element_factory_make("rtspclientsink", "rtsp_sink");
-      g_object_set(
-        G_OBJECT(_rtspSink),
-        "protocols", 4,             // 4 = tcp
-        "tls-validation-flags", 0,
-        "latency", 500,
-        "rtx-time", 0,
-        //"tcp-timeout", 15000000,
-        "location", _streamAddress.c_str(),
-        NULL);
-    }
-
-    g_object_set(
-      G_OBJECT(_appSource), "caps",
-      gst_caps_new_simple(
-        gstFormat.c_str(),
-        "width", G_TYPE_INT, _encoderWidth,
-        "height", G_TYPE_INT, _encoderHeight,
-        "framerate", GST_TYPE_FRACTION, _encoderFps, 1,
-        NULL), NULL);
-
     _h26xEncFilter = gst_element_factory_make("capsfilter", "encoder_filter");
     g_object_set(
       G_OBJECT(_h26xEncFilter), "caps",
@@ -321,27 +275,17 @@ void GstInterface::BuildPipeline()
         "profile", G_TYPE_STRING, "main",
         "stream-format", G_TYPE_STRING, "byte-stream",
         NULL), NULL);
-    if (is_udp_protocol) {
-      gst_bin_add_many(
-        GST_BIN(
-          _pipeline), _appSource, _h26xEncFilter, _h26xparse, _queue1, _h26xpay, _udpSink, NULL);
-      gst_element_link_many(
-        _appSource, _h26xEncFilter, _h26xparse, _queue1, _h26xpay, _udpSink,
-        NULL);
-    } else {
-      gst_bin_add_many(
-        GST_BIN(
-          _pipeline), _appSource, _h26xEncFilter, _h26xparse, _queue1, _rtspSink, NULL);
-      gst_element_link_many(_appSource, _h26xEncFilter, _h26xparse, _queue1, _rtspSink, NULL);
-    }
-    std::cout << "Connecting need-data signal! Signal ID: " << _needDataSignalId << std::endl;
-
-    _needDataSignalId =
-      g_signal_connect(_appSource, "need-data", G_CALLBACK(GstInterface::NeedDataCallBack), this);
+    gst_bin_add_many(GST_BIN(_pipeline), appSource, _h26xEncFilter, _h26xparse, NULL);
+    gst_element_link_many(appSource, _h26xEncFilter, _h26xparse, NULL);
+    LinkDestinations(_h26xparse);
+    AttachAppSource(appSource);
     //GST_DEBUG_BIN_TO_DOT_FILE(GST_BIN(_pipeline), GST_DEBUG_GRAPH_SHOW_ALL, "pipeline_camera");
-    std::cout << "Need-data signal connected! Signal ID: " << _needDataSignalId << std::endl;
-
   }
+  StartPipelineLoop();
+}
+
+void GstInterface::StartPipelineLoop()
+{
   std::cout << "Getting bus element..." << std::endl;
   _bus = gst_pipeline_get_bus(GST_PIPELINE(_pipeline));
   std::cout << "Getting bus element done. Adding bus watch..." << std::endl;
@@ -354,6 +298,1049 @@ void GstInterface::BuildPipeline()
 
 }
 
+bool GstInterface::AddDestination(const std::string & address)
+{
+  std::lock_guard<std::mutex> lock(_destinationsMutex);
+  // The RTSP server and the recording have their branches while they are enabled, a second
+  // one would clash with them.
+  if (address == _streamAddress ||
+    (IsRtspServerEnabled() && address == GetRtspServerUrl()) ||
+    (IsRecordingEnabled() && address == GetRecordingAddress()) ||
+    std::find(_destinations.begin(), _destinations.end(), address) != _destinations.end())
+  {
+    return false;
+  }
+  _destinations.push_back(address);
+  if (_tee != nullptr) {
+    AddDestinationBranch(address, false);
+  }
+  return true;
+}
+
+bool GstInterface::RemoveDestination(const std::string & address)
+{
+  std::lock_guard<std::mutex> lock(_destinationsMutex);
+  auto destination = std::find(_destinations.begin(), _destinations.end(), address);
+  if (destination == _destinations.end()) {
+    return false;
+  }
+  _destinations.erase(destination);
+  RemoveDestinationBranch(address);
+  return true;
+}
+
+std::vector<std::string> GstInterface::GetDestinations()
+{
+  std::lock_guard<std::mutex> lock(_destinationsMutex);
+  std::vector<std::string> destinations{};
+  if (!_streamAddress.empty()) {
+    destinations.push_back(_streamAddress);
+  }
+  destinations.insert(destinations.end(), _destinations.begin(), _destinations.end());
+  return destinations;
+}
+
+void GstInterface::LinkDestinations(GstElement * upstream)
+{
+  std::lock_guard<std::mutex> lock(_destinationsMutex);
+  _tee = gst_element_factory_make("tee", "destination_tee");
+  // Keep streaming while a branch is being added or removed.
+  g_object_set(G_OBJECT(_tee), "allow-not-linked", true, NULL);
+  gst_bin_add(GST_BIN(_pipeline), _tee);
+  gst_element_link(upstream, _tee);
+  if (!_streamAddress.empty()) {
+    AddDestinationBranch(_streamAddress, true);
+  }
+  for (const auto & address : _destinations) {
+    AddDestinationBranch(address, false);
+  }
+  if (_rtspServer != nullptr) {
+    AddDestinationBranch(GetRtspServerUrl(), false);
+  }
+  // The default stream is not worth the disk, the hot-standby pipeline records both inputs.
+  if (IsRecordingEnabled() && (_hotStandby || !_isStreamDefault)) {
+    AddDestinationBranch(GetRecordingAddress(), false);
+  }
+}
+
+GstElement * GstInterface::CreateDestinationBin(const std::string & address, bool primary)
+{
+  const bool is_udp_protocol = (address.find("udp://") == 0);
+  const bool is_h265 = (_encoderProfile == "H265");
+  const std::string name = "destination_" + std::to_string(_destinationCounter++);
+  GstElement * bin = gst_bin_new(name.c_str());
+
+  // A slow destination drops its oldest buffers instead of stalling the tee.
+  // Named for SampleCongestion, its fill is the backpressure of the sink.
+  GstElement * queue = gst_element_factory_make("queue", "queue");
+  g_object_set(
+    G_OBJECT(queue),
+    "leaky", 2,                   // 2 = downstream, drop old buffers
+    "max-size-buffers", 0,
+    "max-size-bytes", 0,
+    "max-size-time", (guint64)(500 * GST_MSECOND),
+    NULL);
+  g_signal_connect(queue, "overrun", G_CALLBACK(GstInterface::DestinationOverrunCallBack), this);
+  GstElement * sink = nullptr;
+  // Element feeding the network sink
+  GstElement * sink_upstream = queue;
+  if (is_udp_protocol) {
+    GstElement * pay = gst_element_factory_make(is_h265 ? "rtph265pay" : "rtph264pay", nullptr);
+    g_object_set(G_OBJECT(pay), "pt", 96, NULL);
+    sink = gst_element_factory_make("udpsink", nullptr);
+    g_object_set(
+      G_OBJECT(sink), "host", DepthAIUtils::ReadIpFromUdpAddress(address).c_str(), NULL);
+    g_object_set(G_OBJECT(sink), "port", DepthAIUtils::ReadPortFromUdpAddress(address), NULL);
+    gst_bin_add_many(GST_BIN(bin), queue, pay, sink, NULL);
+    gst_element_link_many(queue, pay, sink, NULL);
+    sink_upstream = pay;
+    if (primary) {
+      _h26xpay = pay;
+      _udpSink = sink;
+    }
+  } else {
+    sink = gst_element_factory_make("rtspclientsink", nullptr);
+    g_object_set(
+      G_OBJECT(sink),
+      "protocols", 4,             // 4 = tcp
+      "tls-validation-flags", 0,
+      "latency", 500,
+      "rtx-time", 0,
+      "location", address.c_str(),
+      NULL);
+    gst_bin_add_many(GST_BIN(bin), queue, sink, NULL);
+    gst_element_link(queue, sink);
+    if (primary) {
+      _rtspSink = sink;
+      g_signal_connect(
+        sink, "new-manager", G_CALLBACK(GstInterface::RtspSinkManagerCallBack), this);
+    }
+  }
+  if (primary && _latencyTracer.IsEnabled()) {
+    // The rtspclientsink pad is requested by the link, take it from the queue side.
+    GstPad * queueSrcPad = gst_element_get_static_pad(queue, "src");
+    GstPad * sinkPad = gst_pad_get_peer(queueSrcPad);
+    gst_pad_add_probe(
+      sinkPad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+      GstInterface::TraceSinkProbe, this, nullptr);
+    gst_object_unref(sinkPad);
+    gst_object_unref(queueSrcPad);
+  }
+  AddFirstPacketProbe(sink_upstream);
+  GstPad * queueSinkPad = gst_element_get_static_pad(queue, "sink");
+  gst_element_add_pad(bin, gst_ghost_pad_new("sink", queueSinkPad));
+  gst_object_unref(queueSinkPad);
+  return bin;
+}
+
+void GstInterface::AddFirstPacketProbe(GstElement * upstream)
+{
+  if (_timeToFirstPacketMs >= 0) {
+    return;
+  }
+  // Sink pads may be requested by the link, take the pad from the upstream side.
+  GstPad * upstreamSrcPad = gst_element_get_static_pad(upstream, "src");
+  GstPad * sinkPad = gst_pad_get_peer(upstreamSrcPad);
+  gst_pad_add_probe(
+    sinkPad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+    GstInterface::FirstPacketProbe, this, nullptr);
+  gst_object_unref(sinkPad);
+  gst_object_unref(upstreamSrcPad);
+}
+
+GstPadProbeReturn GstInterface::FirstPacketProbe(
+  GstPad * pad, GstPadProbeInfo * info,
+  gpointer data)
+{
+  (void)pad;
+  (void)info;
+  GstInterface * gst = (GstInterface *)data;
+  // Test pattern packets do not count, only the camera video.
+  if (gst->_isStreamDefault) {
+    return GST_PAD_PROBE_OK;
+  }
+  int64_t unset = -1;
+  const int64_t uptime = DepthAIUtils::GetProcessUptimeMs();
+  if (gst->_timeToFirstPacketMs.compare_exchange_strong(unset, uptime)) {
+    std::cout << "GStreamer: First camera packet sent " << uptime <<
+      " ms after the process start" << std::endl;
+  }
+  return GST_PAD_PROBE_REMOVE;
+}
+
+GstPadProbeReturn GstInterface::TraceSourceProbe(
+  GstPad * pad, GstPadProbeInfo * info,
+  gpointer data)
+{
+  (void)pad;
+  GstInterface * gst = (GstInterface *)data;
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList * list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+    for (guint i = 0; i < gst_buffer_list_length(list); i++) {
+      gst->_latencyTracer.OnSourceOutput(GST_BUFFER_PTS(gst_buffer_list_get(list, i)));
+    }
+  } else {
+    gst->_latencyTracer.OnSourceOutput(GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info)));
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn GstInterface::TraceSinkProbe(
+  GstPad * pad, GstPadProbeInfo * info,
+  gpointer data)
+{
+  (void)pad;
+  GstInterface * gst = (GstInterface *)data;
+  const int64_t now = LatencyTracer::Now();
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    // Payloaders push the packets of one frame as a list, they share the PTS.
+    GstBufferList * list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+    if (gst_buffer_list_length(list) > 0) {
+      gst->_latencyTracer.OnSink(GST_BUFFER_PTS(gst_buffer_list_get(list, 0)), now);
+    }
+  } else {
+    gst->_latencyTracer.OnSink(GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info)), now);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+GstElement * GstInterface::CreateServerBin()
+{
+  const std::string gstFormat = (_encoderProfile == "H264") ? "video/x-h264" : "video/x-h265";
+  GstElement * bin = gst_bin_new("rtsp_server_branch");
+  GstElement * queue = gst_element_factory_make("queue", "queue");
+  g_object_set(
+    G_OBJECT(queue),
+    "leaky", 2,                   // 2 = downstream, drop old buffers
+    "max-size-buffers", 0,
+    "max-size-bytes", 0,
+    "max-size-time", (guint64)(500 * GST_MSECOND),
+    NULL);
+  g_signal_connect(queue, "overrun", G_CALLBACK(GstInterface::DestinationOverrunCallBack), this);
+  GstElement * sink = gst_element_factory_make("appsink", "rtsp_server_sink");
+  GstCaps * caps = gst_caps_new_simple(
+    gstFormat.c_str(),
+    "stream-format", G_TYPE_STRING, "byte-stream",
+    "alignment", G_TYPE_STRING, "au",
+    NULL);
+  g_object_set(
+    G_OBJECT(sink),
+    "caps", caps,
+    "emit-signals", true,
+    "sync", false,
+    "max-buffers", 30,
+    "drop", true,
+    NULL);
+  gst_caps_unref(caps);
+  g_signal_connect(sink, "new-sample", G_CALLBACK(GstInterface::ServerNewSampleCallBack), this);
+  gst_bin_add_many(GST_BIN(bin), queue, sink, NULL);
+  gst_element_link(queue, sink);
+  GstPad * queueSinkPad = gst_element_get_static_pad(queue, "sink");
+  gst_element_add_pad(bin, gst_ghost_pad_new("sink", queueSinkPad));
+  gst_object_unref(queueSinkPad);
+  {
+    // The new pipeline may start with another bitstream, clients wait for its key frame.
+    std::lock_guard<std::mutex> lock(_rtspServerMutex);
+    _serverSink = sink;
+    _serverWaitKeyFrame = true;
+  }
+  return bin;
+}
+
+GstElement * GstInterface::CreateRecordingBin()
+{
+  const std::string & location = _recordingConfig.location;
+  const bool is_h265 = (_encoderProfile == "H265");
+  const bool is_matroska = location.size() >= 4 &&
+    location.compare(location.size() - 4, 4, ".mkv") == 0;
+  GstElement * bin = gst_bin_new("recording_branch");
+  // Disk stalls last longer than network hiccups, the queue holds two seconds.
+  GstElement * queue = gst_element_factory_make("queue", nullptr);
+  g_object_set(
+    G_OBJECT(queue),
+    "leaky", 2,                   // 2 = downstream, drop old buffers
+    "max-size-buffers", 0,
+    "max-size-bytes", 0,
+    "max-size-time", (guint64)(2 * GST_SECOND),
+    NULL);
+  g_signal_connect(queue, "overrun", G_CALLBACK(GstInterface::RecordingOverrunCallBack), this);
+  // Converts the byte-stream to the form the muxers take, the video is not re-encoded.
+  GstElement * parse = gst_element_factory_make(is_h265 ? "h265parse" : "h264parse", nullptr);
+  GstElement * muxer = gst_element_factory_make(is_matroska ? "matroskamux" : "mp4mux", nullptr);
+  if (!is_matroska) {
+    // A fragmented MP4 stays playable when the recording is cut by a power loss.
+    g_object_set(G_OBJECT(muxer), "fragment-duration", 1000, NULL);
+  }
+  // Segments are split at the first key frame past a limit, the camera sets the GOP.
+  GstElement * sink = gst_element_factory_make("splitmuxsink", nullptr);
+  g_object_set(
+    G_OBJECT(sink),
+    "location", location.c_str(),
+    "muxer", muxer,
+    "max-size-time", (guint64)_recordingConfig.maxSegmentTimeNs,
+    "max-size-bytes", (guint64)_recordingConfig.maxSegmentBytes,
+    "max-files", (guint)_recordingConfig.maxFiles,
+    NULL);
+  gst_bin_add_many(GST_BIN(bin), queue, parse, sink, NULL);
+  gst_element_link_many(queue, parse, sink, NULL);
+  GstPad * queueSinkPad = gst_element_get_static_pad(queue, "sink");
+  gst_element_add_pad(bin, gst_ghost_pad_new("sink", queueSinkPad));
+  gst_object_unref(queueSinkPad);
+  return bin;
+}
+
+void GstInterface::HandleRecordingMessage(GstMessage * message)
+{
+  const GstStructure * structure = gst_message_get_structure(message);
+  const gchar * location = gst_structure_get_string(structure, "location");
+  if (location == nullptr) {
+    return;
+  }
+  if (gst_structure_has_name(structure, "splitmuxsink-fragment-opened")) {
+    _recordedSegments++;
+    {
+      std::lock_guard<std::mutex> lock(_recordingMutex);
+      _recordingSegment = location;
+    }
+    std::cout << "Recording segment opened: " << location << std::endl;
+    if (_recordingConfig.preallocateBytes == 0) {
+      return;
+    }
+    // Reserve the blocks past the end of the file, the muxer writes into them
+    // without allocating on the way. The file size is not changed.
+    int fd = open(location, O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+      if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)_recordingConfig.preallocateBytes) != 0) {
+        g_printerr("Cannot preallocate recording segment %s\n", location);
+      }
+      close(fd);
+    }
+  } else if (_recordingConfig.preallocateBytes != 0) {
+    // Truncating to the current size releases the unused reservation.
+    int fd = open(location, O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+      struct stat fileStat {};
+      if (fstat(fd, &fileStat) != 0 || ftruncate(fd, fileStat.st_size) != 0) {
+        g_printerr("Cannot release preallocation of recording segment %s\n", location);
+      }
+      close(fd);
+    }
+  }
+}
+
+void GstInterface::RecordingOverrunCallBack(GstElement * queue, gpointer data)
+{
+  (void)queue;
+  GstInterface * gst = (GstInterface *)data;
+  gst->_recordingOverruns++;
+}
+
+void GstInterface::StartRtspServer()
+{
+  if (_rtspServerPort <= 0) {
+    return;
+  }
+  const std::string codec = (_encoderProfile == "H264") ? "h264" : "h265";
+  const std::string launch =
+    "( appsrc name=server_source is-live=true format=time do-timestamp=true ! " +
+    codec + "parse config-interval=-1 ! rtp" + codec + "pay name=pay0 pt=96 )";
+  if (_rtspServer != nullptr) {
+    // The encoder profile may have changed, media created from now on use the new one.
+    gst_rtsp_media_factory_set_launch(_rtspMediaFactory, launch.c_str());
+    return;
+  }
+  _rtspServerContext = g_main_context_new();
+  _rtspServerLoop = g_main_loop_new(_rtspServerContext, false);
+  _rtspServer = gst_rtsp_server_new();
+  g_object_set(G_OBJECT(_rtspServer), "service", std::to_string(_rtspServerPort).c_str(), NULL);
+  _rtspMediaFactory = gst_rtsp_media_factory_new();
+  gst_rtsp_media_factory_set_launch(_rtspMediaFactory, launch.c_str());
+  // One media for all clients, the stream is fed and payloaded once.
+  gst_rtsp_media_factory_set_shared(_rtspMediaFactory, true);
+  g_signal_connect(
+    _rtspMediaFactory, "media-configure",
+    G_CALLBACK(GstInterface::RtspMediaConfigureCallBack), this);
+  GstRTSPMountPoints * mounts = gst_rtsp_server_get_mount_points(_rtspServer);
+  g_object_ref(_rtspMediaFactory);
+  gst_rtsp_mount_points_add_factory(mounts, _rtspServerMount.c_str(), _rtspMediaFactory);
+  g_object_unref(mounts);
+  g_signal_connect(
+    _rtspServer, "client-connected",
+    G_CALLBACK(GstInterface::RtspClientConnectedCallBack), this);
+  _rtspServerSourceId = gst_rtsp_server_attach(_rtspServer, _rtspServerContext);
+  if (_rtspServerSourceId == 0) {
+    g_printerr("Embedded RTSP server failed to listen on port %d.\n", _rtspServerPort);
+    StopRtspServer();
+    return;
+  }
+  _rtspServerThread = g_thread_new(
+    "GstRtspServerThread",
+    (GThreadFunc)GstInterface::RtspServerLoop, this);
+  std::cout << "Embedded RTSP server listening on " << GetRtspServerUrl() << std::endl;
+}
+
+void GstInterface::StopRtspServer()
+{
+  if (_rtspServer == nullptr) {
+    return;
+  }
+  if (_rtspServerLoop != nullptr) {
+    g_main_loop_quit(_rtspServerLoop);
+  }
+  if (_rtspServerThread != nullptr) {
+    g_thread_join(_rtspServerThread);
+    _rtspServerThread = nullptr;
+  }
+  if (_rtspServerSourceId != 0) {
+    GSource * source = g_main_context_find_source_by_id(_rtspServerContext, _rtspServerSourceId);
+    if (source != nullptr) {
+      g_source_destroy(source);
+    }
+    _rtspServerSourceId = 0;
+  }
+  gst_rtsp_server_client_filter(
+    _rtspServer,
+    [](GstRTSPServer *, GstRTSPClient *, gpointer) {return GST_RTSP_FILTER_REMOVE;},
+    nullptr);
+  {
+    std::lock_guard<std::mutex> lock(_rtspServerMutex);
+    if (_serverAppSrc != nullptr) {
+      gst_object_unref(_serverAppSrc);
+      _serverAppSrc = nullptr;
+    }
+    if (_serverMedia != nullptr) {
+      g_object_unref(_serverMedia);
+      _serverMedia = nullptr;
+    }
+    _rtspClients.clear();
+  }
+  g_object_unref(_rtspMediaFactory);
+  _rtspMediaFactory = nullptr;
+  g_object_unref(_rtspServer);
+  _rtspServer = nullptr;
+  g_main_loop_unref(_rtspServerLoop);
+  _rtspServerLoop = nullptr;
+  g_main_context_unref(_rtspServerContext);
+  _rtspServerContext = nullptr;
+}
+
+void * GstInterface::RtspServerLoop(gpointer data)
+{
+  GstInterface * gst = (GstInterface *)data;
+  g_main_context_push_thread_default(gst->_rtspServerContext);
+  g_main_loop_run(gst->_rtspServerLoop);
+  g_main_context_pop_thread_default(gst->_rtspServerContext);
+  return nullptr;
+}
+
+void GstInterface::RequestServerKeyFrame()
+{
+  GstElement * sink = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(_rtspServerMutex);
+    if (_serverSink != nullptr) {
+      sink = GST_ELEMENT(gst_object_ref(_serverSink));
+    }
+  }
+  if (sink == nullptr) {
+    return;
+  }
+  GstPad * sinkPad = gst_element_get_static_pad(sink, "sink");
+  gst_pad_push_event(
+    sinkPad, gst_event_new_custom(
+      GST_EVENT_CUSTOM_UPSTREAM,
+      gst_structure_new("GstForceKeyUnit", "all-headers", G_TYPE_BOOLEAN, true, NULL)));
+  gst_object_unref(sinkPad);
+  gst_object_unref(sink);
+}
+
+void GstInterface::RtspMediaConfigureCallBack(
+  GstRTSPMediaFactory * factory, GstRTSPMedia * media,
+  gpointer data)
+{
+  (void)factory;
+  GstInterface * gst = (GstInterface *)data;
+  GstElement * element = gst_rtsp_media_get_element(media);
+  GstElement * appSrc = gst_bin_get_by_name_recurse_up(GST_BIN(element), "server_source");
+  gst_object_unref(element);
+  g_signal_connect(
+    media, "unprepared",
+    G_CALLBACK(GstInterface::RtspMediaUnpreparedCallBack), data);
+  std::lock_guard<std::mutex> lock(gst->_rtspServerMutex);
+  if (gst->_serverAppSrc != nullptr) {
+    gst_object_unref(gst->_serverAppSrc);
+  }
+  if (gst->_serverMedia != nullptr) {
+    g_object_unref(gst->_serverMedia);
+  }
+  gst->_serverAppSrc = appSrc;
+  gst->_serverMedia = GST_RTSP_MEDIA(g_object_ref(media));
+  gst->_serverWaitKeyFrame = true;
+}
+
+void GstInterface::RtspMediaUnpreparedCallBack(GstRTSPMedia * media, gpointer data)
+{
+  GstInterface * gst = (GstInterface *)data;
+  std::lock_guard<std::mutex> lock(gst->_rtspServerMutex);
+  if (gst->_serverMedia != media) {
+    return;
+  }
+  if (gst->_serverAppSrc != nullptr) {
+    gst_object_unref(gst->_serverAppSrc);
+    gst->_serverAppSrc = nullptr;
+  }
+  g_object_unref(gst->_serverMedia);
+  gst->_serverMedia = nullptr;
+}
+
+void GstInterface::RtspClientConnectedCallBack(
+  GstRTSPServer * server, GstRTSPClient * client,
+  gpointer data)
+{
+  (void)server;
+  GstInterface * gst = (GstInterface *)data;
+  GstRTSPConnection * connection = gst_rtsp_client_get_connection(client);
+  const gchar * ip = (connection != nullptr) ? gst_rtsp_connection_get_ip(connection) : nullptr;
+  g_signal_connect(
+    client, "play-request",
+    G_CALLBACK(GstInterface::RtspClientPlayCallBack), data);
+  g_signal_connect(
+    client, "closed",
+    G_CALLBACK(GstInterface::RtspClientClosedCallBack), data);
+  std::cout << "RTSP client connected: " << (ip ? ip : "unknown") << std::endl;
+  std::lock_guard<std::mutex> lock(gst->_rtspServerMutex);
+  gst->_rtspClients.push_back(
+    RtspClient{client, ip ? ip : "", std::chrono::steady_clock::now()});
+}
+
+void GstInterface::RtspClientPlayCallBack(
+  GstRTSPClient * client, GstRTSPContext * context,
+  gpointer data)
+{
+  (void)client;
+  (void)context;
+  // The shared media is already running, a late client needs a key frame to start from.
+  ((GstInterface *)data)->RequestServerKeyFrame();
+}
+
+void GstInterface::RtspClientClosedCallBack(GstRTSPClient * client, gpointer data)
+{
+  GstInterface * gst = (GstInterface *)data;
+  std::lock_guard<std::mutex> lock(gst->_rtspServerMutex);
+  gst->_rtspClients.erase(
+    std::remove_if(
+      gst->_rtspClients.begin(), gst->_rtspClients.end(),
+      [client](const RtspClient & c) {return c.client == client;}),
+    gst->_rtspClients.end());
+  std::cout << "RTSP client disconnected." << std::endl;
+}
+
+GstFlowReturn GstInterface::ServerNewSampleCallBack(GstAppSink * sink, gpointer data)
+{
+  GstInterface * gst = (GstInterface *)data;
+  GstSample * sample = gst_app_sink_pull_sample(sink);
+  if (sample == nullptr) {
+    return GST_FLOW_OK;
+  }
+  GstBuffer * buffer = gst_sample_get_buffer(sample);
+  std::lock_guard<std::mutex> lock(gst->_rtspServerMutex);
+  if (gst->_serverAppSrc != nullptr && buffer != nullptr) {
+    if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+      gst->_serverWaitKeyFrame = false;
+    }
+    if (!gst->_serverWaitKeyFrame) {
+      GstAppSrc * appSrc = GST_APP_SRC(gst->_serverAppSrc);
+      GstCaps * sampleCaps = gst_sample_get_caps(sample);
+      GstCaps * caps = gst_app_src_get_caps(appSrc);
+      if (sampleCaps != nullptr && (caps == nullptr || !gst_caps_is_equal(caps, sampleCaps))) {
+        gst_app_src_set_caps(appSrc, sampleCaps);
+      }
+      if (caps != nullptr) {
+        gst_caps_unref(caps);
+      }
+      // Shares the memory, only the metadata is copied. The media timestamps it on its clock.
+      GstBuffer * serverBuffer = gst_buffer_copy(buffer);
+      GST_BUFFER_PTS(serverBuffer) = GST_CLOCK_TIME_NONE;
+      GST_BUFFER_DTS(serverBuffer) = GST_CLOCK_TIME_NONE;
+      gst_app_src_push_buffer(appSrc, serverBuffer);
+      gst->_rtspServerBuffers++;
+    }
+  }
+  gst_sample_unref(sample);
+  return GST_FLOW_OK;
+}
+
+std::vector<RtspClientStats> GstInterface::GetRtspClientStats()
+{
+  std::lock_guard<std::mutex> lock(_rtspServerMutex);
+  const auto now = std::chrono::steady_clock::now();
+  std::vector<RtspClientStats> clients;
+  for (const auto & client : _rtspClients) {
+    RtspClientStats stats{};
+    stats.address = client.address;
+    stats.connectedMs =
+      std::chrono::duration_cast<std::chrono::milliseconds>(now - client.connected).count();
+    clients.push_back(stats);
+  }
+  if (_serverMedia == nullptr) {
+    return clients;
+  }
+  // Receiver reports of the shared media, matched to the clients by address.
+  std::vector<RtspClientStats> reports;
+  for (guint i = 0; i < gst_rtsp_media_n_streams(_serverMedia); i++) {
+    GstRTSPStream * stream = gst_rtsp_media_get_stream(_serverMedia, i);
+    GObject * session = gst_rtsp_stream_get_rtpsession(stream);
+    if (session == nullptr) {
+      continue;
+    }
+    ReadReceiverReports(session, reports);
+    g_object_unref(session);
+  }
+  for (const auto & report : reports) {
+    for (auto & stats : clients) {
+      if (report.address.compare(0, stats.address.size() + 1, stats.address + ":") != 0) {
+        continue;
+      }
+      stats.haveReceiverReport = true;
+      stats.packetsLost = report.packetsLost;
+      stats.fractionLost = report.fractionLost;
+      stats.jitterMs = report.jitterMs;
+      stats.roundTripMs = report.roundTripMs;
+    }
+  }
+  return clients;
+}
+
+void GstInterface::ReadReceiverReports(GObject * session, std::vector<RtspClientStats> & reports)
+{
+  GstStructure * sessionStats = nullptr;
+  g_object_get(session, "stats", &sessionStats, NULL);
+  if (sessionStats == nullptr) {
+    return;
+  }
+  const GValue * sources = gst_structure_get_value(sessionStats, "source-stats");
+  G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+  GValueArray * array = (sources != nullptr) ? (GValueArray *)g_value_get_boxed(sources) : nullptr;
+  for (guint j = 0; array != nullptr && j < array->n_values; j++) {
+    const GstStructure * source = gst_value_get_structure(g_value_array_get_nth(array, j));
+    const gchar * rtcpFrom = gst_structure_get_string(source, "rtcp-from");
+    gboolean haveReceiverReport = false;
+    if (rtcpFrom == nullptr ||
+      !gst_structure_get_boolean(source, "have-rb", &haveReceiverReport) ||
+      !haveReceiverReport)
+    {
+      continue;
+    }
+    guint fractionLost = 0, jitter = 0, roundTrip = 0;
+    gint packetsLost = 0;
+    gst_structure_get_uint(source, "rb-fractionlost", &fractionLost);
+    gst_structure_get_int(source, "rb-packetslost", &packetsLost);
+    gst_structure_get_uint(source, "rb-jitter", &jitter);
+    gst_structure_get_uint(source, "rb-round-trip", &roundTrip);
+    RtspClientStats report{};
+    report.address = rtcpFrom;
+    report.haveReceiverReport = true;
+    report.packetsLost = packetsLost;
+    report.fractionLost = fractionLost / 256.0;           // 8 bit fixed point
+    report.jitterMs = jitter / 90.0;                      // 90 kHz video RTP clock
+    report.roundTripMs = roundTrip * 1000.0 / 65536.0;    // 16.16 fixed point seconds
+    reports.push_back(report);
+  }
+  G_GNUC_END_IGNORE_DEPRECATIONS
+  gst_structure_free(sessionStats);
+}
+
+CongestionSample GstInterface::SampleCongestion()
+{
+  CongestionSample sample{};
+  // Receiver reports of the embedded server clients and of the server behind rtspclientsink
+  for (const auto & client : GetRtspClientStats()) {
+    if (client.haveReceiverReport) {
+      sample.fractionLost = std::max(sample.fractionLost, client.fractionLost);
+      sample.roundTripMs = std::max(sample.roundTripMs, client.roundTripMs);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(_bitrateMutex);
+    if (_rtspSinkManager != nullptr) {
+      GObject * session = nullptr;
+      g_signal_emit_by_name(_rtspSinkManager, "get-internal-session", 0, &session);
+      if (session != nullptr) {
+        std::vector<RtspClientStats> reports;
+        ReadReceiverReports(session, reports);
+        g_object_unref(session);
+        for (const auto & report : reports) {
+          sample.fractionLost = std::max(sample.fractionLost, report.fractionLost);
+          sample.roundTripMs = std::max(sample.roundTripMs, report.roundTripMs);
+        }
+      }
+    }
+  }
+  // Backpressure of the network sinks, a TCP connection fills the queue in front of it.
+  // The recording branch has its own disk budget and does not count.
+  {
+    std::lock_guard<std::mutex> lock(_destinationsMutex);
+    for (const auto & branch : _branches) {
+      if (IsRecordingEnabled() && branch.address == GetRecordingAddress()) {
+        continue;
+      }
+      GstElement * queue = gst_bin_get_by_name(GST_BIN(branch.bin), "queue");
+      if (queue == nullptr) {
+        continue;
+      }
+      guint64 levelTime = 0, maxTime = 0;
+      g_object_get(
+        G_OBJECT(queue), "current-level-time", &levelTime, "max-size-time", &maxTime, NULL);
+      gst_object_unref(queue);
+      if (maxTime > 0) {
+        sample.sinkQueueFill = std::max(sample.sinkQueueFill, (double)levelTime / maxTime);
+      }
+    }
+  }
+  // Our own chunk queue fills when the pipeline does not keep up with the camera.
+  const double frameLimit = std::max(1, _encoderFps * 2);
+  sample.queueFill = std::max(
+    (double)_queue.Size() / frameLimit,
+    _queueMaxBytes > 0 ? (double)_queue.Bytes() / _queueMaxBytes : 0.0);
+  sample.droppedFrames = _queueDroppedFrames + _nonReferenceDroppedFrames + _destinationOverruns;
+  return sample;
+}
+
+int GstInterface::UpdateTargetBitrate()
+{
+  const CongestionSample sample = SampleCongestion();
+  const int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  std::lock_guard<std::mutex> lock(_bitrateMutex);
+  _congestion = sample;
+  if (!_adaptiveBitrate) {
+    return _bitrateController.GetTarget();
+  }
+  return _bitrateController.Update(sample, nowMs);
+}
+
+void GstInterface::RtspSinkManagerCallBack(GstElement * sink, GstElement * manager, gpointer data)
+{
+  (void)sink;
+  GstInterface * gst = (GstInterface *)data;
+  std::lock_guard<std::mutex> lock(gst->_bitrateMutex);
+  if (gst->_rtspSinkManager != nullptr) {
+    gst_object_unref(gst->_rtspSinkManager);
+  }
+  gst->_rtspSinkManager = (GstElement *)gst_object_ref(manager);
+}
+
+void GstInterface::DestinationOverrunCallBack(GstElement * queue, gpointer data)
+{
+  (void)queue;
+  GstInterface * gst = (GstInterface *)data;
+  gst->_destinationOverruns++;
+}
+
+void GstInterface::AddDestinationBranch(const std::string & address, bool primary)
+{
+  DestinationBranch branch{};
+  branch.address = address;
+  branch.primary = primary;
+  const bool server = (_rtspServer != nullptr && address == GetRtspServerUrl());
+  const bool recording = (IsRecordingEnabled() && address == GetRecordingAddress());
+  if (server) {
+    branch.bin = CreateServerBin();
+  } else if (recording) {
+    branch.bin = CreateRecordingBin();
+  } else {
+    branch.bin = CreateDestinationBin(address, primary);
+  }
+  gst_bin_add(GST_BIN(_pipeline), branch.bin);
+  branch.teePad = gst_element_get_request_pad(_tee, "src_%u");
+  GstPad * binSinkPad = gst_element_get_static_pad(branch.bin, "sink");
+  gst_pad_link(branch.teePad, binSinkPad);
+  gst_object_unref(binSinkPad);
+  // No-op while the pipeline is being built, brings a runtime branch up to PLAYING.
+  gst_element_sync_state_with_parent(branch.bin);
+  _branches.push_back(branch);
+  std::cout << "Destination added: " << address << std::endl;
+}
+
+void GstInterface::RemoveDestinationBranch(const std::string & address)
+{
+  auto branch = std::find_if(
+    _branches.begin(), _branches.end(),
+    [&address](const DestinationBranch & b) {return b.address == address;});
+  if (branch == _branches.end()) {
+    return;
+  }
+  // Unlink once no buffer is in flight on the tee pad, the other branches keep streaming.
+  auto * removed = new DestinationBranch(*branch);
+  gst_object_ref(removed->bin);
+  _branches.erase(branch);
+  gst_pad_add_probe(
+    removed->teePad, GST_PAD_PROBE_TYPE_IDLE, GstInterface::UnlinkDestinationProbe,
+    removed, nullptr);
+}
+
+GstPadProbeReturn GstInterface::UnlinkDestinationProbe(
+  GstPad * pad, GstPadProbeInfo * info,
+  gpointer data)
+{
+  (void)info;
+  auto * branch = static_cast<DestinationBranch *>(data);
+  GstPad * binSinkPad = gst_element_get_static_pad(branch->bin, "sink");
+  gst_pad_unlink(pad, binSinkPad);
+  gst_object_unref(binSinkPad);
+  GstElement * tee = gst_pad_get_parent_element(pad);
+  if (tee != nullptr) {
+    gst_element_release_request_pad(tee, pad);
+    gst_object_unref(tee);
+  }
+  gst_object_unref(pad);
+  // Sinks may block while shutting down, finish outside the streaming thread.
+  g_idle_add(GstInterface::FinishDestinationRemoval, branch);
+  return GST_PAD_PROBE_REMOVE;
+}
+
+gboolean GstInterface::FinishDestinationRemoval(gpointer data)
+{
+  auto * branch = static_cast<DestinationBranch *>(data);
+  gst_element_set_state(branch->bin, GST_STATE_NULL);
+  GstObject * parent = gst_object_get_parent(GST_OBJECT(branch->bin));
+  if (parent != nullptr) {
+    gst_bin_remove(GST_BIN(parent), branch->bin);
+    gst_object_unref(parent);
+  }
+  gst_object_unref(branch->bin);
+  std::cout << "Destination removed: " << branch->address << std::endl;
+  delete branch;
+  return G_SOURCE_REMOVE;
+}
+
+bool GstInterface::IsExtraDestinationElement(GstObject * object)
+{
+  std::lock_guard<std::mutex> lock(_destinationsMutex);
+  for (const auto & branch : _branches) {
+    if (!branch.primary &&
+      (object == GST_OBJECT(branch.bin) ||
+      gst_object_has_as_ancestor(object, GST_OBJECT(branch.bin))))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void GstInterface::DropFailedDestination(GstObject * object)
+{
+  std::lock_guard<std::mutex> lock(_destinationsMutex);
+  for (const auto & branch : _branches) {
+    if (!branch.primary && gst_object_has_as_ancestor(object, GST_OBJECT(branch.bin))) {
+      // Only this branch is taken out, it is added again on the next pipeline start.
+      const std::string address = branch.address;
+      std::cout << "Destination failed: " << address << std::endl;
+      _destinationErrors++;
+      RemoveDestinationBranch(address);
+      return;
+    }
+  }
+}
+
+GstElement * GstInterface::CreateAppSource()
+{
+  const std::string gstFormat = (_encoderProfile == "H264") ? "video/x-h264" : "video/x-h265";
+  GstElement * appSource = gst_element_factory_make("appsrc", "source");
+  g_object_set(
+    G_OBJECT(appSource),
+    "do-timestamp", true,
+    "is-live", true,
+    "block", false,
+    "stream-type", 0,
+    NULL);
+  gst_util_set_object_arg(G_OBJECT(appSource), "format", "GST_FORMAT_TIME");
+  if (_pushMode) {
+    // Frames are pushed as they arrive. Above max-bytes the backlog waits in our
+    // queue, leaky-type (GStreamer >= 1.20) only protects against a stuck pipeline.
+    g_object_set(G_OBJECT(appSource), "max-bytes", _appSrcMaxBytes, NULL);
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(appSource), "leaky-type")) {
+      gst_util_set_object_arg(G_OBJECT(appSource), "leaky-type", "downstream");
+    }
+  }
+  g_object_set(
+    G_OBJECT(appSource), "caps",
+    gst_caps_new_simple(
+      gstFormat.c_str(),
+      "width", G_TYPE_INT, _encoderWidth,
+      "height", G_TYPE_INT, _encoderHeight,
+      "framerate", GST_TYPE_FRACTION, _encoderFps, 1,
+      NULL), NULL);
+  return appSource;
+}
+
+void GstInterface::AttachAppSource(GstElement * appSource)
+{
+  std::cout << "Connecting need-data signal! Signal ID: " << _needDataSignalId << std::endl;
+
+  RequestGopReplay();
+  if (_latencyTracer.IsEnabled()) {
+    _latencyTracer.Clear();
+    GstPad * srcPad = gst_element_get_static_pad(appSource, "src");
+    gst_pad_add_probe(
+      srcPad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+      GstInterface::TraceSourceProbe, this, nullptr);
+    gst_object_unref(srcPad);
+  }
+  {
+    std::lock_guard<std::mutex> lock(_appSourceMutex);
+    _appSource = appSource;
+  }
+  if (_pushMode) {
+    _needDataSignalId = g_signal_connect(
+      _appSource, "need-data",
+      G_CALLBACK(GstInterface::NeedDataPushModeCallBack), this);
+  } else {
+    _needDataSignalId = g_signal_connect(
+      _appSource, "need-data",
+      G_CALLBACK(GstInterface::NeedDataCallBack), this);
+  }
+  if (_pushMode) {
+    // Chunks collected while waiting in CreatePipeline go in as the first batch.
+    PushQueuedFrames();
+  }
+  std::cout << "Need-data signal connected! Signal ID: " << _needDataSignalId << std::endl;
+}
+
+void GstInterface::BuildStandbyPipeline()
+{
+  std::cout << "Building hot-standby pipeline!" << std::endl;
+  const bool is_h265 = (_encoderProfile == "H265");
+  const std::string gstFormat = is_h265 ? "video/x-h265" : "video/x-h264";
+  _pipeline = gst_pipeline_new("standby_pipeline");
+
+  // "Camera not detected" branch, live so it does not run ahead of the camera branch.
+  _testSrc = gst_element_factory_make("videotestsrc", "test_source");
+  g_object_set(G_OBJECT(_testSrc), "pattern", 18, "is-live", true, NULL);
+  _testSrcFilter = gst_element_factory_make("capsfilter", "source_filter");
+  g_object_set(
+    G_OBJECT(_testSrcFilter), "caps",
+    gst_caps_new_simple(
+      "video/x-raw",
+      "format", G_TYPE_STRING, "I420",
+      "width", G_TYPE_INT, _encoderWidth,
+      "height", G_TYPE_INT, _encoderHeight,
+      "framerate", GST_TYPE_FRACTION, _encoderFps, 1,
+      NULL), NULL);
+  _textOverlay = gst_element_factory_make("textoverlay", "text");
+  g_object_set(
+    G_OBJECT(_textOverlay),
+    "text", "Camera not detected!",
+    "valignment", 4,             // 4 = center
+    "halignment", 1,             // 1 = center
+    "font-desc", "Sans, 42",
+    NULL);
+  _videoConvert = gst_element_factory_make("videoconvert", "video_convert");
+  _h26xEnc = gst_element_factory_make(is_h265 ? "x265enc" : "x264enc", "encoder");
+  gst_util_set_object_arg(G_OBJECT(_h26xEnc), "tune", "zerolatency");
+  gst_util_set_object_arg(G_OBJECT(_h26xEnc), "speed-preset", "superfast");
+  GstElement * defaultParse =
+    gst_element_factory_make(is_h265 ? "h265parse" : "h264parse", "default_parser");
+  GstElement * defaultQueue = gst_element_factory_make("queue", "default_queue");
+
+  // Camera branch.
+  GstElement * appSource = CreateAppSource();
+  _h26xEncFilter = gst_element_factory_make("capsfilter", "encoder_filter");
+  g_object_set(
+    G_OBJECT(_h26xEncFilter), "caps",
+    gst_caps_new_simple(
+      gstFormat.c_str(),
+      "stream-format", G_TYPE_STRING, "byte-stream",
+      NULL), NULL);
+  _h26xparse = gst_element_factory_make(is_h265 ? "h265parse" : "h264parse", "parser");
+  _queue1 = gst_element_factory_make("queue", "queue1");
+
+  // Parameter sets with every key frame, receivers can decode right after a switch.
+  g_object_set(G_OBJECT(defaultParse), "config-interval", -1, NULL);
+  g_object_set(G_OBJECT(_h26xparse), "config-interval", -1, NULL);
+
+  // Inactive input drops its buffers instead of waiting for the active one.
+  _inputSelector = gst_element_factory_make("input-selector", "input_selector");
+  g_object_set(G_OBJECT(_inputSelector), "sync-streams", false, NULL);
+
+  gst_bin_add_many(
+    GST_BIN(_pipeline), _testSrc, _testSrcFilter, _textOverlay, _videoConvert, _h26xEnc,
+    defaultParse, defaultQueue, appSource, _h26xEncFilter, _h26xparse, _queue1,
+    _inputSelector, NULL);
+  gst_element_link_many(
+    _testSrc, _testSrcFilter, _textOverlay, _videoConvert, _h26xEnc, defaultParse,
+    defaultQueue, NULL);
+  gst_element_link_many(appSource, _h26xEncFilter, _h26xparse, _queue1, NULL);
+  LinkDestinations(_inputSelector);
+
+  {
+    std::lock_guard<std::mutex> lock(_selectorMutex);
+    _defaultSelectorPad = gst_element_get_request_pad(_inputSelector, "sink_%u");
+    _cameraSelectorPad = gst_element_get_request_pad(_inputSelector, "sink_%u");
+    GstPad * defaultSrcPad = gst_element_get_static_pad(defaultQueue, "src");
+    GstPad * cameraSrcPad = gst_element_get_static_pad(_queue1, "src");
+    gst_pad_link(defaultSrcPad, _defaultSelectorPad);
+    gst_pad_link(cameraSrcPad, _cameraSelectorPad);
+    gst_object_unref(defaultSrcPad);
+    gst_object_unref(cameraSrcPad);
+    g_object_set(G_OBJECT(_inputSelector), "active-pad", _defaultSelectorPad, NULL);
+  }
+  _isStreamDefault = true;
+  _isStandbyPipeline = true;
+  _pendingSwitchSinceNs = 0;
+
+  AttachAppSource(appSource);
+  _standbyWatchdogId = g_timeout_add(100, GstInterface::StandbyWatchdogCallBack, this);
+  //GST_DEBUG_BIN_TO_DOT_FILE(GST_BIN(_pipeline), GST_DEBUG_GRAPH_SHOW_ALL, "pipeline_standby");
+  StartPipelineLoop();
+}
+
+void GstInterface::SwitchStandbyInput(bool camera)
+{
+  std::lock_guard<std::mutex> lock(_selectorMutex);
+  if (_inputSelector == nullptr || camera == !_isStreamDefault) {
+    return;
+  }
+  const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  int64_t since = 0;
+  if (camera) {
+    since = _pendingSwitchSinceNs.exchange(0);
+    g_object_set(G_OBJECT(_inputSelector), "active-pad", _cameraSelectorPad, NULL);
+    std::cout << "Hot-standby: switched to camera stream." << std::endl;
+  } else {
+    since = _lastFrameTimeNs;
+    g_object_set(G_OBJECT(_inputSelector), "active-pad", _defaultSelectorPad, NULL);
+    // The encoder is in the middle of a GOP, ask it for a key frame with headers.
+    gst_pad_push_event(
+      _defaultSelectorPad, gst_event_new_custom(
+        GST_EVENT_CUSTOM_UPSTREAM,
+        gst_structure_new("GstForceKeyUnit", "all-headers", G_TYPE_BOOLEAN, true, NULL)));
+    // If the camera comes back soon, its GOP continues from the cached one.
+    RequestGopReplay();
+    std::cout << "Hot-standby: switched to default stream." << std::endl;
+  }
+  _isStreamDefault = !camera;
+  _streamSwitches++;
+  NotifyStreamPlaying();
+  if (since > 0) {
+    _lastSwitchLatencyMs = (now - since) / 1000000;
+  }
+}
+
+gboolean GstInterface::StandbyWatchdogCallBack(gpointer data)
+{
+  GstInterface * gst = (GstInterface *)data;
+  if (!gst->_isStreamDefault) {
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (now - gst->_lastFrameTimeNs > gst->_hotStandbyTimeoutMs * 1000000) {
+      gst->SwitchStandbyInput(false);
+    }
+  }
+  return G_SOURCE_CONTINUE;
+}
+
 void GstInterface::NeedDataCallBack(
   GstElement * appsrc, guint unused_size,
   gpointer user_data)
@@ -361,44 +1348,294 @@ void GstInterface::NeedDataCallBack(
   (void)unused_size;
   GstInterface * data = (GstInterface *)user_data;
   GstFlowReturn result;
-  if (!data->_isStreamDefault) {
-    g_mutex_lock(&data->haveDataCondMutex);
-    while (data->queue.empty() and !data->_isStreamShutdown) {
-      g_cond_wait(&data->haveDataCond, &data->haveDataCondMutex);
-    }
-    std::shared_ptr<sensor_msgs::msg::CompressedImage> videoPtr;
-    // Mutex might be locked here, if gstreamer is not able to process during shutdown.
-    if (data->_isStreamShutdown) {
-      std::cout << "Shutdown is called, not processing data!" << std::endl;
-      g_mutex_unlock(&data->haveDataCondMutex);
+  if (!data->_isStreamDefault || data->_isStandbyPipeline) {
+    // A (re)started stream begins with the cached GOP, receivers get a decodable picture at once.
+    std::vector<CompressedImageMsg::SharedPtr> replay;
+    if (data->TakeGopReplay(replay)) {
+      for (const auto & cachedPtr : replay) {
+        GstBuffer * buffer = data->CreateBuffer(cachedPtr);
+        g_signal_emit_by_name(appsrc, "push-buffer", buffer, &result);
+        gst_buffer_unref(buffer);
+      }
       return;
-    } else {
-      // std::cout << "Processing data! Queue size: " << data->queue.size() << std::endl;
-      videoPtr = data->queue.front();
-      data->queue.pop();
-      g_mutex_unlock(&data->haveDataCondMutex);
     }
 
-    auto & frame = videoPtr->data;
-    GstBuffer * buffer = gst_buffer_new_and_alloc(frame.size());
-    gst_buffer_fill(buffer, 0, &frame[0], frame.size());
-    const auto stamp = videoPtr->header.stamp;
-    const GstClockTime stampTime = stamp.sec * 1000000000UL + stamp.nanosec;
+    CompressedImageMsg::SharedPtr videoPtr;
+    do {
+      while (!data->_queue.Pop(videoPtr)) {
+        if (data->_isStreamShutdown) {
+          std::cout << "Shutdown is called, not processing data!" << std::endl;
+          return;
+        }
+        // Timeout only guards against a missed wake-up, StopStream wakes the queue.
+        data->_queue.WaitForData(100);
+      }
+    } while (data->IsAlreadyReplayed(videoPtr));
+
+    GstBuffer * buffer = data->CreateBuffer(videoPtr);
+    g_signal_emit_by_name(appsrc, "push-buffer", buffer, &result);
+    gst_buffer_unref(buffer);
+  }
+}
+
+void GstInterface::NeedDataPushModeCallBack(
+  GstElement * appsrc, guint unused_size,
+  gpointer user_data)
+{
+  (void)appsrc;
+  (void)unused_size;
+  // The appsrc has room again, hand over whatever backlog is waiting in the queue.
+  GstInterface * data = (GstInterface *)user_data;
+  data->PushQueuedFrames();
+}
+
+bool GstInterface::PushFrame(const CompressedImageMsg::SharedPtr & videoPtr)
+{
+  const H26xFrameInfo info = ParseFrame(videoPtr);
+  const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  _lastFrameTimeNs = now;
+  if (_isStandbyPipeline && _isStreamDefault && _pendingSwitchSinceNs == 0) {
+    _pendingSwitchSinceNs = now;
+  }
 
-    if (data->_gstStartTimestamp == 0) {
-      data->_gstStartTimestamp = data->_gstTimestamp;
+  // Chunks without start codes cannot be classified, they are only dropped on overflow.
+  if (info.valid) {
+    UpdateGopCache(videoPtr, info);
+    if (_skipUntilKeyFrame) {
+      if (!info.isKeyFrame) {
+        _queueDroppedFrames++;
+        return false;
+      }
+      _skipUntilKeyFrame = false;
     }
+    const bool queueFilling =
+      _queue.Size() * 4 >= _queue.MaxFrames() * 3 ||
+      _queue.Bytes() + videoPtr->data.size() >= _queue.MaxBytes() / 4 * 3;
+    if (queueFilling && info.hasPicture && !info.isReference) {
+      // Nothing refers to this picture, dropping it does not corrupt the stream.
+      _queueDroppedFrames++;
+      _nonReferenceDroppedFrames++;
+      return false;
+    }
+  }
 
-    const GstClockTime fromStart = stampTime - data->_gstStartTimestamp;
-    const auto timeDifference = fromStart - data->_gstTimestamp;
-    data->_gstTimestamp = fromStart;
+  CompressedImageMsg::SharedPtr item = videoPtr;
+  if (!_queue.Push(std::move(item), videoPtr->data.size())) {
+    _queueDroppedFrames++;
+    // Following pictures refer to the dropped one, skip the rest of the GOP.
+    if (info.valid) {
+      _skipUntilKeyFrame = true;
+      _skippedGops++;
+    }
+    return false;
+  }
+  if (_pushMode) {
+    PushQueuedFrames();
+  }
+  return true;
+}
 
-    GST_BUFFER_PTS(buffer) = (gint64)fromStart;
-    GST_BUFFER_DURATION(buffer) = (gint64)timeDifference;
+void GstInterface::PushQueuedFrames()
+{
+  // The lock serializes the queue consumers in push mode (ROS2 subscriber, need-data
+  // and pipeline creation) and keeps StopStream from releasing the appsrc under us.
+  std::lock_guard<std::mutex> lock(_appSourceMutex);
+  if (_appSource == nullptr || _isStreamShutdown || (_isStreamDefault && !_isStandbyPipeline)) {
+    return;
+  }
+  GstAppSrc * appsrc = GST_APP_SRC(_appSource);
+  guint64 level = gst_app_src_get_current_level_bytes(appsrc);
+  GstBuffer * first = nullptr;
+  GstBufferList * list = nullptr;
+  auto append = [&](const CompressedImageMsg::SharedPtr & videoPtr) {
+      GstBuffer * buffer = CreateBuffer(videoPtr);
+      level += gst_buffer_get_size(buffer);
+      if (first == nullptr) {
+        first = buffer;
+      } else {
+        if (list == nullptr) {
+          list = gst_buffer_list_new();
+          gst_buffer_list_add(list, first);
+        }
+        gst_buffer_list_add(list, buffer);
+      }
+    };
 
-    g_signal_emit_by_name(appsrc, "push-buffer", buffer, &result);
-    gst_buffer_unref(buffer);
+  // A (re)started stream begins with the cached GOP, regardless of max-bytes.
+  std::vector<CompressedImageMsg::SharedPtr> replay;
+  if (TakeGopReplay(replay)) {
+    for (const auto & cachedPtr : replay) {
+      append(cachedPtr);
+    }
   }
+  CompressedImageMsg::SharedPtr videoPtr;
+  // Frames beyond max-bytes stay in our queue and go in with the next batch.
+  while (level < _appSrcMaxBytes && _queue.Pop(videoPtr)) {
+    if (!IsAlreadyReplayed(videoPtr)) {
+      append(videoPtr);
+    }
+  }
+  // Both push functions take the ownership of the buffers.
+  if (list != nullptr) {
+    gst_app_src_push_buffer_list(appsrc, list);
+    _bufferListPushes++;
+  } else if (first != nullptr) {
+    gst_app_src_push_buffer(appsrc, first);
+  }
+}
+
+H26xFrameInfo GstInterface::ParseFrame(const CompressedImageMsg::SharedPtr & videoPtr)
+{
+  const bool isH265 = videoPtr->format.empty() ?
+    (_encoderProfile == "H265") : (videoPtr->format.compare(0, 4, "H265") == 0);
+  return H26xParser::Parse(videoPtr->data.data(), videoPtr->data.size(), isH265);
+}
+
+void GstInterface::UpdateGopCache(
+  const CompressedImageMsg::SharedPtr & videoPtr,
+  const H26xFrameInfo & info)
+{
+  std::lock_guard<std::mutex> lock(_gopCacheMutex);
+  if (info.hasParameterSets) {
+    _parameterSetsChunk = videoPtr;
+  }
+  if (!info.hasPicture) {
+    return;
+  }
+  if (info.isKeyFrame) {
+    _gopCache.clear();
+    _gopCacheBytes = 0;
+  } else if (_gopCache.empty()) {
+    // The GOP start is unknown, nothing decodable to cache until the next key frame.
+    return;
+  }
+  if (_gopCacheBytes + videoPtr->data.size() > _queueMaxBytes) {
+    // Too long GOP for the budget, a partial GOP would not be decodable either.
+    _gopCache.clear();
+    _gopCacheBytes = 0;
+    return;
+  }
+  _gopCache.push_back(videoPtr);
+  _gopCacheBytes += videoPtr->data.size();
+  _gopCacheUpdateTime = std::chrono::steady_clock::now();
+}
+
+bool GstInterface::TakeGopReplay(std::vector<CompressedImageMsg::SharedPtr> & replay)
+{
+  if (!_gopReplayPending.exchange(false)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_gopCacheMutex);
+  // A GOP from before a camera pause would only flash an outdated picture.
+  if (_gopCache.empty() ||
+    std::chrono::steady_clock::now() - _gopCacheUpdateTime > std::chrono::seconds(2))
+  {
+    return false;
+  }
+  if (!ParseFrame(_gopCache.front()).hasParameterSets && _parameterSetsChunk) {
+    replay.push_back(_parameterSetsChunk);
+  }
+  replay.insert(replay.end(), _gopCache.begin(), _gopCache.end());
+  const auto stamp = _gopCache.back()->header.stamp;
+  _replayedUntilNs = stamp.sec * 1000000000UL + stamp.nanosec;
+  return true;
+}
+
+bool GstInterface::IsAlreadyReplayed(const CompressedImageMsg::SharedPtr & videoPtr)
+{
+  if (_replayedUntilNs == 0) {
+    return false;
+  }
+  const auto stamp = videoPtr->header.stamp;
+  if ((uint64_t)(stamp.sec * 1000000000UL + stamp.nanosec) <= _replayedUntilNs) {
+    return true;
+  }
+  _replayedUntilNs = 0;
+  return false;
+}
+
+GstBuffer * GstInterface::CreateBuffer(const CompressedImageMsg::SharedPtr & videoPtr)
+{
+  auto & frame = videoPtr->data;
+  if (_timeToFirstDecodableFrameMs < 0 || (_isStandbyPipeline && _isStreamDefault)) {
+    if (ParseFrame(videoPtr).isKeyFrame) {
+      if (_timeToFirstDecodableFrameMs < 0) {
+        _timeToFirstDecodableFrameMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - _streamStartTime).count();
+      }
+      // Switch before this buffer reaches the selector, the camera output starts decodable.
+      if (_isStandbyPipeline) {
+        SwitchStandbyInput(true);
+      }
+    }
+  }
+  GstBuffer * buffer;
+  if (frame.empty()) {
+    buffer = gst_buffer_new();
+  } else if (_zeroCopy) {
+    // The buffer points straight into the message storage. A reference to the message
+    // is handed over to GStreamer and dropped in ReleaseWrappedMessage.
+    buffer = gst_buffer_new_wrapped_full(
+      GST_MEMORY_FLAG_READONLY, frame.data(), frame.size(), 0, frame.size(),
+      new CompressedImageMsg::SharedPtr(videoPtr), GstInterface::ReleaseWrappedMessage);
+  } else {
+    buffer = gst_buffer_new_and_alloc(frame.size());
+    gst_buffer_fill(buffer, 0, frame.data(), frame.size());
+    _bytesCopied += frame.size();
+  }
+  _bytesPushed += frame.size();
+  if (_latencyTracer.IsEnabled()) {
+    _latencyTracer.OnDequeue(videoPtr->format, LatencyTracer::Now());
+  }
+
+  if (_isStandbyPipeline) {
+    // Left to do-timestamp, both selector inputs then share the pipeline running time.
+    return buffer;
+  }
+
+  const auto stamp = videoPtr->header.stamp;
+  const GstClockTime stampTime = stamp.sec * 1000000000UL + stamp.nanosec;
+
+  if (_gstStartTimestamp == 0) {
+    _gstStartTimestamp = _gstTimestamp;
+  }
+
+  const GstClockTime fromStart = stampTime - _gstStartTimestamp;
+  const auto timeDifference = fromStart - _gstTimestamp;
+  _gstTimestamp = fromStart;
+
+  GST_BUFFER_PTS(buffer) = (gint64)fromStart;
+  GST_BUFFER_DURATION(buffer) = (gint64)timeDifference;
+  return buffer;
+}
+
+void GstInterface::ReleaseWrappedMessage(gpointer data)
+{
+  delete static_cast<CompressedImageMsg::SharedPtr *>(data);
+}
+
+void GstInterface::PreloadElements()
+{
+  static std::once_flag preloaded;
+  std::call_once(
+    preloaded, []() {
+      const char * names[] = {
+        "appsrc", "videotestsrc", "videoconvert", "textoverlay", "x264enc", "x265enc",
+        "h264parse", "h265parse", "rtph264pay", "rtph265pay", "udpsink", "rtspclientsink",
+        "tee", "queue", "input-selector", "appsink"};
+      for (const char * name : names) {
+        GstElementFactory * factory = gst_element_factory_find(name);
+        if (factory == nullptr) {
+          continue;
+        }
+        GstPluginFeature * loaded = gst_plugin_feature_load(GST_PLUGIN_FEATURE(factory));
+        if (loaded != nullptr) {
+          gst_object_unref(loaded);
+        }
+        gst_object_unref(factory);
+      }
+    });
 }
 
 void * GstInterface::CreatePipeline(gpointer data)
@@ -406,21 +1643,24 @@ void * GstInterface::CreatePipeline(gpointer data)
   GstInterface * gst = (GstInterface *)data;
 
   gint64 end_time;
-  end_time = g_get_monotonic_time() + 2 * G_TIME_SPAN_SECOND;
-  g_mutex_lock(&gst->haveDataCondMutex);
-  while (gst->queue.empty()) {
-    if (!g_cond_wait_until(&gst->haveDataCond, &gst->haveDataCondMutex, end_time)) {
+  end_time = g_get_monotonic_time() + gst->_pipelineDataWaitMs * G_TIME_SPAN_MILLISECOND;
+  // While the camera boots, load the plugins so that building either pipeline is quick.
+  PreloadElements();
+  gst->_isStreamDefault = false;
+  while (!gst->_hotStandby) {
+    const gint64 remaining_ms = (end_time - g_get_monotonic_time()) / G_TIME_SPAN_MILLISECOND;
+    if (gst->_queue.WaitForData((int)std::max<gint64>(0, std::min<gint64>(100, remaining_ms)))) {
+      break;
+    }
+    if (gst->_isStreamShutdown || g_get_monotonic_time() >= end_time) {
       std::cout << "Queue is empty after timeout! Building default pipeline." << std::endl;
       gst->_isStreamDefault = true;
       break;
-    }else {
-      std::cout << "Queue is not empty after timeout! Building camera streaming pipeline." << std::endl;
-      gst->_isStreamDefault = false;
-      break;
-
     }
   }
-  g_mutex_unlock(&gst->haveDataCondMutex);
+  if (!gst->_isStreamDefault) {
+    std::cout << "Queue is not empty! Building camera streaming pipeline." << std::endl;
+  }
 
   gst->BuildPipeline();
   g_thread_exit(gst->_mCreatePipelineThread);
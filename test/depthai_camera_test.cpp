@@ -1,8 +1,22 @@
 #include "depthai_camera.h"
+#include "depthai_utils.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
 
 using ImageMsg = depthai_ctrl::DepthAICamera::ImageMsg;
 using CompressedImageMsg = depthai_ctrl::DepthAICamera::CompressedImageMsg;
+using PointCloudMsg = depthai_ctrl::DepthAICamera::PointCloudMsg;
 
 int main(int argc, char* argv[])
 {
@@ -12,6 +26,104 @@ int main(int argc, char* argv[])
     return RUN_ALL_TESTS();
 }
 
+namespace
+{
+/// Frame of a recording at 25 FPS, the host and device timestamps follow the sequence number
+depthai_ctrl::RecordedFrame RecordingFrame(
+    const std::string & stream, dai::RawImgFrame::Type type, uint32_t width, uint32_t height,
+    int sequence)
+{
+    depthai_ctrl::RecordedFrame frame;
+    frame.stream = stream;
+    frame.type = (uint32_t)type;
+    frame.width = width;
+    frame.height = height;
+    frame.sequenceNum = sequence;
+    frame.timestampNs = 1000000000 + sequence * 40000000LL;
+    frame.timestampDeviceNs = frame.timestampNs;
+    return frame;
+}
+
+/// Write a recording with the frames made for each of count captures, returns false if it
+/// cannot be written
+bool WriteRecording(
+    const std::string & path, int count,
+    const std::function<std::vector<depthai_ctrl::RecordedFrame>(int)> & frames)
+{
+    depthai_ctrl::FrameRecordWriter writer;
+    if (!writer.Open(path)) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        for (const auto & frame : frames(i)) {
+            if (!writer.Write(frame)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// Write a recording of 10 encoded chunks at 25 FPS, returns false if it cannot be written
+bool WriteVideoRecording(const std::string & path)
+{
+    return WriteRecording(path, 10, [](int i) {
+        auto chunk = RecordingFrame("enc26xColor", dai::RawImgFrame::Type::BITSTREAM, 0, 0, i);
+        chunk.data.assign(1000, (uint8_t)i);
+        return std::vector<depthai_ctrl::RecordedFrame>{chunk};
+    });
+}
+
+/// Options of a camera node replaying a recording, with the given parameters on top
+rclcpp::NodeOptions ReplayOptions(
+    const std::string & path, const std::vector<rclcpp::Parameter> & parameters)
+{
+    rclcpp::NodeOptions options;
+    options.parameter_overrides({{"frame_source", "replay"}, {"replay_path", path}});
+    options.parameter_overrides().insert(
+        options.parameter_overrides().end(), parameters.begin(), parameters.end());
+    return options;
+}
+
+/// Spin the executor for a while, so that the published messages are handled
+void SpinFor(rclcpp::Executor & executor, std::chrono::milliseconds duration)
+{
+    const auto deadline = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < deadline) {
+        executor.spin_some(std::chrono::milliseconds(10));
+    }
+}
+
+/// Node subscribing to the topics of a camera under test, with its own executor.
+/// The subscription callbacks and the checks of the test share the mutex.
+struct TestSubscriber
+{
+    explicit TestSubscriber(const std::string & name)
+    : node(std::make_shared<rclcpp::Node>(name))
+    {
+        executor.add_node(node);
+    }
+
+    /// Spin until done returns true, it is called under the mutex
+    bool SpinUntil(std::chrono::milliseconds timeout, const std::function<bool()> & done)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::chrono::steady_clock::now() < deadline) {
+            executor.spin_some(std::chrono::milliseconds(10));
+            std::lock_guard<std::mutex> lock(mutex);
+            if (done()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::shared_ptr<rclcpp::Node> node;
+    rclcpp::executors::SingleThreadedExecutor executor;
+    std::mutex mutex;
+};
+}  // namespace
+
 /// DepthAI camera is not connected, but ROS Node must not crush anyway
 TEST(DepthAICameraTest, BasicTest)
 {
@@ -40,3 +152,1234 @@ TEST(DepthAICameraTest, BasicTest)
 
     EXPECT_NO_THROW(camera_node.reset());
 }
+
+/// Recorded frames are played back through the callbacks and publishers without a device
+TEST(DepthAICameraTest, ReplayFrameSource)
+{
+    const std::string path = "/tmp/depthai_camera_test.dairec";
+    const int64_t frameIntervalNs = 40000000;
+    const int64_t deviceStartNs = 5000000000;
+    ASSERT_TRUE(WriteRecording(path, 10, [&](int i) {
+        auto chunk = RecordingFrame("enc26xColor", dai::RawImgFrame::Type::BITSTREAM, 0, 0, i);
+        chunk.sequenceNum = 100 + i;
+        chunk.timestampDeviceNs = deviceStartNs + i * frameIntervalNs;
+        chunk.data.assign(1000, (uint8_t)i);
+
+        depthai_ctrl::RecordedFrame left = chunk;
+        left.stream = "left";
+        left.type = (uint32_t)dai::RawImgFrame::Type::GRAY8;
+        left.width = 64;
+        left.height = 48;
+        left.data.assign(64 * 48, (uint8_t)i);
+        return std::vector<depthai_ctrl::RecordedFrame>{chunk, left};
+    }));
+
+    const rclcpp::NodeOptions options = ReplayOptions(path, {
+        {"replay_loop", true},
+        {"use_mono_cams", true},
+        // The chunks are checked against the recorded device time.
+        {"use_clock_estimator", false}});
+
+    TestSubscriber subscriber("replay_subscriber");
+    std::vector<int64_t> videoStamps;
+    std::vector<uint8_t> videoData;
+    int leftFrames = 0;
+    auto video_subscriber = subscriber.node->create_subscription<CompressedImageMsg>(
+        "camera/color/video", rclcpp::QoS(rclcpp::KeepLast(10)),
+        [&](const CompressedImageMsg::SharedPtr msg) {
+            std::lock_guard<std::mutex> lock(subscriber.mutex);
+            videoStamps.push_back(rclcpp::Time(msg->header.stamp).nanoseconds());
+            videoData.push_back(msg->data.empty() ? 0xff : msg->data[0]);
+        });
+    auto left_subscriber = subscriber.node->create_subscription<ImageMsg>(
+        "camera/left/image_raw", rclcpp::SensorDataQoS(),
+        [&](const ImageMsg::SharedPtr msg) {
+            std::lock_guard<std::mutex> lock(subscriber.mutex);
+            EXPECT_EQ("mono8", msg->encoding);
+            EXPECT_EQ(64U, msg->width);
+            EXPECT_EQ(48U, msg->height);
+            EXPECT_EQ(64U * 48U, msg->data.size());
+            leftFrames++;
+        });
+
+    std::shared_ptr<depthai_ctrl::DepthAICamera> camera_node;
+    EXPECT_NO_THROW(camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options));
+    EXPECT_TRUE(camera_node->WaitForBoot(std::chrono::seconds(5)));
+    subscriber.SpinUntil(std::chrono::seconds(10), [&] {
+        return videoStamps.size() >= 15 && leftFrames >= 15;
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(subscriber.mutex);
+        ASSERT_GE(videoStamps.size(), 15UL);
+        EXPECT_GE(leftFrames, 15);
+        // Chunks carry the recorded device time, looping continues the timeline.
+        for (size_t i = 0; i < videoStamps.size(); i++) {
+            EXPECT_EQ(0, (videoStamps[i] - deviceStartNs) % frameIntervalNs);
+            EXPECT_EQ((videoStamps[i] - deviceStartNs) / frameIntervalNs % 10, videoData[i]);
+            if (i > 0) {
+                EXPECT_GT(videoStamps[i], videoStamps[i - 1]);
+            }
+        }
+    }
+
+    EXPECT_NO_THROW(camera_node.reset());
+    std::remove(path.c_str());
+}
+
+/// Raw images are published from preallocated or loaned messages, without allocating per frame
+TEST(DepthAICameraTest, PooledImageMessages)
+{
+    const std::string path = "/tmp/depthai_camera_pool_test.dairec";
+    ASSERT_TRUE(WriteRecording(path, 30, [](int i) {
+        auto left = RecordingFrame("left", dai::RawImgFrame::Type::GRAY8, 1280, 720, i);
+        left.data.assign(1280 * 720, (uint8_t)i);
+        return std::vector<depthai_ctrl::RecordedFrame>{left};
+    }));
+
+    const rclcpp::NodeOptions options = ReplayOptions(path, {{"use_mono_cams", true}});
+
+    // Each frame carries its sequence number in every pixel.
+    TestSubscriber subscriber("pool_subscriber");
+    std::vector<int> received;
+    auto left_subscriber = subscriber.node->create_subscription<ImageMsg>(
+        "camera/left/image_raw", rclcpp::SensorDataQoS().keep_last(30),
+        [&](const ImageMsg::SharedPtr msg) {
+            std::lock_guard<std::mutex> lock(subscriber.mutex);
+            EXPECT_EQ("mono8", msg->encoding);
+            EXPECT_EQ(1280U, msg->width);
+            EXPECT_EQ(720U, msg->height);
+            EXPECT_EQ(1280U, msg->step);
+            ASSERT_EQ(1280U * 720U, msg->data.size());
+            EXPECT_EQ(msg->data.front(), msg->data[640 * 360]);
+            EXPECT_EQ(msg->data.front(), msg->data.back());
+            received.push_back(msg->data.front());
+        });
+
+    auto camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options);
+    camera_node->WaitForBoot(std::chrono::seconds(5));
+    const uint64_t allocations = camera_node->GetImageMessageAllocations();
+    subscriber.SpinUntil(std::chrono::seconds(10), [&] {return !camera_node->IsNodeRunning();});
+    // The last images may still be on their way.
+    SpinFor(subscriber.executor, std::chrono::milliseconds(500));
+    EXPECT_FALSE(camera_node->IsNodeRunning());
+    EXPECT_EQ(30UL, camera_node->GetPooledImageMessages() + camera_node->GetLoanedImageMessages());
+    EXPECT_EQ(allocations, camera_node->GetImageMessageAllocations());
+
+    {
+        std::lock_guard<std::mutex> lock(subscriber.mutex);
+        // Best effort may drop a large image, but a reused message never repeats an old one.
+        EXPECT_GE(received.size(), 15UL);
+        for (size_t i = 0; i < received.size(); i++) {
+            EXPECT_LT(received[i], 30);
+            if (i > 0) {
+                EXPECT_GT(received[i], received[i - 1]);
+            }
+        }
+    }
+
+    camera_node.reset();
+    std::remove(path.c_str());
+}
+
+/// Only the levels up to the last subscribed one are computed, each from the previous level
+TEST(DepthAICameraTest, ColorPyramid)
+{
+    const std::string path = "/tmp/depthai_camera_pyramid_test.dairec";
+    ASSERT_TRUE(WriteRecording(path, 10, [](int i) {
+        auto color = RecordingFrame("color", dai::RawImgFrame::Type::BGR888i, 64, 48, i);
+        for (int p = 0; p < 64 * 48; p++) {
+            // Columns alternate between 10 and 30 blue, the 2x2 average is 20.
+            color.data.push_back(p % 2 == 0 ? 10 : 30);
+            color.data.push_back(100);
+            color.data.push_back(200);
+        }
+        return std::vector<depthai_ctrl::RecordedFrame>{color};
+    }));
+
+    const rclcpp::NodeOptions options = ReplayOptions(path, {
+        {"replay_loop", true},
+        {"use_raw_color_cam", true},
+        {"color_pyramid_levels", 3}});
+
+    TestSubscriber subscriber("pyramid_subscriber");
+    int levelFrames = 0;
+    auto level_subscriber = subscriber.node->create_subscription<ImageMsg>(
+        "camera/color/pyramid/level_2", rclcpp::SensorDataQoS(),
+        [&](const ImageMsg::SharedPtr msg) {
+            std::lock_guard<std::mutex> lock(subscriber.mutex);
+            EXPECT_EQ("bgr8", msg->encoding);
+            EXPECT_EQ(16U, msg->width);
+            EXPECT_EQ(12U, msg->height);
+            EXPECT_EQ(16U * 3U, msg->step);
+            ASSERT_EQ(16U * 12U * 3U, msg->data.size());
+            EXPECT_EQ(20, msg->data[0]);
+            EXPECT_EQ(100, msg->data[1]);
+            EXPECT_EQ(200, msg->data[2]);
+            levelFrames++;
+        });
+
+    auto camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options);
+    subscriber.SpinUntil(std::chrono::seconds(10), [&] {return levelFrames >= 10;});
+    camera_node->Stop();
+
+    std::lock_guard<std::mutex> lock(subscriber.mutex);
+    EXPECT_GE(levelFrames, 10);
+    // Levels 1 and 2 per frame, the unsubscribed level 3 is skipped.
+    EXPECT_EQ(0UL, camera_node->GetPyramidImages() % 2);
+    EXPECT_GE(camera_node->GetPyramidImages(), 2UL * levelFrames);
+    std::remove(path.c_str());
+}
+
+TEST(ImageKernelsTest, SimdMatchesScalar)
+{
+    using depthai_ctrl::OutputEncoding;
+    using depthai_ctrl::PixelFormat;
+    const PixelFormat formats[] = {
+        PixelFormat::NV12, PixelFormat::YUV422i, PixelFormat::BGR888p, PixelFormat::RGB888p,
+        PixelFormat::BGR888i, PixelFormat::RGB888i, PixelFormat::GRAY8};
+    const OutputEncoding encodings[] = {
+        OutputEncoding::BGR8, OutputEncoding::RGB8, OutputEncoding::Mono8};
+    // Widths below, at and past the 16 pixel blocks, so that the scalar tail is covered.
+    const uint32_t sizes[][2] = {{2, 2}, {16, 2}, {18, 4}, {46, 6}, {130, 10}};
+    const depthai_ctrl::SimdLevel level = depthai_ctrl::image_kernels::DetectSimdLevel();
+    uint32_t seed = 1;
+
+    for (PixelFormat format : formats) {
+        for (OutputEncoding encoding : encodings) {
+            for (const auto & size : sizes) {
+                std::vector<uint8_t> src(
+                    depthai_ctrl::image_kernels::InputSize(format, size[0], size[1]));
+                for (uint8_t & value : src) {
+                    seed = seed * 1103515245 + 12345;
+                    value = (uint8_t)(seed >> 16);
+                }
+                const size_t outputSize =
+                    depthai_ctrl::image_kernels::OutputSize(encoding, size[0], size[1]);
+                std::vector<uint8_t> reference(outputSize), simd(outputSize);
+                ASSERT_TRUE(depthai_ctrl::ConvertPixels(
+                    format, encoding, src.data(), size[0], size[1], reference.data(),
+                    depthai_ctrl::SimdLevel::Scalar));
+                ASSERT_TRUE(depthai_ctrl::ConvertPixels(
+                    format, encoding, src.data(), size[0], size[1], simd.data(), level));
+                EXPECT_EQ(reference, simd) << "format " << (int)format << " encoding " <<
+                    (int)encoding << " width " << size[0];
+            }
+        }
+    }
+
+    // Limited range white and full range red
+    const uint8_t nv12[6] = {235, 235, 235, 235, 128, 128};
+    uint8_t rgb[12];
+    ASSERT_TRUE(depthai_ctrl::ConvertPixels(
+        PixelFormat::NV12, OutputEncoding::RGB8, nv12, 2, 2, rgb));
+    EXPECT_EQ(255, rgb[0]);
+    EXPECT_EQ(255, rgb[1]);
+    EXPECT_EQ(255, rgb[2]);
+    const uint8_t bgr[3] = {0, 0, 255};
+    uint8_t gray = 0;
+    ASSERT_TRUE(depthai_ctrl::ConvertPixels(
+        PixelFormat::BGR888i, OutputEncoding::Mono8, bgr, 1, 1, &gray));
+    EXPECT_EQ(77, gray);
+    EXPECT_FALSE(depthai_ctrl::ConvertPixels(
+        PixelFormat::NV12, OutputEncoding::RGB8, nv12, 1, 2, rgb));
+}
+
+TEST(PointCloudTest, SyntheticDepthMap)
+{
+    depthai_ctrl::DepthIntrinsics intrinsics;
+    intrinsics.width = 101;
+    intrinsics.height = 7;
+    intrinsics.fx = 80.0f;
+    intrinsics.fy = 82.0f;
+    intrinsics.cx = 50.0f;
+    intrinsics.cy = 3.0f;
+    depthai_ctrl::DepthRayTable rays;
+    rays.Build(intrinsics);
+    ASSERT_EQ(101U * 7U, rays.Size());
+
+    // A slanted plane with holes, the width leaves a tail after the SIMD blocks.
+    std::vector<uint16_t> depth(rays.Size());
+    for (size_t i = 0; i < depth.size(); i++) {
+        depth[i] = i % 5 == 0 ? 0 : (uint16_t)(1000 + i * 7);
+    }
+    std::vector<uint8_t> reference(depth.size() * depthai_ctrl::point_cloud::kPointStep);
+    std::vector<uint8_t> simd(reference.size());
+    depthai_ctrl::DepthToPoints(
+        depth.data(), rays, 0.001f, reference.data(), depthai_ctrl::SimdLevel::Scalar);
+    depthai_ctrl::DepthToPoints(
+        depth.data(), rays, 0.001f, simd.data(),
+        depthai_ctrl::image_kernels::DetectSimdLevel());
+    EXPECT_EQ(0, std::memcmp(reference.data(), simd.data(), reference.size()));
+
+    const float * points = reinterpret_cast<const float *>(simd.data());
+    for (uint32_t v = 0; v < intrinsics.height; v++) {
+        for (uint32_t u = 0; u < intrinsics.width; u++) {
+            const size_t i = v * intrinsics.width + u;
+            const float * point = points + i * 4;
+            if (depth[i] == 0) {
+                EXPECT_TRUE(std::isnan(point[0]) && std::isnan(point[1]) && std::isnan(point[2]));
+                continue;
+            }
+            const float z = depth[i] * 0.001f;
+            EXPECT_FLOAT_EQ(z, point[2]);
+            EXPECT_NEAR((u - intrinsics.cx) / intrinsics.fx * z, point[0], 1e-6);
+            EXPECT_NEAR((v - intrinsics.cy) / intrinsics.fy * z, point[1], 1e-6);
+        }
+    }
+}
+
+/// The point cloud follows the replayed depth frames, only while it has a subscriber
+TEST(DepthAICameraTest, StereoDepthPointCloud)
+{
+    const std::string path = "/tmp/depthai_camera_depth_test.dairec";
+    ASSERT_TRUE(WriteRecording(path, 10, [](int i) {
+        auto depth = RecordingFrame("depth", dai::RawImgFrame::Type::RAW16, 64, 48, i);
+        // A wall at 2 m
+        const std::vector<uint16_t> wall(64 * 48, 2000);
+        depth.data.assign(
+            reinterpret_cast<const uint8_t *>(wall.data()),
+            reinterpret_cast<const uint8_t *>(wall.data() + wall.size()));
+        return std::vector<depthai_ctrl::RecordedFrame>{depth};
+    }));
+
+    const rclcpp::NodeOptions options = ReplayOptions(path, {
+        {"replay_loop", true},
+        {"use_stereo_depth", true},
+        {"depth_hfov_deg", 90.0}});
+
+    TestSubscriber subscriber("points_subscriber");
+    int clouds = 0;
+    auto points_subscriber = subscriber.node->create_subscription<PointCloudMsg>(
+        "camera/depth/points", rclcpp::SensorDataQoS(),
+        [&](const PointCloudMsg::SharedPtr msg) {
+            std::lock_guard<std::mutex> lock(subscriber.mutex);
+            EXPECT_EQ(64U, msg->width);
+            EXPECT_EQ(48U, msg->height);
+            EXPECT_EQ(16U, msg->point_step);
+            ASSERT_EQ(3U, msg->fields.size());
+            ASSERT_EQ(64U * 48U * 16U, msg->data.size());
+            // With a 90 degree field of view the left edge is about as far out as the wall.
+            const float * first = reinterpret_cast<const float *>(msg->data.data());
+            EXPECT_NEAR(-2.0f * 31.5f / 32.0f, first[0], 1e-4);
+            EXPECT_FLOAT_EQ(2.0f, first[2]);
+            clouds++;
+        });
+
+    auto camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options);
+    EXPECT_TRUE(subscriber.SpinUntil(std::chrono::seconds(10), [&] {return clouds >= 10;}));
+
+    // Without the subscriber no cloud is computed any more.
+    points_subscriber.reset();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    const uint64_t computed = camera_node->GetPointClouds();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(computed, camera_node->GetPointClouds());
+    camera_node->Stop();
+    std::remove(path.c_str());
+}
+
+/// Receive times with 2 - 12 ms of latency, device clock 50 ppm slow
+TEST(ClockDriftTest, SkewAndOffset)
+{
+    depthai_ctrl::ClockDriftEstimator estimator;
+    const int64_t offsetNs = 123456789000LL;
+    uint32_t seed = 7;
+    int64_t lastStamp = 0;
+    for (int i = 0; i < 3000; i++) {
+        const int64_t deviceNs = 1000000000LL + i * 33333333LL;
+        const int64_t captureNs = offsetNs + deviceNs + deviceNs / 20000;
+        seed = seed * 1103515245 + 12345;
+        const int64_t latencyNs = 2000000 + (seed >> 8) % 10000000;
+        estimator.AddSample(deviceNs, captureNs + latencyNs);
+
+        const int64_t stamp = estimator.ToHostNs(deviceNs);
+        if (i > 30) {
+            // The stamps follow the fastest frames, the callback jitter is gone.
+            EXPECT_NEAR(captureNs + 2000000, stamp, 2000000) << "frame " << i;
+            EXPECT_GT(stamp, lastStamp);
+        }
+        lastStamp = stamp;
+    }
+    const depthai_ctrl::ClockDriftStats stats = estimator.GetStats();
+    EXPECT_NEAR(50.0, stats.skewPpm, 5.0);
+    EXPECT_NEAR(2.9, stats.residualRmsUs / 1000.0, 0.3);
+    EXPECT_EQ(0UL, stats.resets);
+
+    // A restarted device starts its clock again, the model follows at once.
+    estimator.AddSample(1000000000LL, lastStamp + 100000000LL);
+    EXPECT_EQ(1UL, estimator.GetStats().resets);
+    EXPECT_EQ(lastStamp + 100000000LL, estimator.ToHostNs(1000000000LL));
+
+    // Mono and video frames feed one estimator. The encoded frame of a capture arrives
+    // after the mono frame of the next one, the older samples are no clock jump.
+    depthai_ctrl::ClockDriftEstimator interleaved;
+    for (int i = 0; i < 900; i++) {
+        const int64_t deviceNs = 1000000000LL + i * 33333333LL;
+        const int64_t captureNs = offsetNs + deviceNs + deviceNs / 20000;
+        seed = seed * 1103515245 + 12345;
+        interleaved.AddSample(deviceNs, captureNs + 2000000 + (seed >> 8) % 10000000);
+        if (i > 0) {
+            const int64_t videoDeviceNs = deviceNs - 33333333LL + 16666666LL;
+            const int64_t videoCaptureNs = offsetNs + videoDeviceNs + videoDeviceNs / 20000;
+            interleaved.AddSample(videoDeviceNs, videoCaptureNs + 40000000);
+            EXPECT_NEAR(
+                videoCaptureNs + 2000000, interleaved.ToHostNs(videoDeviceNs), 2000000)
+                << "frame " << i;
+        }
+    }
+    const depthai_ctrl::ClockDriftStats interleavedStats = interleaved.GetStats();
+    EXPECT_EQ(0UL, interleavedStats.resets);
+    EXPECT_EQ(1799UL, interleavedStats.samples);
+    EXPECT_NEAR(50.0, interleavedStats.skewPpm, 5.0);
+}
+
+/// Target bitrates of the GStreamer node reach the encoder with hysteresis
+TEST(DepthAICameraTest, AdaptiveBitrateTarget)
+{
+    const std::string path = "/tmp/depthai_camera_bitrate_test.dairec";
+    ASSERT_TRUE(WriteVideoRecording(path));
+
+    rclcpp::NodeOptions options;
+    options.parameter_overrides({
+        {"frame_source", "replay"},
+        {"replay_path", path},
+        {"replay_loop", true},
+        {"adaptive_bitrate", true},
+        {"adaptive_bitrate_interval_ms", 0}});
+    auto camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options);
+    ASSERT_TRUE(camera_node->WaitForBoot(std::chrono::seconds(5)));
+    EXPECT_EQ(3000000, camera_node->GetVideoBitrate());
+
+    auto publisher_node = std::make_shared<rclcpp::Node>("bitrate_target_publisher");
+    auto publisher = publisher_node->create_publisher<std_msgs::msg::String>(
+        "videostreambitrate", rclcpp::SystemDefaultsQoS());
+    rclcpp::executors::SingleThreadedExecutor executor;
+    executor.add_node(camera_node);
+    executor.add_node(publisher_node);
+    auto publish = [&](int bitrate) {
+        std_msgs::msg::String msg;
+        msg.data = "{\"TargetBitrate\":" + std::to_string(bitrate) + "}";
+        publisher->publish(msg);
+        SpinFor(executor, std::chrono::seconds(1));
+    };
+
+    // Within the hysteresis, the encoder keeps its bitrate.
+    publish(2800000);
+    EXPECT_EQ(3000000, camera_node->GetVideoBitrate());
+    EXPECT_EQ(0UL, camera_node->GetBitrateChanges());
+    publish(2000000);
+    EXPECT_EQ(2000000, camera_node->GetVideoBitrate());
+    EXPECT_EQ(1UL, camera_node->GetBitrateChanges());
+    // The restarted pipeline keeps streaming.
+    EXPECT_TRUE(camera_node->IsNodeRunning());
+
+    camera_node->Stop();
+    std::remove(path.c_str());
+}
+
+/// Configuration diff: controls and host stream switches keep the device pipeline
+TEST(CameraConfigTest, ClassifyReconfigure)
+{
+    using depthai_ctrl::ReconfigureKind;
+    depthai_ctrl::CameraConfig pipeline;
+    pipeline.useMonoCams = true;
+    depthai_ctrl::CameraConfig current = pipeline;
+    EXPECT_EQ(ReconfigureKind::None, depthai_ctrl::ClassifyReconfigure(pipeline, current, current));
+
+    depthai_ctrl::CameraConfig requested = current;
+    requested.lensPosition = 50;
+    requested.exposureUs = 10000;
+    requested.region = depthai_ctrl::CameraRegion{100, 100, 640, 480};
+    EXPECT_EQ(ReconfigureKind::Control, depthai_ctrl::ClassifyReconfigure(pipeline, current, requested));
+
+    // The mono streams of the running pipeline are switched on the host.
+    requested.useMonoCams = false;
+    EXPECT_EQ(ReconfigureKind::Host, depthai_ctrl::ClassifyReconfigure(pipeline, current, requested));
+    current.useMonoCams = false;
+    requested.useMonoCams = true;
+    EXPECT_EQ(ReconfigureKind::Host, depthai_ctrl::ClassifyReconfigure(pipeline, current, requested));
+
+    // Streams the pipeline was built without and encoder settings need a new pipeline.
+    requested.useRawColorCam = true;
+    EXPECT_EQ(ReconfigureKind::Reboot, depthai_ctrl::ClassifyReconfigure(pipeline, current, requested));
+    requested = current;
+    requested.bitrate = 2000000;
+    EXPECT_EQ(ReconfigureKind::Reboot, depthai_ctrl::ClassifyReconfigure(pipeline, current, requested));
+    requested = current;
+    requested.h265 = true;
+    EXPECT_EQ(ReconfigureKind::Reboot, depthai_ctrl::ClassifyReconfigure(pipeline, current, requested));
+}
+
+/// Start commands to a running camera only reopen the source for pipeline changes
+TEST(DepthAICameraTest, FastReconfiguration)
+{
+    const std::string path = "/tmp/depthai_camera_reconfigure_test.dairec";
+    ASSERT_TRUE(WriteVideoRecording(path));
+
+    rclcpp::NodeOptions options;
+    options.parameter_overrides({
+        {"frame_source", "replay"},
+        {"replay_path", path},
+        {"replay_loop", true}});
+    auto camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options);
+    ASSERT_TRUE(camera_node->WaitForBoot(std::chrono::seconds(5)));
+
+    auto publisher_node = std::make_shared<rclcpp::Node>("reconfigure_command_publisher");
+    auto publisher = publisher_node->create_publisher<std_msgs::msg::String>(
+        "videostreamcmd", rclcpp::SystemDefaultsQoS());
+    rclcpp::executors::SingleThreadedExecutor executor;
+    executor.add_node(camera_node);
+    executor.add_node(publisher_node);
+    auto command = [&](const std::string & json) {
+        std_msgs::msg::String msg;
+        msg.data = json;
+        publisher->publish(msg);
+        SpinFor(executor, std::chrono::seconds(1));
+    };
+
+    using depthai_ctrl::ReconfigureKind;
+    command("{\"Command\":\"start\",\"LensPosition\":60,\"ExposureUs\":8000,\"Iso\":400}");
+    EXPECT_EQ(60, camera_node->GetConfig().lensPosition);
+    EXPECT_EQ(8000, camera_node->GetConfig().exposureUs);
+    EXPECT_EQ(1UL, camera_node->GetReconfigureStats(ReconfigureKind::Control).count);
+    EXPECT_EQ(0UL, camera_node->GetReconfigureStats(ReconfigureKind::Reboot).count);
+
+    // Same settings again, nothing to do.
+    command("{\"Command\":\"start\",\"LensPosition\":60}");
+    EXPECT_EQ(1UL, camera_node->GetReconfigureStats(ReconfigureKind::Control).count);
+
+    command("{\"Command\":\"start\",\"Bitrate\":2000000}");
+    EXPECT_EQ(2000000, camera_node->GetConfig().bitrate);
+    EXPECT_EQ(1UL, camera_node->GetReconfigureStats(ReconfigureKind::Reboot).count);
+    EXPECT_GT(camera_node->GetReconfigureStats(ReconfigureKind::Reboot).lastMs, 0.0);
+    EXPECT_TRUE(camera_node->IsNodeRunning());
+
+    camera_node->Stop();
+    std::remove(path.c_str());
+}
+
+/// The constructor returns before the device is opened, the boot runs in the background
+TEST(DepthAICameraTest, AsyncBoot)
+{
+    const int64_t uptime = depthai_ctrl::DepthAIUtils::GetProcessUptimeMs();
+    EXPECT_GE(uptime, 0);
+
+    // No device is connected, the open attempts must not block the constructor.
+    auto start = std::chrono::steady_clock::now();
+    auto device_node = std::make_shared<depthai_ctrl::DepthAICamera>();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    EXPECT_FALSE(device_node->WaitForBoot(std::chrono::seconds(30)));
+    EXPECT_EQ(-1, device_node->GetBootTimeMs());
+    EXPECT_EQ(-1, device_node->GetTimeToFirstFrameMs());
+    device_node.reset();
+
+    const std::string path = "/tmp/depthai_camera_boot_test.dairec";
+    ASSERT_TRUE(WriteVideoRecording(path));
+
+    rclcpp::NodeOptions options;
+    options.parameter_overrides({
+        {"frame_source", "replay"},
+        {"replay_path", path},
+        {"replay_loop", true}});
+    auto camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options);
+    ASSERT_TRUE(camera_node->WaitForBoot(std::chrono::seconds(5)));
+    EXPECT_GE(camera_node->GetBootTimeMs(), 0);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (camera_node->GetTimeToFirstFrameMs() < 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // Counted from the process start, not from the constructor.
+    EXPECT_GE(camera_node->GetTimeToFirstFrameMs(), uptime);
+    EXPECT_LE(camera_node->GetTimeToFirstFrameMs(), depthai_ctrl::DepthAIUtils::GetProcessUptimeMs());
+
+    camera_node->Stop();
+    std::remove(path.c_str());
+}
+
+/// Shared memory ring: every client reads every frame, held slots are not overwritten,
+/// slots of a crashed client are reclaimed
+TEST(ShmFrameRingTest, RefCountedSlots)
+{
+    const std::string name = depthai_ctrl::shm::ObjectName("depthai_ctrl_test", "ring");
+    auto producer = depthai_ctrl::ShmFrameRing::Create(name, 4, 1024);
+    ASSERT_TRUE(producer);
+    auto first = depthai_ctrl::ShmFrameRing::Attach(name);
+    auto second = depthai_ctrl::ShmFrameRing::Attach(name);
+    ASSERT_TRUE(first);
+    ASSERT_TRUE(second);
+    EXPECT_EQ(2, producer->GetClients());
+
+    auto write = [&](int i) {
+        std::vector<uint8_t> data(100 + i, (uint8_t)i);
+        depthai_ctrl::ShmFrameInfo info;
+        info.sequenceNum = i;
+        info.size = (uint32_t)data.size();
+        return producer->Write(info, data.data());
+    };
+    depthai_ctrl::ShmFrameRing::Ref ref;
+    EXPECT_FALSE(first->Read(ref));
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(write(i));
+    }
+    // Both clients read all frames in order, from the same slots.
+    for (int i = 0; i < 3; i++) {
+        depthai_ctrl::ShmFrameRing::Ref a, b;
+        ASSERT_TRUE(first->Read(a));
+        ASSERT_TRUE(second->Read(b));
+        EXPECT_EQ(i, a.Info().sequenceNum);
+        EXPECT_EQ(100U + i, a.Info().size);
+        EXPECT_EQ((uint8_t)i, a.Data()[0]);
+        // Both hold the same slot, each through its own mapping.
+        EXPECT_EQ(a.Sequence(), b.Sequence());
+        EXPECT_EQ(0, std::memcmp(a.Data(), b.Data(), a.Info().size));
+    }
+    EXPECT_FALSE(first->Read(ref));
+
+    // A held frame stays intact while the producer goes around the ring.
+    ASSERT_TRUE(write(3));
+    ASSERT_TRUE(first->Read(ref));
+    EXPECT_EQ(3, ref.Info().sequenceNum);
+    for (int i = 4; i < 10; i++) {
+        ASSERT_TRUE(write(i));
+    }
+    EXPECT_EQ(3, ref.Info().sequenceNum);
+    EXPECT_EQ(3, ref.Data()[0]);
+    // The client fell behind, it continues with the oldest frame in the ring.
+    ref.Reset();
+    ASSERT_TRUE(first->Read(ref));
+    EXPECT_EQ(7, ref.Info().sequenceNum);
+    EXPECT_EQ(3UL, first->GetSkipped());
+    ref.Reset();
+
+    // Too large for a slot
+    std::vector<uint8_t> large(2000);
+    depthai_ctrl::ShmFrameInfo info;
+    info.size = (uint32_t)large.size();
+    EXPECT_FALSE(producer->Write(info, large.data()));
+    EXPECT_EQ(1UL, producer->GetDrops());
+
+    // A client process which dies holding every slot does not stall the producer.
+    first.reset();
+    second.reset();
+    const pid_t child = fork();
+    if (child == 0) {
+        // The child writes through its copy of the producer, and exits holding the slots.
+        auto client = depthai_ctrl::ShmFrameRing::Attach(name);
+        std::vector<depthai_ctrl::ShmFrameRing::Ref> refs(4);
+        for (int i = 0; i < 4; i++) {
+            write(20 + i);
+            client->Read(refs[i]);
+        }
+        _exit(refs[3].IsValid() ? 0 : 1);
+    }
+    int status = 0;
+    ASSERT_EQ(child, waitpid(child, &status, 0));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+    EXPECT_EQ(1, producer->GetClients());
+    EXPECT_TRUE(write(30));
+    EXPECT_EQ(0, producer->GetClients());
+
+    // Readers wake up with the write, and see a closed ring.
+    auto client = depthai_ctrl::ShmFrameRing::Attach(name);
+    ASSERT_TRUE(client);
+    EXPECT_FALSE(client->WaitForData(10));
+    std::thread writer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        write(40);
+    });
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(client->WaitForData(2000));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+    writer.join();
+    EXPECT_FALSE(client->IsClosed());
+    producer.reset();
+    EXPECT_TRUE(client->IsClosed());
+    EXPECT_FALSE(depthai_ctrl::ShmFrameRing::Attach(name));
+
+    // A client posts the configuration it needs, the device owner takes the latest one.
+    const std::string control_name = depthai_ctrl::shm::ObjectName("depthai_ctrl_test", "control");
+    EXPECT_FALSE(depthai_ctrl::ShmDeviceControl::Attach(control_name));
+    auto owner = depthai_ctrl::ShmDeviceControl::Create(control_name);
+    ASSERT_TRUE(owner);
+    auto control = depthai_ctrl::ShmDeviceControl::Attach(control_name);
+    ASSERT_TRUE(control);
+    depthai_ctrl::CameraConfig config;
+    EXPECT_FALSE(owner->TakeConfig(config));
+    config.bitrate = 1000000;
+    EXPECT_TRUE(control->PostConfig(config));
+    config.bitrate = 2000000;
+    EXPECT_TRUE(control->PostConfig(config));
+    depthai_ctrl::CameraConfig taken;
+    ASSERT_TRUE(owner->TakeConfig(taken));
+    EXPECT_EQ(2000000, taken.bitrate);
+    EXPECT_FALSE(owner->TakeConfig(taken));
+
+    // Another client shares the device as it runs, it cannot reboot it under the holder.
+    auto other = depthai_ctrl::ShmDeviceControl::Attach(control_name);
+    ASSERT_TRUE(other);
+    depthai_ctrl::CameraConfig shared = config;
+    shared.useMonoCams = false;
+    EXPECT_TRUE(other->PostConfig(shared));
+    shared.bitrate = 3000000;
+    EXPECT_FALSE(other->PostConfig(shared));
+    shared.bitrate = config.bitrate;
+    shared.exposureUs = 10000;
+    EXPECT_FALSE(other->PostConfig(shared));
+    EXPECT_EQ(2UL, owner->GetRejectedConfigs());
+    EXPECT_FALSE(owner->TakeConfig(taken));
+    // Once the holder detached, the next client to post holds the configuration.
+    control.reset();
+    EXPECT_TRUE(other->PostConfig(shared));
+    ASSERT_TRUE(owner->TakeConfig(taken));
+    EXPECT_EQ(10000, taken.exposureUs);
+    other.reset();
+
+    // A client which is killed, maybe holding the lock, neither wedges the owner nor keeps
+    // the configuration.
+    const pid_t poster = fork();
+    if (poster == 0) {
+        auto crashing = depthai_ctrl::ShmDeviceControl::Attach(control_name);
+        depthai_ctrl::CameraConfig posted;
+        for (int i = 0; crashing; i++) {
+            posted.bitrate = 1000000 + i % 1000;
+            crashing->PostConfig(posted);
+        }
+        _exit(1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    kill(poster, SIGKILL);
+    ASSERT_EQ(poster, waitpid(poster, &status, 0));
+    EXPECT_TRUE(owner->TakeConfig(taken));
+    control = depthai_ctrl::ShmDeviceControl::Attach(control_name);
+    ASSERT_TRUE(control);
+    config.bitrate = 4000000;
+    EXPECT_TRUE(control->PostConfig(config));
+    ASSERT_TRUE(owner->TakeConfig(taken));
+    EXPECT_EQ(4000000, taken.bitrate);
+    depthai_ctrl::ShmDeviceState state;
+    state.running = true;
+    owner->SetState(state);
+    EXPECT_TRUE(control->GetState().running);
+    EXPECT_TRUE(control->IsOwnerAlive());
+    owner.reset();
+    EXPECT_FALSE(control->IsOwnerAlive());
+}
+
+/// A camera node with the device of another process reads the frames from the shared
+/// memory rings and posts its configuration to the device owner
+TEST(DepthAICameraTest, SharedMemoryClient)
+{
+    // Stand-in for the device daemon: the control block and the ring of the video stream
+    const std::string shm_name = "depthai_ctrl_client_test";
+    auto owner = depthai_ctrl::ShmDeviceControl::Create(
+        depthai_ctrl::shm::ObjectName(shm_name, "control"));
+    ASSERT_TRUE(owner);
+    auto ring = depthai_ctrl::ShmFrameRing::Create(
+        depthai_ctrl::shm::ObjectName(shm_name, "enc26xColor"), 8, 4096);
+    ASSERT_TRUE(ring);
+    depthai_ctrl::ShmDeviceState state;
+    state.running = true;
+    std::snprintf(state.connection, sizeof(state.connection), "test device");
+    owner->SetState(state);
+
+    std::mutex ring_mutex;
+    std::atomic<bool> writing(true);
+    std::thread writer([&]() {
+        std::vector<uint8_t> chunk(1000);
+        for (int64_t i = 0; writing; i++) {
+            depthai_ctrl::ShmFrameInfo info;
+            info.type = (uint32_t)dai::RawImgFrame::Type::BITSTREAM;
+            info.sequenceNum = i;
+            info.size = (uint32_t)chunk.size();
+            info.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            info.timestampDeviceNs = info.timestampNs;
+            chunk.assign(chunk.size(), (uint8_t)i);
+            {
+                std::lock_guard<std::mutex> lock(ring_mutex);
+                if (ring) {
+                    ring->Write(info, chunk.data());
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        }
+    });
+
+    std::mutex mutex;
+    int videoChunks = 0;
+    auto subscriber_node = std::make_shared<rclcpp::Node>("shm_subscriber");
+    auto video_subscriber = subscriber_node->create_subscription<CompressedImageMsg>(
+        "camera/color/video", rclcpp::QoS(rclcpp::KeepLast(10)),
+        [&](const CompressedImageMsg::SharedPtr msg) {
+            std::lock_guard<std::mutex> lock(mutex);
+            EXPECT_EQ(1000U, msg->data.size());
+            videoChunks++;
+        });
+    rclcpp::executors::SingleThreadedExecutor executor;
+    executor.add_node(subscriber_node);
+    auto wait_for_chunks = [&](int count) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < deadline) {
+            executor.spin_some(std::chrono::milliseconds(10));
+            std::lock_guard<std::mutex> lock(mutex);
+            if (videoChunks >= count) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    rclcpp::NodeOptions options;
+    options.parameter_overrides({
+        {"frame_source", "shm"},
+        {"shm_name", shm_name},
+        {"bitrate", 2000000}});
+    auto camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options);
+    ASSERT_TRUE(camera_node->WaitForBoot(std::chrono::seconds(5)));
+    EXPECT_TRUE(wait_for_chunks(10));
+
+    // The owner gets the configuration of the client, to reboot the device if needed.
+    depthai_ctrl::CameraConfig posted;
+    ASSERT_TRUE(owner->TakeConfig(posted));
+    EXPECT_EQ(2000000, posted.bitrate);
+    camera_node->Stop();
+    camera_node.reset();
+
+    // The device stays booted, a new client gets video within a few frames.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        videoChunks = 0;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options);
+    ASSERT_TRUE(camera_node->WaitForBoot(std::chrono::seconds(5)));
+    EXPECT_TRUE(wait_for_chunks(1));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+
+    // The client follows a restarted owner.
+    {
+        std::lock_guard<std::mutex> lock(ring_mutex);
+        ring.reset();
+        ring = depthai_ctrl::ShmFrameRing::Create(
+            depthai_ctrl::shm::ObjectName(shm_name, "enc26xColor"), 8, 4096);
+    }
+    ASSERT_TRUE(ring);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        videoChunks = 0;
+    }
+    EXPECT_TRUE(wait_for_chunks(5));
+
+    camera_node->Stop();
+    writing = false;
+    writer.join();
+}
+
+/// Stalls are detected after the missed frame intervals, reopens back off until the
+/// streams deliver again
+TEST(FrameWatchdogTest, StallAndBackoff)
+{
+    depthai_ctrl::FrameWatchdogConfig config;
+    config.missedIntervals = 10;
+    config.firstFrameTimeoutMs = 2000;
+    config.minBackoffMs = 500;
+    config.maxBackoffMs = 1500;
+    depthai_ctrl::FrameWatchdog watchdog(config);
+    EXPECT_FALSE(watchdog.Check(0, false));
+
+    // 25 FPS, a stall after 400 ms without a frame
+    watchdog.Arm({"enc26xColor", "left"}, 25, 0);
+    EXPECT_FALSE(watchdog.Check(1900, true));
+    int64_t now = 0;
+    for (; now < 1000; now += 40) {
+        watchdog.OnFrames("enc26xColor", now);
+        watchdog.OnFrames("left", now);
+        EXPECT_FALSE(watchdog.Check(now, true));
+    }
+    // The left stream stops, the video goes on.
+    const int64_t last_left = now - 40;
+    for (; now < 1400; now += 40) {
+        watchdog.OnFrames("enc26xColor", now);
+        EXPECT_FALSE(watchdog.Check(now, true));
+    }
+    for (; now <= last_left + 400; now += 40) {
+        watchdog.OnFrames("enc26xColor", now);
+        EXPECT_FALSE(watchdog.Check(now, true));
+    }
+    watchdog.OnFrames("enc26xColor", now);
+    EXPECT_TRUE(watchdog.Check(now, true));
+    EXPECT_EQ(1UL, watchdog.GetStats().stalls);
+    EXPECT_EQ("left", watchdog.GetStats().stalledStream);
+    EXPECT_TRUE(watchdog.GetStats().stalled);
+
+    // Reopens back off: 500, 1000, then the maximum of 1500 ms
+    EXPECT_EQ(500, watchdog.OnRecoveryAttempt(now));
+    watchdog.Arm({"enc26xColor", "left"}, 25, now + 300);
+    EXPECT_FALSE(watchdog.Check(now + 700, true));
+    now += 800;
+    EXPECT_TRUE(watchdog.Check(now, true));
+    EXPECT_EQ(1000, watchdog.OnRecoveryAttempt(now));
+    EXPECT_FALSE(watchdog.Check(now + 999, true));
+    now += 1000;
+    EXPECT_TRUE(watchdog.Check(now, true));
+    EXPECT_EQ(1500, watchdog.OnRecoveryAttempt(now));
+    now += 1500;
+    EXPECT_TRUE(watchdog.Check(now, true));
+    EXPECT_EQ(1500, watchdog.OnRecoveryAttempt(now));
+    EXPECT_EQ(4UL, watchdog.GetStats().attempts);
+
+    // Video alone does not end the outage, every stream has to be back.
+    EXPECT_FALSE(watchdog.OnFrames("enc26xColor", now + 100));
+    EXPECT_TRUE(watchdog.GetStats().stalled);
+    EXPECT_TRUE(watchdog.OnFrames("left", now + 120));
+    const depthai_ctrl::FrameWatchdogStats stats = watchdog.GetStats();
+    EXPECT_FALSE(stats.stalled);
+    EXPECT_EQ(1UL, stats.recoveries);
+    EXPECT_DOUBLE_EQ((double)(now + 120 - last_left), stats.lastDowntimeMs);
+    EXPECT_DOUBLE_EQ(stats.lastDowntimeMs, stats.totalDowntimeMs);
+    EXPECT_FALSE(watchdog.Check(now + 130, true));
+
+    // A stopped source is a stall at once, the backoff starts over.
+    EXPECT_TRUE(watchdog.Check(now + 200, false));
+    EXPECT_EQ("device", watchdog.GetStats().stalledStream);
+    EXPECT_EQ(500, watchdog.OnRecoveryAttempt(now + 200));
+    watchdog.Disarm();
+    EXPECT_FALSE(watchdog.Check(now + 5000, false));
+}
+
+/// Frames which stop make the camera node reopen the source until they are back
+TEST(DepthAICameraTest, WatchdogRecovery)
+{
+    // Stand-in for the device daemon, its frames stop for a while
+    const std::string shm_name = "depthai_ctrl_watchdog_test";
+    auto owner = depthai_ctrl::ShmDeviceControl::Create(
+        depthai_ctrl::shm::ObjectName(shm_name, "control"));
+    ASSERT_TRUE(owner);
+    auto ring = depthai_ctrl::ShmFrameRing::Create(
+        depthai_ctrl::shm::ObjectName(shm_name, "enc26xColor"), 8, 4096);
+    ASSERT_TRUE(ring);
+    std::atomic<bool> writing(true);
+    std::atomic<bool> paused(false);
+    std::thread writer([&]() {
+        std::vector<uint8_t> chunk(1000);
+        for (int64_t i = 0; writing; i++) {
+            if (!paused) {
+                depthai_ctrl::ShmFrameInfo info;
+                info.type = (uint32_t)dai::RawImgFrame::Type::BITSTREAM;
+                info.sequenceNum = i;
+                info.size = (uint32_t)chunk.size();
+                ring->Write(info, chunk.data());
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        }
+    });
+
+    rclcpp::NodeOptions options;
+    options.parameter_overrides({
+        {"frame_source", "shm"},
+        {"shm_name", shm_name},
+        {"watchdog_min_backoff_ms", 200},
+        {"watchdog_max_backoff_ms", 400}});
+    auto camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options);
+    ASSERT_TRUE(camera_node->WaitForBoot(std::chrono::seconds(5)));
+
+    std::mutex mutex;
+    std::vector<std::string> reports;
+    auto subscriber_node = std::make_shared<rclcpp::Node>("watchdog_subscriber");
+    auto watchdog_subscriber = subscriber_node->create_subscription<std_msgs::msg::String>(
+        "camera/watchdog", rclcpp::SystemDefaultsQoS(),
+        [&](const std_msgs::msg::String::SharedPtr msg) {
+            std::lock_guard<std::mutex> lock(mutex);
+            reports.push_back(msg->data);
+        });
+    rclcpp::executors::SingleThreadedExecutor executor;
+    executor.add_node(camera_node);
+    executor.add_node(subscriber_node);
+    // Frames every 40 ms, nothing to do.
+    SpinFor(executor, std::chrono::milliseconds(1000));
+    EXPECT_EQ(0UL, camera_node->GetWatchdogStats().stalls);
+
+    // 25 FPS and 10 missed intervals: a stall after 400 ms, reopens every 200 - 400 ms
+    paused = true;
+    SpinFor(executor, std::chrono::milliseconds(1500));
+    depthai_ctrl::FrameWatchdogStats stats = camera_node->GetWatchdogStats();
+    EXPECT_EQ(1UL, stats.stalls);
+    EXPECT_TRUE(stats.stalled);
+    EXPECT_EQ("enc26xColor", stats.stalledStream);
+    EXPECT_GE(stats.attempts, 2UL);
+    EXPECT_LE(stats.attempts, 5UL);
+
+    paused = false;
+    SpinFor(executor, std::chrono::milliseconds(1000));
+    stats = camera_node->GetWatchdogStats();
+    EXPECT_FALSE(stats.stalled);
+    EXPECT_EQ(1UL, stats.recoveries);
+    EXPECT_GE(stats.lastDowntimeMs, 1500.0);
+    EXPECT_LT(stats.lastDowntimeMs, 2500.0);
+    EXPECT_TRUE(camera_node->IsNodeRunning());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ASSERT_FALSE(reports.empty());
+        EXPECT_NE(std::string::npos, reports.back().find("\"Recoveries\":1"));
+    }
+
+    camera_node->Stop();
+    writing = false;
+    writer.join();
+}
+
+/// A device which is missing at startup is opened by the watchdog once it shows up
+TEST(DepthAICameraTest, WatchdogFirstOpenFails)
+{
+    const std::string shm_name = "depthai_ctrl_first_open_test";
+    rclcpp::NodeOptions options;
+    options.parameter_overrides({
+        {"frame_source", "shm"},
+        {"shm_name", shm_name},
+        {"watchdog_min_backoff_ms", 200},
+        {"watchdog_max_backoff_ms", 400}});
+    auto camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options);
+    EXPECT_FALSE(camera_node->WaitForBoot(std::chrono::seconds(5)));
+
+    TestSubscriber subscriber("first_open_subscriber");
+    int videoChunks = 0;
+    auto video_subscriber = subscriber.node->create_subscription<CompressedImageMsg>(
+        "camera/color/video", rclcpp::QoS(rclcpp::KeepLast(10)),
+        [&](const CompressedImageMsg::SharedPtr) {
+            std::lock_guard<std::mutex> lock(subscriber.mutex);
+            videoChunks++;
+        });
+    subscriber.executor.add_node(camera_node);
+
+    // No owner yet: reopens back off, nothing is delivered.
+    SpinFor(subscriber.executor, std::chrono::milliseconds(1000));
+    depthai_ctrl::FrameWatchdogStats stats = camera_node->GetWatchdogStats();
+    EXPECT_EQ(1UL, stats.stalls);
+    EXPECT_TRUE(stats.stalled);
+    EXPECT_EQ("device", stats.stalledStream);
+    EXPECT_GE(stats.attempts, 2UL);
+    EXPECT_LE(stats.attempts, 5UL);
+    EXPECT_FALSE(camera_node->IsNodeRunning());
+
+    // Stand-in for the device daemon, started late
+    auto owner = depthai_ctrl::ShmDeviceControl::Create(
+        depthai_ctrl::shm::ObjectName(shm_name, "control"));
+    ASSERT_TRUE(owner);
+    auto ring = depthai_ctrl::ShmFrameRing::Create(
+        depthai_ctrl::shm::ObjectName(shm_name, "enc26xColor"), 8, 4096);
+    ASSERT_TRUE(ring);
+    std::atomic<bool> writing(true);
+    std::thread writer([&]() {
+        std::vector<uint8_t> chunk(1000);
+        for (int64_t i = 0; writing; i++) {
+            depthai_ctrl::ShmFrameInfo info;
+            info.type = (uint32_t)dai::RawImgFrame::Type::BITSTREAM;
+            info.sequenceNum = i;
+            info.size = (uint32_t)chunk.size();
+            ring->Write(info, chunk.data());
+            std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        }
+    });
+
+    EXPECT_TRUE(subscriber.SpinUntil(std::chrono::seconds(5), [&] {return videoChunks >= 5;}));
+    stats = camera_node->GetWatchdogStats();
+    EXPECT_FALSE(stats.stalled);
+    EXPECT_EQ(1UL, stats.recoveries);
+    EXPECT_TRUE(camera_node->IsNodeRunning());
+
+    camera_node->Stop();
+    writing = false;
+    writer.join();
+}
+
+namespace
+{
+struct FakeFrame
+{
+    int64_t sequence;
+    int64_t getSequenceNum() const {return sequence;}
+};
+
+std::vector<std::shared_ptr<FakeFrame>> MakeBatch(int64_t first, int64_t count)
+{
+    std::vector<std::shared_ptr<FakeFrame>> frames;
+    for (int64_t i = 0; i < count; i++) {
+        frames.push_back(std::make_shared<FakeFrame>(FakeFrame{first + i}));
+    }
+    return frames;
+}
+
+/// Non-blocking device output queue, a full queue drops its oldest frame
+class FakeQueue
+{
+public:
+    explicit FakeQueue(size_t maxSize) : _maxSize(maxSize) {}
+
+    void Push(std::shared_ptr<FakeFrame> frame)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_frames.size() >= _maxSize) {
+            _frames.pop_front();
+        }
+        _frames.push_back(frame);
+        _cond.notify_one();
+    }
+
+    template<typename Frame>
+    std::shared_ptr<Frame> get(std::chrono::milliseconds timeout, bool & hasTimedout)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        hasTimedout = !_cond.wait_for(lock, timeout, [this] {return !_frames.empty();});
+        if (hasTimedout) {
+            return nullptr;
+        }
+        std::shared_ptr<Frame> frame = _frames.front();
+        _frames.pop_front();
+        return frame;
+    }
+
+    template<typename Frame>
+    std::vector<std::shared_ptr<Frame>> tryGetAll()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<std::shared_ptr<Frame>> frames(_frames.begin(), _frames.end());
+        _frames.clear();
+        return frames;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<std::shared_ptr<FakeFrame>> _frames;
+    size_t _maxSize;
+};
+}  // namespace
+
+/// Each queue policy keeps its frames of a batch, drops and fill are counted
+TEST(QueuePolicyTest, PoliciesAndTelemetry)
+{
+    using depthai_ctrl::QueuePolicy;
+    QueuePolicy policy = QueuePolicy::Bounded;
+    EXPECT_TRUE(depthai_ctrl::ParseQueuePolicy("newest", policy));
+    EXPECT_EQ(QueuePolicy::NewestOnly, policy);
+    EXPECT_FALSE(depthai_ctrl::ParseQueuePolicy("latest", policy));
+    EXPECT_EQ(QueuePolicy::NewestOnly, policy);
+    EXPECT_STREQ("blocking", depthai_ctrl::QueuePolicyName(QueuePolicy::Blocking));
+
+    // 100 ms at 25 FPS are 3 frames, never less than one.
+    depthai_ctrl::StreamQueueConfig config;
+    config.depthMs = 100;
+    EXPECT_EQ(3, depthai_ctrl::ResolveQueueDepth(config, 25).depth);
+    config.depthMs = 1;
+    EXPECT_EQ(1, depthai_ctrl::ResolveQueueDepth(config, 25).depth);
+    config.depthMs = 0;
+    config.depth = 8;
+    EXPECT_EQ(8, depthai_ctrl::ResolveQueueDepth(config, 25).depth);
+
+    // Newest only: a queue of one, older frames of a batch are discarded.
+    config.policy = QueuePolicy::NewestOnly;
+    EXPECT_EQ(1, config.MaxSize());
+    EXPECT_FALSE(config.IsBlocking());
+    depthai_ctrl::QueueMonitor newest(config);
+    auto frames = MakeBatch(0, 3);
+    newest.Apply(frames);
+    ASSERT_EQ(1UL, frames.size());
+    EXPECT_EQ(2, frames[0]->getSequenceNum());
+    // Frames 3 and 4 never reached the host.
+    frames = MakeBatch(5, 1);
+    newest.Apply(frames);
+    depthai_ctrl::QueueStats stats = newest.GetStats();
+    EXPECT_EQ(2UL, stats.batches);
+    EXPECT_EQ(2UL, stats.frames);
+    EXPECT_EQ(2UL, stats.discarded);
+    EXPECT_EQ(2UL, stats.lost);
+    EXPECT_DOUBLE_EQ(1.0, stats.fillMax);
+
+    // Bounded: everything up to the depth, a device queue with room for a backlog beyond it,
+    // so the frames the host drops are counted. The device is not held back.
+    config.policy = QueuePolicy::Bounded;
+    config.depth = 4;
+    EXPECT_EQ(4, config.Depth());
+    EXPECT_EQ(8, config.MaxSize());
+    EXPECT_FALSE(config.IsBlocking());
+    depthai_ctrl::QueueMonitor bounded(config);
+    frames = MakeBatch(0, 2);
+    bounded.Apply(frames);
+    EXPECT_EQ(2UL, frames.size());
+    frames = MakeBatch(2, 6);
+    bounded.Apply(frames);
+    ASSERT_EQ(4UL, frames.size());
+    EXPECT_EQ(4, frames[0]->getSequenceNum());
+    stats = bounded.GetStats();
+    EXPECT_EQ(4, stats.depth);
+    EXPECT_EQ(2UL, stats.discarded);
+    EXPECT_EQ(0UL, stats.lost);
+    EXPECT_DOUBLE_EQ(1.0, stats.fillLast);
+    EXPECT_DOUBLE_EQ(0.75, stats.fillMean);
+    // A restarted device starts over without counting a loss.
+    frames = MakeBatch(0, 1);
+    bounded.Apply(frames);
+    EXPECT_EQ(0UL, bounded.GetStats().lost);
+    EXPECT_DOUBLE_EQ(0.25, bounded.GetStats().fillLast);
+
+    // Blocking: every frame is delivered.
+    config.policy = QueuePolicy::Blocking;
+    EXPECT_TRUE(config.IsBlocking());
+    EXPECT_FALSE(config.IsLossy());
+    EXPECT_EQ(4, config.MaxSize());
+    depthai_ctrl::QueueMonitor blocking(config);
+    frames = MakeBatch(0, 6);
+    blocking.Apply(frames);
+    EXPECT_EQ(6UL, frames.size());
+    EXPECT_EQ(0UL, blocking.GetStats().discarded);
+    EXPECT_EQ(QueuePolicy::Blocking, blocking.GetStats().policy);
+    EXPECT_EQ(4, blocking.GetStats().depth);
+}
+
+/// A slow callback of a bounded stream gets batches of the backlog, trimmed to the depth
+TEST(QueuePolicyTest, SlowCallbackDrops)
+{
+    depthai_ctrl::StreamQueueConfig config;
+    config.policy = depthai_ctrl::QueuePolicy::Bounded;
+    config.depth = 4;
+    ASSERT_FALSE(config.IsBlocking());
+    FakeQueue queue((size_t)config.MaxSize());
+    depthai_ctrl::QueueMonitor monitor(config);
+
+    // The reader loop of DeviceFrameSource, with a callback slower than the frames.
+    std::atomic<bool> running(true);
+    std::atomic<int64_t> lastDelivered(-1);
+    size_t largestBatch = 0;
+    std::thread reader([&] {
+        std::vector<std::shared_ptr<FakeFrame>> frames;
+        while (running) {
+            if (!depthai_ctrl::ReadQueueBatch(queue, std::chrono::milliseconds(10), frames)) {
+                continue;
+            }
+            monitor.Apply(frames);
+            largestBatch = std::max(largestBatch, frames.size());
+            lastDelivered = frames.back()->getSequenceNum();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    });
+    const int64_t count = 100;
+    for (int64_t i = 0; i < count; i++) {
+        queue.Push(std::make_shared<FakeFrame>(FakeFrame{i}));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (lastDelivered != count - 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    running = false;
+    reader.join();
+
+    // The host drops beyond the depth, the device queue beyond twice the depth.
+    const depthai_ctrl::QueueStats stats = monitor.GetStats();
+    EXPECT_EQ(count - 1, lastDelivered);
+    EXPECT_EQ(4UL, largestBatch);
+    EXPECT_GT(stats.discarded, 0UL);
+    EXPECT_DOUBLE_EQ(1.0, stats.fillMax);
+    EXPECT_EQ((uint64_t)count, stats.frames + stats.discarded + stats.lost);
+}
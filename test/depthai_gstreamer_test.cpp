@@ -1,11 +1,19 @@
+#include "depthai_camera.h"
 #include "depthai_gstreamer.h"
+#include "encoded_test_chunks.hpp"
 #include "gtest/gtest.h"
 #include <gst/app/gstappsink.h>
 #include <gst/gst.h>
 #include <gst/gstcaps.h>
 #include <gst/rtsp-server/rtsp-server.h>
 #include <rclcpp/rclcpp.hpp>
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using CompressedImageMsg = depthai_ctrl::DepthAIGStreamer::CompressedImageMsg;
 //#define MULTI_THREADING_FIXED
@@ -188,6 +196,34 @@ TEST_F(DepthAIGStreamerTest, BasicTest_CreateDeleteTest)
   ASSERT_NO_THROW(gstreamer_node.reset());
 }
 
+/// Both nodes as in the combined binary, intra-process comms reject publishers or
+/// subscriptions without an explicit keep-last depth
+TEST_F(DepthAIGStreamerTest, BasicTest_IntraProcessTest)
+{
+  rclcpp::NodeOptions options{};
+  options.use_intra_process_comms(true);
+  // Enable the optional topics as well
+  options.parameter_overrides({
+    {"start_stream_on_boot", false},
+    {"adaptive_bitrate", true}});
+
+  std::shared_ptr<depthai_ctrl::DepthAICamera> camera_node;
+  std::shared_ptr<depthai_ctrl::DepthAIGStreamer> gstreamer_node;
+  ASSERT_NO_THROW(camera_node = std::make_shared<depthai_ctrl::DepthAICamera>(options));
+  ASSERT_NO_THROW(gstreamer_node = std::make_shared<depthai_ctrl::DepthAIGStreamer>(options));
+
+  auto video_subscriber = rclcpp::create_subscription<CompressedImageMsg>(
+    *camera_node, "camera/color/video", rclcpp::QoS(rclcpp::KeepLast(10)),
+    [](const CompressedImageMsg::SharedPtr msg) {(void)msg;});
+  EXPECT_EQ(1UL, video_subscriber->get_publisher_count());
+  auto video_publisher = rclcpp::create_publisher<CompressedImageMsg>(
+    *gstreamer_node, "camera/color/video", rclcpp::QoS(rclcpp::KeepLast(10)));
+  EXPECT_EQ(2UL, video_publisher->get_subscription_count());
+
+  ASSERT_NO_THROW(gstreamer_node.reset());
+  ASSERT_NO_THROW(camera_node.reset());
+}
+
 /*
 /// Creates GStreamerNode with argc/argv constructor
 TEST_F(DepthAIGStreamerTest, BasicTest_ArgcArgvTest)
@@ -270,6 +306,953 @@ TEST_F(DepthAIGStreamerTest, StartOnBoot_BasicTest)
   ASSERT_NO_THROW(gstreamer_node.reset());
 }
 
+/// NAL unit classification used by the GOP-aware queue overflow handling
+TEST(H26xParserTest, H264FrameTypes)
+{
+  // SPS, PPS and an IDR slice
+  const std::vector<uint8_t> idr = {0, 0, 0, 1, 0x67, 0x42, 0, 0, 0, 1, 0x68, 0xce,
+    0, 0, 0, 1, 0x65, 0x88, 0x84};
+  auto info = depthai_ctrl::H26xParser::Parse(idr.data(), idr.size(), false);
+  EXPECT_TRUE(info.valid);
+  EXPECT_TRUE(info.hasPicture);
+  EXPECT_TRUE(info.isKeyFrame);
+  EXPECT_TRUE(info.hasParameterSets);
+  EXPECT_TRUE(info.isReference);
+
+  // Reference P slice, nal_ref_idc = 2
+  const std::vector<uint8_t> p = {0, 0, 1, 0x41, 0x9a, 0x02};
+  info = depthai_ctrl::H26xParser::Parse(p.data(), p.size(), false);
+  EXPECT_TRUE(info.hasPicture);
+  EXPECT_FALSE(info.isKeyFrame);
+  EXPECT_TRUE(info.isReference);
+
+  // Non-reference slice, nal_ref_idc = 0
+  const std::vector<uint8_t> b = {0, 0, 0, 1, 0x01, 0x9e, 0x04};
+  info = depthai_ctrl::H26xParser::Parse(b.data(), b.size(), false);
+  EXPECT_TRUE(info.hasPicture);
+  EXPECT_FALSE(info.isReference);
+
+  // No start code at all
+  const std::vector<uint8_t> garbage = {0x12, 0x34, 0x56, 0x78};
+  info = depthai_ctrl::H26xParser::Parse(garbage.data(), garbage.size(), false);
+  EXPECT_FALSE(info.valid);
+}
+
+TEST(H26xParserTest, H265FrameTypes)
+{
+  // VPS, SPS, PPS and an IDR_W_RADL slice
+  const std::vector<uint8_t> idr = {0, 0, 0, 1, 0x40, 0x01, 0, 0, 0, 1, 0x42, 0x01,
+    0, 0, 0, 1, 0x44, 0x01, 0, 0, 0, 1, 0x26, 0x01, 0xaf};
+  auto info = depthai_ctrl::H26xParser::Parse(idr.data(), idr.size(), true);
+  EXPECT_TRUE(info.isKeyFrame);
+  EXPECT_TRUE(info.hasParameterSets);
+  EXPECT_TRUE(info.isReference);
+
+  // TRAIL_R slice
+  const std::vector<uint8_t> trailR = {0, 0, 1, 0x02, 0x01, 0xd0};
+  info = depthai_ctrl::H26xParser::Parse(trailR.data(), trailR.size(), true);
+  EXPECT_FALSE(info.isKeyFrame);
+  EXPECT_TRUE(info.isReference);
+
+  // TRAIL_N slice
+  const std::vector<uint8_t> trailN = {0, 0, 1, 0x00, 0x01, 0xd0};
+  info = depthai_ctrl::H26xParser::Parse(trailN.data(), trailN.size(), true);
+  EXPECT_TRUE(info.hasPicture);
+  EXPECT_FALSE(info.isReference);
+}
+
+/// Synthetic H.264 GOP of 10 chunks: IDR with SPS/PPS, then alternating reference P
+/// and non-reference pictures. The stamp carries the GOP and the index in the GOP.
+static std::vector<CompressedImageMsg::SharedPtr> SyntheticGop(int gop)
+{
+  std::vector<CompressedImageMsg::SharedPtr> chunks;
+  for (int i = 0; i < 10; i++) {
+    auto chunk = std::make_shared<CompressedImageMsg>();
+    chunk->format = "H264";
+    chunk->header.stamp.sec = gop;
+    chunk->header.stamp.nanosec = i;
+    if (i == 0) {
+      chunk->data = {0, 0, 0, 1, 0x67, 0x42, 0, 0, 0, 1, 0x68, 0xce, 0, 0, 0, 1, 0x65, 0x88, 0x84};
+    } else if (i % 2 == 1) {
+      chunk->data = {0, 0, 0, 1, 0x41, 0x9a, 0x02};
+    } else {
+      chunk->data = {0, 0, 0, 1, 0x01, 0x9e, 0x04};
+    }
+    chunks.push_back(chunk);
+  }
+  return chunks;
+}
+
+/// An overflowing queue drops non-reference pictures first and then whole GOP tails,
+/// the queued chunks of every GOP stay decodable from its IDR
+TEST(GopAwareDropTest, OverflowKeepsDecodableGops)
+{
+  depthai_ctrl::GstInterface gst(0, nullptr);
+  // 20 chunks, non-reference pictures are dropped from 15 on
+  gst.SetEncoderFps(10);
+  gst.SetQueueMaxBytes(1000000);
+
+  for (int gop = 1; gop <= 3; gop++) {
+    for (const auto & chunk : SyntheticGop(gop)) {
+      gst.PushFrame(chunk);
+    }
+  }
+  EXPECT_EQ(20UL, gst.GetQueueSize());
+  EXPECT_EQ(3UL, gst.GetNonReferenceDroppedFrames());
+  EXPECT_EQ(1UL, gst.GetSkippedGops());
+  EXPECT_EQ(10UL, gst.GetQueueDroppedFrames());
+
+  // The pipeline takes the first GOP, queuing resumes at the next IDR.
+  CompressedImageMsg::SharedPtr chunk;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(gst.PopFrame(chunk));
+    EXPECT_EQ(1, chunk->header.stamp.sec);
+  }
+  for (const auto & gopChunk : SyntheticGop(4)) {
+    gst.PushFrame(gopChunk);
+  }
+  EXPECT_EQ(5UL, gst.GetNonReferenceDroppedFrames());
+  EXPECT_EQ(1UL, gst.GetSkippedGops());
+  EXPECT_EQ(12UL, gst.GetQueueDroppedFrames());
+
+  std::vector<std::pair<int, int>> remaining;
+  while (gst.PopFrame(chunk)) {
+    remaining.emplace_back(chunk->header.stamp.sec, chunk->header.stamp.nanosec);
+  }
+  const std::vector<std::pair<int, int>> expected = {
+    {2, 0}, {2, 1}, {2, 2}, {2, 3}, {2, 4}, {2, 5}, {2, 7}, {2, 9},
+    {3, 0}, {3, 1},
+    {4, 0}, {4, 1}, {4, 2}, {4, 3}, {4, 4}, {4, 5}, {4, 7}, {4, 9}};
+  EXPECT_EQ(expected, remaining);
+}
+
+/// Items come out in push order, the capacity is rounded up to a power of two
+TEST(SpscRingTest, PushPopOrder)
+{
+  depthai_ctrl::SpscRing<int> ring(5);
+  EXPECT_EQ(8UL, ring.Capacity());
+  EXPECT_TRUE(ring.Empty());
+  for (int i = 0; i < 8; i++) {
+    EXPECT_TRUE(ring.Push(int(i), 10));
+  }
+  EXPECT_FALSE(ring.Push(8, 10));
+  EXPECT_EQ(8UL, ring.Size());
+  EXPECT_EQ(80UL, ring.Bytes());
+
+  int item = -1;
+  for (int i = 0; i < 8; i++) {
+    ASSERT_TRUE(ring.Pop(item));
+    EXPECT_EQ(i, item);
+  }
+  EXPECT_FALSE(ring.Pop(item));
+  EXPECT_TRUE(ring.Empty());
+  EXPECT_EQ(0UL, ring.Bytes());
+}
+
+/// Pushes beyond the frame count or the byte budget are rejected, but an item larger
+/// than the budget still goes into an empty ring
+TEST(SpscRingTest, FrameAndByteLimits)
+{
+  depthai_ctrl::SpscRing<int> ring(16);
+  ring.SetLimits(3, 100);
+  EXPECT_EQ(3UL, ring.MaxFrames());
+  EXPECT_EQ(100UL, ring.MaxBytes());
+  EXPECT_TRUE(ring.Push(1, 40));
+  EXPECT_TRUE(ring.Push(2, 40));
+  EXPECT_FALSE(ring.Push(3, 40));
+  EXPECT_TRUE(ring.Push(3, 20));
+  EXPECT_FALSE(ring.Push(4, 0));
+  EXPECT_EQ(3UL, ring.Size());
+
+  int item;
+  while (ring.Pop(item)) {}
+  EXPECT_TRUE(ring.Push(5, 500));
+  EXPECT_FALSE(ring.Push(6, 1));
+  ASSERT_TRUE(ring.Pop(item));
+  EXPECT_EQ(5, item);
+
+  // Zero or too many frames means the whole capacity
+  ring.SetLimits(0, SIZE_MAX);
+  EXPECT_EQ(16UL, ring.MaxFrames());
+  ring.SetLimits(100, SIZE_MAX);
+  EXPECT_EQ(16UL, ring.MaxFrames());
+}
+
+/// A clear request drops the queued items on the next pop, high-water marks survive it
+TEST(SpscRingTest, ClearAndHighWaterMarks)
+{
+  depthai_ctrl::SpscRing<std::shared_ptr<int>> ring(8);
+  auto shared = std::make_shared<int>(1);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(ring.Push(std::shared_ptr<int>(shared), 10));
+  }
+  EXPECT_EQ(5L, shared.use_count());
+  EXPECT_EQ(4UL, ring.HighWaterFrames());
+  EXPECT_EQ(40UL, ring.HighWaterBytes());
+
+  ring.RequestClear();
+  std::shared_ptr<int> item;
+  EXPECT_FALSE(ring.Pop(item));
+  EXPECT_TRUE(ring.Empty());
+  EXPECT_EQ(0UL, ring.Bytes());
+  // The ring does not keep references to the dropped items
+  EXPECT_EQ(1L, shared.use_count());
+  EXPECT_EQ(4UL, ring.HighWaterFrames());
+  EXPECT_EQ(40UL, ring.HighWaterBytes());
+
+  ring.ResetHighWaterMarks();
+  EXPECT_EQ(0UL, ring.HighWaterFrames());
+  EXPECT_EQ(0UL, ring.HighWaterBytes());
+  EXPECT_TRUE(ring.Push(std::shared_ptr<int>(shared), 10));
+  EXPECT_EQ(1UL, ring.HighWaterFrames());
+}
+
+/// Producer and consumer threads, while a third thread keeps changing the limits
+TEST(SpscRingTest, TwoThreadStress)
+{
+  const int items = 200000;
+  depthai_ctrl::SpscRing<int> ring(64);
+  std::atomic<bool> done{false};
+
+  std::thread limits([&] {
+      size_t frames = 1;
+      while (!done) {
+        ring.SetLimits(frames, 64 * 1000);
+        frames = frames % 64 + 1;
+        std::this_thread::yield();
+      }
+    });
+  std::thread producer([&] {
+      for (int i = 0; i < items; i++) {
+        while (!ring.Push(int(i), i % 1000)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+
+  int expected = 0;
+  int outOfOrder = 0;
+  int item;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+  while (expected < items && std::chrono::steady_clock::now() < deadline) {
+    if (!ring.WaitForData(10)) {
+      continue;
+    }
+    while (ring.Pop(item)) {
+      if (item != expected) {
+        outOfOrder++;
+      }
+      expected++;
+    }
+  }
+  producer.join();
+  done = true;
+  limits.join();
+
+  EXPECT_EQ(items, expected);
+  EXPECT_EQ(0, outOfOrder);
+  EXPECT_TRUE(ring.Empty());
+  EXPECT_EQ(0UL, ring.Bytes());
+  EXPECT_LE(ring.HighWaterFrames(), 64UL);
+}
+
+/// Encode a short 720p H.264 test sequence at 25 FPS with the given GOP length
+static std::vector<CompressedImageMsg::SharedPtr> EncodeTestChunks(int frames, int gop)
+{
+  TestChunkConfig config;
+  config.frames = frames;
+  config.gop = gop;
+  return EncodeTestChunks(config);
+}
+
+/// Hot-standby pipeline switches to the camera on its first frame and back after
+/// its last one, without restarting the stream. Records the switch latencies, the
+/// bounds only separate the event-driven switch from the standby timeout, so that
+/// a loaded machine does not fail the test.
+TEST(HotStandbyTest, SwitchLatency)
+{
+  const auto chunks = EncodeTestChunks(50, 25);
+  ASSERT_EQ(chunks.size(), 50UL);
+
+  depthai_ctrl::GstInterface gst(0, nullptr);
+  gst.SetStreamAddress("udp://127.0.0.1:5601");
+  gst.SetHotStandby(true);
+  gst.SetHotStandbyTimeoutMs(500);
+  gst.StartStream();
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!gst.IsStreamPlaying() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_TRUE(gst.IsStreamPlaying());
+  EXPECT_TRUE(gst.IsStreamDefault());
+
+  for (const auto & chunk : chunks) {
+    gst.PushFrame(chunk);
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  }
+  EXPECT_FALSE(gst.IsStreamDefault());
+  const int64_t toCameraMs = gst.GetLastSwitchLatencyMs();
+
+  const auto lastFrame = std::chrono::steady_clock::now();
+  while (!gst.IsStreamDefault() &&
+    std::chrono::steady_clock::now() - lastFrame < std::chrono::seconds(10))
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_TRUE(gst.IsStreamDefault());
+  const int64_t toDefaultMs = gst.GetLastSwitchLatencyMs();
+
+  std::cout << "Switch latency to camera " << toCameraMs << " ms, to default "
+            << toDefaultMs << " ms" << std::endl;
+  ::testing::Test::RecordProperty("CameraSwitchLatencyMs", (int)toCameraMs);
+  ::testing::Test::RecordProperty("DefaultSwitchLatencyMs", (int)toDefaultMs);
+  // The switch to the camera does not wait for the timeout, it happens on the first
+  // frames out of the two seconds pushed.
+  EXPECT_GE(toCameraMs, 0);
+  EXPECT_LT(toCameraMs, 2000);
+  // Switching back never happens before the timeout, the upper bound is generous.
+  EXPECT_GE(toDefaultMs, 500);
+  EXPECT_LT(toDefaultMs, 5000);
+  EXPECT_EQ(gst.GetStreamSwitches(), 2UL);
+  // The stream was never restarted.
+  EXPECT_TRUE(gst.IsStreamPlaying());
+}
+
+/// Latency histogram percentiles stay within the bucket resolution
+TEST(LatencyTracerTest, HistogramPercentiles)
+{
+  depthai_ctrl::LatencyHistogram histogram;
+  EXPECT_EQ(histogram.Percentile(0.5), 0.0);
+  for (int64_t ms = 1; ms <= 1000; ms++) {
+    histogram.Record(ms * 1000000);
+  }
+  EXPECT_EQ(histogram.Count(), 1000UL);
+  EXPECT_NEAR(histogram.Percentile(0.50), 500.0, 500.0 * 0.07);
+  EXPECT_NEAR(histogram.Percentile(0.95), 950.0, 950.0 * 0.07);
+  EXPECT_NEAR(histogram.Percentile(0.99), 990.0, 990.0 * 0.07);
+  histogram.Reset();
+  EXPECT_EQ(histogram.Count(), 0UL);
+}
+
+/// Chunks stamped like the camera node are traced through the pipeline to the UDP sink
+TEST(LatencyTracerTest, PipelineStages)
+{
+  using depthai_ctrl::LatencyTracer;
+  const auto chunks = EncodeTestChunks(50, 25);
+  ASSERT_EQ(chunks.size(), 50UL);
+
+  depthai_ctrl::GstInterface gst(0, nullptr);
+  gst.SetStreamAddress("udp://127.0.0.1:5604");
+  gst.SetLatencyTracing(true);
+  auto push = [&gst](const CompressedImageMsg::SharedPtr & chunk) {
+      const int64_t now = LatencyTracer::Now();
+      auto traced = std::make_shared<CompressedImageMsg>(*chunk);
+      LatencyTracer::AppendStamp(traced->format, now - 5000000);    // capture
+      LatencyTracer::AppendStamp(traced->format, now - 1000000);    // callback
+      LatencyTracer::AppendStamp(traced->format, now - 500000);     // publish
+      LatencyTracer::AppendStamp(traced->format, now);              // receive
+      gst.PushFrame(traced);
+    };
+  push(chunks[0]);
+  gst.StartStream();
+  for (size_t i = 1; i < chunks.size(); i++) {
+    push(chunks[i]);
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  }
+  EXPECT_TRUE(gst.IsStreamPlaying());
+  EXPECT_FALSE(gst.IsStreamDefault());
+
+  for (const auto & interval : gst.TakeLatencyStats()) {
+    std::cout << interval.name << ": " << interval.count << " p50 " << interval.p50Ms <<
+      " p95 " << interval.p95Ms << " p99 " << interval.p99Ms << " ms" << std::endl;
+    EXPECT_GT(interval.count, 0UL) << interval.name;
+    if (std::string(interval.name) == "CaptureToCallback") {
+      EXPECT_NEAR(interval.p50Ms, 4.0, 0.3);
+    }
+    if (std::string(interval.name) == "CaptureToSink") {
+      EXPECT_GE(interval.p50Ms, 5.0);
+    }
+  }
+  // Taking the stats restarts the histograms.
+  EXPECT_EQ(gst.TakeLatencyStats()[0].count, 0UL);
+}
+
+/// Count UDP datagrams arriving on a local port within the given time
+static int CountUdpPackets(int port, std::chrono::milliseconds duration)
+{
+  const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    close(sock);
+    return -1;
+  }
+  timeval timeout{0, 50000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  int packets = 0;
+  char buffer[2048];
+  const auto end = std::chrono::steady_clock::now() + duration;
+  while (std::chrono::steady_clock::now() < end) {
+    if (recv(sock, buffer, sizeof(buffer), 0) > 0) {
+      packets++;
+    }
+  }
+  close(sock);
+  return packets;
+}
+
+/// Destinations are added to and removed from the running pipeline without restart
+TEST(DestinationsTest, AddRemoveAtRuntime)
+{
+  depthai_ctrl::GstInterface gst(0, nullptr);
+  gst.SetStreamAddress("udp://127.0.0.1:5602");
+  gst.SetPipelineDataWaitMs(0);
+  gst.StartStream();
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!gst.IsStreamPlaying() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_TRUE(gst.IsStreamPlaying());
+  EXPECT_EQ(CountUdpPackets(5603, std::chrono::milliseconds(500)), 0);
+
+  EXPECT_TRUE(gst.AddDestination("udp://127.0.0.1:5603"));
+  EXPECT_FALSE(gst.AddDestination("udp://127.0.0.1:5603"));
+  EXPECT_EQ(gst.GetDestinations().size(), 2UL);
+  EXPECT_GT(CountUdpPackets(5603, std::chrono::milliseconds(1000)), 0);
+  EXPECT_GT(CountUdpPackets(5602, std::chrono::milliseconds(500)), 0);
+
+  EXPECT_TRUE(gst.RemoveDestination("udp://127.0.0.1:5603"));
+  EXPECT_FALSE(gst.RemoveDestination("udp://127.0.0.1:5603"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_EQ(CountUdpPackets(5603, std::chrono::milliseconds(500)), 0);
+  // The primary destination kept streaming all along.
+  EXPECT_GT(CountUdpPackets(5602, std::chrono::milliseconds(500)), 0);
+  EXPECT_TRUE(gst.IsStreamPlaying());
+}
+
+/// Embedded RTSP server: two clients share one media, both start on a key frame
+TEST(RtspServerModeTest, SharedMediaClients)
+{
+  depthai_ctrl::GstInterface gst(0, nullptr);
+  gst.SetStreamAddress("");
+  gst.SetRtspServer(8556, "/shared");
+  gst.SetPipelineDataWaitMs(0);
+  gst.StartStream();
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!gst.IsStreamPlaying() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_TRUE(gst.IsStreamPlaying());
+  // The server already has its branch.
+  EXPECT_FALSE(gst.AddDestination(gst.GetRtspServerUrl()));
+
+  const std::string launch = "rtspsrc location=" + gst.GetRtspServerUrl() +
+    " latency=0 ! rtph264depay ! h264parse ! appsink name=sink sync=false";
+  GstElement * clients[2] = {};
+  for (int i = 0; i < 2; i++) {
+    clients[i] = gst_parse_launch(launch.c_str(), nullptr);
+    ASSERT_NE(clients[i], nullptr);
+    gst_element_set_state(clients[i], GST_STATE_PLAYING);
+    GstElement * sink = gst_bin_get_by_name(GST_BIN(clients[i]), "sink");
+    GstSample * sample = gst_app_sink_try_pull_sample(GST_APP_SINK(sink), 5 * GST_SECOND);
+    ASSERT_NE(sample, nullptr);
+    // The late client does not wait for the end of the GOP of the first one.
+    EXPECT_FALSE(
+      GST_BUFFER_FLAG_IS_SET(gst_sample_get_buffer(sample), GST_BUFFER_FLAG_DELTA_UNIT));
+    gst_sample_unref(sample);
+    gst_object_unref(sink);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  }
+  EXPECT_EQ(gst.GetRtspClientStats().size(), 2UL);
+  EXPECT_GT(gst.GetRtspServerBuffers(), 0UL);
+
+  for (auto * client : clients) {
+    gst_element_set_state(client, GST_STATE_NULL);
+    gst_object_unref(client);
+  }
+  gst.StopStream();
+}
+
+/// On-board recording cuts segments at key frames while the stream keeps playing,
+/// the preallocated space of the closed segments is released
+TEST(RecordingTest, SegmentsAtKeyFrames)
+{
+  const auto chunks = EncodeTestChunks(100, 25);
+  ASSERT_EQ(chunks.size(), 100UL);
+  const std::string directory = "/tmp/depthai_recording_test";
+  ASSERT_TRUE(mkdir(directory.c_str(), 0755) == 0 || errno == EEXIST);
+  auto segmentFile = [&directory](int index) {
+      char name[64];
+      snprintf(name, sizeof(name), "/segment_%03d.mkv", index);
+      return directory + name;
+    };
+
+  depthai_ctrl::GstInterface gst(0, nullptr);
+  gst.SetStreamAddress("udp://127.0.0.1:5611");
+  depthai_ctrl::RecordingConfig config{};
+  config.location = directory + "/segment_%03d.mkv";
+  config.maxSegmentTimeNs = GST_SECOND;
+  config.preallocateBytes = 16 << 20;
+  gst.SetRecording(config);
+  gst.PushFrame(chunks[0]);
+  gst.StartStream();
+  for (size_t i = 1; i < chunks.size(); i++) {
+    gst.PushFrame(chunks[i]);
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  }
+  EXPECT_TRUE(gst.IsStreamPlaying());
+  EXPECT_FALSE(gst.IsStreamDefault());
+  // A key frame every second, the first one past the limit starts a new segment.
+  EXPECT_GE(gst.GetRecordedSegments(), 3UL);
+  EXPECT_EQ(gst.GetRecordingOverruns(), 0UL);
+  EXPECT_EQ(gst.GetDestinations().size(), 1UL);
+  // The recording already has its branch.
+  EXPECT_FALSE(gst.AddDestination(gst.GetRecordingAddress()));
+  gst.StopStream();
+
+  for (int i = 0; i + 1 < (int)gst.GetRecordedSegments(); i++) {
+    const std::string file = segmentFile(i);
+    struct stat fileStat {};
+    ASSERT_EQ(stat(file.c_str(), &fileStat), 0) << file;
+    EXPECT_GT(fileStat.st_size, 0) << file;
+    EXPECT_LT((int64_t)fileStat.st_blocks * 512, fileStat.st_size + (1 << 20)) << file;
+
+    const std::string launch = "filesrc location=" + file +
+      " ! matroskademux ! h264parse ! appsink name=sink sync=false";
+    GstElement * reader = gst_parse_launch(launch.c_str(), nullptr);
+    ASSERT_NE(reader, nullptr);
+    gst_element_set_state(reader, GST_STATE_PLAYING);
+    GstElement * sink = gst_bin_get_by_name(GST_BIN(reader), "sink");
+    GstSample * sample = gst_app_sink_try_pull_sample(GST_APP_SINK(sink), 5 * GST_SECOND);
+    ASSERT_NE(sample, nullptr) << file;
+    EXPECT_FALSE(
+      GST_BUFFER_FLAG_IS_SET(gst_sample_get_buffer(sample), GST_BUFFER_FLAG_DELTA_UNIT)) << file;
+    gst_sample_unref(sample);
+    gst_object_unref(sink);
+    gst_element_set_state(reader, GST_STATE_NULL);
+    gst_object_unref(reader);
+  }
+  for (int i = 0; i < (int)gst.GetRecordedSegments(); i++) {
+    std::remove(segmentFile(i).c_str());
+  }
+  rmdir(directory.c_str());
+}
+
+/// Stream state machine: error recovery with exponential backoff and jitter
+TEST(StreamStateMachineTest, BackoffRecovery)
+{
+  using depthai_ctrl::StreamAction;
+  using depthai_ctrl::StreamEvent;
+  using depthai_ctrl::StreamState;
+  using std::chrono::milliseconds;
+  depthai_ctrl::StreamStateMachineConfig config{};
+  config.seed = 42;
+  depthai_ctrl::StreamStateMachine machine(config);
+  auto now = depthai_ctrl::StreamStateMachine::Clock::now();
+
+  machine.Post(StreamEvent::StartRequested);
+  auto transitions = machine.Process(now);
+  ASSERT_EQ(transitions.size(), 1UL);
+  EXPECT_EQ(transitions[0].action, StreamAction::Start);
+  EXPECT_EQ(machine.GetState(), StreamState::Starting);
+
+  // Every failure doubles the delay, within the jitter range.
+  int64_t expectedMs = 100;
+  for (uint32_t attempt = 0; attempt < 8; attempt++) {
+    machine.Post(StreamEvent::PipelineError);
+    transitions = machine.Process(now);
+    ASSERT_EQ(transitions.size(), 1UL);
+    EXPECT_EQ(transitions[0].to, StreamState::Backoff);
+    EXPECT_EQ(transitions[0].action, StreamAction::Stop);
+    EXPECT_EQ(transitions[0].attempt, attempt + 1);
+    EXPECT_GE(transitions[0].retryInMs, expectedMs * 8 / 10);
+    EXPECT_LE(transitions[0].retryInMs, expectedMs * 12 / 10);
+
+    // Nothing happens before the delay is over.
+    EXPECT_TRUE(machine.Process(now + milliseconds(transitions[0].retryInMs - 1)).empty());
+    now += milliseconds(transitions[0].retryInMs);
+    transitions = machine.Process(now);
+    ASSERT_EQ(transitions.size(), 1UL);
+    EXPECT_EQ(transitions[0].event, StreamEvent::BackoffElapsed);
+    EXPECT_EQ(transitions[0].action, StreamAction::Start);
+    expectedMs = std::min<int64_t>(expectedMs * 2, 5000);
+  }
+
+  // Playing resets the attempts, the next failure is retried within a second again.
+  machine.Post(StreamEvent::PipelinePlayingDefault);
+  machine.Process(now);
+  EXPECT_EQ(machine.GetState(), StreamState::Default);
+  EXPECT_EQ(machine.GetAttempt(), 0U);
+  machine.Post(StreamEvent::PipelineError);
+  transitions = machine.Process(now);
+  ASSERT_EQ(transitions.size(), 1UL);
+  EXPECT_LT(transitions[0].retryInMs, 1000);
+
+  // Stop is accepted while waiting for the retry.
+  machine.Post(StreamEvent::StopRequested);
+  transitions = machine.Process(now);
+  ASSERT_EQ(transitions.size(), 1UL);
+  EXPECT_EQ(transitions[0].action, StreamAction::Stop);
+  machine.Post(StreamEvent::Stopped);
+  machine.Process(now + milliseconds(5000));
+  EXPECT_EQ(machine.GetState(), StreamState::Idle);
+}
+
+/// A start command while waiting for the retry starts right away and resets the attempts
+TEST(StreamStateMachineTest, StartDuringBackoff)
+{
+  using depthai_ctrl::StreamAction;
+  using depthai_ctrl::StreamEvent;
+  using depthai_ctrl::StreamState;
+  using std::chrono::milliseconds;
+  depthai_ctrl::StreamStateMachineConfig config{};
+  config.seed = 42;
+  depthai_ctrl::StreamStateMachine machine(config);
+  const auto now = depthai_ctrl::StreamStateMachine::Clock::now();
+
+  machine.Post(StreamEvent::StartRequested);
+  machine.Process(now);
+  for (int i = 0; i < 6; i++) {
+    machine.Post(StreamEvent::StartTimeout);
+    machine.Process(now);
+    if (i < 5) {
+      machine.Post(StreamEvent::BackoffElapsed);
+      machine.Process(now);
+    }
+  }
+  ASSERT_EQ(machine.GetState(), StreamState::Backoff);
+  EXPECT_EQ(machine.GetAttempt(), 6U);
+
+  machine.Post(StreamEvent::StartRequested);
+  auto transitions = machine.Process(now + milliseconds(1));
+  ASSERT_EQ(transitions.size(), 1UL);
+  EXPECT_EQ(transitions[0].from, StreamState::Backoff);
+  EXPECT_EQ(transitions[0].to, StreamState::Starting);
+  EXPECT_EQ(transitions[0].action, StreamAction::Start);
+  EXPECT_EQ(transitions[0].attempt, 0U);
+  EXPECT_EQ(machine.GetAttempt(), 0U);
+
+  // The pending retry is gone, and the next failure waits the initial delay again.
+  EXPECT_TRUE(machine.Process(now + milliseconds(2)).empty());
+  EXPECT_EQ(machine.GetState(), StreamState::Starting);
+  machine.Post(StreamEvent::PipelineError);
+  transitions = machine.Process(now + milliseconds(3));
+  ASSERT_EQ(transitions.size(), 1UL);
+  EXPECT_EQ(transitions[0].attempt, 1U);
+  EXPECT_LE(transitions[0].retryInMs, 120);
+}
+
+/// Stream state machine: start timeout and switching between camera and default stream
+TEST(StreamStateMachineTest, FramesAndTimeouts)
+{
+  using depthai_ctrl::StreamAction;
+  using depthai_ctrl::StreamEvent;
+  using depthai_ctrl::StreamState;
+  using std::chrono::milliseconds;
+  depthai_ctrl::StreamStateMachineConfig config{};
+  config.seed = 1;
+  depthai_ctrl::StreamStateMachine machine(config);
+  auto now = depthai_ctrl::StreamStateMachine::Clock::now();
+
+  machine.Post(StreamEvent::StartRequested);
+  machine.Process(now);
+  auto transitions = machine.Process(now + milliseconds(5001));
+  ASSERT_EQ(transitions.size(), 1UL);
+  EXPECT_EQ(transitions[0].event, StreamEvent::StartTimeout);
+  now += milliseconds(6000);
+  machine.Process(now);
+  EXPECT_EQ(machine.GetState(), StreamState::Starting);
+
+  // Camera frames while the default stream plays rebuild the pipeline.
+  machine.Post(StreamEvent::PipelinePlayingDefault);
+  machine.Process(now);
+  EXPECT_TRUE(machine.Process(now + milliseconds(100)).empty());
+  machine.OnFrame(now + milliseconds(200));
+  transitions = machine.Process(now + milliseconds(200));
+  ASSERT_EQ(transitions.size(), 1UL);
+  EXPECT_EQ(transitions[0].event, StreamEvent::FramesArrived);
+  EXPECT_EQ(transitions[0].action, StreamAction::Restart);
+
+  // Camera frames stop while the camera stream plays.
+  machine.Post(StreamEvent::PipelinePlaying);
+  now += milliseconds(300);
+  machine.Process(now);
+  EXPECT_EQ(machine.GetState(), StreamState::Playing);
+  machine.OnFrame(now + milliseconds(500));
+  EXPECT_TRUE(machine.Process(now + milliseconds(1400)).empty());
+  transitions = machine.Process(now + milliseconds(1600));
+  ASSERT_EQ(transitions.size(), 1UL);
+  EXPECT_EQ(transitions[0].event, StreamEvent::FramesStopped);
+  EXPECT_EQ(transitions[0].action, StreamAction::Restart);
+}
+
+/// An announced camera reboot keeps the camera stream, up to the hold timeout
+TEST(StreamStateMachineTest, CameraRebootHold)
+{
+  using depthai_ctrl::StreamAction;
+  using depthai_ctrl::StreamEvent;
+  using depthai_ctrl::StreamState;
+  using std::chrono::milliseconds;
+  depthai_ctrl::StreamStateMachineConfig config{};
+  config.seed = 1;
+  config.rebootHoldTimeout = milliseconds(3000);
+  depthai_ctrl::StreamStateMachine machine(config);
+  auto now = depthai_ctrl::StreamStateMachine::Clock::now();
+
+  machine.Post(StreamEvent::StartRequested);
+  machine.Post(StreamEvent::PipelinePlaying);
+  machine.Process(now);
+  ASSERT_EQ(machine.GetState(), StreamState::Playing);
+  machine.OnFrame(now + milliseconds(500));
+
+  // The frames stop for 2.5 s, the frame timeout counts from the end of the reboot.
+  machine.Post(StreamEvent::CameraRebooting);
+  EXPECT_TRUE(machine.Process(now + milliseconds(500)).empty());
+  EXPECT_TRUE(machine.Process(now + milliseconds(2000)).empty());
+  machine.Post(StreamEvent::CameraRebooted);
+  EXPECT_TRUE(machine.Process(now + milliseconds(3000)).empty());
+  EXPECT_TRUE(machine.Process(now + milliseconds(3900)).empty());
+  machine.OnFrame(now + milliseconds(3500));
+  EXPECT_TRUE(machine.Process(now + milliseconds(4400)).empty());
+  EXPECT_EQ(machine.GetState(), StreamState::Playing);
+
+  // A reboot which does not end in time counts as a camera which is gone.
+  now += milliseconds(4400);
+  machine.OnFrame(now);
+  machine.Post(StreamEvent::CameraRebooting);
+  EXPECT_TRUE(machine.Process(now).empty());
+  EXPECT_TRUE(machine.Process(now + milliseconds(3900)).empty());
+  auto transitions = machine.Process(now + milliseconds(4100));
+  ASSERT_EQ(transitions.size(), 1UL);
+  EXPECT_EQ(transitions[0].event, StreamEvent::FramesStopped);
+  EXPECT_EQ(transitions[0].action, StreamAction::Restart);
+
+  // Without an announcement the same outage restarts the pipeline.
+  machine.Post(StreamEvent::PipelinePlaying);
+  now += milliseconds(5000);
+  machine.Process(now);
+  machine.OnFrame(now);
+  transitions = machine.Process(now + milliseconds(1100));
+  ASSERT_EQ(transitions.size(), 1UL);
+  EXPECT_EQ(transitions[0].event, StreamEvent::FramesStopped);
+}
+
+/// Adaptive bitrate: multiplicative decrease on every congestion signal, additive increase
+/// after a quiet hold time, and the hysteresis of the encoder changes
+TEST(BitrateControllerTest, AimdAndHysteresis)
+{
+  depthai_ctrl::BitrateControllerConfig config{};
+  config.minBitrate = 500000;
+  config.maxBitrate = 3000000;
+  depthai_ctrl::BitrateController controller(config);
+  depthai_ctrl::CongestionSample clean{};
+  EXPECT_EQ(controller.Update(clean, 0), 3000000);
+
+  depthai_ctrl::CongestionSample lossy{};
+  lossy.fractionLost = 0.1;
+  EXPECT_EQ(controller.Update(lossy, 500), 2100000);
+  // The encoder gets time to react before the next decrease.
+  EXPECT_EQ(controller.Update(lossy, 1000), 2100000);
+  EXPECT_EQ(controller.Update(lossy, 2500), 1470000);
+
+  depthai_ctrl::CongestionSample backpressure{};
+  backpressure.sinkQueueFill = 0.8;
+  EXPECT_EQ(controller.Update(backpressure, 4500), 1029000);
+  depthai_ctrl::CongestionSample drops{};
+  drops.droppedFrames = 3;
+  EXPECT_EQ(controller.Update(drops, 6500), 720300);
+  // Drops count once, the same total is no news.
+  EXPECT_EQ(controller.Update(drops, 9000), 720300);
+  drops.droppedFrames = 5;
+  drops.queueFill = 0.9;
+  EXPECT_EQ(controller.Update(drops, 9000), 504210);
+  EXPECT_EQ(controller.Update(drops, 11000), 500000);
+
+  // Quiet for the hold time, then one step per hold time.
+  drops.queueFill = 0.0;
+  EXPECT_EQ(controller.Update(drops, 15000), 500000);
+  EXPECT_EQ(controller.Update(drops, 16000), 650000);
+  EXPECT_EQ(controller.Update(drops, 20000), 650000);
+  // Close to the queue limit the target holds.
+  drops.sinkQueueFill = 0.3;
+  EXPECT_EQ(controller.Update(drops, 21000), 650000);
+  drops.sinkQueueFill = 0.0;
+  EXPECT_EQ(controller.Update(drops, 25000), 650000);
+  EXPECT_EQ(controller.Update(drops, 26000), 800000);
+
+  // A round trip time rising above the lowest one is congestion too.
+  depthai_ctrl::CongestionSample delayed = drops;
+  delayed.roundTripMs = 20.0;
+  EXPECT_EQ(controller.Update(delayed, 26500), 800000);
+  delayed.roundTripMs = 300.0;
+  EXPECT_EQ(controller.Update(delayed, 27000), 560000);
+  EXPECT_EQ(controller.GetDecreases(), 7UL);
+  EXPECT_EQ(controller.GetIncreases(), 2UL);
+
+  controller.SetRange(500000, 2000000);
+  EXPECT_EQ(controller.GetTarget(), 2000000);
+
+  depthai_ctrl::BitrateHysteresis hysteresis(0.15, 1000);
+  EXPECT_FALSE(hysteresis.Apply(3000000, 2800000, 0));
+  EXPECT_TRUE(hysteresis.Apply(3000000, 2100000, 0));
+  EXPECT_FALSE(hysteresis.Apply(2100000, 1500000, 500));
+  EXPECT_TRUE(hysteresis.Apply(2100000, 1500000, 1000));
+  // Increases wait twice as long.
+  EXPECT_FALSE(hysteresis.Apply(1500000, 2000000, 2500));
+  EXPECT_TRUE(hysteresis.Apply(1500000, 2000000, 3000));
+}
+
+/// Drops every fourth RTP packet received by a client, RTCP passes
+static GstPadProbeReturn DropRtpProbe(GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  (void)info;
+  auto * packets = static_cast<std::atomic<int> *>(data);
+  GstCaps * caps = gst_pad_get_current_caps(pad);
+  const bool rtp = caps != nullptr &&
+    gst_structure_has_name(gst_caps_get_structure(caps, 0), "application/x-rtp");
+  if (caps != nullptr) {
+    gst_caps_unref(caps);
+  }
+  return (rtp && (*packets)++ % 4 == 0) ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+}
+
+/// GstBin "deep-element-added", makes the UDP sources of rtspsrc lossy
+static void AddLossyUdpSource(GstBin * bin, GstBin * subBin, GstElement * element, gpointer data)
+{
+  (void)bin;
+  (void)subBin;
+  GstElementFactory * factory = gst_element_get_factory(element);
+  if (factory == nullptr ||
+    std::string(gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory))) != "udpsrc")
+  {
+    return;
+  }
+  GstPad * pad = gst_element_get_static_pad(element, "src");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, DropRtpProbe, data, nullptr);
+  gst_object_unref(pad);
+}
+
+/// Adaptive bitrate against a local lossy loopback: an RTSP client over UDP loses a quarter
+/// of the packets, its receiver reports lower the target bitrate
+TEST(AdaptiveBitrateTest, LossyLoopback)
+{
+  depthai_ctrl::GstInterface gst(0, nullptr);
+  gst.SetStreamAddress("");
+  gst.SetRtspServer(8557, "/lossy");
+  gst.SetPipelineDataWaitMs(0);
+  depthai_ctrl::BitrateControllerConfig config{};
+  config.minBitrate = 500000;
+  config.maxBitrate = 3000000;
+  config.decreaseIntervalMs = 1000;
+  gst.SetAdaptiveBitrate(config);
+  gst.StartStream();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!gst.IsStreamPlaying() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_TRUE(gst.IsStreamPlaying());
+  // Nobody is watching yet, there is nothing to react to.
+  EXPECT_EQ(gst.UpdateTargetBitrate(), 3000000);
+
+  const std::string launch = "rtspsrc location=" + gst.GetRtspServerUrl() +
+    " protocols=udp latency=0 ! rtph264depay ! fakesink sync=false";
+  GstElement * client = gst_parse_launch(launch.c_str(), nullptr);
+  ASSERT_NE(client, nullptr);
+  std::atomic<int> packets{0};
+  g_signal_connect(client, "deep-element-added", G_CALLBACK(AddLossyUdpSource), &packets);
+  gst_element_set_state(client, GST_STATE_PLAYING);
+
+  // Receiver reports follow every few seconds.
+  deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+  while (gst.GetTargetBitrate() == 3000000 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    gst.UpdateTargetBitrate();
+  }
+  const depthai_ctrl::CongestionSample congestion = gst.GetCongestion();
+  std::cout << "Fraction lost " << congestion.fractionLost << ", target bitrate " <<
+    gst.GetTargetBitrate() << std::endl;
+  EXPECT_GT(packets.load(), 0);
+  EXPECT_GT(congestion.fractionLost, 0.1);
+  EXPECT_LT(gst.GetTargetBitrate(), 3000000);
+  EXPECT_GE(gst.GetTargetBitrate(), 500000);
+  EXPECT_GE(gst.GetBitrateDecreases(), 1UL);
+
+  // The camera node reboots for the lower target, its frames stop for longer than the frame
+  // timeout. The announced reboot does not restart the pipeline, neither when the frames
+  // stop nor when they are back. The camera is simulated, this stream is the default one.
+  depthai_ctrl::BitrateHysteresis hysteresis;
+  ASSERT_TRUE(hysteresis.Apply(3000000, gst.GetTargetBitrate(), 0));
+  depthai_ctrl::StreamStateMachineConfig state_config{};
+  state_config.seed = 1;
+  depthai_ctrl::StreamStateMachine stream_state(state_config);
+  int restarts = 0;
+  auto run_for = [&](std::chrono::milliseconds duration, bool frames) {
+      const auto end = std::chrono::steady_clock::now() + duration;
+      while (std::chrono::steady_clock::now() < end) {
+        const auto now = depthai_ctrl::StreamStateMachine::Clock::now();
+        if (frames) {
+          stream_state.OnFrame(now);
+        }
+        // Restarts are executed like the GStreamer node does.
+        for (const auto & transition : stream_state.Process(now)) {
+          if (transition.action == depthai_ctrl::StreamAction::Restart) {
+            restarts++;
+            gst.StopStream();
+            gst.StartStream();
+          }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+      }
+    };
+  stream_state.Post(depthai_ctrl::StreamEvent::StartRequested);
+  stream_state.Post(depthai_ctrl::StreamEvent::PipelinePlaying);
+  run_for(std::chrono::milliseconds(500), true);
+  ASSERT_EQ(stream_state.GetState(), depthai_ctrl::StreamState::Playing);
+  stream_state.Post(depthai_ctrl::StreamEvent::CameraRebooting);
+  run_for(std::chrono::milliseconds(1500), false);
+  stream_state.Post(depthai_ctrl::StreamEvent::CameraRebooted);
+  run_for(std::chrono::milliseconds(1000), true);
+  EXPECT_EQ(restarts, 0);
+  EXPECT_EQ(stream_state.GetState(), depthai_ctrl::StreamState::Playing);
+  EXPECT_TRUE(gst.IsStreamPlaying());
+
+  gst_element_set_state(client, GST_STATE_NULL);
+  gst_object_unref(client);
+  gst.StopStream();
+}
+
+/// Boot-to-video time counts from the process start to the first camera packet,
+/// the default stream played before it does not count
+TEST(BootTimeTest, TimeToFirstPacket)
+{
+  const auto chunks = EncodeTestChunks(25, 25);
+  ASSERT_EQ(chunks.size(), 25UL);
+
+  depthai_ctrl::GstInterface gst(0, nullptr);
+  gst.SetStreamAddress("udp://127.0.0.1:5604");
+  gst.SetHotStandby(true);
+  gst.StartStream();
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!gst.IsStreamPlaying() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_TRUE(gst.IsStreamPlaying());
+  EXPECT_GT(CountUdpPackets(5604, std::chrono::milliseconds(500)), 0);
+  EXPECT_EQ(gst.GetTimeToFirstPacketMs(), -1);
+
+  const int64_t before = depthai_ctrl::DepthAIUtils::GetProcessUptimeMs();
+  for (const auto & chunk : chunks) {
+    gst.PushFrame(chunk);
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  }
+  const int64_t after = depthai_ctrl::DepthAIUtils::GetProcessUptimeMs();
+  std::cout << "Time to first packet " << gst.GetTimeToFirstPacketMs() << " ms" << std::endl;
+  EXPECT_GE(gst.GetTimeToFirstPacketMs(), before);
+  EXPECT_LE(gst.GetTimeToFirstPacketMs(), after);
+}
+
 #ifdef MULTI_THREADING_FIXED
 /// Same as before, but UDP address is set
 TEST_F(DepthAIGStreamerTest, StartOnBoot_UDPTest)
@@ -292,6 +1275,48 @@ TEST_F(DepthAIGStreamerTest, StartOnBoot_UDPTest)
   ASSERT_NO_THROW(gstreamer_node.reset());
 }
 
+/// Push-mode appsrc streams the camera chunks, the stream is stopped and restarted
+/// while the chunks keep being pushed
+TEST(PushModeTest, StopRestartWhilePushing)
+{
+  const auto chunks = EncodeTestChunks(50, 25);
+  ASSERT_EQ(chunks.size(), 50UL);
+
+  depthai_ctrl::GstInterface gst(0, nullptr);
+  gst.SetPushMode(true);
+  gst.SetStreamAddress("udp://127.0.0.1:5605");
+  gst.SetPipelineDataWaitMs(2000);
+
+  // Same producer thread as the ROS2 video subscriber, the timestamps keep increasing.
+  std::atomic<bool> feeding{true};
+  std::thread feeder([&] {
+      int64_t frame = 0;
+      while (feeding) {
+        auto chunk = std::make_shared<CompressedImageMsg>(*chunks[frame % chunks.size()]);
+        chunk->header.stamp = rclcpp::Time(frame * 40000000LL, RCL_STEADY_TIME);
+        gst.PushFrame(chunk);
+        frame++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+      }
+    });
+
+  for (int run = 0; run < 2; run++) {
+    gst.StartStream();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!gst.IsStreamPlaying() && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(gst.IsStreamPlaying());
+    EXPECT_FALSE(gst.IsStreamDefault());
+    EXPECT_TRUE(gst.IsPushMode());
+    EXPECT_GT(CountUdpPackets(5605, std::chrono::milliseconds(1000)), 0);
+    gst.StopStream();
+    EXPECT_FALSE(gst.IsStreamPlaying());
+  }
+  feeding = false;
+  feeder.join();
+}
+
 /// Same as before, but H265 encoding is set
 TEST_F(DepthAIGStreamerTest, StartOnBoot_H265Test)
 {
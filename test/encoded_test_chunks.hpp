@@ -0,0 +1,75 @@
+#ifndef FOG_SW_DEPTHAI_ENCODED_TEST_CHUNKS_H
+#define FOG_SW_DEPTHAI_ENCODED_TEST_CHUNKS_H
+#include <gst/app/gstappsink.h>
+#include <gst/gst.h>
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/compressed_image.hpp>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Synthetic camera output for the tests and benchmarks, without a device
+struct TestChunkConfig
+{
+  std::string codec = "H264";
+  int width = 1280;
+  int height = 720;
+  int fps = 25;
+  int bitrateKbps = 0;  ///< Encoder default if 0
+  int frames = 50;
+  int gop = 25;
+};
+
+/// Encode a videotestsrc sequence with x264enc/x265enc, one chunk per access unit like
+/// the camera output. The chunks are stamped at the frame rate from zero.
+inline std::vector<sensor_msgs::msg::CompressedImage::SharedPtr> EncodeTestChunks(
+  const TestChunkConfig & config)
+{
+  std::vector<sensor_msgs::msg::CompressedImage::SharedPtr> chunks;
+  const bool h265 = (config.codec == "H265");
+  std::string encoder = h265 ?
+    "x265enc tune=zerolatency speed-preset=superfast" :
+    "x264enc tune=zerolatency speed-preset=superfast";
+  if (config.bitrateKbps > 0) {
+    encoder += " bitrate=" + std::to_string(config.bitrateKbps);
+  }
+  const std::string pipeline_string =
+    "videotestsrc num-buffers=" + std::to_string(config.frames) + " pattern=ball ! "
+    "video/x-raw,format=I420,width=" + std::to_string(config.width) +
+    ",height=" + std::to_string(config.height) +
+    ",framerate=" + std::to_string(config.fps) + "/1 ! " +
+    encoder + " key-int-max=" + std::to_string(config.gop) + " ! " +
+    (h265 ? "video/x-h265" : "video/x-h264") +
+    ",stream-format=byte-stream,alignment=au ! appsink name=sink sync=false";
+  GError * parse_error = nullptr;
+  GstElement * pipeline = gst_parse_launch(pipeline_string.c_str(), &parse_error);
+  if (parse_error != nullptr) {
+    std::cerr << "Encoder pipeline failed: " << parse_error->message << std::endl;
+    g_error_free(parse_error);
+    return chunks;
+  }
+  GstElement * sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+  gst_element_set_state(pipeline, GST_STATE_PLAYING);
+  const int64_t period_ns = 1000000000LL / config.fps;
+  GstSample * sample;
+  while ((sample = gst_app_sink_pull_sample(GST_APP_SINK(sink))) != nullptr) {
+    GstMapInfo map;
+    GstBuffer * buffer = gst_sample_get_buffer(sample);
+    gst_buffer_map(buffer, &map, GST_MAP_READ);
+    auto chunk = std::make_shared<sensor_msgs::msg::CompressedImage>();
+    chunk->format = config.codec;
+    chunk->header.frame_id = "color_camera_frame";
+    chunk->header.stamp = rclcpp::Time((int64_t)chunks.size() * period_ns, RCL_STEADY_TIME);
+    chunk->data.assign(map.data, map.data + map.size);
+    gst_buffer_unmap(buffer, &map);
+    gst_sample_unref(sample);
+    chunks.push_back(chunk);
+  }
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(sink);
+  gst_object_unref(pipeline);
+  return chunks;
+}
+
+#endif  // FOG_SW_DEPTHAI_ENCODED_TEST_CHUNKS_H
@@ -0,0 +1,333 @@
+#include <gstreamer_interface.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "encoded_test_chunks.hpp"
+
+using CompressedImageMsg = sensor_msgs::msg::CompressedImage;
+using depthai_ctrl::LatencyHistogram;
+
+/// Streaming benchmark of GstInterface with a synthetic camera, runs without a device.
+/// Chunks are encoded up front with x264enc/x265enc, then published at the camera rate
+/// through an intra-process topic to a subscriber doing what DepthAIGStreamer::GrabVideoMsg
+/// does. The appsrc need-data callback feeds the UDP pipeline, and a loopback receiver
+/// counts the RTP frames.
+///
+/// Usage: gstreamer_interface_benchmark [H264|H265] [width] [height] [fps] [bitrate_kbps]
+///                                      [frames] [push_mode]
+/// Exits with 1 if the sustained frame rate is below 95 % of the requested one.
+
+namespace
+{
+
+/// Every heap allocation of the process, C++ and GLib, counted through the glibc entry points.
+std::atomic<uint64_t> g_allocations {0};
+std::atomic<uint64_t> g_allocatedBytes {0};
+
+}  // namespace
+
+extern "C" {
+void * __libc_malloc(size_t size);
+void * __libc_calloc(size_t count, size_t size);
+void * __libc_realloc(void * ptr, size_t size);
+
+void * malloc(size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void * calloc(size_t count, size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocatedBytes.fetch_add(count * size, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+void * realloc(void * ptr, size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+}
+
+namespace
+{
+
+struct BenchmarkConfig
+{
+  std::string codec = "H264";
+  int width = 1280;
+  int height = 720;
+  int fps = 30;
+  int bitrateKbps = 4000;
+  uint64_t frames = 600;
+  bool pushMode = false;
+  int udpPort = 5610;
+};
+
+struct BenchmarkResult
+{
+  uint64_t published = 0;
+  uint64_t received = 0;
+  uint64_t queueDropped = 0;
+  double streamSeconds = 0.0;
+  double cpuSeconds = 0.0;
+  double producerWaitSeconds = 0.0;
+  uint64_t allocations = 0;
+  uint64_t allocatedBytes = 0;
+  LatencyHistogram latency {};
+  LatencyHistogram pushFrame {};
+};
+
+double ProcessCpuSeconds()
+{
+  timespec ts{};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int64_t ThreadCpuNs()
+{
+  timespec ts{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int64_t NowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Receive the RTP stream on the loopback port. The marker bit ends an access unit,
+/// the frame index follows from the 90 kHz RTP timestamp of the first one.
+void ReceiveFrames(
+  const BenchmarkConfig & config, const std::vector<std::atomic<int64_t>> & publishedNs,
+  std::atomic<bool> & running, std::atomic<uint64_t> & received, LatencyHistogram & latency,
+  std::atomic<int64_t> & lastReceivedNs)
+{
+  const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons((uint16_t)config.udpPort);
+  const int bufferSize = 8 * 1024 * 1024;
+  setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+  timeval timeout{0, 100000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  if (bind(sock, (sockaddr *)&address, sizeof(address)) != 0) {
+    std::cerr << "Cannot bind UDP port " << config.udpPort << std::endl;
+    close(sock);
+    return;
+  }
+  std::vector<uint8_t> packet(65536);
+  bool haveFirst = false;
+  uint32_t firstTimestamp = 0;
+  while (running) {
+    const ssize_t size = recv(sock, packet.data(), packet.size(), 0);
+    if (size < 12 || (packet[1] & 0x80) == 0) {
+      continue;
+    }
+    const int64_t now = NowNs();
+    const uint32_t timestamp =
+      ((uint32_t)packet[4] << 24) | ((uint32_t)packet[5] << 16) |
+      ((uint32_t)packet[6] << 8) | (uint32_t)packet[7];
+    if (!haveFirst) {
+      haveFirst = true;
+      firstTimestamp = timestamp;
+    }
+    const uint64_t index =
+      ((uint64_t)(uint32_t)(timestamp - firstTimestamp) * config.fps + 45000) / 90000;
+    if (index < publishedNs.size() && publishedNs[index] != 0) {
+      latency.Record(now - publishedNs[index]);
+    }
+    received++;
+    lastReceivedNs = now;
+  }
+  close(sock);
+}
+
+/// The result holds lock-free histograms, it is filled in place
+void RunBenchmark(
+  const BenchmarkConfig & config,
+  const std::vector<CompressedImageMsg::SharedPtr> & chunks, BenchmarkResult & result)
+{
+  depthai_ctrl::GstInterface gst(0, nullptr);
+  gst.SetEncoderProfile(config.codec);
+  // The caps of the camera branch follow the encoder size, not the chunks.
+  gst.SetEncoderWidth(config.width);
+  gst.SetEncoderHeight(config.height);
+  gst.SetEncoderFps(config.fps);
+  gst.SetEncoderBitrate(config.bitrateKbps * 1000);
+  gst.SetPushMode(config.pushMode);
+  gst.SetStreamAddress("udp://127.0.0.1:" + std::to_string(config.udpPort));
+
+  std::vector<std::atomic<int64_t>> publishedNs(chunks.size());
+  std::atomic<bool> running{true};
+  std::atomic<uint64_t> received{0};
+  std::atomic<int64_t> lastReceivedNs{0};
+  std::thread receiver(
+    ReceiveFrames, std::cref(config), std::cref(publishedNs), std::ref(running),
+    std::ref(received), std::ref(result.latency), std::ref(lastReceivedNs));
+
+  rclcpp::NodeOptions options;
+  options.use_intra_process_comms(true);
+  auto node = std::make_shared<rclcpp::Node>("gstreamer_interface_benchmark", options);
+  std::atomic<int64_t> producerWaitNs{0};
+  auto publisher = node->create_publisher<CompressedImageMsg>(
+    "benchmark/video", rclcpp::QoS(rclcpp::KeepLast(10)));
+  auto subscription = node->create_subscription<CompressedImageMsg>(
+    "benchmark/video", rclcpp::QoS(rclcpp::KeepLast(10)),
+    [&](CompressedImageMsg::UniquePtr msg) {
+      // Same hand-off as DepthAIGStreamer::GrabVideoMsg.
+      const CompressedImageMsg::SharedPtr shared = std::move(msg);
+      const int64_t wallStart = NowNs();
+      const int64_t cpuStart = ThreadCpuNs();
+      gst.PushFrame(shared);
+      const int64_t wall = NowNs() - wallStart;
+      const int64_t cpu = ThreadCpuNs() - cpuStart;
+      result.pushFrame.Record(wall);
+      // Time off the CPU inside PushFrame is spent waiting, for locks or the pipeline.
+      producerWaitNs += std::max<int64_t>(0, wall - cpu);
+    });
+  rclcpp::executors::SingleThreadedExecutor exec;
+  exec.add_node(node);
+  std::thread spinThread([&exec] {exec.spin();});
+
+  // The first chunk makes CreatePipeline build the camera pipeline right away.
+  const auto period = std::chrono::nanoseconds(1000000000LL / config.fps);
+  auto next = std::chrono::steady_clock::now();
+  auto publish = [&](uint64_t i) {
+      // The publisher gets its own copy, like the encoder callback filling a new message.
+      auto chunk = std::make_unique<CompressedImageMsg>(*chunks[i]);
+      publishedNs[i] = NowNs();
+      publisher->publish(std::move(chunk));
+      result.published++;
+    };
+  publish(0);
+  gst.StartStream();
+
+  const uint64_t allocationsStart = g_allocations;
+  const uint64_t allocatedBytesStart = g_allocatedBytes;
+  const double cpuStart = ProcessCpuSeconds();
+  const int64_t streamStartNs = NowNs();
+  for (uint64_t i = 1; i < chunks.size(); i++) {
+    next += period;
+    std::this_thread::sleep_until(next);
+    publish(i);
+  }
+  // Drain: wait until the receiver has been idle for a while.
+  const auto drainDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+  while (std::chrono::steady_clock::now() < drainDeadline &&
+    (received < chunks.size()) &&
+    (lastReceivedNs == 0 || NowNs() - lastReceivedNs < 500000000LL))
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  const int64_t lastNs = lastReceivedNs;
+  result.streamSeconds = ((lastNs != 0 ? lastNs : NowNs()) - streamStartNs) * 1e-9;
+  result.cpuSeconds = ProcessCpuSeconds() - cpuStart;
+  result.allocations = g_allocations - allocationsStart;
+  result.allocatedBytes = g_allocatedBytes - allocatedBytesStart;
+  result.received = received;
+  result.queueDropped = gst.GetQueueDroppedFrames();
+  result.producerWaitSeconds = producerWaitNs * 1e-9;
+
+  gst.StopStream();
+  exec.cancel();
+  spinThread.join();
+  running = false;
+  receiver.join();
+}
+
+void PrintResult(const BenchmarkConfig & config, const BenchmarkResult & result)
+{
+  const double fps = result.streamSeconds > 0.0 ? result.received / result.streamSeconds : 0.0;
+  const double frames = result.published > 0 ? (double)result.published : 1.0;
+  std::cout << "Frames: published " << result.published << ", received " << result.received
+            << ", queue dropped " << result.queueDropped << std::endl;
+  std::cout << "Sustained: " << fps << " fps (target " << config.fps << ")" << std::endl;
+  std::cout << "Latency publish -> UDP: p50 " << result.latency.Percentile(0.50)
+            << " ms, p95 " << result.latency.Percentile(0.95)
+            << " ms, p99 " << result.latency.Percentile(0.99) << " ms" << std::endl;
+  std::cout << "CPU: " << result.cpuSeconds * 1e6 / frames << " us/frame, load "
+            << (result.streamSeconds > 0.0 ? 100.0 * result.cpuSeconds / result.streamSeconds : 0.0)
+            << " %" << std::endl;
+  std::cout << "PushFrame: p50 " << result.pushFrame.Percentile(0.50) * 1000.0
+            << " us, p99 " << result.pushFrame.Percentile(0.99) * 1000.0
+            << " us, waiting " << result.producerWaitSeconds * 1e6 / frames << " us/frame"
+            << std::endl;
+  std::cout << "Allocations: " << result.allocations / frames << " per frame, "
+            << result.allocatedBytes / frames << " bytes per frame" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char * argv[])
+{
+  BenchmarkConfig config{};
+  if (argc > 1) {config.codec = argv[1];}
+  if (argc > 2) {config.width = atoi(argv[2]);}
+  if (argc > 3) {config.height = atoi(argv[3]);}
+  if (argc > 4) {config.fps = atoi(argv[4]);}
+  if (argc > 5) {config.bitrateKbps = atoi(argv[5]);}
+  if (argc > 6) {config.frames = strtoull(argv[6], nullptr, 10);}
+  if (argc > 7) {config.pushMode = atoi(argv[7]) != 0;}
+  if ((config.codec != "H264" && config.codec != "H265") || config.fps <= 0 ||
+    config.fps > 60 || config.frames < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " [H264|H265] [width] [height] [fps <= 60] "
+              << "[bitrate_kbps] [frames >= 2] [push_mode]" << std::endl;
+    return 2;
+  }
+
+  gst_init(&argc, &argv);
+  rclcpp::init(argc, argv);
+  std::cout << config.codec << " " << config.width << "x" << config.height << " @ "
+            << config.fps << " fps, " << config.bitrateKbps << " kbit/s, "
+            << config.frames << " frames, " << (config.pushMode ? "push" : "pull")
+            << " mode" << std::endl;
+
+  const auto encodeStart = std::chrono::steady_clock::now();
+  TestChunkConfig chunkConfig;
+  chunkConfig.codec = config.codec;
+  chunkConfig.width = config.width;
+  chunkConfig.height = config.height;
+  chunkConfig.fps = config.fps;
+  chunkConfig.bitrateKbps = config.bitrateKbps;
+  chunkConfig.frames = (int)config.frames;
+  chunkConfig.gop = config.fps;
+  const auto chunks = EncodeTestChunks(chunkConfig);
+  if (chunks.size() < 2) {
+    std::cerr << "Encoding the synthetic sequence failed." << std::endl;
+    return 2;
+  }
+  size_t totalBytes = 0;
+  for (const auto & chunk : chunks) {
+    totalBytes += chunk->data.size();
+  }
+  std::cout << "Encoded " << chunks.size() << " chunks in "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - encodeStart).count()
+            << " s, " << totalBytes / chunks.size() << " bytes on average" << std::endl;
+
+  BenchmarkResult result{};
+  RunBenchmark(config, chunks, result);
+  PrintResult(config, result);
+
+  rclcpp::shutdown();
+  const double fps = result.streamSeconds > 0.0 ? result.received / result.streamSeconds : 0.0;
+  return fps >= config.fps * 0.95 ? 0 : 1;
+}
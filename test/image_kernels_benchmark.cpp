@@ -0,0 +1,111 @@
+#include <image_kernels.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using depthai_ctrl::OutputEncoding;
+using depthai_ctrl::PixelFormat;
+using depthai_ctrl::SimdLevel;
+
+/// Microbenchmark of the raw image conversion kernels used by DepthAICamera.
+/// Every layout and output encoding is converted with the scalar reference and with the
+/// SIMD kernels of the running CPU. The outputs are compared byte by byte.
+///
+/// Usage: image_kernels_benchmark [width] [height] [iterations]
+/// Exits with 1 if a SIMD output differs from the scalar reference.
+
+namespace
+{
+
+const char * FormatName(PixelFormat format)
+{
+  switch (format) {
+    case PixelFormat::NV12: return "NV12";
+    case PixelFormat::YUV422i: return "YUV422i";
+    case PixelFormat::BGR888p: return "BGR888p";
+    case PixelFormat::RGB888p: return "RGB888p";
+    case PixelFormat::BGR888i: return "BGR888i";
+    case PixelFormat::RGB888i: return "RGB888i";
+    default: return "GRAY8";
+  }
+}
+
+const char * LevelName(SimdLevel level)
+{
+  switch (level) {
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::NEON: return "NEON";
+    default: return "scalar";
+  }
+}
+
+/// Return the mean time of one conversion in microseconds
+double Measure(
+  PixelFormat format, OutputEncoding encoding, SimdLevel level,
+  const std::vector<uint8_t> & src, uint32_t width, uint32_t height,
+  std::vector<uint8_t> & dst, int iterations)
+{
+  // One untimed pass to fault in the destination pages
+  depthai_ctrl::ConvertPixels(format, encoding, src.data(), width, height, dst.data(), level);
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    depthai_ctrl::ConvertPixels(format, encoding, src.data(), width, height, dst.data(), level);
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+}
+
+}  // namespace
+
+int main(int argc, char * argv[])
+{
+  const uint32_t width = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1920;
+  const uint32_t height = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1080;
+  const int iterations = argc > 3 ? atoi(argv[3]) : 100;
+  const SimdLevel level = depthai_ctrl::image_kernels::DetectSimdLevel();
+
+  std::cout << "Frame " << width << "x" << height << ", " << iterations <<
+    " iterations, SIMD level " << LevelName(level) << std::endl;
+
+  const PixelFormat formats[] = {
+    PixelFormat::NV12, PixelFormat::YUV422i, PixelFormat::BGR888p, PixelFormat::RGB888p,
+    PixelFormat::BGR888i, PixelFormat::RGB888i, PixelFormat::GRAY8};
+  const OutputEncoding encodings[] = {
+    OutputEncoding::BGR8, OutputEncoding::RGB8, OutputEncoding::Mono8};
+
+  bool identical = true;
+  for (PixelFormat format : formats) {
+    std::vector<uint8_t> src(depthai_ctrl::image_kernels::InputSize(format, width, height));
+    uint32_t seed = 1;
+    for (uint8_t & value : src) {
+      seed = seed * 1103515245 + 12345;
+      value = (uint8_t)(seed >> 16);
+    }
+    for (OutputEncoding encoding : encodings) {
+      const size_t outputSize = depthai_ctrl::image_kernels::OutputSize(encoding, width, height);
+      std::vector<uint8_t> reference(outputSize), simd(outputSize);
+      if (!depthai_ctrl::ConvertPixels(
+          format, encoding, src.data(), width, height, reference.data(),
+          SimdLevel::Scalar))
+      {
+        std::cerr << "Cannot convert " << FormatName(format) << " of " << width << "x" <<
+          height << std::endl;
+        return 1;
+      }
+      const double scalarUs = Measure(
+        format, encoding, SimdLevel::Scalar, src, width, height, reference, iterations);
+      const double simdUs = Measure(format, encoding, level, src, width, height, simd, iterations);
+      const bool same = std::memcmp(reference.data(), simd.data(), outputSize) == 0;
+      identical = identical && same;
+
+      std::cout << FormatName(format) << " -> " <<
+        depthai_ctrl::image_kernels::EncodingName(encoding) << ": scalar " << scalarUs <<
+        " us, " << LevelName(level) << " " << simdUs << " us, speedup " <<
+        scalarUs / simdUs << "x" << (same ? "" : ", OUTPUT DIFFERS") << std::endl;
+    }
+  }
+  return identical ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/compressed_image.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using CompressedImageMsg = sensor_msgs::msg::CompressedImage;
+
+/// Compares the intra-process video path used by the combined depthai_ctrl binary with
+/// the regular (serialized) path. The publisher side mimics DepthAICamera::onVideoEncoderCallback
+/// and the subscriber side mimics DepthAIGStreamer::GrabVideoMsg, using the same QoS.
+///
+/// Usage: intra_process_benchmark [chunk_size_bytes] [fps] [frames]
+///   fps = 0 publishes as fast as possible.
+
+namespace
+{
+
+struct BenchmarkResult
+{
+  uint64_t published = 0;
+  uint64_t received = 0;
+  uint64_t zeroCopy = 0;
+  double wallSeconds = 0.0;
+  double cpuSeconds = 0.0;
+};
+
+double ProcessCpuSeconds()
+{
+  timespec ts{};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+BenchmarkResult RunBenchmark(bool intraProcess, size_t chunkSize, int fps, uint64_t frames)
+{
+  rclcpp::NodeOptions options;
+  options.use_intra_process_comms(intraProcess);
+  auto publisherNode = std::make_shared<rclcpp::Node>("benchmark_camera", options);
+  auto subscriberNode = std::make_shared<rclcpp::Node>("benchmark_gstreamer", options);
+
+  std::atomic<uint64_t> received{0};
+  std::atomic<uint64_t> zeroCopy{0};
+  // Storage pointer of every published chunk, indexed by the frame number in the stamp.
+  std::vector<std::atomic<const uint8_t *>> publishedData(frames);
+
+  auto publisher = publisherNode->create_publisher<CompressedImageMsg>(
+    "benchmark/video", rclcpp::QoS(rclcpp::KeepLast(10)));
+  auto subscription = subscriberNode->create_subscription<CompressedImageMsg>(
+    "benchmark/video", rclcpp::QoS(rclcpp::KeepLast(10)),
+    [&](CompressedImageMsg::UniquePtr msg) {
+      // Same storage as published means no copy happened on the way.
+      const uint64_t index = rclcpp::Time(msg->header.stamp).nanoseconds() / 40000000LL;
+      if (index < publishedData.size() && msg->data.data() == publishedData[index].load()) {
+        zeroCopy++;
+      }
+      const CompressedImageMsg::SharedPtr shared = std::move(msg);
+      received++;
+    });
+
+  rclcpp::executors::MultiThreadedExecutor exec;
+  exec.add_node(subscriberNode);
+  std::thread spinThread([&exec] {exec.spin();});
+
+  // Let discovery settle for the inter-process path.
+  while (publisher->get_subscription_count() == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  BenchmarkResult result{};
+  const auto period = fps > 0 ?
+    std::chrono::nanoseconds(1000000000LL / fps) : std::chrono::nanoseconds(0);
+  const double cpuStart = ProcessCpuSeconds();
+  const auto wallStart = std::chrono::steady_clock::now();
+  auto next = wallStart;
+
+  for (uint64_t i = 0; i < frames; i++) {
+    auto chunk = std::make_unique<CompressedImageMsg>();
+    chunk->header.frame_id = "color_camera_frame";
+    chunk->header.stamp = rclcpp::Time((int64_t)i * 40000000LL, RCL_STEADY_TIME);
+    chunk->format = "H264";
+    chunk->data.resize(chunkSize);
+    // Touch the payload so the pages are really allocated, as with a real encoder output.
+    memset(chunk->data.data(), (int)(i & 0xff), chunkSize);
+    publishedData[i] = chunk->data.data();
+    publisher->publish(std::move(chunk));
+    result.published++;
+    if (fps > 0) {
+      next += period;
+      std::this_thread::sleep_until(next);
+    }
+  }
+
+  // Give the subscriber a moment to drain.
+  const auto drainDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (received < frames && std::chrono::steady_clock::now() < drainDeadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  result.wallSeconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  result.cpuSeconds = ProcessCpuSeconds() - cpuStart;
+  result.received = received;
+  result.zeroCopy = zeroCopy;
+
+  exec.cancel();
+  spinThread.join();
+  return result;
+}
+
+void PrintResult(const std::string & name, const BenchmarkResult & result)
+{
+  const double fps = result.wallSeconds > 0.0 ? result.received / result.wallSeconds : 0.0;
+  const double cpuPerFrameUs = result.received > 0 ?
+    result.cpuSeconds * 1e6 / result.received : 0.0;
+  const double cpuLoad = result.wallSeconds > 0.0 ?
+    100.0 * result.cpuSeconds / result.wallSeconds : 0.0;
+  std::cout << name << ": published " << result.published
+            << ", received " << result.received
+            << " (zero-copy " << result.zeroCopy << ")"
+            << ", " << fps << " fps"
+            << ", CPU " << cpuPerFrameUs << " us/frame"
+            << ", CPU load " << cpuLoad << " %" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char * argv[])
+{
+  const size_t chunkSize = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+  const int fps = argc > 2 ? atoi(argv[2]) : 0;
+  const uint64_t frames = argc > 3 ? strtoull(argv[3], nullptr, 10) : 2000;
+
+  rclcpp::init(argc, argv);
+  std::cout << "Video chunk size " << chunkSize << " bytes, "
+            << (fps > 0 ? std::to_string(fps) + " fps" : std::string("unthrottled"))
+            << ", " << frames << " frames" << std::endl;
+
+  PrintResult("Inter-process path", RunBenchmark(false, chunkSize, fps, frames));
+  PrintResult("Intra-process path", RunBenchmark(true, chunkSize, fps, frames));
+
+  rclcpp::shutdown();
+  return 0;
+}